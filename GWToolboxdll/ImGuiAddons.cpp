@@ -2,6 +2,7 @@
 #include "stdafx.h"
 
 #include <ImGuiAddons.h>
+#include <Utils/TextureAtlas.h>
 #include <string>
 #include <Keys.h>
 
@@ -639,6 +640,40 @@ namespace ImGui {
         GetWindowDrawList()->AddImage(user_texture_id, top_left, bottom_right, {0, 0}, CalculateUvCrop(user_texture_id, size));
     }
 
+    // As CalculateUvCrop, within the icon's part of its page; the size comes from the icon rather than the texture
+    ImVec2 CalculateIconUvCrop(const TextureAtlas::Icon& icon, const ImVec2& size)
+    {
+        ImVec2 uv1 = icon.uv1;
+        if (!(icon.width && icon.height && size.x > 0.f && size.y > 0.f))
+            return uv1;
+        const float image_ratio = static_cast<float>(icon.width) / static_cast<float>(icon.height);
+        const float container_ratio = size.x / size.y;
+        if (image_ratio < container_ratio) {
+            uv1.y = icon.uv0.y + (icon.uv1.y - icon.uv0.y) * image_ratio / container_ratio;
+        }
+        else if (image_ratio > container_ratio) {
+            uv1.x = icon.uv0.x + (icon.uv1.x - icon.uv0.x) * container_ratio / image_ratio;
+        }
+        return uv1;
+    }
+
+    void Icon(const TextureAtlas::Icon* icon, const ImVec2& size)
+    {
+        if (!(icon && icon->texture)) {
+            Dummy(size);
+            return;
+        }
+        Image(icon->texture, size, icon->uv0, CalculateIconUvCrop(*icon, size));
+    }
+
+    void AddIcon(ImDrawList* draw_list, const TextureAtlas::Icon* icon, const ImVec2& top_left, const ImVec2& bottom_right)
+    {
+        if (!(icon && icon->texture))
+            return;
+        const ImVec2 size = {bottom_right.x - top_left.x, bottom_right.y - top_left.y};
+        draw_list->AddImage(icon->texture, top_left, bottom_right, icon->uv0, CalculateIconUvCrop(*icon, size));
+    }
+
     bool ColorPalette(const char* label, size_t* palette_index, const ImVec4* palette, const size_t count, const size_t max_per_line, const ImGuiColorEditFlags flags)
     {
         PushID(label);
@@ -2,6 +2,10 @@
 
 using Color = ImU32;
 
+namespace TextureAtlas {
+    struct Icon;
+}
+
 constexpr uint32_t ImGuiButtonFlags_AlignTextLeft = 1 << 20;
 
 namespace ImGui {
@@ -94,6 +98,10 @@ namespace ImGui {
     IMGUI_API void AddImageCropped(ImTextureID user_texture_id, const ImVec2& top_left, const ImVec2& bottom_right);
     // Calculate the end position of a crop box for the given texture to fit into the given size
     IMGUI_API ImVec2 CalculateUvCrop(ImTextureID user_texture_id, const ImVec2& size);
+    // Add cropped atlas icon to current window; consecutive icons on the same page share one draw command
+    IMGUI_API void Icon(const TextureAtlas::Icon* icon, const ImVec2& size);
+    // Add cropped atlas icon to the given draw list
+    IMGUI_API void AddIcon(ImDrawList* draw_list, const TextureAtlas::Icon* icon, const ImVec2& top_left, const ImVec2& bottom_right);
 
     IMGUI_API bool ColorPalette(const char* label, size_t* palette_index, const ImVec4* palette, size_t count, size_t max_per_line, ImGuiColorEditFlags flags);
 
@@ -9,6 +9,9 @@
 #include "Resources.h"
 #include <GWCA/Managers/MemoryMgr.h>
 #include <Utils/ArenaNetFileParser.h>
+#include <ImageDecoder.h>
+#include <Utils/TextureAtlas.h>
+#include <Utils/TextureCache.h>
 
 namespace {
 
@@ -94,15 +97,43 @@ namespace {
         return NULL;
     }
 
-    // OpenImage converts any GW format to ARGB. It is possible to skip conversion if gw format is compatible with D3FMT.
-    uint32_t OpenImage(uint32_t file_id, gw_image_bits* dst_bits, Vec2i& dims, int& levels, GR_FORMAT& format)
+    // Uses the game's decoder for what ImageDecoder can't decode itself: DDS, and ATEX textures that aren't DXT1 to DXT5
+    bool OpenImageWithGame(uint8_t* image_bytes, const size_t image_size, ImageDecoder::Image& image)
     {
         uint8_t* pallete = nullptr;
         gw_image_bits bits = nullptr;
+        GR_FORMAT format = GR_FORMATS;
+        Vec2i dims;
+        int levels = 0;
+        const uint32_t result = DecodeImage_func(image_size, image_bytes, &bits, pallete, &format, &dims, &levels);
 
+        if (format >= GR_FORMATS || !result)
+            return false;
+
+        levels = 1;
+
+        gw_image_bits argb = AllocateImage_func(GR_FORMAT_A8R8G8B8, &dims, levels, 0);
+        Depalletize_func((gw_image_bits)&argb, nullptr, GR_FORMAT_A8R8G8B8, nullptr, bits, pallete, format, nullptr, &dims, levels, 0, 0);
+
+        GW::MemoryMgr::MemFree(bits);
+        if (!argb)
+            return false;
+        if (dims.x > 0 && dims.y > 0) {
+            image.width = static_cast<uint32_t>(dims.x);
+            image.height = static_cast<uint32_t>(dims.y);
+            image.levels = {{image.width, image.height, 0}};
+            image.pixels.assign(argb, argb + static_cast<size_t>(dims.x) * dims.y * 4);
+        }
+        GW::MemoryMgr::MemFree(argb);
+        return !image.pixels.empty();
+    }
+
+    // OpenImage converts any GW format to ARGB
+    bool OpenImage(uint32_t file_id, ImageDecoder::Image& image)
+    {
         ArenaNetFileParser::GameAssetFile asset;
         if (!asset.readFromDat(file_id)) 
-            return 0;
+            return false;
 
         uint8_t* image_bytes = asset.data.data();
         size_t image_size = asset.data.size();
@@ -110,92 +141,81 @@ namespace {
         if (strncmp((char*)image_bytes, "ffna", 4) == 0) {
             const auto anet_file = (ArenaNetFileParser::ArenaNetFile*)&asset;
             if (!anet_file->isValid())
-                return 0;
+                return false;
             const auto chunk = (ArenaNetFileParser::UnknownChunk*)anet_file->FindChunk(ArenaNetFileParser::ChunkType::FA3_InlineTextureDXT3);
             if (!chunk) 
-                return 0;
+                return false;
             image_bytes = chunk->data;
             image_size = chunk->chunk_size;
         }
         if (strncmp((char*)image_bytes, "ATEX", 4) != 0 
             && strncmp((char*)image_bytes, "DDS", 3) != 0) {
-            return 0;
+            return false;
         }
 
-        uint32_t result = DecodeImage_func(image_size, image_bytes, &bits, pallete, &format, &dims, &levels);
-
-        if (format >= GR_FORMATS || !result) 
-            return 0;
-
-        levels = 1;
-        
-        *dst_bits = AllocateImage_func(GR_FORMAT_A8R8G8B8, &dims, levels, 0);
-        Depalletize_func((gw_image_bits)dst_bits, nullptr, GR_FORMAT_A8R8G8B8, nullptr, bits, pallete, format, nullptr, &dims, levels, 0, 0);
-
-        GW::MemoryMgr::MemFree(bits);
-
-        // todo: free bytes;
-        return result;
+        std::string error;
+        if (ImageDecoder::Decode({image_bytes, image_size}, image, error) == ImageDecoder::Result::Ok)
+            return true;
+        return OpenImageWithGame(image_bytes, image_size, image);
     }
 
-    // Replace your existing CreateTexture function with this:
-    IDirect3DTexture9* CreateTexture(IDirect3DDevice9* device, uint32_t file_id, Vec2i& dims)
+    // Only the upload; the image is read and decoded on a worker
+    IDirect3DTexture9* CreateTexture(IDirect3DDevice9* device, const ImageDecoder::Image& image)
     {
-        if (!device || !file_id) {
-            return nullptr;
-        }
-        
-        gw_image_bits bits = nullptr;
-        int levels;
-        GR_FORMAT format;
-        auto ret = OpenImage(file_id, &bits, dims, levels, format);
-        if (!ret || !bits || !dims.x || !dims.y) {
-            if (bits) {
-                GW::MemoryMgr::MemFree(bits);
-            }
+        if (!device || image.pixels.empty()) {
             return nullptr;
         }
 
         // Create a texture: http://msdn.microsoft.com/en-us/library/windows/desktop/bb174363(v=vs.85).aspx
         IDirect3DTexture9* tex = nullptr;
-        if (device->CreateTexture(dims.x, dims.y, levels, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &tex, 0) != D3D_OK) {
+        if (device->CreateTexture(image.width, image.height, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &tex, 0) != D3D_OK) {
             return nullptr;
         }
 
         // Lock the texture for writing: http://msdn.microsoft.com/en-us/library/windows/desktop/bb205913(v=vs.85).aspx
         D3DLOCKED_RECT rect;
         if (tex->LockRect(0, &rect, 0, D3DLOCK_DISCARD) != D3D_OK) {
+            tex->Release();
             return nullptr;
         }
 
-        unsigned int* srcdata = (unsigned int*)bits;
-        for (int y = 0; y < dims.y; y++) {
+        const size_t row_size = static_cast<size_t>(image.width) * 4;
+        const uint8_t* srcdata = image.pixels.data();
+        for (uint32_t y = 0; y < image.height; y++) {
             uint8_t* destAddr = ((uint8_t*)rect.pBits + y * rect.Pitch);
-            memcpy(destAddr, srcdata, dims.x * 4);
-            srcdata += dims.x;
-            /* for (int x = 0; x < dims.x; ++x) {
-                uint8_t* destAddr = ((uint8_t*)rect.pBits + y * rect.Pitch + 4 * x);
-
-                // unsigned int data = 0xFF000000 | (*srcdata >> 24 & 0xFF) | (*srcdata >> 16 & 0xFF00) | (*srcdata >> 8 & 0xFF0000);
-                // memcpy(destAddr, &data, 4);
-                memcpy(destAddr, srcdata, 4);
-                srcdata++;
-            }*/
+            memcpy(destAddr, srcdata, row_size);
+            srcdata += row_size;
         }
-        GW::MemoryMgr::MemFree(bits);
 
         // Unlock the texture so it can be used.
         tex->UnlockRect(0);
         return tex;
     }
 
+    // Reads and decodes the image on a worker, then hands it to the DX thread to upload; image is empty if it couldn't be opened
+    void DecodeThenUpload(const uint32_t file_id, std::function<void(IDirect3DDevice9* device, const ImageDecoder::Image& image)> upload)
+    {
+        Resources::EnqueueWorkerTask([file_id, upload] {
+            auto image = std::make_shared<ImageDecoder::Image>();
+            if (!(file_id && OpenImage(file_id, *image))) {
+                image->pixels.clear();
+            }
+            Resources::EnqueueDxTask([image, upload](IDirect3DDevice9* device) {
+                upload(device, *image);
+            });
+        }, Resources::TaskPriority::UserVisible, nullptr, "Decode dat texture");
+    }
+
     struct GwImg {
         uint32_t m_file_id = 0;
         Vec2i m_dims;
         IDirect3DTexture9* m_tex = nullptr;
     };
 
+    // Looked up from the game thread and StoC handlers as well as the render thread
+    std::mutex by_file_id_mutex;
     std::map<uint32_t,GwImg*> textures_by_file_id;
+    std::map<uint32_t, TextureAtlas::Icon*> icons_by_file_id;
 } // namespace
 
 bool GwDatTextureModule::CloseHandle(GW::RecObject* handle) {
@@ -282,21 +302,49 @@ void GwDatTextureModule::Initialize()
 
 IDirect3DTexture9** GwDatTextureModule::LoadTextureFromFileId(uint32_t file_id)
 {
+    std::lock_guard lock(by_file_id_mutex);
     auto found = textures_by_file_id.find(file_id);
     if (found != textures_by_file_id.end())
-        return &found->second->m_tex;
+        return TextureCache::Request(&found->second->m_tex);
     auto gwimg_ptr = new GwImg(file_id);
     textures_by_file_id[file_id] = gwimg_ptr;
-    Resources::Instance().EnqueueDxTask([gwimg_ptr](IDirect3DDevice9* device) {
-        gwimg_ptr->m_tex = CreateTexture(device, gwimg_ptr->m_file_id, gwimg_ptr->m_dims);
+    return TextureCache::Add(&gwimg_ptr->m_tex, [gwimg_ptr](IDirect3DTexture9**, const TextureCache::LoadDone& done) {
+        DecodeThenUpload(gwimg_ptr->m_file_id, [gwimg_ptr, done](IDirect3DDevice9* device, const ImageDecoder::Image& image) {
+            gwimg_ptr->m_dims = {static_cast<int>(image.width), static_cast<int>(image.height)};
+            gwimg_ptr->m_tex = CreateTexture(device, image);
+            done(gwimg_ptr->m_tex != nullptr, {});
         });
-    return &gwimg_ptr->m_tex;
+    });
+}
+const TextureAtlas::Icon* GwDatTextureModule::LoadIconFromFileId(uint32_t file_id)
+{
+    std::lock_guard lock(by_file_id_mutex);
+    auto found = icons_by_file_id.find(file_id);
+    if (found != icons_by_file_id.end())
+        return found->second;
+    auto icon = new TextureAtlas::Icon();
+    icons_by_file_id[file_id] = icon;
+    DecodeThenUpload(file_id, [icon](IDirect3DDevice9* device, const ImageDecoder::Image& image) {
+        if (device && !image.pixels.empty()) {
+            TextureAtlas::Add(device, image.pixels.data(), image.width, image.height, *icon);
+        }
+    });
+    return icon;
 }
 void GwDatTextureModule::Terminate()
 {
+    std::lock_guard lock(by_file_id_mutex);
     for (auto gwimg_ptr : textures_by_file_id) {
+        TextureCache::Remove(&gwimg_ptr.second->m_tex);
+        if (gwimg_ptr.second->m_tex) gwimg_ptr.second->m_tex->Release();
         delete gwimg_ptr.second;
     }
     textures_by_file_id.clear();
+    for (const auto& icon : icons_by_file_id | std::views::values) {
+        TextureAtlas::Remove(*icon);
+        delete icon;
+    }
+    icons_by_file_id.clear();
+    TextureAtlas::ReleasePages();
 }
 
@@ -5,6 +5,9 @@
 namespace GW {
     struct RecObject;
 }
+namespace TextureAtlas {
+    struct Icon;
+}
 
 class GwDatTextureModule : public ToolboxModule {
     GwDatTextureModule() = default;
@@ -29,4 +32,6 @@ public:
     static bool ReadDatFile(const wchar_t* fileHash, std::vector<uint8_t>* bytes_out, uint32_t stream_id = 0);
 
     static IDirect3DTexture9** LoadTextureFromFileId(uint32_t file_id);
+    // As above, but packed into a TextureAtlas page with other icons. Guaranteed to return a pointer; its texture is null until loaded
+    static const TextureAtlas::Icon* LoadIconFromFileId(uint32_t file_id);
 };
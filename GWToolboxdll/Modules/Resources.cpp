@@ -1,5 +1,8 @@
 #include "stdafx.h"
 
+#include <condition_variable>
+#include <optional>
+
 #include <DirectXTex.h>
 #include <DDSTextureLoader/DDSTextureLoader9.h>
 #include <WICTextureLoader/WICTextureLoader9.h>
@@ -15,6 +18,7 @@
 
 #include <EmbeddedResource.h>
 #include <GWToolbox.h>
+#include <ImageDecoder.h>
 #include <Logger.h>
 #include <Path.h>
 #include <RestClient.h>
@@ -23,6 +27,8 @@
 #include <GWCA/Constants/Constants.h>
 #include <Modules/Resources.h>
 #include <Utils/GuiUtils.h>
+#include <Utils/TextureAtlas.h>
+#include <Utils/TextureCache.h>
 
 #pragma warning(push) // Save current warning state
 #pragma warning(disable : 4189) // local variable is initialized but not referenced
@@ -31,7 +37,6 @@
 #include <nfd_win.cpp>
 #pragma warning(pop)
 #include <dxgiformat.h>
-#include <wolfssl/wolfcrypt/asn.h>
 
 #include <Modules/GwDatTextureModule.h>
 #include <Constants/EncStrings.h>
@@ -101,6 +106,81 @@ namespace {
         }
     }
 
+    // A texture's file, read and decoded on a worker so the DX thread only has to copy pixels into a texture
+    struct DecodedTexture {
+        ImageDecoder::Image image;
+        ImageDecoder::Result result = ImageDecoder::Result::Unsupported;
+        ImageDecoder::Format format = ImageDecoder::Format::Unknown;
+        // Kept for D3DX when the decoder couldn't handle it, e.g. DDS files
+        std::vector<uint8_t> file;
+        std::string error;
+    };
+
+    std::shared_ptr<DecodedTexture> DecodeTexture(std::vector<uint8_t>&& file)
+    {
+        auto decoded = std::make_shared<DecodedTexture>();
+        decoded->format = ImageDecoder::DetectFormat(file);
+        decoded->result = ImageDecoder::Decode(file, decoded->image, decoded->error);
+        if (decoded->result != ImageDecoder::Result::Ok) {
+            decoded->file = std::move(file);
+        }
+        return decoded;
+    }
+
+    HRESULT UploadTexture(IDirect3DDevice9* device, const ImageDecoder::Image& image, IDirect3DTexture9** texture)
+    {
+        IDirect3DTexture9* created = nullptr;
+        HRESULT res = device->CreateTexture(image.width, image.height, static_cast<UINT>(image.levels.size()), 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &created, nullptr);
+        if (res != D3D_OK)
+            return res;
+        for (UINT i = 0; i < image.levels.size(); i++) {
+            const auto& level = image.levels[i];
+            D3DLOCKED_RECT locked;
+            res = created->LockRect(i, &locked, nullptr, 0);
+            if (res != D3D_OK) {
+                created->Release();
+                return res;
+            }
+            const size_t row_bytes = level.width * 4;
+            const auto src = image.LevelPixels(i);
+            const auto dst = static_cast<uint8_t*>(locked.pBits);
+            if (static_cast<size_t>(locked.Pitch) == row_bytes) {
+                memcpy(dst, src, row_bytes * level.height);
+            }
+            else {
+                for (size_t y = 0; y < level.height; y++) {
+                    memcpy(dst + y * locked.Pitch, src + y * row_bytes, row_bytes);
+                }
+            }
+            created->UnlockRect(i);
+        }
+        *texture = created;
+        return D3D_OK;
+    }
+
+    // Copies the decoded pixels in, or has D3DX load the file if the decoder couldn't
+    HRESULT CreateDecodedTexture(IDirect3DDevice9* device, const DecodedTexture& decoded, const bool dds_force_srgb, IDirect3DTexture9** texture)
+    {
+        // NB: Some Graphics cards seem to spit out D3DERR_NOTAVAILABLE when loading textures, haven't figured out why but retry if this error is reported
+        HRESULT res = D3DERR_NOTAVAILABLE;
+        size_t tries = 0;
+        while (res == D3DERR_NOTAVAILABLE && tries++ < 5) {
+            if (decoded.result == ImageDecoder::Result::Ok) {
+                res = UploadTexture(device, decoded.image, texture);
+            }
+            else if (decoded.format == ImageDecoder::Format::Dds) {
+                res = DirectX::CreateDDSTextureFromMemoryEx(device, decoded.file.data(), decoded.file.size(), 0, D3DPOOL_MANAGED, dds_force_srgb, texture);
+            }
+            else {
+                res = DirectX::CreateWICTextureFromMemoryEx(device, decoded.file.data(), decoded.file.size(), 0, 0, D3DPOOL_MANAGED, DirectX::WIC_LOADER_DEFAULT, texture);
+            }
+        }
+        if (res == D3D_OK && !*texture) {
+            res = D3DERR_NOTFOUND;
+        }
+        return res;
+    }
+
     constexpr std::array profession_icon_urls = {
         "",
         "8/87/Warrior-tango-icon-48",
@@ -135,25 +215,188 @@ namespace {
     std::unordered_map<GW::Constants::Language, std::unordered_map<uint32_t, GuiUtils::EncString*>> encoded_string_ids;
     std::filesystem::path current_settings_folder;
     constexpr size_t MAX_WORKERS = 20;
+    // Background tasks never take more than this many workers, so user visible ones always find one free
+    constexpr size_t MAX_BACKGROUND_WORKERS = 4;
     const wchar_t* GUILD_WARS_WIKI_FILES_PATH = L"img\\gww_files";
     const wchar_t* SKILL_IMAGES_PATH = L"img\\skills";
     const wchar_t* ITEM_IMAGES_PATH = L"img\\items";
     const wchar_t* PROF_ICONS_PATH = L"img\\professions";
     const wchar_t* DMGTYPE_ICONS_PATH = L"img\\damagetypes";
 
-    std::recursive_mutex worker_mutex;
-    std::recursive_mutex main_mutex;
-    std::recursive_mutex dx_mutex;
+    std::mutex worker_mutex;
+    std::condition_variable worker_cv;
+
+    using Clock = std::chrono::steady_clock;
+    constexpr size_t PRIORITY_COUNT = 2;
+
+    struct WorkerTask {
+        std::function<void()> func;
+        std::optional<Resources::CancellationToken> token;
+        const char* label = nullptr;
+        Clock::time_point enqueued;
+    };
+    // tasks to be done async by the worker threads, by Resources::TaskPriority; guarded by worker_mutex
+    std::deque<WorkerTask> thread_jobs[PRIORITY_COUNT];
+    size_t running_jobs[PRIORITY_COUNT] = {};
+    Resources::WorkerTaskStats priority_stats[PRIORITY_COUNT];
+    std::map<std::string, Resources::WorkerTaskStats> label_stats;
+    std::atomic<float> frame_task_budget_ms = 1.f;
+
+    // Tasks run by one thread once per frame. The thread swaps out everything queued with one lock, then runs
+    // the batch until the frame budget is used up; the rest of the batch goes first next frame.
+    template <typename... Args>
+    class FrameTaskQueue {
+    public:
+        using Task = std::function<void(Args...)>;
+
+        void Push(const Task& f)
+        {
+            {
+                std::lock_guard lock(mutex);
+                queued.push(f);
+            }
+            queued_count++;
+        }
+
+        void Run(Args... args)
+        {
+            if (batch.empty()) {
+                std::lock_guard lock(mutex);
+                batch.swap(queued);
+            }
+            if (batch.empty())
+                return;
+            const auto budget = std::chrono::duration<float, std::milli>(frame_task_budget_ms.load());
+            const auto started = std::chrono::high_resolution_clock::now();
+            auto elapsed = std::chrono::high_resolution_clock::duration::zero();
+            do {
+                const auto func = std::move(batch.front());
+                batch.pop();
+                queued_count--;
+                completed++;
+                func(args...);
+                elapsed = std::chrono::high_resolution_clock::now() - started;
+            } while (!batch.empty() && elapsed < budget);
+
+            const auto frame_ms = std::chrono::duration<float, std::milli>(elapsed).count();
+            last_frame_ms = frame_ms;
+            if (frame_ms > max_frame_ms)
+                max_frame_ms = frame_ms;
+            if (!batch.empty())
+                frames_over_budget++;
+        }
+
+        [[nodiscard]] Resources::FrameQueueStats GetStats() const
+        {
+            return {queued_count, completed, last_frame_ms, max_frame_ms, frames_over_budget};
+        }
+
+    private:
+        std::mutex mutex;
+        std::queue<Task> queued;      // guarded by mutex
+        std::queue<Task> batch;       // only touched by the thread calling Run()
+        std::atomic<size_t> queued_count = 0;
+        std::atomic<uint64_t> completed = 0;
+        std::atomic<float> last_frame_ms = 0.f;
+        std::atomic<float> max_frame_ms = 0.f;
+        std::atomic<uint64_t> frames_over_budget = 0;
+    };
 
-    // tasks to be done async by the worker thread
-    std::queue<std::function<void()>> thread_jobs;
     // tasks to be done in the render thread
-    std::queue<std::function<void(IDirect3DDevice9*)>> dx_jobs;
+    FrameTaskQueue<IDirect3DDevice9*> dx_jobs;
     // tasks to be done in main thread
-    std::queue<std::function<void()>> main_jobs;
+    FrameTaskQueue<> main_jobs;
+
+    std::atomic<uint64_t> requests_started = 0;
+    std::atomic<uint64_t> requests_coalesced = 0;
+    std::atomic<size_t> requests_in_flight = 0;
+
+    // Async requests being transferred, by key. An identical request made meanwhile adds its callback to the
+    // one in flight instead of making its own transfer; every callback gets the result on the main thread.
+    template <typename... Result>
+    class InFlightRequests {
+    public:
+        using Waiter = std::function<void(const Result&...)>;
+
+        // Returns true if the caller has to start the request and call Complete(key, ...) when it's done
+        bool Join(const std::string& key, Waiter waiter)
+        {
+            std::lock_guard lock(mutex);
+            const auto found = waiters_by_key.find(key);
+            if (found != waiters_by_key.end()) {
+                found->second.push_back(std::move(waiter));
+                requests_coalesced++;
+                return false;
+            }
+            waiters_by_key[key].push_back(std::move(waiter));
+            requests_started++;
+            requests_in_flight++;
+            return true;
+        }
+
+        // Does nothing if the request has already been failed by CompleteAll
+        void Complete(const std::string& key, Result... result)
+        {
+            std::vector<Waiter> waiters;
+            {
+                std::lock_guard lock(mutex);
+                const auto found = waiters_by_key.find(key);
+                if (found == waiters_by_key.end())
+                    return;
+                waiters = std::move(found->second);
+                waiters_by_key.erase(found);
+            }
+            requests_in_flight--;
+            Resources::EnqueueMainTask([waiters = std::move(waiters), ...result = std::move(result)] {
+                for (const auto& waiter : waiters) {
+                    waiter(result...);
+                }
+            });
+        }
+
+        // Gives every request still in flight the same result, for when whatever would have completed them won't run
+        void CompleteAll(const Result&... result)
+        {
+            std::vector<std::string> keys;
+            {
+                std::lock_guard lock(mutex);
+                for (const auto& key : waiters_by_key | std::views::keys) {
+                    keys.push_back(key);
+                }
+            }
+            for (const auto& key : keys) {
+                Complete(key, result...);
+            }
+        }
+
+    private:
+        std::mutex mutex;
+        std::unordered_map<std::string, std::vector<Waiter>> waiters_by_key;
+    };
+
+    // Responses of Download() calls given a cache duration
+    HttpCache http_cache;
+    uint64_t http_cache_max_bytes = 128 * 1024 * 1024;
+    constexpr size_t HTTP_CACHE_MEMORY_BYTES = 8 * 1024 * 1024;
+
+    // Same range as RestClient::IsSuccessful()
+    bool IsSuccessStatus(const int status_code)
+    {
+        return status_code >= 200 && status_code <= 302;
+    }
+
+    // Successes, plus pages that are gone so they aren't asked for again every time. Never timeouts or rate limits.
+    bool IsCacheableStatus(const int status_code)
+    {
+        return (status_code >= 200 && status_code < 300) || status_code == 404 || status_code == 410;
+    }
+
+    InFlightRequests<bool, std::string> in_flight_requests;    // Download and Post to memory
+    InFlightRequests<bool, std::wstring> in_flight_downloads;  // Download to file
 
     IDirect3DTexture9* empty_texture_ptr = nullptr;
-    bool should_stop = false;
+    const TextureAtlas::Icon empty_icon;
+    std::atomic<bool> should_stop = false;
 
     // snprintf error message, pass to callback as a failure. Used internally.
     void trigger_failure_callback(const std::function<void(bool, const std::wstring&)>& callback, const wchar_t* format, ...)
@@ -182,9 +425,89 @@ namespace {
         }
     }
 
+    double MillisecondsBetween(const Clock::time_point from, const Clock::time_point to)
+    {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    void RecordTaskStats(Resources::WorkerTaskStats& stats, const bool cancelled, const double wait_ms, const double run_ms)
+    {
+        if (cancelled) {
+            stats.cancelled++;
+            return;
+        }
+        stats.completed++;
+        stats.total_wait_ms += wait_ms;
+        stats.max_wait_ms = std::max(stats.max_wait_ms, wait_ms);
+        stats.total_run_ms += run_ms;
+        stats.max_run_ms = std::max(stats.max_run_ms, run_ms);
+    }
+
+    // Call with worker_mutex held
+    void RecordTask(const size_t priority, const char* label, const bool cancelled, const double wait_ms = 0.0, const double run_ms = 0.0)
+    {
+        RecordTaskStats(priority_stats[priority], cancelled, wait_ms, run_ms);
+        if (label) {
+            RecordTaskStats(label_stats[label], cancelled, wait_ms, run_ms);
+        }
+    }
+
+    // Drops the tasks no worker will run now and fails every request still in flight; nothing waits on their
+    // transfers finishing, and the ones that do finish later find their request already completed
+    void FailPendingRequests()
+    {
+        {
+            std::lock_guard lock(worker_mutex);
+            for (size_t priority = 0; priority < PRIORITY_COUNT; priority++) {
+                for (const auto& task : thread_jobs[priority]) {
+                    RecordTask(priority, task.label, true);
+                }
+                thread_jobs[priority].clear();
+            }
+        }
+        in_flight_requests.CompleteAll(false, "Toolbox is closing");
+        in_flight_downloads.CompleteAll(false, L"Toolbox is closing");
+    }
+
+    // Set under the lock so a worker can't miss the notify between checking should_stop and waiting
+    void StopWorkers()
+    {
+        {
+            std::lock_guard lock(worker_mutex);
+            should_stop = true;
+        }
+        worker_cv.notify_all();
+        FailPendingRequests();
+    }
+
+    // Call with worker_mutex held; user visible tasks go first, background ones only while under their cap
+    bool PopWorkerTask(WorkerTask& out, size_t& out_priority)
+    {
+        constexpr auto user_visible = static_cast<size_t>(Resources::TaskPriority::UserVisible);
+        constexpr auto background = static_cast<size_t>(Resources::TaskPriority::Background);
+        for (const auto priority : {user_visible, background}) {
+            auto& queue = thread_jobs[priority];
+            if (priority == background && running_jobs[background] >= MAX_BACKGROUND_WORKERS)
+                continue;
+            // Tasks cancelled while queued are dropped here rather than handed to a worker
+            while (!queue.empty() && queue.front().token && queue.front().token->IsCancelled()) {
+                RecordTask(priority, queue.front().label, true);
+                queue.pop_front();
+            }
+            if (queue.empty())
+                continue;
+            out = std::move(queue.front());
+            queue.pop_front();
+            out_priority = priority;
+            running_jobs[priority]++;
+            return true;
+        }
+        return false;
+    }
+
     class WorkerThread {
     public:
-        bool is_running = false;
+        std::atomic<bool> is_running = false;
         std::jthread thread;
 
         WorkerThread()
@@ -192,17 +515,24 @@ namespace {
             ASSERT(!is_running);
             is_running = true;
             thread = std::jthread([&] {
+                std::unique_lock lock(worker_mutex);
                 while (!should_stop) {
-                    worker_mutex.lock();
-                    if (thread_jobs.empty()) {
-                        worker_mutex.unlock();
-                        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    WorkerTask task;
+                    size_t priority = 0;
+                    if (!PopWorkerTask(task, priority)) {
+                        worker_cv.wait(lock);
+                        continue;
                     }
-                    else {
-                        std::function<void()> func = thread_jobs.front();
-                        thread_jobs.pop();
-                        worker_mutex.unlock();
-                        func();
+                    lock.unlock();
+                    const auto started = Clock::now();
+                    task.func();
+                    const auto finished = Clock::now();
+                    lock.lock();
+                    running_jobs[priority]--;
+                    RecordTask(priority, task.label, false, MillisecondsBetween(task.enqueued, started), MillisecondsBetween(started, finished));
+                    // A background task may have been left queued because the cap was reached
+                    if (priority == static_cast<size_t>(Resources::TaskPriority::Background) && !thread_jobs[priority].empty()) {
+                        worker_cv.notify_one();
                     }
                 }
                 is_running = false;
@@ -228,20 +558,58 @@ namespace {
         r->SetVerifyHost(false);
         r->SetConnectTimeoutSec(5);
         r->SetTimeoutSec(10);
+        r->SetTcpKeepAlive(true);
     }
 
-    const std::string HashStr(const std::string& str)
+    // Transfers all go through the curl multi thread (RestClient.cpp), which keeps connections open for reuse
+    // and runs them side by side; this just blocks until r is done
+    void Transfer(AsyncRestClient& r)
     {
-        const auto bytes_to_hash = std::vector<byte>(str.begin(), str.end());
-        auto hash = std::vector<byte>(WC_SHA256_DIGEST_SIZE);
-        wc_Sha256Hash(bytes_to_hash.data(), bytes_to_hash.size(), hash.data());
-        std::stringstream hexstream;
-        hexstream << std::hex << std::setfill('0');
-        for (auto b : hash) {
-            hexstream << std::setw(2) << static_cast<unsigned>(b);
-        }
-        return hexstream.str();
-    };
+        r.ExecuteAsync();
+        r.Wait();
+    }
+
+    // As above, but returns straight away; done gets the finished request on the curl thread, which then deletes it
+    void TransferAsync(AsyncRestClient* r, const std::function<void(AsyncRestClient&)>& done)
+    {
+        r->SetCompletionCallback([done](AsyncRestClient& finished) {
+            done(finished);
+            delete &finished;
+        });
+        r->ExecuteAsync();
+    }
+
+    bool TakeDownloadResponse(RestClient& r, const std::string& url, std::string& response)
+    {
+        response = std::move(r.GetContent());
+        if (!r.IsSuccessful()) {
+            if (response.empty()) {
+                response = std::format("Failed to download {}, curl status {} {}", url, r.GetStatusCode(), r.GetStatusStr());
+            }
+            return false;
+        }
+        return true;
+    }
+
+    void InitPostClient(RestClient& r, const std::string& url, const std::string& payload)
+    {
+        InitRestClient(&r);
+        r.SetMethod(HttpMethod::Post);
+        r.SetPostContent(payload.c_str(), payload.size(), ContentFlag::Copy);
+        const char* content_type = nlohmann::json::accept(payload) ? "application/json" : "application/x-www-form-urlencoded";
+        r.SetHeader("Content-Type", content_type);
+        r.SetUrl(url.c_str());
+    }
+
+    bool TakePostResponse(RestClient& r, const std::string& url, std::string& response)
+    {
+        if (!(r.IsSuccessful() || r.GetStatusCode() == 415)) {
+            StrSprintf(response, "Failed to POST %s, curl status %d %s", url.c_str(), r.GetStatusCode(), r.GetStatusStr());
+            return false;
+        }
+        response = std::move(r.GetContent());
+        return true;
+    }
 } // namespace
 
 extern "C" __declspec(dllexport) IDirect3DTexture9** __cdecl GetSkillImage(GW::Constants::SkillID skill_id)
@@ -251,30 +619,67 @@ extern "C" __declspec(dllexport) IDirect3DTexture9** __cdecl GetSkillImage(GW::C
 
 Resources::Resources()
 {
-    InitCurl();
+    InitAsyncRest();
     initialised_curl = true;
     co_initialized = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
 }
 
 void Resources::EnqueueWorkerTask(const std::function<void()>& f)
 {
-    worker_mutex.lock();
-    thread_jobs.push(f);
-    worker_mutex.unlock();
+    EnqueueWorkerTask(f, TaskPriority::UserVisible);
+}
+
+void Resources::EnqueueWorkerTask(const std::function<void()>& f, const TaskPriority priority, const CancellationToken* token, const char* label)
+{
+    {
+        std::lock_guard lock(worker_mutex);
+        thread_jobs[static_cast<size_t>(priority)].push_back({f, token ? std::optional(*token) : std::nullopt, label, Clock::now()});
+    }
+    worker_cv.notify_one();
+}
+
+Resources::WorkerStats Resources::GetWorkerStats()
+{
+    WorkerStats stats;
+    std::lock_guard lock(worker_mutex);
+    stats.workers = workers.size();
+    for (size_t i = 0; i < PRIORITY_COUNT; i++) {
+        stats.queued[i] = thread_jobs[i].size();
+        stats.running[i] = running_jobs[i];
+        stats.by_priority[i] = priority_stats[i];
+    }
+    stats.by_label = label_stats;
+    return stats;
 }
 
 void Resources::EnqueueMainTask(const std::function<void()>& f)
 {
-    main_mutex.lock();
-    main_jobs.push(f);
-    main_mutex.unlock();
+    main_jobs.Push(f);
 }
 
 void Resources::EnqueueDxTask(const std::function<void(IDirect3DDevice9*)>& f)
 {
-    dx_mutex.lock();
-    dx_jobs.push(f);
-    dx_mutex.unlock();
+    dx_jobs.Push(f);
+}
+
+void Resources::SetFrameTaskBudget(const float milliseconds)
+{
+    frame_task_budget_ms = std::max(milliseconds, 0.f);
+}
+
+float Resources::GetFrameTaskBudget()
+{
+    return frame_task_budget_ms;
+}
+
+Resources::FrameQueueStats Resources::GetMainQueueStats()
+{
+    return main_jobs.GetStats();
+}
+
+Resources::FrameQueueStats Resources::GetDxQueueStats()
+{
+    return dx_jobs.GetStats();
 }
 
 void Resources::OpenFileDialog(std::function<void(const char*)> callback, const char* filterList, const char* defaultPath)
@@ -300,7 +705,7 @@ void Resources::OpenFileDialog(std::function<void(const char*)> callback, const
         if (outPath) {
             free(outPath);
         }
-    });
+    }, TaskPriority::UserVisible, nullptr, "File dialog");
 }
 
 void Resources::SaveFileDialog(std::function<void(const char*)> callback, const char* filterList, const char* defaultPath)
@@ -328,7 +733,7 @@ void Resources::SaveFileDialog(std::function<void(const char*)> callback, const
         if (outPath) {
             free(outPath);
         }
-    });
+    }, TaskPriority::UserVisible, nullptr, "File dialog");
 }
 
 float Resources::GetGWScaleMultiplier(const bool force)
@@ -418,11 +823,13 @@ void Resources::Initialize()
         workers.push_back(new WorkerThread());
     }
     RegisterUIMessageCallback(&OnUIMessage_Hook, GW::UI::UIMessage::kPreferenceEnumChanged, OnUIMessage, 0x8000);
+    http_cache.Open(GetPath("cache"), http_cache_max_bytes, HTTP_CACHE_MEMORY_BYTES);
 }
 
 void Resources::Cleanup()
 {
-    should_stop = true;
+    StopWorkers();
+    http_cache.SaveIndex();
     for (const auto worker : workers) {
         for (size_t i = 0; i < 5000; i += 10) {
             if (!worker->is_running) 
@@ -433,20 +840,35 @@ void Resources::Cleanup()
     }
     workers.clear();
     for (const auto& tex : skill_images | std::views::values) {
+        TextureCache::Remove(tex);
         if(tex && *tex) (*tex)->Release();
         delete tex;
     }
     skill_images.clear();
     for (const auto& tex : item_images | std::views::values) {
+        TextureCache::Remove(tex);
         if (tex && *tex) (*tex)->Release();
         delete tex;
     }
     item_images.clear();
     for (const auto& img : guild_wars_wiki_images | std::views::values) {
+        TextureCache::Remove(img);
         if (img && *img) (*img)->Release();
         delete img;
     }
     guild_wars_wiki_images.clear();
+    for (const auto& tex : profession_icons | std::views::values) {
+        TextureCache::Remove(tex);
+        if (tex && *tex) (*tex)->Release();
+        delete tex;
+    }
+    profession_icons.clear();
+    for (const auto& tex : damagetype_icons | std::views::values) {
+        TextureCache::Remove(tex);
+        if (tex && *tex) (*tex)->Release();
+        delete tex;
+    }
+    damagetype_icons.clear();
     for (const auto& enc_strings : encoded_string_ids | std::views::values) {
         for (const auto& enc_string : enc_strings | std::views::values) {
             enc_string->Release();
@@ -465,7 +887,7 @@ void Resources::Terminate()
 
     Cleanup();
     if (initialised_curl)
-        ShutdownCurl();
+        ShutdownAsyncRest();
     initialised_curl = false;
     if (co_initialized) {
         CoUninitialize();
@@ -478,19 +900,21 @@ bool Resources::CanTerminate()
         if (worker->is_running)
             return false;
     }
-    return true;
+    // Anything asked for since the workers stopped won't be run either
+    FailPendingRequests();
+    return requests_in_flight == 0;
 }
 
 void Resources::SignalTerminate()
 {
     ToolboxModule::SignalTerminate();
-    should_stop = true;
+    StopWorkers();
 }
 
 void Resources::EndLoading() const
 {
-    EnqueueWorkerTask([this] {
-        should_stop = true;
+    EnqueueWorkerTask([] {
+        StopWorkers();
     });
 }
 
@@ -582,19 +1006,23 @@ bool Resources::Download(const std::filesystem::path& path_to_file, const std::s
 
 void Resources::Download(const std::filesystem::path& path_to_file, const std::string& url, const AsyncLoadCallback& callback) const
 {
-    EnqueueWorkerTask([this, path_to_file, url, callback] {
-        std::wstring error_message;
-        bool success = Download(path_to_file, url, error_message);
-        // and call the callback in the main thread
+    // Keyed on the destination too; two transfers writing the same file would trip over each other
+    const auto key = std::format("GET {} > {}", url, path_to_file.string());
+    const auto waiter = [path_to_file, url, callback](const bool success, const std::wstring& error_message) {
         if (callback) {
-            EnqueueMainTask([callback, success, error_message] {
-                callback(success, error_message);
-            });
+            callback(success, error_message);
         }
         else if (!success) {
             Log::LogW(L"Failed to download %s from %S\n%S", path_to_file.wstring().c_str(), url.c_str(), error_message.c_str());
         }
-    });
+    };
+    if (!in_flight_downloads.Join(key, waiter))
+        return;
+    EnqueueWorkerTask([path_to_file, url, key] {
+        std::wstring error_message;
+        const bool success = Download(path_to_file, url, error_message);
+        in_flight_downloads.Complete(key, success, std::move(error_message));
+    }, TaskPriority::UserVisible, nullptr, "Download");
 }
 
 bool Resources::ReadFile(const std::filesystem::path& path, std::string& response)
@@ -631,134 +1059,115 @@ bool Resources::Download(const std::string& url, std::string& response)
 
 bool Resources::Download(const std::string& url, std::string& response, int& statusCode)
 {
-    RestClient r;
+    AsyncRestClient r;
     InitRestClient(&r);
     r.SetUrl(url.c_str());
-    r.Execute();
+    Transfer(r);
     statusCode = r.GetStatusCode();
-    response = std::move(r.GetContent());
-    if (!r.IsSuccessful()) {
-        if (response.empty()) {
-            response = std::format("Failed to download {}, curl status {} {}", url, r.GetStatusCode(), r.GetStatusStr());
-        }
-        return false;
-    }
-    return true;
+    return TakeDownloadResponse(r, url, response);
 }
 
 void Resources::Download(const std::string& url, AsyncLoadMbCallback callback, void* context)
 {
-    EnqueueWorkerTask([url, callback, context] {
+    const auto key = "GET " + url;
+    const auto waiter = [callback, context](const bool ok, const std::string& response) {
+        callback(ok, response, context);
+    };
+    if (!in_flight_requests.Join(key, waiter))
+        return;
+    const auto r = new AsyncRestClient();
+    InitRestClient(r);
+    r->SetUrl(url.c_str());
+    TransferAsync(r, [url, key](AsyncRestClient& finished) {
         std::string response;
-        int statusCode = 0;
-        bool ok = Download(url, response, statusCode);
-        EnqueueMainTask([callback, ok, response, context] {
-            callback(ok, response, context);
-        });
+        const bool ok = TakeDownloadResponse(finished, url, response);
+        in_flight_requests.Complete(key, ok, std::move(response));
     });
 }
 
 void Resources::Download(const std::string& url, AsyncLoadMbCallback callback, void* context, std::chrono::seconds cache_duration)
 {
-    EnqueueWorkerTask([url, callback, context, &cache_duration] {
-        const auto get_cache_modified_time = [](const std::filesystem::path& file_name) -> std::optional<std::filesystem::file_time_type> {
-            if (!std::filesystem::exists(file_name)) {
-                return std::optional<std::filesystem::file_time_type>();
-            }
-
-            const auto file_time = std::filesystem::last_write_time(file_name);
-            return file_time;
-        };
-
-        const auto load_from_cache = [](const std::filesystem::path& file_name) -> std::optional<std::string> {
-            std::ifstream cache_file(file_name);
-            if (!cache_file.is_open()) {
-                return {};
-            }
-
-            std::string contents((std::istreambuf_iterator<char>(cache_file)), std::istreambuf_iterator<char>());
-            return contents;
-        };
-
-        const auto save_to_cache = [](const std::filesystem::path& file_name, const std::string& content) -> bool {
-            std::filesystem::create_directories(file_name.parent_path());
-            std::ofstream cache_file(file_name);
-            if (!cache_file.is_open()) {
-                return false;
-            }
-
-            cache_file << content;
-            return true;
-        };
-
-        const auto remove_protocol = [](const std::string& url) -> std::string {
-            const std::string http = "http://";
-            const std::string https = "https://";
-
-            // Check if the URL starts with http:// or https:// and remove it
-            if (url.substr(0, http.size()) == http) {
-                return url.substr(http.size());
-            }
-            if (url.substr(0, https.size()) == https) {
-                return url.substr(https.size());
-            }
-            return url; // Return the original if no match is found
-        };
-        const auto cache_path = Resources::GetPath("cache") / HashStr(remove_protocol(url));
-        const auto expiration = get_cache_modified_time(cache_path);
-        if (expiration.has_value() &&
-            expiration.value() - std::chrono::file_clock::now() < cache_duration) {
-            const auto response = load_from_cache(cache_path);
-            if (response.has_value()) {
-                EnqueueMainTask([callback, context, response] {
-                    callback(true, response.value(), context);
-                });
-                return;
-            }
+    // Separate from uncached requests for the same url, which mustn't be answered from the cache
+    const auto key = "GET (cached) " + url;
+    const auto waiter = [callback, context](const bool ok, const std::string& response) {
+        callback(ok, response, context);
+    };
+    if (!in_flight_requests.Join(key, waiter))
+        return;
+    EnqueueWorkerTask([url, key, cache_duration] {
+        HttpCache::Entry cached;
+        const auto lookup = http_cache.Get(url, cached);
+        if (lookup == HttpCache::Lookup::Fresh) {
+            in_flight_requests.Complete(key, IsSuccessStatus(cached.status_code), std::move(cached.body));
+            return;
+        }
+        AsyncRestClient r;
+        InitRestClient(&r);
+        r.SetUrl(url.c_str());
+        if (lookup == HttpCache::Lookup::Stale) {
+            if (!cached.etag.empty()) r.SetHeader("If-None-Match", cached.etag.c_str());
+            if (!cached.last_modified.empty()) r.SetHeader("If-Modified-Since", cached.last_modified.c_str());
+        }
+        Transfer(r);
+        const auto statusCode = r.GetStatusCode();
+        if (lookup == HttpCache::Lookup::Stale && statusCode == 304 && r.GetStatus() == ResponseStatus::Completed) {
+            http_cache.Revalidated(url, cache_duration);
+            in_flight_requests.Complete(key, IsSuccessStatus(cached.status_code), std::move(cached.body));
+            return;
+        }
+        if (lookup == HttpCache::Lookup::Stale) {
+            http_cache.CountMiss();
+        }
+        if (r.GetStatus() == ResponseStatus::Completed && IsCacheableStatus(statusCode)) {
+            http_cache.Put(url, r.GetContent(), statusCode, r.GetHeader(), cache_duration);
         }
         std::string response;
-        int statusCode = 0;
-        bool ok = Download(url, response, statusCode);
-        if (ok ||
-            (statusCode >= 300 && statusCode < 500)) {
-            save_to_cache(cache_path, response);
-        }
-        EnqueueMainTask([callback, ok, response, context] {
-            callback(ok, response, context);
-        });
-    });
+        const bool ok = TakeDownloadResponse(r, url, response);
+        in_flight_requests.Complete(key, ok, std::move(response));
+    }, TaskPriority::UserVisible, nullptr, "Download");
 }
 
 bool Resources::Post(const std::string& url, const std::string& payload, std::string& response)
 {
-    RestClient r;
-    InitRestClient(&r);
-    r.SetMethod(HttpMethod::Post);
-    r.SetPostContent(payload.c_str(), payload.size(), ContentFlag::ByRef);
-
-    std::string content_type = nlohmann::json::accept(payload) ? "application/json" : "application/x-www-form-urlencoded";
-    r.SetHeader("Content-Type", content_type.c_str());
-    r.SetUrl(url.c_str());
-    r.Execute();
-    if (!(r.IsSuccessful() || r.GetStatusCode() == 415)) {
-        StrSprintf(response, "Failed to POST %s, curl status %d %s", url.c_str(), r.GetStatusCode(), r.GetStatusStr());
-        return false;
-    }
-    response = std::move(r.GetContent());
-    return true;
+    AsyncRestClient r;
+    InitPostClient(r, url, payload);
+    Transfer(r);
+    return TakePostResponse(r, url, response);
 }
 
 void Resources::Post(const std::string& url, const std::string& payload, AsyncLoadMbCallback callback, void* wparam)
 {
-    EnqueueWorkerTask([url, payload, callback, wparam] {
+    const auto key = std::format("POST {}\n{}", url, payload);
+    const auto waiter = [callback, wparam](const bool ok, const std::string& response) {
+        callback(ok, response, wparam);
+    };
+    if (!in_flight_requests.Join(key, waiter))
+        return;
+    const auto r = new AsyncRestClient();
+    InitPostClient(*r, url, payload);
+    TransferAsync(r, [url, key](AsyncRestClient& finished) {
         std::string response;
-        bool ok = Post(url, payload, response);
-        EnqueueMainTask([callback, ok, response, wparam] {
-            callback(ok, response, wparam);
-        });
+        const bool ok = TakePostResponse(finished, url, response);
+        in_flight_requests.Complete(key, ok, std::move(response));
     });
 }
 
+void Resources::SetHttpCacheLimit(const uint64_t max_bytes)
+{
+    http_cache_max_bytes = max_bytes;
+    http_cache.SetMaxDiskBytes(max_bytes);
+}
+
+HttpCache::Stats Resources::GetHttpCacheStats()
+{
+    return http_cache.GetStats();
+}
+
+Resources::RequestStats Resources::GetRequestStats()
+{
+    return {requests_started, requests_coalesced, requests_in_flight};
+}
+
 void Resources::EnsureFileExists(const std::filesystem::path& path_to_file, const std::string& url, const AsyncLoadCallback& callback)
 {
     if (exists(path_to_file)) {
@@ -771,85 +1180,55 @@ void Resources::EnsureFileExists(const std::filesystem::path& path_to_file, cons
     }
 }
 
-HRESULT Resources::TryCreateTexture(IDirect3DDevice9* device, const std::filesystem::path& path_to_file, IDirect3DTexture9** texture, std::wstring& error)
-{
-    // NB: Some Graphics cards seem to spit out D3DERR_NOTAVAILABLE when loading textures, haven't figured out why but retry if this error is reported
-    HRESULT res = D3DERR_NOTAVAILABLE;
-    size_t tries = 0;
-    const auto ext = path_to_file.extension();
-    while (res == D3DERR_NOTAVAILABLE && tries++ < 5) {
-        if (ext == ".dds") {
-            res = DirectX::CreateDDSTextureFromFileEx(device, path_to_file.c_str(), 0, D3DPOOL_MANAGED, true, texture);
-        }
-        else {
-            res = CreateWICTextureFromFileEx(device, path_to_file.c_str(), 0, 0, D3DPOOL_MANAGED, DirectX::WIC_LOADER_FLAGS::WIC_LOADER_DEFAULT, texture);
-        }
-    }
-    if (res != D3D_OK) {
-        std::filesystem::remove(path_to_file);
-        StrSwprintf(error, L"Error loading resource from file %s - Error is %S", path_to_file.filename().wstring().c_str(), d3dErrorMessage(res));
-        return res;
-    }
-    if (!*texture) {
-        res = D3DERR_NOTFOUND;
-        StrSwprintf(error, L"Error loading resource from file %s - texture loaded is null", path_to_file.filename().wstring().c_str());
-    }
-    return res;
-}
-
-HRESULT Resources::TryCreateTexture(IDirect3DDevice9* pDevice, const HMODULE hSrcModule, const LPCSTR pSrcResource, IDirect3DTexture9** texture, std::wstring& error)
-{
-    // NB: Some Graphics cards seem to spit out D3DERR_NOTAVAILABLE when loading textures, haven't figured out why but retry if this error is reported
-    HRESULT res = D3DERR_NOTAVAILABLE;
-    size_t tries = 0;
-    while (res == D3DERR_NOTAVAILABLE && tries++ < 3) {
-        EmbeddedResource resource(pSrcResource, RT_RCDATA, hSrcModule);
-        if (!resource.data()) {
-            StrSwprintf(error, L"Error loading resource for id %p, module %p - texture not found", pSrcResource, hSrcModule);
-            return D3DERR_NOTFOUND;
-        }
-        res = CreateWICTextureFromMemoryEx(pDevice, static_cast<const uint8_t*>(resource.data()), resource.size(), 0, 0, D3DPOOL_MANAGED, DirectX::WIC_LOADER_DEFAULT, texture);
-        if (res != S_OK) {
-            res = DirectX::CreateDDSTextureFromMemoryEx(pDevice, static_cast<const uint8_t*>(resource.data()), resource.size(), 0, D3DPOOL_MANAGED, false, texture);
-        }
-    }
-    if (res != D3D_OK) {
-        StrSwprintf(error, L"Error loading resource for id %p, module %p - Error is %s", pSrcResource, hSrcModule, d3dErrorMessage(res));
-    }
-    else if (!*texture) {
-        res = D3DERR_NOTFOUND;
-        StrSwprintf(error, L"Error loading resource for id %p, module %p - texture loaded is null", pSrcResource, hSrcModule);
-    }
-    return res;
-}
-
 void Resources::LoadTexture(IDirect3DTexture9** texture, const std::filesystem::path& path_to_file, AsyncLoadCallback callback)
 {
-    EnqueueDxTask([path_to_file, texture, callback](IDirect3DDevice9* device) {
-        std::wstring error;
-        const HRESULT res = TryCreateTexture(device, path_to_file.c_str(), texture, error);
-        const bool success = res == D3D_OK;
-        if (callback) {
-            callback(success, error);
-        }
-        else if (!success) {
-            Log::LogW(L"Failed to load texture from file %s\n%s", TextUtils::PrintFilename(path_to_file.wstring()).c_str(), error.c_str());
-        }
-    });
+    EnqueueWorkerTask([path_to_file, texture, callback] {
+        std::vector<uint8_t> file;
+        const auto decoded = ImageDecoder::ReadFile(path_to_file, file) ? DecodeTexture(std::move(file)) : nullptr;
+        EnqueueDxTask([path_to_file, texture, callback, decoded](IDirect3DDevice9* device) {
+            std::wstring error;
+            const HRESULT res = decoded ? CreateDecodedTexture(device, *decoded, true, texture) : D3DERR_NOTFOUND;
+            if (res != D3D_OK) {
+                // Most likely a bad download; let it be fetched again
+                std::filesystem::remove(path_to_file);
+                StrSwprintf(error, L"Error loading resource from file %s - Error is %S %S", path_to_file.filename().wstring().c_str(), d3dErrorMessage(res),
+                            decoded ? decoded->error.c_str() : "file could not be read");
+            }
+            const bool success = res == D3D_OK;
+            if (callback) {
+                callback(success, error);
+            }
+            else if (!success) {
+                Log::LogW(L"Failed to load texture from file %s\n%s", TextUtils::PrintFilename(path_to_file.wstring()).c_str(), error.c_str());
+            }
+        });
+    }, TaskPriority::UserVisible, nullptr, "Decode texture");
 }
 
 void Resources::LoadTexture(IDirect3DTexture9** texture, WORD id, AsyncLoadCallback callback)
 {
-    EnqueueDxTask([id, texture, callback](IDirect3DDevice9* device) {
-        std::wstring error{};
-        const bool success = TryCreateTexture(device, GWToolbox::GetDLLModule(), MAKEINTRESOURCE(id), texture, error) == D3D_OK;
-        if (callback) {
-            callback(success, error);
-        }
-        else if (!success) {
-            Log::LogW(L"Failed to load texture from id %d\n%s", id, error.c_str());
-        }
-    });
+    EnqueueWorkerTask([id, texture, callback] {
+        const EmbeddedResource resource(MAKEINTRESOURCE(id), RT_RCDATA, GWToolbox::GetDLLModule());
+        const auto data = static_cast<const uint8_t*>(resource.data());
+        const auto decoded = data ? DecodeTexture(std::vector<uint8_t>(data, data + resource.size())) : nullptr;
+        EnqueueDxTask([id, texture, callback, decoded](IDirect3DDevice9* device) {
+            std::wstring error;
+            const HRESULT res = decoded ? CreateDecodedTexture(device, *decoded, false, texture) : D3DERR_NOTFOUND;
+            if (!decoded) {
+                StrSwprintf(error, L"Error loading resource for id %d - texture not found", id);
+            }
+            else if (res != D3D_OK) {
+                StrSwprintf(error, L"Error loading resource for id %d - Error is %S %S", id, d3dErrorMessage(res), decoded->error.c_str());
+            }
+            const bool success = res == D3D_OK;
+            if (callback) {
+                callback(success, error);
+            }
+            else if (!success) {
+                Log::LogW(L"Failed to load texture from id %d\n%s", id, error.c_str());
+            }
+        });
+    }, TaskPriority::UserVisible, nullptr, "Decode texture");
 }
 
 void Resources::LoadTexture(IDirect3DTexture9** texture, const std::filesystem::path& path_to_file, const std::string& url, AsyncLoadCallback callback)
@@ -943,55 +1322,41 @@ int Resources::SaveIniToFile(const std::filesystem::path& absolute_path, const T
 
 void Resources::DxUpdate(IDirect3DDevice9* device)
 {
-    while (true) {
-        dx_mutex.lock();
-        if (dx_jobs.empty()) {
-            dx_mutex.unlock();
-            return;
-        }
-        const std::function<void(IDirect3DDevice9*)> func = std::move(dx_jobs.front());
-        dx_jobs.pop();
-        dx_mutex.unlock();
-        func(device);
-    }
+    dx_jobs.Run(device);
+    TextureCache::Update(device);
 }
 
 void Resources::Update(float)
 {
-    main_mutex.lock();
-    if (main_jobs.empty()) {
-        main_mutex.unlock();
-        return;
-    }
-    const auto func = std::move(main_jobs.front());
-    main_jobs.pop();
-    main_mutex.unlock();
-    func();
+    main_jobs.Run();
 }
 
 IDirect3DTexture9** Resources::GetProfessionIcon(GW::Constants::Profession p)
 {
     const auto prof_id = std::to_underlying(p);
     if (profession_icons.contains(prof_id)) {
-        return profession_icons.at(prof_id);
+        return TextureCache::Request(profession_icons.at(prof_id));
     }
     const auto texture = new IDirect3DTexture9*;
     *texture = nullptr;
     profession_icons[prof_id] = texture;
-    if (profession_icon_urls[prof_id][0]) {
+    if (!profession_icon_urls[prof_id][0]) {
+        return texture;
+    }
+    return TextureCache::Add(texture, [p, prof_id](IDirect3DTexture9** slot, const TextureCache::LoadDone& done) {
         const auto path = GetPath(PROF_ICONS_PATH);
         EnsureFolderExists(path);
         wchar_t local_image[MAX_PATH];
         swprintf(local_image, _countof(local_image), L"%s\\%d.png", path.c_str(), p);
         char remote_image[128];
         snprintf(remote_image, _countof(remote_image), "https://wiki.guildwars.com/images/%s.png", profession_icon_urls[prof_id]);
-        LoadTexture(texture, local_image, remote_image, [prof_id](const bool success, const std::wstring& error) {
+        LoadTexture(slot, local_image, remote_image, [prof_id, done](const bool success, const std::wstring& error) {
             if (!success) {
                 Log::ErrorW(L"Failed to load icon for profession %d\n%s", prof_id, error.c_str());
             }
+            done(success, error);
         });
-    }
-    return texture;
+    });
 }
 
 bool Resources::GetTextureSize(IDirect3DTexture9* texture, ImVec2* out)
@@ -1010,24 +1375,27 @@ bool Resources::GetTextureSize(IDirect3DTexture9* texture, ImVec2* out)
 IDirect3DTexture9** Resources::GetDamagetypeImage(std::string dmg_type)
 {
     if (damagetype_icons.contains(dmg_type)) {
-        return damagetype_icons.at(dmg_type);
+        return TextureCache::Request(damagetype_icons.at(dmg_type));
     }
     const auto texture = new IDirect3DTexture9*;
     *texture = nullptr;
     damagetype_icons[dmg_type] = texture;
-    if (damagetype_icon_urls.contains(dmg_type)) {
+    if (!damagetype_icon_urls.contains(dmg_type)) {
+        return texture;
+    }
+    return TextureCache::Add(texture, [dmg_type](IDirect3DTexture9** slot, const TextureCache::LoadDone& done) {
         const auto path = GetPath(DMGTYPE_ICONS_PATH);
         EnsureFolderExists(path);
         const auto local_path = path / TextUtils::SanitiseFilename(dmg_type + ".png");
         const auto remote_path = std::format("https://wiki.guildwars.com/images/thumb/{}", damagetype_icon_urls.at(dmg_type));
-        LoadTexture(texture, local_path, remote_path, [dmg_type](const bool success, const std::wstring& error) {
+        LoadTexture(slot, local_path, remote_path, [dmg_type, done](const bool success, const std::wstring& error) {
             if (!success) {
                 const auto dmg_type_wstr = TextUtils::StringToWString(dmg_type);
                 Log::ErrorW(L"Failed to load icon for %d\n%s", dmg_type_wstr.c_str(), error.c_str());
             }
+            done(success, error);
         });
-    }
-    return texture;
+    });
 }
 
 IDirect3DTexture9** Resources::GetGuildWarsWikiImage(const char* filename, size_t width, const bool urlencode_filename)
@@ -1042,29 +1410,39 @@ IDirect3DTexture9** Resources::GetGuildWarsWikiImage(const char* filename, size_
     }
     const auto filename_sanitised = TextUtils::SanitiseFilename(filename_on_disk);
     if (guild_wars_wiki_images.contains(filename_sanitised)) {
-        return guild_wars_wiki_images.at(filename_sanitised);
+        return TextureCache::Request(guild_wars_wiki_images.at(filename_sanitised));
     }
-    const auto callback = [filename_sanitised](const bool success, const std::wstring& error) {
+    const auto texture = new IDirect3DTexture9*;
+    *texture = nullptr;
+    guild_wars_wiki_images[filename_sanitised] = texture;
+    return TextureCache::Add(texture, [wiki_filename = std::string(filename), filename_sanitised, width, urlencode_filename](IDirect3DTexture9** slot, const TextureCache::LoadDone& done) {
+        LoadGuildWarsWikiImage(slot, wiki_filename, filename_sanitised, width, urlencode_filename, done);
+    });
+}
+
+void Resources::LoadGuildWarsWikiImage(IDirect3DTexture9** texture, const std::string& filename, const std::string& filename_sanitised, const size_t width, const bool urlencode_filename, const AsyncLoadCallback& done)
+{
+    const auto callback = [filename_sanitised, done](const bool success, const std::wstring& error) {
         if (!success) {
             Log::LogW(L"Failed to load Guild Wars Wiki file%S\n%s", filename_sanitised.c_str(), error.c_str());
         }
         else {
             Log::LogW(L"Loaded Guild Wars Wiki file %S", filename_sanitised.c_str());
         }
+        if (done) {
+            done(success, error);
+        }
     };
-    const auto texture = new IDirect3DTexture9*;
-    *texture = nullptr;
-    guild_wars_wiki_images[filename] = texture;
     static std::filesystem::path path = GetPath(GUILD_WARS_WIKI_FILES_PATH);
     if (!EnsureFolderExists(path)) {
         trigger_failure_callback(callback, L"Failed to create folder %s", path.wstring().c_str());
-        return texture;
+        return;
     }
     const auto path_to_file = std::format("{}\\{}", path.string(), filename_sanitised);
     // Check for local file
     if (std::filesystem::exists(path_to_file)) {
         LoadTexture(texture, path_to_file, callback);
-        return texture;
+        return;
     }
     // No local file found; download from wiki via skill link URL
     std::string wiki_url = "https://wiki.guildwars.com/wiki/File:";
@@ -1111,7 +1489,6 @@ IDirect3DTexture9** Resources::GetGuildWarsWikiImage(const char* filename, size_
             trigger_failure_callback(callback, L"Regex failed loading file %S", filename_sanitised.c_str());
         }
     });
-    return texture;
 }
 
 std::filesystem::path Resources::GetExePath()
@@ -1138,42 +1515,58 @@ IDirect3DTexture9** Resources::GetSkillHiResImage(GW::Constants::SkillID skill_i
     return skill && skill->icon_file_id_hi_res ? GwDatTextureModule::LoadTextureFromFileId(skill->icon_file_id_hi_res) : &empty_texture_ptr;
 }
 
+const TextureAtlas::Icon* Resources::GetSkillIcon(GW::Constants::SkillID skill_id)
+{
+    const auto skill = GW::SkillbarMgr::GetSkillConstantData(skill_id);
+    return skill && skill->icon_file_id ? GwDatTextureModule::LoadIconFromFileId(skill->icon_file_id) : &empty_icon;
+}
+
 IDirect3DTexture9** Resources::GetSkillImageFromGWW(GW::Constants::SkillID skill_id)
 {
     if (skill_images.contains(skill_id)) {
-        return skill_images.at(skill_id);
+        return TextureCache::Request(skill_images.at(skill_id));
+    }
+    const auto texture = new IDirect3DTexture9*;
+    *texture = nullptr;
+    skill_images[skill_id] = texture;
+    if (skill_id == static_cast<GW::Constants::SkillID>(0)) {
+        return texture;
     }
-    const auto callback = [skill_id](const bool success, const std::wstring& error) {
+    return TextureCache::Add(texture, [skill_id](IDirect3DTexture9** slot, const TextureCache::LoadDone& done) {
+        LoadSkillImageFromGWW(slot, skill_id, done);
+    });
+}
+
+void Resources::LoadSkillImageFromGWW(IDirect3DTexture9** texture, GW::Constants::SkillID skill_id, const AsyncLoadCallback& done)
+{
+    const auto callback = [skill_id, done](const bool success, const std::wstring& error) {
         if (!success) {
             Log::ErrorW(L"Failed to load skill image %d\n%s", skill_id, error.c_str());
         }
         else {
             Log::LogW(L"Loaded skill image %d", skill_id);
         }
+        if (done) {
+            done(success, error);
+        }
     };
-    const auto texture = new IDirect3DTexture9*;
-    *texture = nullptr;
-    skill_images[skill_id] = texture;
-    if (skill_id == static_cast<GW::Constants::SkillID>(0)) {
-        return texture;
-    }
     static std::filesystem::path path = GetPath(SKILL_IMAGES_PATH);
     if (!EnsureFolderExists(path)) {
         trigger_failure_callback(callback, L"Failed to create folder %s", path.wstring().c_str());
-        return texture;
+        return;
     }
     wchar_t path_to_file[MAX_PATH];
     // Check for local jpg file
     swprintf(path_to_file, _countof(path_to_file), L"%s\\%d.jpg", path.wstring().c_str(), skill_id);
     if (std::filesystem::exists(path_to_file)) {
         LoadTexture(texture, path_to_file, callback);
-        return texture;
+        return;
     }
     // Check for local png file
     swprintf(path_to_file, _countof(path_to_file), L"%s\\%d.png", path.wstring().c_str(), skill_id);
     if (std::filesystem::exists(path_to_file)) {
         LoadTexture(texture, path_to_file, callback);
-        return texture;
+        return;
     }
     // No local file found; download from wiki via skill link URL
     char url[128];
@@ -1230,7 +1623,6 @@ IDirect3DTexture9** Resources::GetSkillImageFromGWW(GW::Constants::SkillID skill
 
         LoadTexture(texture, path_to_file, url, callback);
     });
-    return texture;
 }
 
 GuiUtils::EncString* Resources::GetSkillName(const GW::Constants::SkillID skill_id)
@@ -1333,9 +1725,22 @@ GuiUtils::EncString* Resources::DecodeStringId(const uint32_t enc_str_id, GW::Co
 }
 
 IDirect3DTexture9** Resources::GetItemImage(GW::Item* item)
+{
+    const auto file_id = GetItemIconFileId(item);
+    return file_id ? GwDatTextureModule::LoadTextureFromFileId(file_id) : nullptr;
+    // @Enhancement: How to apply dye_info to the result?
+}
+
+const TextureAtlas::Icon* Resources::GetItemIcon(GW::Item* item)
+{
+    const auto file_id = GetItemIconFileId(item);
+    return file_id ? GwDatTextureModule::LoadIconFromFileId(file_id) : &empty_icon;
+}
+
+uint32_t Resources::GetItemIconFileId(GW::Item* item)
 {
     if (!(item && item->model_file_id))
-        return nullptr;
+        return 0;
     uint32_t model_id_to_load = 0;
     const bool is_composite_item = (item->interaction & 4) != 0;
 
@@ -1351,8 +1756,7 @@ IDirect3DTexture9** Resources::GetItemImage(GW::Item* item)
     }
     if (!model_id_to_load)
         model_id_to_load = item->model_file_id;
-    return GwDatTextureModule::LoadTextureFromFileId(model_id_to_load);
-    // @Enhancement: How to apply dye_info to the result?
+    return model_id_to_load;
 }
 
 IDirect3DTexture9** Resources::GetItemImage(const std::wstring& item_name)
@@ -1361,19 +1765,29 @@ IDirect3DTexture9** Resources::GetItemImage(const std::wstring& item_name)
         return nullptr;
     }
     if (item_images.contains(item_name)) {
-        return item_images.at(item_name);
+        return TextureCache::Request(item_images.at(item_name));
     }
-    const auto callback = [item_name](const bool success, const std::wstring& error) {
+    const auto texture = new IDirect3DTexture9*;
+    *texture = nullptr;
+    item_images[item_name] = texture;
+    return TextureCache::Add(texture, [item_name](IDirect3DTexture9** slot, const TextureCache::LoadDone& done) {
+        LoadItemImage(slot, item_name, done);
+    });
+}
+
+void Resources::LoadItemImage(IDirect3DTexture9** texture, const std::wstring& item_name, const AsyncLoadCallback& done)
+{
+    const auto callback = [item_name, done](const bool success, const std::wstring& error) {
         if (!success) {
             Log::LogW(L"Error: Failed to load item image %s\n%s", item_name.c_str(), error.c_str());
         }
         else {
             Log::LogW(L"Loaded item image %s", item_name.c_str());
         }
+        if (done) {
+            done(success, error);
+        }
     };
-    const auto texture = new IDirect3DTexture9*;
-    *texture = nullptr;
-    item_images[item_name] = texture;
     static std::filesystem::path path = GetPath(ITEM_IMAGES_PATH);
     ASSERT(EnsureFolderExists(path));
 
@@ -1382,7 +1796,7 @@ IDirect3DTexture9** Resources::GetItemImage(const std::wstring& item_name)
     swprintf(path_to_file, _countof(path_to_file), L"%s\\%s.png", path.c_str(), item_name.c_str());
     if (std::filesystem::exists(path_to_file)) {
         LoadTexture(texture, path_to_file, callback);
-        return texture;
+        return;
     }
 
     // No local file found; download from wiki via searching by the item name; the wiki will usually return a 302 redirect if its an exact item match
@@ -1429,7 +1843,6 @@ IDirect3DTexture9** Resources::GetItemImage(const std::wstring& item_name)
         }
         LoadTexture(texture, path_to_file, url, callback);
     });
-    return texture;
 }
 
 bool Resources::SaveTextureToFile(IDirect3DTexture9* texture, const std::filesystem::path& file_path)
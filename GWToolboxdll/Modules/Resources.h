@@ -2,10 +2,14 @@
 
 #include <ToolboxModule.h>
 #include <Utf8.h>
+#include <Utils/HttpCache.h>
 
 namespace GuiUtils {
     class EncString;
 }
+namespace TextureAtlas {
+    struct Icon;
+}
 namespace GW {
     struct Item;
     namespace Constants {
@@ -41,8 +45,57 @@ public:
     void Update(float delta) override;
     static void DxUpdate(IDirect3DDevice9* device);
 
+    enum class TaskPriority : uint8_t {
+        UserVisible, // something on screen is waiting for it
+        Background   // prefetches and other work nobody is waiting on; only a few of these run at once
+    };
+
+    // Calls off worker tasks it was passed to. Tasks that haven't started when Cancel() is called are dropped;
+    // running ones can check IsCancelled() to stop early. Copies share the same flag.
+    class CancellationToken {
+    public:
+        CancellationToken() : cancelled(std::make_shared<std::atomic<bool>>(false)) {}
+        void Cancel() const { *cancelled = true; }
+        [[nodiscard]] bool IsCancelled() const { return *cancelled; }
+
+    private:
+        std::shared_ptr<std::atomic<bool>> cancelled;
+    };
+
+    struct WorkerTaskStats {
+        uint64_t completed = 0;
+        uint64_t cancelled = 0;
+        double total_wait_ms = 0.0; // from enqueued to started
+        double max_wait_ms = 0.0;
+        double total_run_ms = 0.0;
+        double max_run_ms = 0.0;
+    };
+    struct WorkerStats {
+        size_t workers = 0;
+        size_t queued[2] = {};  // by TaskPriority
+        size_t running[2] = {}; // by TaskPriority
+        WorkerTaskStats by_priority[2];
+        std::map<std::string, WorkerTaskStats> by_label;
+    };
+
     // Enqueue instruction to be called on worker thread, away from the render loop e.g. curl requests
     static void EnqueueWorkerTask(const std::function<void()>& f);
+    // As above; label groups the task's timings in GetWorkerStats(), and must outlive the task (e.g. a literal)
+    static void EnqueueWorkerTask(const std::function<void()>& f, TaskPriority priority, const CancellationToken* token = nullptr, const char* label = nullptr);
+    static WorkerStats GetWorkerStats();
+
+    struct FrameQueueStats {
+        size_t queued = 0;
+        uint64_t completed = 0;
+        float last_frame_ms = 0.f; // time spent running tasks in the last frame that had any
+        float max_frame_ms = 0.f;
+        uint64_t frames_over_budget = 0; // frames that stopped with tasks still queued
+    };
+    // Main and DX tasks run each frame until this much time has been spent on them; at least one runs per frame
+    static void SetFrameTaskBudget(float milliseconds);
+    static float GetFrameTaskBudget();
+    static FrameQueueStats GetMainQueueStats();
+    static FrameQueueStats GetDxQueueStats();
     // Enqueue instruction to be called on the main update loop of GW
     static void EnqueueMainTask(const std::function<void()>& f);
     // Enqueue instruction to be called on the draw loop of GW e.g. messing with DirectX9 device
@@ -77,7 +130,8 @@ public:
     // Callback for binary, usually only curl stuff; try to stick to wstrings where possible
     using AsyncLoadMbCallback = std::function<void(bool success, const std::string& response, void* context)>;
 
-    // Load from file to D3DTexture, runs callback on completion
+    // Load from file to D3DTexture, runs callback on completion. The file is read and decoded on a worker;
+    // the DX thread only creates the texture and copies the pixels in.
     static void LoadTexture(IDirect3DTexture9** texture, const std::filesystem::path& path_to_file, AsyncLoadCallback callback = nullptr);
     // Load from compiled resource id to D3DTexture, runs callback on completion
     static void LoadTexture(IDirect3DTexture9** texture, WORD id, AsyncLoadCallback callback = nullptr);
@@ -94,6 +148,8 @@ public:
     // Fetches skill image from gw dat via file_id
     static IDirect3DTexture9** GetSkillImage(GW::Constants::SkillID skill_id);
     static IDirect3DTexture9** GetSkillHiResImage(GW::Constants::SkillID skill_id);
+    // As GetSkillImage, but on a shared atlas page; draw with ImGui::Icon to batch rows of them
+    static const TextureAtlas::Icon* GetSkillIcon(GW::Constants::SkillID skill_id);
     // Fetches skill page from GWW, parses out the image for the skill then downloads that to disk
     // Not elegant, but without a proper API to provide images, and to avoid including libxml, this is the next best thing.
     // Guaranteed to return a pointer, but reference will be null until the texture has been loaded
@@ -102,6 +158,8 @@ public:
     static GuiUtils::EncString* GetSkillName(const GW::Constants::SkillID skill_id);
 
     static IDirect3DTexture9** GetItemImage(GW::Item* item);
+    // As GetItemImage, but on a shared atlas page; draw with ImGui::Icon to batch rows of them
+    static const TextureAtlas::Icon* GetItemIcon(GW::Item* item);
     // Fetches item page from GWW, parses out the image for the item then downloads that to disk
     // Not elegant, but without a proper API to provide images, and to avoid including libxml, this is the next best thing.
     // Guaranteed to return a pointer, but reference will be null until the texture has been loaded
@@ -139,6 +197,7 @@ public:
     // download to memory, async, calls callback on completion. If an error occurs, details are held in response string
     static void Download(const std::string& url, AsyncLoadMbCallback callback, void* context = nullptr);
     // download to memory, async, calls callback on completion and caches the response locally for the duration specified. If an error occurs, details are held in response string
+    // Once the duration is up the cached response is revalidated with the server (ETag/Last-Modified) before downloading it again.
     static void Download(const std::string& url, AsyncLoadMbCallback callback, void* context, std::chrono::seconds cache_duration);
 
     // download to memory, blocking. If an error occurs, details are held in response string
@@ -146,6 +205,17 @@ public:
     // download to memory, async, calls callback on completion. If an error occurs, details are held in response string
     static void Post(const std::string& url, const std::string& payload, AsyncLoadMbCallback callback, void* wparam = nullptr);
 
+    // The async Download/Post calls above share one transfer between identical requests made while it is in flight
+    struct RequestStats {
+        uint64_t started = 0;   // transfers actually made
+        uint64_t coalesced = 0; // requests that waited on an identical one instead
+        size_t in_flight = 0;
+    };
+    static RequestStats GetRequestStats();
+    // Least recently used cached responses are removed once the cache grows past this
+    static void SetHttpCacheLimit(uint64_t max_bytes);
+    static HttpCache::Stats GetHttpCacheStats();
+
     // Stops the worker thread once it's done with the current jobs.
     void EndLoading() const;
 
@@ -159,12 +229,14 @@ public:
 
 private:
     static void Cleanup();
-    // Assign IDirect3DTexture9* from file
-    static HRESULT TryCreateTexture(IDirect3DDevice9* device, const std::filesystem::path& path_to_file, IDirect3DTexture9** texture, std::wstring& error);
-    // Assign IDirect3DTexture9* from resource
-    static HRESULT TryCreateTexture(IDirect3DDevice9* pDevice, HMODULE hSrcModule, LPCSTR pSrcResource, IDirect3DTexture9** texture, std::wstring& error);
     // Copy from compiled resource binary to file on local disk.
     static bool ResourceToFile(WORD id, const std::filesystem::path& path_to_file, std::wstring& error);
+    // Dat file id of the item's inventory icon, 0 if it has none
+    static uint32_t GetItemIconFileId(GW::Item* item);
+    // Loaders for the image caches; used again to reload an image the TextureCache evicted. done is called once the load is over, either way
+    static void LoadSkillImageFromGWW(IDirect3DTexture9** texture, GW::Constants::SkillID skill_id, const AsyncLoadCallback& done = nullptr);
+    static void LoadItemImage(IDirect3DTexture9** texture, const std::wstring& item_name, const AsyncLoadCallback& done = nullptr);
+    static void LoadGuildWarsWikiImage(IDirect3DTexture9** texture, const std::string& filename, const std::string& filename_sanitised, size_t width, bool urlencode_filename, const AsyncLoadCallback& done = nullptr);
 
     bool co_initialized = false;
 };
@@ -6,6 +6,7 @@
 #include <GWCA/Managers/AgentMgr.h>
 
 #include <Utils/GuiUtils.h>
+#include <Utils/TextureCache.h>
 #include <GWToolbox.h>
 
 #include <Modules/Updater.h>
@@ -262,6 +263,16 @@ void ToolboxSettings::DrawSettingsInternal()
 
     ImGui::Checkbox("Save Location Data", &save_location_data);
     ImGui::ShowHelp("Toolbox will save your location every second in a file in Settings Folder.");
+    ImGui::PushItemWidth(200.f);
+    if (ImGui::SliderInt("Download cache size", &download_cache_size_mb, 16, 4096, "%d MB", ImGuiSliderFlags_AlwaysClamp)) {
+        Resources::SetHttpCacheLimit(static_cast<uint64_t>(download_cache_size_mb) * 1024 * 1024);
+    }
+    ImGui::ShowHelp("Wiki pages, prices and images downloaded by Toolbox are kept in the cache folder so they aren't downloaded again every launch.\nThe least recently used are removed once it grows past this size.");
+    if (ImGui::SliderInt("Texture memory", &texture_memory_mb, 32, 1024, "%d MB", ImGuiSliderFlags_AlwaysClamp)) {
+        TextureCache::SetBudget(static_cast<uint64_t>(texture_memory_mb) * 1024 * 1024);
+    }
+    ImGui::PopItemWidth();
+    ImGui::ShowHelp("Skill, item and wiki images Toolbox has loaded are kept in memory for reuse.\nOnce they take up more than this, those not shown for a while are released, and loaded again when next needed.");
     const auto cols = static_cast<size_t>(floor(ImGui::GetWindowWidth() / (170.0f * ImGui::GetIO().FontGlobalScale)));
 
     ImGui::Separator();
@@ -321,6 +332,12 @@ void ToolboxSettings::LoadSettings(ToolboxIni* ini)
     LOAD_BOOL(clamp_windows_to_screen);
     LOAD_BOOL(hide_on_loading_screen);
     LOAD_BOOL(send_anonymous_gameplay_info);
+    LOAD_UINT(download_cache_size_mb);
+    download_cache_size_mb = std::clamp(download_cache_size_mb, 16, 4096);
+    Resources::SetHttpCacheLimit(static_cast<uint64_t>(download_cache_size_mb) * 1024 * 1024);
+    LOAD_UINT(texture_memory_mb);
+    texture_memory_mb = std::clamp(texture_memory_mb, 32, 1024);
+    TextureCache::SetBudget(static_cast<uint64_t>(texture_memory_mb) * 1024 * 1024);
 
     for (auto& m : optional_modules) {
         m.enabled = ini->GetBoolValue(modules_ini_section, m.name, m.enabled);
@@ -337,6 +354,8 @@ void ToolboxSettings::SaveSettings(ToolboxIni* ini)
     SAVE_BOOL(clamp_windows_to_screen);
     SAVE_BOOL(hide_on_loading_screen);
     SAVE_BOOL(send_anonymous_gameplay_info);
+    SAVE_UINT(download_cache_size_mb);
+    SAVE_UINT(texture_memory_mb);
 
     for (const auto& m : optional_modules) {
         ini->SetBoolValue(modules_ini_section, m.name, m.enabled);
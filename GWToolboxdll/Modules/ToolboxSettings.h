@@ -45,4 +45,7 @@ private:
     GW::Constants::MapID location_current_map = static_cast<GW::Constants::MapID>(0);
     std::wofstream location_file;
     bool save_location_data = false;
+
+    int download_cache_size_mb = 128;
+    int texture_memory_mb = 128;
 };
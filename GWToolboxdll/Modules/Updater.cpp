@@ -302,7 +302,7 @@ void Updater::CheckForUpdate(const bool forced)
                 step = CheckAndWarn;
                 break;
         }
-    });
+    }, forced ? Resources::TaskPriority::UserVisible : Resources::TaskPriority::Background, nullptr, "Update check");
 }
 
 bool Updater::IsLatestVersion()
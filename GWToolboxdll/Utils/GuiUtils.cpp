@@ -159,7 +159,7 @@ namespace GuiUtils {
         cursor_pos.x += text_size;
         for (auto& skill : skill_template.skills) {
             ImGui::SetCursorPos(cursor_pos);
-            ImGui::ImageCropped(*Resources::GetSkillImage(skill), skill_size);
+            ImGui::Icon(Resources::GetSkillIcon(skill), skill_size);
             cursor_pos.x += skill_size.x;
         }
     }
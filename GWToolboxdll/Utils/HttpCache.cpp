@@ -0,0 +1,331 @@
+#include "stdafx.h"
+
+#include "HttpCache.h"
+
+namespace {
+    constexpr int INDEX_VERSION = 1;
+    constexpr const char* INDEX_FILE_NAME = "index.json";
+    // Saved at most this often while responses come in; SaveIndex() writes it regardless
+    constexpr time_t INDEX_SAVE_INTERVAL = 30;
+
+    bool HeaderNameEquals(const std::string_view line, const std::string_view name)
+    {
+        return line.size() > name.size() && line[name.size()] == ':'
+               && std::ranges::equal(line.substr(0, name.size()), name, [](const char a, const char b) {
+                   return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+               });
+    }
+
+    // Value of the last header called name; redirects leave one header block per response, the final one last
+    std::string FindHeader(const std::string& headers, const std::string_view name)
+    {
+        std::string value;
+        size_t pos = 0;
+        while (pos < headers.size()) {
+            auto end = headers.find('\n', pos);
+            if (end == std::string::npos) end = headers.size();
+            const auto line = std::string_view(headers).substr(pos, end - pos);
+            if (HeaderNameEquals(line, name)) {
+                auto v = line.substr(name.size() + 1);
+                while (!v.empty() && (v.front() == ' ' || v.front() == '\t')) v.remove_prefix(1);
+                while (!v.empty() && (v.back() == '\r' || v.back() == ' ')) v.remove_suffix(1);
+                value = v;
+            }
+            pos = end + 1;
+        }
+        return value;
+    }
+
+    bool ReadBody(const std::filesystem::path& path, std::string& out)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+        out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return !file.bad();
+    }
+
+    bool WriteBody(const std::filesystem::path& path, const std::string& body)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+        file.write(body.data(), static_cast<std::streamsize>(body.size()));
+        return file.good();
+    }
+} // namespace
+
+std::string HttpCache::FileName(const std::string& url)
+{
+    // FNV-1a; the index keeps the url too, so a collision is a miss rather than the wrong body
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const auto c : url) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3ull;
+    }
+    return std::format("{:016x}", hash);
+}
+
+void HttpCache::Open(const std::filesystem::path& _folder, const uint64_t _max_disk_bytes, const size_t _max_memory_bytes)
+{
+    std::lock_guard lock(mutex);
+    folder = _folder;
+    max_disk_bytes = _max_disk_bytes;
+    max_memory_bytes = _max_memory_bytes;
+    index.clear();
+    memory.clear();
+    disk_bytes = 0;
+    memory_bytes = 0;
+
+    std::error_code ec;
+    std::filesystem::create_directories(folder, ec);
+
+    std::ifstream index_file(folder / INDEX_FILE_NAME);
+    const auto json = index_file.is_open() ? nlohmann::json::parse(index_file, nullptr, false) : nlohmann::json();
+    if (json.is_object() && json.value("version", 0) == INDEX_VERSION && json.contains("entries") && json["entries"].is_object()) {
+        use_clock = json.value("clock", 0ull);
+        for (const auto& [file_name, j] : json["entries"].items()) {
+            if (!j.is_object()) continue;
+            IndexEntry entry;
+            entry.url = j.value("url", "");
+            entry.status_code = j.value("status", 0);
+            entry.etag = j.value("etag", "");
+            entry.last_modified = j.value("last_modified", "");
+            entry.size = j.value("size", 0ull);
+            entry.expires = j.value("expires", static_cast<time_t>(0));
+            entry.last_used = j.value("last_used", 0ull);
+            // Drop entries whose body went missing or was left half written
+            const auto size = std::filesystem::file_size(folder / file_name, ec);
+            if (ec || size != entry.size || entry.url.empty()) continue;
+            disk_bytes += entry.size;
+            index.emplace(file_name, std::move(entry));
+        }
+    }
+    // Anything not in the index can't be looked up, e.g. files from before there was an index
+    for (const auto& file : std::filesystem::directory_iterator(folder, ec)) {
+        const auto file_name = file.path().filename().string();
+        if (file_name == INDEX_FILE_NAME || index.contains(file_name)) continue;
+        std::filesystem::remove_all(file.path(), ec);
+    }
+    EvictFromDisk();
+    SaveIndexLocked();
+}
+
+void HttpCache::SaveIndex()
+{
+    std::lock_guard lock(mutex);
+    if (index_dirty) {
+        SaveIndexLocked();
+    }
+}
+
+void HttpCache::SaveIndexLocked()
+{
+    if (folder.empty())
+        return;
+    nlohmann::json entries = nlohmann::json::object();
+    for (const auto& [file_name, entry] : index) {
+        entries[file_name] = {
+            {"url", entry.url},
+            {"status", entry.status_code},
+            {"etag", entry.etag},
+            {"last_modified", entry.last_modified},
+            {"size", entry.size},
+            {"expires", entry.expires},
+            {"last_used", entry.last_used}
+        };
+    }
+    const nlohmann::json json = {{"version", INDEX_VERSION}, {"clock", use_clock}, {"entries", entries}};
+    const auto tmp_path = folder / (std::string(INDEX_FILE_NAME) + ".tmp");
+    if (!WriteBody(tmp_path, json.dump()))
+        return;
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, folder / INDEX_FILE_NAME, ec);
+    index_dirty = false;
+    index_saved = std::time(nullptr);
+}
+
+void HttpCache::Touch(IndexEntry& entry)
+{
+    entry.last_used = ++use_clock;
+    index_dirty = true;
+}
+
+HttpCache::Lookup HttpCache::Get(const std::string& url, Entry& out)
+{
+    const auto file_name = FileName(url);
+    IndexEntry entry;
+    std::shared_ptr<const std::string> body;
+    {
+        std::lock_guard lock(mutex);
+        const auto found = index.find(file_name);
+        if (found == index.end() || found->second.url != url) {
+            stats.misses++;
+            return Lookup::Miss;
+        }
+        Touch(found->second);
+        entry = found->second;
+        if (const auto in_memory = memory.find(file_name); in_memory != memory.end()) {
+            in_memory->second.last_used = ++use_clock;
+            body = in_memory->second.body;
+        }
+    }
+
+    std::string from_disk;
+    if (!body) {
+        if (!ReadBody(folder / file_name, from_disk) || from_disk.size() != entry.size) {
+            std::lock_guard lock(mutex);
+            if (const auto found = index.find(file_name); found != index.end() && found->second.url == url) {
+                disk_bytes -= found->second.size;
+                index.erase(found);
+                index_dirty = true;
+            }
+            stats.misses++;
+            return Lookup::Miss;
+        }
+    }
+
+    const auto fresh = std::time(nullptr) < entry.expires;
+    {
+        std::lock_guard lock(mutex);
+        if (body) {
+            if (fresh) stats.memory_hits++;
+        }
+        else {
+            body = std::make_shared<const std::string>(std::move(from_disk));
+            KeepInMemory(file_name, body);
+            if (fresh) stats.disk_hits++;
+        }
+    }
+    out.body = *body;
+    out.status_code = entry.status_code;
+    out.etag = entry.etag;
+    out.last_modified = entry.last_modified;
+    return fresh ? Lookup::Fresh : Lookup::Stale;
+}
+
+void HttpCache::Put(const std::string& url, const std::string& body, const int status_code, const std::string& response_headers, const std::chrono::seconds max_age)
+{
+    const auto file_name = FileName(url);
+    {
+        std::lock_guard lock(mutex);
+        if (folder.empty())
+            return;
+    }
+    // Written aside and moved into place, so a reader never sees half a body
+    const auto tmp_path = folder / (file_name + ".tmp");
+    if (!WriteBody(tmp_path, body))
+        return;
+
+    std::lock_guard lock(mutex);
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, folder / file_name, ec);
+    if (ec) {
+        std::filesystem::remove(tmp_path, ec);
+        return;
+    }
+    auto& entry = index[file_name];
+    disk_bytes -= entry.size;
+    entry.url = url;
+    entry.status_code = status_code;
+    entry.etag = FindHeader(response_headers, "ETag");
+    entry.last_modified = FindHeader(response_headers, "Last-Modified");
+    entry.size = body.size();
+    entry.expires = std::time(nullptr) + max_age.count();
+    Touch(entry);
+    disk_bytes += entry.size;
+    KeepInMemory(file_name, std::make_shared<const std::string>(body));
+    EvictFromDisk();
+    if (std::time(nullptr) - index_saved >= INDEX_SAVE_INTERVAL) {
+        SaveIndexLocked();
+    }
+}
+
+void HttpCache::Revalidated(const std::string& url, const std::chrono::seconds max_age)
+{
+    std::lock_guard lock(mutex);
+    const auto found = index.find(FileName(url));
+    if (found == index.end() || found->second.url != url)
+        return;
+    found->second.expires = std::time(nullptr) + max_age.count();
+    Touch(found->second);
+    stats.revalidated++;
+}
+
+void HttpCache::CountMiss()
+{
+    std::lock_guard lock(mutex);
+    stats.misses++;
+}
+
+void HttpCache::KeepInMemory(const std::string& file_name, std::shared_ptr<const std::string> body)
+{
+    // The old body is out of date even if the new one is too big to keep
+    const auto found = memory.find(file_name);
+    if (found != memory.end()) {
+        memory_bytes -= found->second.body->size();
+        memory.erase(found);
+    }
+    // One big response shouldn't push out everything else
+    if (body->size() > max_memory_bytes / 4)
+        return;
+    auto& in_memory = memory[file_name];
+    memory_bytes += body->size();
+    in_memory.body = std::move(body);
+    in_memory.last_used = ++use_clock;
+    EvictFromMemory();
+}
+
+void HttpCache::EvictFromMemory()
+{
+    while (memory_bytes > max_memory_bytes && !memory.empty()) {
+        const auto oldest = std::ranges::min_element(memory, {}, [](const auto& it) {
+            return it.second.last_used;
+        });
+        memory_bytes -= oldest->second.body->size();
+        memory.erase(oldest);
+    }
+}
+
+void HttpCache::EvictFromDisk()
+{
+    if (disk_bytes <= max_disk_bytes)
+        return;
+    std::vector<std::pair<uint64_t, std::string>> by_last_used;
+    by_last_used.reserve(index.size());
+    for (const auto& [file_name, entry] : index) {
+        by_last_used.emplace_back(entry.last_used, file_name);
+    }
+    std::ranges::sort(by_last_used);
+    std::error_code ec;
+    for (const auto& file_name : by_last_used | std::views::values) {
+        if (disk_bytes <= max_disk_bytes)
+            break;
+        disk_bytes -= index[file_name].size;
+        index.erase(file_name);
+        if (const auto in_memory = memory.find(file_name); in_memory != memory.end()) {
+            memory_bytes -= in_memory->second.body->size();
+            memory.erase(in_memory);
+        }
+        std::filesystem::remove(folder / file_name, ec);
+        stats.evictions++;
+    }
+    index_dirty = true;
+}
+
+void HttpCache::SetMaxDiskBytes(const uint64_t _max_disk_bytes)
+{
+    std::lock_guard lock(mutex);
+    max_disk_bytes = _max_disk_bytes;
+    EvictFromDisk();
+}
+
+HttpCache::Stats HttpCache::GetStats()
+{
+    std::lock_guard lock(mutex);
+    auto out = stats;
+    out.entries = index.size();
+    out.disk_bytes = disk_bytes;
+    out.memory_bytes = memory_bytes;
+    out.max_disk_bytes = max_disk_bytes;
+    return out;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+// Responses to GET requests, kept on disk so they survive restarts.
+// Bodies are stored one file per url in the cache folder, listed in index.json with
+// their expiry and the validators (ETag, Last-Modified) the server sent, so an expired
+// entry can be revalidated with a conditional GET instead of downloaded again.
+// The least recently used entries are removed once the folder grows past its byte cap;
+// the most recently used bodies are also kept in memory.
+// All functions are thread safe.
+class HttpCache {
+public:
+    enum class Lookup {
+        Miss,
+        Fresh, // use the body as is
+        Stale  // expired; revalidate with the etag/last_modified it came with
+    };
+
+    struct Entry {
+        std::string body;
+        int status_code = 0;
+        std::string etag;
+        std::string last_modified;
+    };
+
+    struct Stats {
+        uint64_t memory_hits = 0;
+        uint64_t disk_hits = 0;
+        uint64_t revalidated = 0; // stale entries the server said were still good
+        uint64_t misses = 0;      // includes stale entries that had to be downloaded again
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        uint64_t disk_bytes = 0;
+        size_t memory_bytes = 0;
+        uint64_t max_disk_bytes = 0;
+    };
+
+    // Loads the index; files in folder that aren't in it are removed
+    void Open(const std::filesystem::path& folder, uint64_t max_disk_bytes, size_t max_memory_bytes);
+    // Writes the index if anything changed since the last save
+    void SaveIndex();
+
+    Lookup Get(const std::string& url, Entry& out);
+    // response_headers is the raw header block from curl; the validators are taken from it
+    void Put(const std::string& url, const std::string& body, int status_code, const std::string& response_headers, std::chrono::seconds max_age);
+    // The server answered 304 for a stale entry; it's good for max_age more
+    void Revalidated(const std::string& url, std::chrono::seconds max_age);
+    // Counts a stale entry that had to be downloaded again
+    void CountMiss();
+
+    void SetMaxDiskBytes(uint64_t max_disk_bytes);
+    Stats GetStats();
+
+private:
+    struct IndexEntry {
+        std::string url;
+        int status_code = 0;
+        std::string etag;
+        std::string last_modified;
+        uint64_t size = 0;
+        time_t expires = 0;
+        uint64_t last_used = 0; // use_clock when last looked up or stored
+    };
+    struct MemoryEntry {
+        std::shared_ptr<const std::string> body;
+        uint64_t last_used = 0;
+    };
+
+    static std::string FileName(const std::string& url);
+    void Touch(IndexEntry& entry);
+    void KeepInMemory(const std::string& file_name, std::shared_ptr<const std::string> body);
+    void EvictFromDisk();
+    void EvictFromMemory();
+    void SaveIndexLocked();
+
+    std::mutex mutex;
+    std::filesystem::path folder;
+    std::unordered_map<std::string, IndexEntry> index; // by file name
+    std::unordered_map<std::string, MemoryEntry> memory; // by file name
+    uint64_t use_clock = 0;
+    uint64_t max_disk_bytes = 0;
+    size_t max_memory_bytes = 0;
+    uint64_t disk_bytes = 0;
+    size_t memory_bytes = 0;
+    bool index_dirty = false;
+    time_t index_saved = 0;
+    Stats stats;
+};
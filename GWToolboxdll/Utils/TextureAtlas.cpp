@@ -0,0 +1,124 @@
+#include "stdafx.h"
+
+#include "TextureAtlas.h"
+
+namespace {
+    constexpr uint32_t PAGE_SIZE = 1024;
+    constexpr uint32_t MAX_PAGES = 8;
+    // Bigger images get a texture of their own
+    constexpr uint32_t MAX_ICON_SIZE = 128;
+    // Edge pixels repeated round each icon, so linear filtering doesn't pull in its neighbours
+    constexpr uint32_t BORDER = 1;
+
+    AtlasAllocator allocator(PAGE_SIZE, PAGE_SIZE, MAX_PAGES);
+    std::vector<IDirect3DTexture9*> pages;
+    size_t standalone = 0;
+
+    // Fills rect, which is the icon plus its border
+    HRESULT CopyWithBorder(IDirect3DTexture9* texture, const RECT* rect, const uint8_t* pixels, const uint32_t width, const uint32_t height, const uint32_t border)
+    {
+        D3DLOCKED_RECT locked;
+        const HRESULT res = texture->LockRect(0, &locked, rect, 0);
+        if (res != D3D_OK)
+            return res;
+        const size_t row_bytes = width * 4;
+        for (uint32_t y = 0; y < height + border * 2; y++) {
+            const auto src = pixels + std::clamp(static_cast<int>(y) - static_cast<int>(border), 0, static_cast<int>(height) - 1) * row_bytes;
+            const auto dst = static_cast<uint8_t*>(locked.pBits) + y * locked.Pitch;
+            for (uint32_t x = 0; x < border; x++) {
+                memcpy(dst + x * 4, src, 4);
+                memcpy(dst + (border + width + x) * 4, src + row_bytes - 4, 4);
+            }
+            memcpy(dst + border * 4, src, row_bytes);
+        }
+        texture->UnlockRect(0);
+        return D3D_OK;
+    }
+
+    HRESULT AddToPage(IDirect3DDevice9* device, const uint8_t* pixels, const uint32_t width, const uint32_t height, TextureAtlas::Icon& icon)
+    {
+        AtlasAllocator::Allocation allocation;
+        if (width > MAX_ICON_SIZE || height > MAX_ICON_SIZE || !allocator.Allocate(width + BORDER * 2, height + BORDER * 2, allocation))
+            return D3DERR_OUTOFVIDEOMEMORY;
+        if (allocation.page == pages.size()) {
+            IDirect3DTexture9* page = nullptr;
+            const HRESULT res = device->CreateTexture(PAGE_SIZE, PAGE_SIZE, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &page, nullptr);
+            if (res != D3D_OK) {
+                allocator.Free(allocation);
+                return res;
+            }
+            pages.push_back(page);
+        }
+        const RECT rect = {
+            static_cast<LONG>(allocation.x), static_cast<LONG>(allocation.y),
+            static_cast<LONG>(allocation.x + allocation.width), static_cast<LONG>(allocation.y + allocation.height)
+        };
+        const HRESULT res = CopyWithBorder(pages[allocation.page], &rect, pixels, width, height, BORDER);
+        if (res != D3D_OK) {
+            allocator.Free(allocation);
+            return res;
+        }
+        constexpr float texel = 1.f / PAGE_SIZE;
+        icon.texture = pages[allocation.page];
+        icon.uv0 = {(allocation.x + BORDER) * texel, (allocation.y + BORDER) * texel};
+        icon.uv1 = {(allocation.x + BORDER + width) * texel, (allocation.y + BORDER + height) * texel};
+        icon.on_page = true;
+        icon.allocation = allocation;
+        return D3D_OK;
+    }
+} // namespace
+
+namespace TextureAtlas {
+    HRESULT Add(IDirect3DDevice9* device, const uint8_t* pixels, const uint32_t width, const uint32_t height, Icon& icon)
+    {
+        if (!(device && pixels && width && height))
+            return D3DERR_INVALIDCALL;
+        icon.width = width;
+        icon.height = height;
+        if (AddToPage(device, pixels, width, height, icon) == D3D_OK)
+            return D3D_OK;
+
+        IDirect3DTexture9* texture = nullptr;
+        HRESULT res = device->CreateTexture(width, height, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &texture, nullptr);
+        if (res != D3D_OK)
+            return res;
+        res = CopyWithBorder(texture, nullptr, pixels, width, height, 0);
+        if (res != D3D_OK) {
+            texture->Release();
+            return res;
+        }
+        icon.texture = texture;
+        icon.uv0 = {0.f, 0.f};
+        icon.uv1 = {1.f, 1.f};
+        icon.on_page = false;
+        standalone++;
+        return D3D_OK;
+    }
+
+    void Remove(Icon& icon)
+    {
+        if (icon.on_page) {
+            allocator.Free(icon.allocation);
+        }
+        else if (icon.texture) {
+            icon.texture->Release();
+            standalone--;
+        }
+        icon = {};
+    }
+
+    void ReleasePages()
+    {
+        assert(allocator.GetStats().allocations == 0);
+        for (const auto page : pages) {
+            page->Release();
+        }
+        pages.clear();
+        allocator = AtlasAllocator(PAGE_SIZE, PAGE_SIZE, MAX_PAGES);
+    }
+
+    Stats GetStats()
+    {
+        return {allocator.GetStats(), standalone};
+    }
+} // namespace TextureAtlas
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <AtlasAllocator.h>
+
+// Small images such as skill and item icons, packed into a few shared textures ("pages") so that
+// ImGui can draw a run of them in one command instead of one per image.
+// Only used from the render thread, where DX tasks and ImGui both run.
+namespace TextureAtlas {
+    struct Icon {
+        // The page it's on, or a texture of its own if it didn't fit on one; null until loaded
+        IDirect3DTexture9* texture = nullptr;
+        ImVec2 uv0 = {0.f, 0.f};
+        ImVec2 uv1 = {1.f, 1.f};
+        uint32_t width = 0;
+        uint32_t height = 0;
+        bool on_page = false;
+        AtlasAllocator::Allocation allocation; // when on_page
+    };
+
+    struct Stats {
+        AtlasAllocator::Stats packing;
+        size_t standalone = 0; // icons with a texture of their own
+    };
+
+    // pixels are A8R8G8B8, rows of width * 4 bytes. Copies them onto a page, or into a texture of their own
+    // if they're too big for one or every page is full.
+    HRESULT Add(IDirect3DDevice9* device, const uint8_t* pixels, uint32_t width, uint32_t height, Icon& icon);
+    // Gives its place on the page back, or releases its own texture
+    void Remove(Icon& icon);
+    // Once every icon has been removed
+    void ReleasePages();
+    Stats GetStats();
+}
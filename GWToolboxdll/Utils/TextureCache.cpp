@@ -0,0 +1,282 @@
+#include "stdafx.h"
+
+#include <Modules/Resources.h>
+
+#include "TextureCache.h"
+
+namespace {
+    // Not evicted until unused for this many frames, however far over budget
+    constexpr uint64_t MIN_IDLE_FRAMES = 300;
+    // How often to look for something to evict while over budget
+    constexpr uint64_t EVICT_INTERVAL_FRAMES = 60;
+
+    struct Entry {
+        IDirect3DTexture9** slot = nullptr;
+        TextureCache::Loader loader;
+        IDirect3DTexture9* resident = nullptr; // what was in the slot when last looked; counted in total_bytes
+        IDirect3DTexture9* stand_in = nullptr; // while evicted, until a reload replaces it
+        uint64_t bytes = 0;
+        uint64_t last_used = 0; // frame
+        uint64_t load_id = 0;   // of the latest load, so a late result for an older one is ignored
+        bool failed = false;    // last load finished without a texture; not retried
+    };
+
+    // Loads are started once the lock is released, so a loader can't deadlock calling back in
+    struct PendingLoad {
+        IDirect3DTexture9** slot;
+        TextureCache::Loader loader;
+        uint64_t load_id;
+    };
+
+    std::mutex mutex; // everything below
+    std::unordered_map<IDirect3DTexture9**, Entry> entries;
+    std::unordered_map<IDirect3DTexture9*, Entry*> by_texture; // resident textures and stand-ins, for what ImGui drew
+    std::unordered_set<Entry*> loading;                       // a loader may still fill in the slot
+    uint64_t frame = 0;
+    uint64_t last_evict_frame = 0;
+    uint64_t budget = 128 * 1024 * 1024;
+    uint64_t total_bytes = 0;
+    size_t resident_count = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t next_load_id = 0;
+
+    uint64_t TextureBytes(IDirect3DTexture9* texture)
+    {
+        uint64_t bits = 0;
+        D3DSURFACE_DESC desc;
+        for (DWORD i = 0; i < texture->GetLevelCount(); i++) {
+            if (texture->GetLevelDesc(i, &desc) != D3D_OK)
+                break;
+            bits += static_cast<uint64_t>(desc.Width) * desc.Height * Resources::GetBitsPerPixel(desc.Format);
+        }
+        return bits / 8;
+    }
+
+    IDirect3DTexture9* CreateStandIn(IDirect3DDevice9* device)
+    {
+        IDirect3DTexture9* texture = nullptr;
+        if (device->CreateTexture(1, 1, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &texture, nullptr) != D3D_OK)
+            return nullptr;
+        D3DLOCKED_RECT locked;
+        if (texture->LockRect(0, &locked, nullptr, 0) != D3D_OK) {
+            texture->Release();
+            return nullptr;
+        }
+        *static_cast<uint32_t*>(locked.pBits) = 0; // transparent
+        texture->UnlockRect(0);
+        return texture;
+    }
+
+    // Picks up whatever a loader has put in the slot since it was last looked at
+    void Sync(Entry& entry)
+    {
+        const auto current = *entry.slot;
+        if (entry.stand_in ? current == entry.stand_in : current == entry.resident)
+            return;
+        if (entry.stand_in) {
+            by_texture.erase(entry.stand_in);
+            entry.stand_in->Release();
+            entry.stand_in = nullptr;
+        }
+        if (entry.resident) {
+            // Replaced by its owner, who released the old one
+            by_texture.erase(entry.resident);
+            total_bytes -= entry.bytes;
+            resident_count--;
+        }
+        entry.resident = current;
+        entry.bytes = current ? TextureBytes(current) : 0;
+        if (current) {
+            by_texture[current] = &entry;
+            total_bytes += entry.bytes;
+            resident_count++;
+        }
+    }
+
+    void QueueLoad(Entry& entry, std::vector<PendingLoad>& loads)
+    {
+        misses++;
+        loading.insert(&entry);
+        entry.load_id = ++next_load_id;
+        loads.push_back({entry.slot, entry.loader, entry.load_id});
+    }
+
+    void Reload(Entry& entry, std::vector<PendingLoad>& loads)
+    {
+        if (!entry.stand_in || entry.failed || loading.contains(&entry))
+            return;
+        QueueLoad(entry, loads);
+    }
+
+    // A successful load is picked up by Sync once the texture is in the slot; a failed one never will be
+    void LoadFinished(IDirect3DTexture9** slot, const uint64_t load_id, const bool success)
+    {
+        if (success)
+            return;
+        std::lock_guard lock(mutex);
+        const auto found = entries.find(slot);
+        if (found == entries.end() || found->second.load_id != load_id)
+            return;
+        found->second.failed = true;
+        loading.erase(&found->second);
+    }
+
+    void StartLoads(const std::vector<PendingLoad>& loads)
+    {
+        for (const auto& [slot, loader, load_id] : loads) {
+            loader(slot, [slot, load_id](const bool success, const std::wstring&) {
+                LoadFinished(slot, load_id, success);
+            });
+        }
+    }
+
+    bool Evict(IDirect3DDevice9* device, Entry& entry)
+    {
+        const auto stand_in = CreateStandIn(device);
+        if (!stand_in)
+            return false;
+        by_texture.erase(entry.resident);
+        entry.resident->Release();
+        entry.resident = nullptr;
+        total_bytes -= entry.bytes;
+        entry.bytes = 0;
+        resident_count--;
+        entry.stand_in = stand_in;
+        *entry.slot = stand_in;
+        by_texture[stand_in] = &entry;
+        evictions++;
+        return true;
+    }
+
+    void MarkDrawn(std::vector<PendingLoad>& loads)
+    {
+        if (!ImGui::GetCurrentContext())
+            return;
+        for (const auto viewport : ImGui::GetPlatformIO().Viewports) {
+            const auto draw_data = viewport->DrawData;
+            if (!(draw_data && draw_data->Valid))
+                continue;
+            for (const auto draw_list : draw_data->CmdLists) {
+                for (const auto& cmd : draw_list->CmdBuffer) {
+                    const auto found = by_texture.find(static_cast<IDirect3DTexture9*>(cmd.GetTexID()));
+                    if (found == by_texture.end())
+                        continue;
+                    found->second->last_used = frame;
+                    // A caller holding on to an evicted slot is drawing its stand-in
+                    Reload(*found->second, loads);
+                }
+            }
+        }
+    }
+
+    void EvictIdle(IDirect3DDevice9* device)
+    {
+        if (total_bytes <= budget || frame - last_evict_frame < EVICT_INTERVAL_FRAMES)
+            return;
+        last_evict_frame = frame;
+        std::vector<Entry*> idle;
+        for (auto& entry : entries | std::views::values) {
+            if (entry.resident && frame - entry.last_used >= MIN_IDLE_FRAMES) {
+                idle.push_back(&entry);
+            }
+        }
+        std::ranges::sort(idle, {}, &Entry::last_used);
+        for (const auto entry : idle) {
+            if (total_bytes <= budget || !Evict(device, *entry))
+                break;
+        }
+    }
+} // namespace
+
+namespace TextureCache {
+    IDirect3DTexture9** Add(IDirect3DTexture9** texture, Loader loader)
+    {
+        std::vector<PendingLoad> loads;
+        {
+            std::lock_guard lock(mutex);
+            ASSERT(texture && !entries.contains(texture));
+            auto& entry = entries[texture];
+            entry.slot = texture;
+            entry.loader = std::move(loader);
+            entry.last_used = frame;
+            QueueLoad(entry, loads);
+        }
+        StartLoads(loads);
+        return texture;
+    }
+
+    IDirect3DTexture9** Request(IDirect3DTexture9** texture)
+    {
+        std::vector<PendingLoad> loads;
+        {
+            std::lock_guard lock(mutex);
+            const auto found = entries.find(texture);
+            if (found == entries.end())
+                return texture;
+            auto& entry = found->second;
+            entry.last_used = frame;
+            Sync(entry);
+            if (entry.stand_in) {
+                Reload(entry, loads);
+            }
+            else {
+                hits++;
+            }
+        }
+        StartLoads(loads);
+        return texture;
+    }
+
+    void Remove(IDirect3DTexture9** texture)
+    {
+        std::lock_guard lock(mutex);
+        const auto found = entries.find(texture);
+        if (found == entries.end())
+            return;
+        auto& entry = found->second;
+        if (entry.stand_in) {
+            by_texture.erase(entry.stand_in);
+            // Otherwise it's in the slot, for the owner to release
+            if (*texture != entry.stand_in) {
+                entry.stand_in->Release();
+            }
+        }
+        if (entry.resident) {
+            by_texture.erase(entry.resident);
+            total_bytes -= entry.bytes;
+            resident_count--;
+        }
+        loading.erase(&entry);
+        entries.erase(found);
+    }
+
+    void Update(IDirect3DDevice9* device)
+    {
+        std::vector<PendingLoad> loads;
+        {
+            std::lock_guard lock(mutex);
+            frame++;
+            for (auto it = loading.begin(); it != loading.end();) {
+                Sync(**it);
+                it = (*it)->resident ? loading.erase(it) : std::next(it);
+            }
+            MarkDrawn(loads);
+            EvictIdle(device);
+        }
+        StartLoads(loads);
+    }
+
+    void SetBudget(const uint64_t bytes)
+    {
+        std::lock_guard lock(mutex);
+        budget = bytes;
+    }
+
+    Stats GetStats()
+    {
+        std::lock_guard lock(mutex);
+        return {entries.size(), resident_count, total_bytes, budget, hits, misses, evictions};
+    }
+} // namespace TextureCache
@@ -0,0 +1,41 @@
+#pragma once
+
+// Textures that Resources and GwDatTextureModule keep for reuse (skill, item, wiki and dat images),
+// held to a byte budget. Each is tracked by the slot callers are handed (the IDirect3DTexture9**),
+// along with the function that loads it into that slot.
+// Textures drawn by ImGui or asked for again are marked used for that frame. Once the total is over
+// budget, those unused for a while are released, least recently used first. An evicted slot is given
+// a 1x1 transparent stand-in of its own; a request for it, or a caller still holding the slot drawing
+// the stand-in, loads the real one again.
+// Add, Request and Remove may be called from any thread; the cache's state is behind a lock, and loaders
+// are started outside it. Update, which releases evicted textures, runs on the render thread.
+namespace TextureCache {
+    // Called once a load is over, whether or not it put a texture in the slot; same as Resources::AsyncLoadCallback
+    using LoadDone = std::function<void(bool success, const std::wstring& error)>;
+    // Starts loading into the slot; may finish later, e.g. from a DX task. done must be called either way,
+    // after the texture is in the slot; a slot whose load failed isn't loaded again.
+    using Loader = std::function<void(IDirect3DTexture9** texture, LoadDone done)>;
+
+    struct Stats {
+        size_t entries = 0;
+        size_t resident = 0; // loaded and not evicted
+        uint64_t bytes = 0;  // held by resident ones
+        uint64_t budget = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0; // first loads and reloads
+        uint64_t evictions = 0;
+    };
+
+    // Tracks the slot from now on, and loads it
+    IDirect3DTexture9** Add(IDirect3DTexture9** texture, Loader loader);
+    // For a slot being handed out again; reloads it if it was evicted
+    IDirect3DTexture9** Request(IDirect3DTexture9** texture);
+    // Stops tracking the slot before its owner releases what's in it and frees it
+    void Remove(IDirect3DTexture9** texture);
+
+    // Once per frame, before ImGui starts the next one: marks what was drawn last frame and evicts down to budget
+    void Update(IDirect3DDevice9* device);
+
+    void SetBudget(uint64_t bytes);
+    Stats GetStats();
+}
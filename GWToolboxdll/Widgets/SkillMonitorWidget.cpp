@@ -265,10 +265,7 @@ void SkillMonitorWidget::Draw(IDirect3DDevice9*)
                 const ImVec2 top_left = {history_flip_direction ? window_x + (i * img_size) : window_x + width - (i * img_size) - img_size, health_bar_pos->top_left.y};
                 const ImVec2 bottom_right = {top_left.x + img_size, top_left.y + img_size};
 
-                const auto texture = *Resources::GetSkillImage(skill_activation.id);
-                if (texture) {
-                    draw_list->AddImage(texture, top_left, bottom_right);
-                }
+                ImGui::AddIcon(draw_list, Resources::GetSkillIcon(skill_activation.id), top_left, bottom_right);
 
                 if (status_border_thickness != 0) {
                     draw_list->AddRect(top_left, bottom_right, GetColor(skill_activation.status), 0.f,
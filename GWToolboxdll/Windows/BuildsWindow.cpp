@@ -634,7 +634,7 @@ namespace {
                 if (i) {
                     ImGui::SameLine(0, 0);
                 }
-                ImGui::ImageCropped(*Resources::GetSkillImage(skills[i]), skill_size);
+                ImGui::Icon(Resources::GetSkillIcon(skills[i]), skill_size);
                 if (ImGui::IsItemHovered()) {
                     const GW::Skill* s = GW::SkillbarMgr::GetSkillConstantData(skills[i]);
                     if (s) {
@@ -64,6 +64,8 @@
 #include <Utils/ToolboxUtils.h>
 #include <Utils/ArenaNetFileParser.h>
 #include <Utils/TextUtils.h>
+#include <Utils/TextureAtlas.h>
+#include <Utils/TextureCache.h>
 
 #include <Logger.h>
 #include <GWToolbox.h>
@@ -464,6 +466,57 @@ namespace {
         }
     }
 
+    void DrawWorkerTaskStats(const char* name, const Resources::WorkerTaskStats& stats)
+    {
+        const auto completed = static_cast<double>(std::max<uint64_t>(stats.completed, 1));
+        ImGui::Text("%s: %llu done, %llu cancelled, wait avg %.1f max %.1f ms, run avg %.1f max %.1f ms", name, stats.completed, stats.cancelled,
+                    stats.total_wait_ms / completed, stats.max_wait_ms, stats.total_run_ms / completed, stats.max_run_ms);
+    }
+
+    void DrawFrameQueueStats(const char* name, const Resources::FrameQueueStats& stats)
+    {
+        ImGui::Text("%s: %zu queued, %llu done, last frame %.2f ms, max %.2f ms, %llu frames over budget", name, stats.queued, stats.completed,
+                    stats.last_frame_ms, stats.max_frame_ms, stats.frames_over_budget);
+    }
+
+    void DrawResourcesTaskStats()
+    {
+        float budget_ms = Resources::GetFrameTaskBudget();
+        if (ImGui::SliderFloat("Main/DX task budget per frame", &budget_ms, 0.f, 8.f, "%.2f ms")) {
+            Resources::SetFrameTaskBudget(budget_ms);
+        }
+        DrawFrameQueueStats("Main thread tasks", Resources::GetMainQueueStats());
+        DrawFrameQueueStats("DX tasks", Resources::GetDxQueueStats());
+        const auto requests = Resources::GetRequestStats();
+        ImGui::Text("Requests: %llu transferred, %llu shared an identical one in flight, %zu in flight", requests.started, requests.coalesced, requests.in_flight);
+        const auto cache = Resources::GetHttpCacheStats();
+        ImGui::Text("Download cache: %zu entries, %.1f / %.1f MB on disk, %.1f MB in memory", cache.entries, cache.disk_bytes / 1048576.0,
+                    cache.max_disk_bytes / 1048576.0, cache.memory_bytes / 1048576.0);
+        ImGui::Text("Download cache: %llu memory hits, %llu disk hits, %llu revalidated, %llu misses, %llu evicted", cache.memory_hits, cache.disk_hits,
+                    cache.revalidated, cache.misses, cache.evictions);
+        const auto atlas = TextureAtlas::GetStats();
+        const auto page_area = static_cast<double>(std::max<uint64_t>(atlas.packing.page_area, 1));
+        ImGui::Text("Texture atlas: %zu icons on %zu pages, %zu standalone; %.1f%% covered, %.1f%% reserved", atlas.packing.allocations,
+                    atlas.packing.pages, atlas.standalone, atlas.packing.used_area * 100.0 / page_area, atlas.packing.reserved_area * 100.0 / page_area);
+        const auto textures = TextureCache::GetStats();
+        const auto requests_made = static_cast<double>(std::max<uint64_t>(textures.hits + textures.misses, 1));
+        ImGui::Text("Textures: %zu loaded of %zu, %.1f / %.1f MB; %.1f%% hit rate (%llu hits, %llu misses), %llu evicted", textures.resident, textures.entries,
+                    textures.bytes / 1048576.0, textures.budget / 1048576.0, textures.hits * 100.0 / requests_made, textures.hits, textures.misses, textures.evictions);
+        ImGui::Separator();
+
+        const auto stats = Resources::GetWorkerStats();
+        constexpr auto user_visible = static_cast<size_t>(Resources::TaskPriority::UserVisible);
+        constexpr auto background = static_cast<size_t>(Resources::TaskPriority::Background);
+        ImGui::Text("%zu workers; user visible: %zu running, %zu queued; background: %zu running, %zu queued", stats.workers,
+                    stats.running[user_visible], stats.queued[user_visible], stats.running[background], stats.queued[background]);
+        DrawWorkerTaskStats("User visible", stats.by_priority[user_visible]);
+        DrawWorkerTaskStats("Background", stats.by_priority[background]);
+        ImGui::Separator();
+        for (const auto& [label, task_stats] : stats.by_label) {
+            DrawWorkerTaskStats(label.c_str(), task_stats);
+        }
+    }
+
     void DrawResignlog()
     {
         if (GW::Map::GetInstanceType() == GW::Constants::InstanceType::Loading) {
@@ -1276,6 +1329,9 @@ void InfoWindow::Draw(IDirect3DDevice9*)
             static GuiUtils::EncString item_name;
             DrawItemInfo(GW::Items::GetItemBySlot(GW::Items::GetBag(GW::Constants::Bag::Backpack), 1), &item_name);
         }
+        if (ImGui::CollapsingHeader("Resources Task Queues")) {
+            DrawResourcesTaskStats();
+        }
         if (ImGui::CollapsingHeader("Loaded DirectX9 Textures")) {
             record_dx9_textures = true;
             ImGui::PushID(&dx9_textures_created_by_hash);
@@ -1,5 +1,7 @@
 #include "stdafx.h"
 
+#include <future>
+
 #include <GWCA/Constants/Constants.h>
 #include <GWCA/Packets/StoC.h>
 
@@ -20,12 +22,15 @@
 #include <GWCA/Context/MapContext.h>
 #include <Utils/ArenaNetFileParser.h>
 
-#include "PathingMapData.h"
+#include <Modules/GwDatTextureModule.h>
+#include <MapPack.h>
+#include <PathingMapData.h>
 #include "PathingMapDataLoader.h"
 
 
 namespace {
     std::unordered_map<uint64_t, Pathing::MilePath*> mile_paths_by_coords;
+    uint32_t current_map_file_id = 0;
     // Returns milepath pointer for the current map, nullptr if we're not in a valid state
     Pathing::MilePath* GetMilepathForCurrentMap()
     {
@@ -40,18 +45,27 @@ namespace {
         if (mile_paths_by_coords.contains(hash))
             return mile_paths_by_coords[hash];
 
-        const auto m = new Pathing::MilePath(mc);
+        const auto m = new Pathing::MilePath(mc, current_map_file_id);
         mile_paths_by_coords[hash] = m;
         return m;
     }
 
     Pathing::AStar* astar = nullptr;
+    // Token of the most recently queued RecalculatePath search
+    std::optional<Resources::CancellationToken> pending_search;
+    // Token of the map pack being built, if any; cancelled on close since the build waits on the game thread
+    std::optional<Resources::CancellationToken> pending_map_pack;
     size_t draw_pos = 0;
     clock_t last_draw = 0;
 
     volatile bool pending_terminate = false;
     volatile bool pending_worker_task = false;
 
+    // Clears pending_worker_task however a path or route task returns
+    struct PendingWorkerTaskGuard {
+        ~PendingWorkerTaskGuard() { pending_worker_task = false; }
+    };
+
     bool pending_redraw = false;
     clock_t pending_undraw = 0;
 
@@ -81,13 +95,22 @@ namespace {
             return;
         delete astar;
         astar = nullptr;
-        Resources::EnqueueWorkerTask([from, to] {
+        // Only the latest search matters; one still queued for an older position is dropped
+        if (pending_search) {
+            pending_search->Cancel();
+        }
+        pending_search.emplace();
+        Resources::EnqueueWorkerTask([from, to, token = *pending_search] {
             const auto milepath = GetMilepathForCurrentMap();
             if (!milepath) {
                 return;
             }
             const auto tmpAstar = new Pathing::AStar(milepath);
             const auto res = tmpAstar->Search(from, to);
+            if (token.IsCancelled()) {
+                delete tmpAstar;
+                return;
+            }
             if (res == Pathing::Error::FailedToFinializePath) {
                 // Silent error; this could be valid?
                 delete tmpAstar;
@@ -107,6 +130,87 @@ namespace {
             draw_pos = 0;
             last_draw = 0;
             astar = tmpAstar;
+        }, Resources::TaskPriority::UserVisible, &*pending_search, "Pathing search");
+    }
+
+    // Packs the pathing data of every map for the offline pathing benchmark
+    void BuildMapPackFromDat()
+    {
+        std::vector<uint32_t> map_file_ids;
+        for (auto i = 1u; i < static_cast<uint32_t>(GW::Constants::MapID::Count); i++) {
+            const auto info = GW::Map::GetMapInfo(static_cast<GW::Constants::MapID>(i));
+            if (info && info->file_id) map_file_ids.push_back(info->file_id);
+        }
+        // A second click starts over
+        if (pending_map_pack) {
+            pending_map_pack->Cancel();
+        }
+        pending_map_pack.emplace();
+        Resources::EnqueueWorkerTask([map_file_ids, token = *pending_map_pack] {
+            // DAT reads stay on the game thread; the pack parses on this one while the next file is read.
+            // The read owns its buffer, so giving up on it (toolbox closing) can't leave the game thread writing into this stack.
+            const auto read_from_dat = [token](uint32_t map_file_id, std::vector<uint8_t>& out) {
+                // Main tasks stop running at shutdown; don't queue one that nothing will answer
+                if (token.IsCancelled()) return false;
+                struct DatRead {
+                    std::promise<bool> done;
+                    std::vector<uint8_t> bytes;
+                };
+                const auto read = std::make_shared<DatRead>();
+                auto done = read->done.get_future();
+                Resources::EnqueueMainTask([map_file_id, read, token] {
+                    if (token.IsCancelled()) {
+                        read->done.set_value(false);
+                        return;
+                    }
+                    wchar_t file_hash[4] = {0};
+                    ArenaNetFileParser::FileIdToFileHash(map_file_id, file_hash);
+                    read->done.set_value(GwDatTextureModule::ReadDatFile(file_hash, &read->bytes, 1));
+                });
+                while (done.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+                    if (token.IsCancelled()) return false;
+                }
+                if (!done.get()) return false;
+                out = std::move(read->bytes);
+                return true;
+            };
+            const auto folder = Resources::GetPath(L"pathing");
+            if (!Resources::EnsureFolderExists(folder)) return;
+            // Cancelling between the last read and the write still writes a pack; keep it away from the real one until then
+            const auto path = folder / L"maps.gwmp";
+            const auto tmp_path = folder / L"maps.gwmp.tmp";
+            Pathing::MapPackStats stats;
+            const bool built = Pathing::BuildMapPack(tmp_path, map_file_ids, read_from_dat, 0, &stats, [token] {
+                return token.IsCancelled();
+            });
+            std::error_code ec;
+            if (token.IsCancelled()) {
+                std::filesystem::remove(tmp_path, ec);
+                return;
+            }
+            if (built) {
+                std::filesystem::rename(tmp_path, path, ec);
+            }
+            if (!built || ec) {
+                std::filesystem::remove(tmp_path, ec);
+                Log::Error("Failed to write %s", path.string().c_str());
+                return;
+            }
+            Log::Flash("Map pack: %u maps, %u without pathing data, %u unreadable", stats.maps, stats.without_pathing, stats.unreadable);
+        }, Resources::TaskPriority::Background, &*pending_map_pack, "Build map pack");
+    }
+
+    // Writes the queries recorded on this map, with the map, to pathing/corpus for PathingCorpus
+    void SaveRecordedQueries(Pathing::MilePath* milepath)
+    {
+        Resources::EnqueueWorkerTask([milepath] {
+            const auto folder = Resources::GetPath(L"pathing") / L"corpus";
+            if (!Resources::EnsureFolderExists(folder)) return;
+            if (!milepath->saveRecordedQueries(folder)) {
+                Log::Error("Failed to save recorded pathing queries to %s", folder.string().c_str());
+                return;
+            }
+            Log::Flash("Recorded pathing queries saved to %s", folder.string().c_str());
         });
     }
 
@@ -115,7 +219,8 @@ namespace {
         if (status->blocked) return;
         switch (message_id) {
             case GW::UI::UIMessage::kLoadMapContext: {
-                [[maybe_unused]] const auto packet = static_cast<GW::UI::UIPacket::kLoadMapContext*>(wParam);
+                const auto packet = static_cast<GW::UI::UIPacket::kLoadMapContext*>(wParam);
+                current_map_file_id = packet->file_name && *packet->file_name ? ArenaNetFileParser::FileHashToFileId(packet->file_name) : 0;
                 #ifdef _DEBUG
                 // Load from map context, but also load from the DAT - save both to JSON to review and compare the data.
                 if (packet->file_name && *packet->file_name) {
@@ -132,7 +237,21 @@ namespace {
                         delete from_context;
                         return;
                     }
-                    Resources::EnqueueWorkerTask([from_dat, from_context]() {
+                    // Raw map file, for running the offline pathing benchmark against
+                    auto raw_map_file = new std::vector<uint8_t>();
+                    if (!GwDatTextureModule::ReadDatFile(packet->file_name, raw_map_file, 1)) {
+                        raw_map_file->clear();
+                    }
+                    Resources::EnqueueWorkerTask([from_dat, from_context, raw_map_file]() {
+                        if (!raw_map_file->empty()) {
+                            const auto raw_path = Resources::GetPath(std::format(L"pathing_map_{:#x}.ffna", from_dat->map_file_id));
+                            auto raw_fp = fopen(raw_path.string().c_str(), "wb");
+                            if (raw_fp) {
+                                fwrite(raw_map_file->data(), raw_map_file->size(), 1, raw_fp);
+                                fclose(raw_fp);
+                            }
+                        }
+                        delete raw_map_file;
                         auto write_to = std::format(L"pathing_map_data_from_file_{:#}.json", from_dat->map_file_id);
                         auto fp = fopen(Resources::GetPath(write_to).string().c_str(), "wb");
                         if (fp) {
@@ -151,7 +270,7 @@ namespace {
                         }
                         delete from_dat;
                         delete from_context;
-                    });
+                    }, Resources::TaskPriority::Background, nullptr, "Pathing debug dump");
                 }
                 #endif
                 PathfindingWindow::ReadyForPathing();
@@ -166,7 +285,7 @@ bool PathfindingWindow::ReadyForPathing()
     if (GW::Map::GetInstanceType() == GW::Constants::InstanceType::Loading) 
         return false;
     const auto m = GetMilepathForCurrentMap();
-    return m && m->ready();
+    return m && m->canSearch();
 }
 
 void PathfindingWindow::Draw(IDirect3DDevice9*)
@@ -235,6 +354,37 @@ void PathfindingWindow::Draw(IDirect3DDevice9*)
         RecalculatePath(from, to);
         pending_redraw = true;
     }
+    if (ImGui::Button("Route Through Markers")) {
+        std::vector<GW::GamePos> waypoints;
+        for (const auto& marker : Minimap::Instance().custom_renderer.GetMarkers()) {
+            if (marker.map == GW::Map::GetMapID()) waypoints.push_back(marker.pos);
+        }
+        const auto start = player->pos;
+        CalculateRoute(start, waypoints, [start, waypoints](const std::vector<uint32_t>& order, void*) {
+            auto from = start;
+            for (const auto i : order) {
+                const auto line = Minimap::Instance().custom_renderer.AddCustomLine(from, waypoints[i]);
+                line->created_by_toolbox = true;
+                minimap_lines.push_back(line);
+                from = waypoints[i];
+            }
+            pending_undraw = TIMER_INIT() + 10000;
+            Log::Flash("Route through %zu of %zu markers drawn on minimap", order.size(), waypoints.size());
+        });
+    }
+    if (ImGui::Button("Build Map Pack")) {
+        BuildMapPackFromDat();
+    }
+    bool recording = current_milepath->isRecordingQueries();
+    if (ImGui::Checkbox("Record Queries", &recording)) {
+        current_milepath->recordQueries(recording);
+    }
+    if (const auto recorded = current_milepath->recordedQueryCount()) {
+        ImGui::SameLine();
+        if (ImGui::Button(std::format("Save {} Queries", recorded).c_str())) {
+            SaveRecordedQueries(current_milepath);
+        }
+    }
     if (!astar)
         return ImGui::End();
     ImGui::Text("Length: %.2f", astar->m_path.cost());
@@ -271,6 +421,9 @@ void PathfindingWindow::SignalTerminate()
 {
     ToolboxWindow::SignalTerminate();
     pending_terminate = true;
+    if (pending_map_pack) {
+        pending_map_pack->Cancel();
+    }
     GW::UI::RemoveUIMessageCallback(&gw_ui_hookentry);
     for (const auto mile_path : mile_paths_by_coords | std::views::values) {
         mile_path->stopProcessing();
@@ -300,15 +453,17 @@ clock_t PathfindingWindow::CalculatePath(const GW::GamePos& from, const GW::Game
     pending_worker_task = true;
 
     Resources::EnqueueWorkerTask([from, to, callback, args] {
+        PendingWorkerTaskGuard guard;
         if (pending_terminate) {
             return;
         }
 
         const auto milepath = GetMilepathForCurrentMap();
-        if (milepath && milepath->ready()) {
+        if (milepath && milepath->canSearch()) {
             auto astr = Pathing::AStar(milepath);
 
-            const auto res = astr.Search(from, to);
+            // Callers recalculate as the player moves towards the same destination; repair the last search instead of starting over
+            const auto res = astr.Replan(from, to);
             if (res == Pathing::Error::FailedToFinializePath) {
                 // Path route is blocked; this is a valid result.
                 Resources::EnqueueMainTask([callback, args] {
@@ -337,7 +492,43 @@ clock_t PathfindingWindow::CalculatePath(const GW::GamePos& from, const GW::Game
                 delete waypoints;
             });
         }
-        pending_worker_task = false;
+    });
+    return TIMER_INIT();
+}
+
+clock_t PathfindingWindow::CalculateRoute(const GW::GamePos& from, const std::vector<GW::GamePos>& waypoints, RouteCalculatedCallback callback, void* args)
+{
+    if (pending_terminate)
+        return 0;
+
+    // Route distances need the full graph, not just the corridors ReadyForPathing() settles for
+    const auto milepath = ReadyForPathing() ? GetMilepathForCurrentMap() : nullptr;
+    if (!(milepath && milepath->ready()))
+        return 0;
+
+    pending_worker_task = true;
+
+    Resources::EnqueueWorkerTask([from, waypoints, callback, args] {
+        PendingWorkerTaskGuard guard;
+        if (pending_terminate) {
+            return;
+        }
+
+        const auto milepath = GetMilepathForCurrentMap();
+        if (milepath && milepath->ready()) {
+            auto astr = Pathing::AStar(milepath);
+            auto order = new std::vector<uint32_t>();
+            const auto res = astr.OptimizeRoute(from, waypoints, *order);
+            if (res != Pathing::Error::OK) {
+                Log::Error("Route failed; Pathing::Error code %d", res);
+                delete order;
+                return;
+            }
+            Resources::EnqueueMainTask([order, callback, args] {
+                callback(*order, args);
+                delete order;
+            });
+        }
     });
     return TIMER_INIT();
 }
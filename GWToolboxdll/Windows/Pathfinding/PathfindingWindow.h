@@ -4,6 +4,8 @@
 #include <Windows/Pathfinding/Pathing.h>
 
 using CalculatedCallback = std::function<void (std::vector<GW::GamePos>& waypoints, void* args)>;
+// order holds indices into the waypoints passed to CalculateRoute, in visiting order; unreachable ones are left out
+using RouteCalculatedCallback = std::function<void (std::vector<uint32_t>& order, void* args)>;
 
 /*
     This should really have been a module to just manage pathing - its used in a lot of places.
@@ -30,10 +32,13 @@ public:
     bool CanTerminate() override;
     void Initialize() override;
     void Terminate() override;
-    // False if still calculating current map
+    // False until paths can be calculated on the current map; may be before its graph is done
     static bool ReadyForPathing();
     // False if still calculating current map
     static clock_t CalculatePath(const GW::GamePos& from, const GW::GamePos& to, CalculatedCallback callback, void* args = nullptr);
+    // Orders waypoints (enemy groups, markers, ...) into a short walk from `from` on a worker thread. Cheap to call again
+    // with the remaining waypoints as they get done. False if still calculating current map
+    static clock_t CalculateRoute(const GW::GamePos& from, const std::vector<GW::GamePos>& waypoints, RouteCalculatedCallback callback, void* args = nullptr);
 
 private:
     GW::GamePos m_saved_pos;
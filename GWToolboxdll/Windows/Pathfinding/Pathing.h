@@ -3,35 +3,19 @@
 #include <cstdint>
 #include <GWCA/GameContainers/GamePos.h>
 #include <GWCA/GameEntities/Pathing.h>
-#include "MapSpecificData.h"
+#include <PathingTypes.h>
 
 namespace Pathing {
-    #define PATHING_MAX_PLANE_COUNT 192 // Be sure to ASSERT if this is ever higher!
-
-    using BlockedPlaneBitset = std::bitset<PATHING_MAX_PLANE_COUNT>;
-
-    enum class Error : uint32_t {
-        OK,
-        Unknown,
-        FailedToFindStartPathingTrapezoid,
-        FailedToFindGoalPathingTrapezoid,
-        FailedToFinializePath,
-        InvalidMapContext,
-        BuildPathLengthExceeded,
-        FailedToGetPathingMapBlock
-    };
-
-	typedef uint16_t PointId;
+    struct PathResult;
 
     class MilePath {
         volatile bool m_processing = false;
         volatile bool m_done = false;
-        volatile int m_progress = 0;
 
         std::thread* worker_thread = nullptr;
 
     public:	
-        MilePath(GW::MapContext*);
+        MilePath(GW::MapContext*, uint32_t map_file_id = 0);
         ~MilePath();
 
         // Signals terminate to worker thread. Usually followed late by shutdown() to grab the thread again.
@@ -51,19 +35,26 @@ namespace Pathing {
             }
         }
 
-        int progress()
-        {
-            return m_progress;
-        }
+        int progress();
+        // True once AStar::Search can answer; that's before progress() reaches 100, with slightly longer paths until it does
+        bool canSearch();
 
         bool ready()
         {
-            return m_progress >= 100;
+            return progress() >= 100;
         }
 
+        // While on, AStar::Search remembers the queries it is asked, for the offline regression corpus (PathingCorpus)
+        void recordQueries(bool record);
+        bool isRecordingQueries();
+        size_t recordedQueryCount();
+        // Writes the map and the recorded queries, with what the finished graph answers as expected results, to folder.
+        // Blocking; call from a worker thread.
+        bool saveRecordedQueries(const std::filesystem::path& folder);
+
         void* GetImpl() { return opaque; };
     private:
-        void LoadMapSpecificData();
+        std::vector<Teleport> LoadMapSpecificData();
 
         int opaque[336 / sizeof(int)];
     };
@@ -128,6 +119,21 @@ namespace Pathing {
 
         AStar(MilePath* mp);
 
+        // Long searches go through the cluster level graph once it's built; those paths may be a percent or so longer than the shortest.
         Error Search(const GW::GamePos& start_pos, const GW::GamePos& goal_pos);
+        // Like Search, but reuses the search tree of the previous Replan towards the same goal on this MilePath.
+        // Much cheaper when only the start moved or doors opened/closed since; a new goal costs about one Search.
+        Error Replan(const GW::GamePos& start_pos, const GW::GamePos& goal_pos);
+        // Path lengths from every source to every target with the current doors, row major ([source * targets.size() + target]).
+        // Unreachable pairs get INFINITY. next_hops is the first waypoint towards the target, for walking there directly.
+        // Doesn't touch m_path.
+        Error ComputeDistanceMatrix(const std::vector<GW::GamePos>& sources, const std::vector<GW::GamePos>& targets, std::vector<float>& distances, std::vector<GW::GamePos>& next_hops);
+        // Short walk from start_pos through all the waypoints it can reach, by walking distance; order holds indices into waypoints.
+        // Keeps the distances between the waypoints until called with waypoints that aren't among the last ones,
+        // so rerunning it as waypoints are done only costs about one Search. Doesn't touch m_path.
+        Error OptimizeRoute(const GW::GamePos& start_pos, const std::vector<GW::GamePos>& waypoints, std::vector<uint32_t>& order);
+
+    private:
+        void SetPath(const PathResult& result);
     };
 }
@@ -33,6 +33,10 @@ namespace Pathing {
         const uint32_t plane_count = src_maps.size();
         result.planes.resize(static_cast<size_t>(plane_count));
 
+        // Portal pairs are linked by pointer in game memory; translate to shared ids
+        std::unordered_map<const GW::Portal*, uint16_t> shared_ids;
+        uint16_t next_shared_id = 0;
+
         // Process each plane
         for (uint32_t plane_idx = 0; plane_idx < plane_count; ++plane_idx) {
             const GW::PathingMap& src = src_maps[plane_idx];
@@ -119,14 +123,18 @@ namespace Pathing {
                     dp.neighbor_plane = sp.neighbor_plane;
                     dp.flags = static_cast<uint8_t>(sp.flags);
 
-                    // Find shared_id by examining the pair portal
-                    // The pair portal on the other plane has the same shared_id
+                    // The pair portal on the other plane has the same shared_id.
+                    // Whichever side of the pair we see first hands out the id.
                     dp.shared_id = INVALID_INDEX16;
                     if (sp.pair) {
-                        // We need to figure out which portal index sp.pair is
-                        // For now, use portal_plane as a proxy
-                        // A more accurate approach would be to match by geometry
-                        dp.shared_id = static_cast<uint16_t>(i); // Simplified
+                        const auto found = shared_ids.find(sp.pair);
+                        if (found != shared_ids.end()) {
+                            dp.shared_id = found->second;
+                        }
+                        else {
+                            dp.shared_id = next_shared_id++;
+                            shared_ids[&sp] = dp.shared_id;
+                        }
                     }
 
                     // Convert trapezoid pointers to indices
@@ -228,56 +236,10 @@ namespace Pathing {
         const auto pathfinding_chunk = game_asset.FindChunk(ArenaNetFileParser::ChunkType::Map_Pathfinding);
         if (!pathfinding_chunk) return false;
 
-        auto chunk_data = (uint8_t*)pathfinding_chunk;
-        chunk_data += sizeof(*pathfinding_chunk);
-
-        auto chunk_size = pathfinding_chunk->chunk_size;
-
-        // Header: signature(4) + version(4) + sequence(4)
-        uint32_t signature, version, sequence;
-        if (!detail::read_u32(chunk_data, 0, chunk_size, signature)) return false;
-        if (!detail::read_u32(chunk_data, 4, chunk_size, version)) return false;
-        if (!detail::read_u32(chunk_data, 8, chunk_size, sequence)) return false;
-
-        // Verify signature
-        if (signature != 0xEEFE704C) return false;
-
-        size_t off = 12;
-
-        // --- Tag 7: Preamble (skip) ---
-        uint8_t tag;
-        uint32_t tag_size;
-        if (!detail::read_tag(chunk_data, off, chunk_size, tag, tag_size)) return false;
-        if (tag != 7) return false;
-        off += 5 + tag_size;
-
-        // --- Tag 8: All planes ---
-        if (!detail::read_tag(chunk_data, off, chunk_size, tag, tag_size)) return false;
-        if (tag != 8) return false;
-        off += 5;
-
-        uint32_t plane_count;
-        if (!detail::read_u32(chunk_data, off, chunk_size, plane_count)) return false;
-        off += 4;
-
-        // Sanity check
-        if (plane_count > 256) return false;
+        const auto chunk_data = reinterpret_cast<const uint8_t*>(pathfinding_chunk) + sizeof(*pathfinding_chunk);
 
         PathingMapData result;
-        result.planes.resize(plane_count);
-
-        // Parse each plane
-        for (uint32_t i = 0; i < plane_count; ++i) {
-            if (!detail::parse_plane(chunk_data, off, chunk_size, result.planes[i])) {
-                return false;
-            }
-
-            // Set zplane (plane 0 = ground = UINT32_MAX, others = 0, 1, 2, ...)
-            result.planes[i].zplane = (i == 0) ? UINT32_MAX : (i - 1);
-        }
-
-        // Skip remaining tags (12, 13, 14, terminator) - we don't need them for pathfinding
-        // They contain obstacle data that can be processed separately if needed
+        if (!ParsePathingChunk(chunk_data, pathfinding_chunk->chunk_size, &result)) return false;
 
         *out = std::move(result);
 
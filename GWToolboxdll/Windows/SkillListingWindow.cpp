@@ -182,6 +182,9 @@ void SkillListingWindow::Draw(IDirect3DDevice9*)
     if (ImGui::InputText("Search", buf, sizeof buf)) {
         search_term = TextUtils::ToLower(TextUtils::StringToWString(buf));
     }
+    // Icons on their own channel, so consecutive rows' icons from the same atlas page draw in one go
+    const auto draw_list = ImGui::GetWindowDrawList();
+    draw_list->ChannelsSplit(2);
     for (size_t i = 0; i < skills.size(); i++) {
         if (!skills[i]) {
             continue;
@@ -195,11 +198,12 @@ void SkillListingWindow::Draw(IDirect3DDevice9*)
             continue;
         }
         ImGui::SameLine(offset += tiny_text_width);
-        const auto low_res_img = skills[i]->skill->icon_file_id ? GwDatTextureModule::LoadTextureFromFileId(skills[i]->skill->icon_file_id) : nullptr;
-        const auto hi_res_img = skills[i]->skill->icon_file_id_2 ? GwDatTextureModule::LoadTextureFromFileId(skills[i]->skill->icon_file_id_2) : nullptr;
-        const auto to_use = low_res_img ? low_res_img : hi_res_img;
-        if (to_use) 
-            ImGui::ImageCropped(to_use ? *to_use : nullptr, {20.f, 20.f});
+        const auto icon_file_id = skills[i]->skill->icon_file_id ? skills[i]->skill->icon_file_id : skills[i]->skill->icon_file_id_2;
+        if (icon_file_id) {
+            draw_list->ChannelsSetCurrent(1);
+            ImGui::Icon(GwDatTextureModule::LoadIconFromFileId(icon_file_id), {20.f, 20.f});
+            draw_list->ChannelsSetCurrent(0);
+        }
         /*
         if (low_res_img && *low_res_img) {
             const auto filename = std::format("{}_lowres.jpg", (uint32_t)skills[i]->skill->skill_id);
@@ -242,6 +246,7 @@ void SkillListingWindow::Draw(IDirect3DDevice9*)
             });
         }
     }
+    draw_list->ChannelsMerge();
     if (ImGui::Button("Export to JSON")) {
         ExportToJSON();
     }
@@ -0,0 +1,470 @@
+#include "stdafx.h"
+
+#include "Atex.h"
+#include "DxtKernels.h"
+
+// Ported from the game's decoder, by way of Unused/GWDatBrowser/AtexAsm.cpp. The quirks noted
+// below are the game's; they're kept so the blocks come out the same.
+
+namespace ImageDecoder {
+    namespace {
+        using detail::LoadU32;
+
+        constexpr size_t HEADER_SIZE = 12;
+        // Words of the file before the first level's data: the header, the level's size and its compression code
+        constexpr size_t DATA_WORD = HEADER_SIZE / 4 + 2;
+
+        // Compression code bits: which sections come before the DXT blocks, in this order
+        constexpr uint32_t MIRRORED_EDGES = 0x10;   // 256x256 DXT2/3 only; no data, filled in at the end
+        constexpr uint32_t TRANSPARENT_BLOCKS = 0x1; // DXT1 only
+        constexpr uint32_t ALPHA_4_BITS = 0x2;       // DXT2/3 only
+        constexpr uint32_t ALPHA_8_BITS = 0x4;       // DXT4/5 only
+        constexpr uint32_t PLAIN_COLOUR = 0x8;
+
+        // The game's format numbers, as the sections check them
+        enum class GameFormat : uint32_t {
+            Dxt1 = 0xf,
+            Dxt3 = 0x11,
+            Dxt5 = 0x13
+        };
+
+        // Reads the compressed sections: most significant bit first, 32 bit little endian words, zeros after
+        // the end. The current word is kept topped up from the next one.
+        class BitReader {
+        public:
+            BitReader(const uint8_t* bytes, const size_t first_word, const size_t end_word)
+                : data(bytes), pos(first_word), end(end_word)
+            {
+                if (pos != end) current = LoadU32(data + pos++ * 4);
+            }
+
+            // Next word to be loaded
+            size_t Position() const { return pos; }
+
+            uint32_t Peek(const uint32_t count) const { return current >> (32 - count); }
+
+            // 1 to 24 bits
+            void Skip(const uint32_t count)
+            {
+                current = current << count | next >> (32 - count);
+                if (count <= available) {
+                    next <<= count;
+                    available -= count;
+                }
+                else if (pos != end) {
+                    const uint32_t word = LoadU32(data + pos++ * 4);
+                    current |= word >> (32 + available - count);
+                    next = word << (count - available);
+                    available += 32 - count;
+                }
+                else {
+                    next = 0;
+                    available = 0;
+                }
+            }
+
+            uint32_t Read(const uint32_t count)
+            {
+                const uint32_t value = Peek(count);
+                Skip(count);
+                return value;
+            }
+
+        private:
+            const uint8_t* data;
+            size_t pos;
+            size_t end;
+            uint32_t current = 0;
+            uint32_t next = 0;
+            uint32_t available = 0; // bits left in next
+        };
+
+        struct Blocks {
+            std::vector<uint32_t> words;
+            uint32_t count = 0;
+            uint32_t size = 0;         // in words
+            uint32_t colour_offset = 0; // of the colour half of a block, in words
+            // Blocks a section has filled in, so the DXT data doesn't have them
+            std::vector<uint8_t> alpha_done;
+            std::vector<uint8_t> colour_done_storage;
+            uint8_t* colour_done = nullptr;
+
+            uint32_t* Block(const uint32_t i) { return words.data() + static_cast<size_t>(i) * size; }
+        };
+
+        // Run lengths: 1 is "1", 18 is "01", and 2 to 17 are "00" and 15 less the length in 4 bits
+        uint32_t ReadRunLength(BitReader& bits)
+        {
+            const uint32_t top = bits.Peek(6);
+            if (top >= 32) {
+                bits.Skip(1);
+                return 1;
+            }
+            if (top >= 16) {
+                bits.Skip(2);
+                return 18;
+            }
+            bits.Skip(6);
+            return 17 - top;
+        }
+
+        // Each section is runs of blocks, not counting those done already: a run length, then what the run's blocks
+        // get, which is nothing when read_value() gives 0. The runs go on until the last block.
+        template <typename ReadValue, typename Fill>
+        void DecodeRuns(BitReader& bits, const uint8_t* done, const uint32_t count, ReadValue read_value, Fill fill)
+        {
+            uint32_t i = 0;
+            while (i < count) {
+                uint32_t run = ReadRunLength(bits);
+                const uint32_t value = read_value();
+                for (; run; i++) {
+                    if (i == count)
+                        return;
+                    if (!done[i]) {
+                        if (value) fill(i, value);
+                        run--;
+                    }
+                }
+                while (i < count && done[i]) {
+                    i++;
+                }
+            }
+        }
+
+        // 256x256 textures made of 32x32 block tiles: the two block rows and columns either side of a tile edge are left
+        // out, to be mirrored from the ones next to them
+        constexpr uint32_t TILE_EDGES = 0xc0000003; // 0, 1, 30 and 31 within a tile
+
+        bool IsTileEdge(const uint32_t i)
+        {
+            return (1u << (i & 31) & TILE_EDGES) || (1u << (i >> 6 & 31) & TILE_EDGES);
+        }
+
+        void MarkMirroredEdges(Blocks& blocks)
+        {
+            for (uint32_t i = 0; i < blocks.count; i++) {
+                if (IsTileEdge(i)) {
+                    blocks.alpha_done[i] = 1;
+                    blocks.colour_done[i] = 1;
+                }
+            }
+        }
+
+        // Reverses each 4 pixel row of DXT3 alpha
+        uint32_t MirrorAlpha(const uint32_t v)
+        {
+            const uint32_t a = (v >> 8 & 0x00f000f0) | (v & 0x0f000f00);
+            const uint32_t b = (v & 0xffff000f) << 8 | (v & 0x00f000f0);
+            return a >> 4 | b << 4;
+        }
+
+        void FillMirroredEdges(Blocks& blocks)
+        {
+            for (uint32_t i = 0; i < blocks.count; i++) {
+                const uint32_t x = i & 63;
+                const uint32_t y = i >> 6;
+                const bool x_edge = (1u << (x & 31) & TILE_EDGES) != 0;
+                const bool y_edge = (1u << (y & 31) & TILE_EDGES) != 0;
+                if (!x_edge && !y_edge)
+                    continue;
+                const uint32_t* from = blocks.Block((y_edge ? y ^ 3 : y) << 6 | (x_edge ? x ^ 3 : x));
+                uint32_t alpha0 = from[0];
+                uint32_t alpha1 = from[1];
+                const uint32_t colours = from[2];
+                uint32_t indices = from[3];
+                if (x_edge) {
+                    // The game mirrors the first alpha word twice, so the second ends up a copy of the first
+                    alpha0 = MirrorAlpha(alpha0);
+                    alpha1 = MirrorAlpha(alpha0);
+                    const uint32_t a = ((indices & 0xff030303) << 4 | (indices & 0x0c0c0c0c)) << 2;
+                    const uint32_t b = ((indices >> 4 & 0x0c0c0c0c) | (indices & 0x30303030)) >> 2;
+                    indices = a | b;
+                }
+                if (y_edge) {
+                    const uint32_t top = alpha0;
+                    alpha0 = alpha1 >> 16 | alpha1 << 16;
+                    alpha1 = top >> 16 | top << 16;
+                    indices = ((indices & 0x00ff0000) | indices >> 16) >> 8 | (indices << 16 | (indices & 0x0000ff00)) << 8;
+                }
+                uint32_t* to = blocks.Block(i);
+                to[0] = alpha0;
+                to[1] = alpha1;
+                to[2] = colours;
+                to[3] = indices;
+            }
+        }
+
+        // The DXT1 colour half of a block that is all one 24 bit colour (blue in the low byte). Each channel is the nearer
+        // 5:6:5 value, or a mix of the two either side of it when that's closer (in twelfths); the block then uses the in
+        // between colour that comes closest overall.
+        void PlainColourBlock(const uint32_t colour, const bool dxt1, uint32_t out[2])
+        {
+            uint32_t low[3], high[3], value[3], twelfths[3];
+            for (uint32_t c = 0; c < 3; c++) {
+                const uint32_t v = colour >> (c * 8) & 0xff;
+                const bool green = c == 1;
+                const uint32_t q = green ? (v - (v >> 6)) >> 2 : (v - (v >> 5)) >> 3;
+                const uint32_t expanded = green ? (q << 2) + (q >> 4) : (q << 3) + (q >> 2);
+                const uint32_t next = q + 1;
+                const uint32_t next_expanded = green ? (next << 2) + (next >> 4) : (next << 3) + (next >> 2);
+                value[c] = q;
+                twelfths[c] = (v * 12 - expanded * 12) / (next_expanded - expanded);
+                if (twelfths[c] < 2) {
+                    low[c] = high[c] = q;
+                }
+                else if (twelfths[c] < 6) {
+                    low[c] = q;
+                    high[c] = next;
+                }
+                else if (twelfths[c] < 10) {
+                    low[c] = next;
+                    high[c] = q;
+                }
+                else {
+                    low[c] = high[c] = next;
+                }
+            }
+            uint32_t a = (low[2] << 6 | low[1]) << 5 | low[0];
+            uint32_t b = (high[2] << 6 | high[1]) << 5 | high[0];
+
+            uint32_t mixed = 0;
+            uint32_t weight = 0;
+            for (uint32_t c = 0; c < 3; c++) {
+                if (low[c] == high[c])
+                    continue;
+                weight += low[c] == value[c] ? twelfths[c] : 12 - twelfths[c];
+                mixed++;
+            }
+            if (mixed) {
+                weight = (weight + mixed / 2) / mixed;
+            }
+
+            // DXT1 can use the half way colour; otherwise the two colours have to differ
+            const bool half_way = dxt1 && (weight == 5 || weight == 6 || !mixed);
+            if (!mixed && !half_way) {
+                if (b != 0xffff) {
+                    weight = 0;
+                    b++;
+                }
+                else {
+                    weight = 12;
+                    a--;
+                }
+            }
+            // First colour the greater for four colours, otherwise not
+            if (half_way != (b >= a)) {
+                std::swap(a, b);
+                weight = 12 - weight;
+            }
+            uint32_t index;
+            if (half_way) index = 2;
+            else if (weight < 2) index = 0;
+            else if (weight < 6) index = 2;
+            else if (weight < 10) index = 3;
+            else index = 1;
+
+            out[0] = b << 16 | a;
+            out[1] = index * 0x55555555;
+        }
+
+        // Needs 20 bytes of header, which ReadAtexHeader doesn't check for
+        Result ReadLevelSize(const std::span<const uint8_t> data, uint32_t& level_size, std::string& error)
+        {
+            if (data.size() <= HEADER_SIZE + 8) {
+                error = "Truncated ATEX header";
+                return Result::Corrupt;
+            }
+            level_size = LoadU32(data.data() + HEADER_SIZE);
+            if (level_size <= 8 || level_size > data.size() - HEADER_SIZE) {
+                error = "Bad ATEX level size " + std::to_string(level_size);
+                return Result::Corrupt;
+            }
+            return Result::Ok;
+        }
+    } // namespace
+
+    Result ReadAtexHeader(const std::span<const uint8_t> data, AtexInfo& info, std::string& error)
+    {
+        if (data.size() < HEADER_SIZE || (memcmp(data.data(), "ATEX", 4) != 0 && memcmp(data.data(), "ATTX", 4) != 0)) {
+            error = "Not an ATEX texture";
+            return Result::Corrupt;
+        }
+        if (memcmp(data.data() + 4, "DXT", 3) != 0) {
+            error = "ATEX texture isn't DXT compressed";
+            return Result::Unsupported;
+        }
+        info.format = static_cast<char>(data[7]);
+        switch (info.format) {
+            case '1':
+                info.dxt_format = DxtFormat::Dxt1;
+                break;
+            case '2':
+            case '3':
+                info.dxt_format = DxtFormat::Dxt3;
+                break;
+            case '4':
+            case '5':
+                info.dxt_format = DxtFormat::Dxt5;
+                break;
+            default:
+                error = std::string("DXT") + info.format + " ATEX textures aren't supported";
+                return Result::Unsupported;
+        }
+        info.width = data[8] | data[9] << 8;
+        info.height = data[10] | data[11] << 8;
+        if (!info.width || !info.height || info.width % 4 || info.height % 4) {
+            error = "ATEX size " + std::to_string(info.width) + "x" + std::to_string(info.height) + " isn't whole blocks";
+            return Result::Unsupported;
+        }
+        return Result::Ok;
+    }
+
+    Result DecompressAtex(const std::span<const uint8_t> data, AtexInfo& info, std::vector<uint8_t>& out, std::string& error)
+    {
+        if (const auto result = ReadAtexHeader(data, info, error); result != Result::Ok)
+            return result;
+        uint32_t level_size;
+        if (const auto result = ReadLevelSize(data, level_size, error); result != Result::Ok)
+            return result;
+
+        const auto game_format = info.dxt_format == DxtFormat::Dxt1 ? GameFormat::Dxt1 : info.dxt_format == DxtFormat::Dxt3 ? GameFormat::Dxt3 : GameFormat::Dxt5;
+        const bool has_alpha = game_format != GameFormat::Dxt1;
+        Blocks blocks;
+        blocks.count = info.width * info.height / 16;
+        blocks.size = has_alpha ? 4 : 2;
+        blocks.colour_offset = has_alpha ? 2 : 0;
+        blocks.words.resize(static_cast<size_t>(blocks.count) * blocks.size);
+        blocks.alpha_done.resize(blocks.count);
+        // The game keeps both as bit arrays in one buffer of one word per block, the second starting half way. A
+        // single block's two bits are the same one.
+        if (blocks.count == 1) {
+            blocks.colour_done = blocks.alpha_done.data();
+        }
+        else {
+            blocks.colour_done_storage.resize(blocks.count);
+            blocks.colour_done = blocks.colour_done_storage.data();
+        }
+
+        const uint8_t* p = data.data();
+        const size_t words = data.size() / 4;
+        const uint32_t code = LoadU32(p + HEADER_SIZE + 4);
+        const bool mirrored_edges = code & MIRRORED_EDGES && info.width == 256 && info.height == 256 && game_format == GameFormat::Dxt3;
+        size_t pos = DATA_WORD;
+        if (code) {
+            BitReader bits(p, DATA_WORD, DATA_WORD + (level_size - 8) / 4);
+            if (mirrored_edges) {
+                MarkMirroredEdges(blocks);
+            }
+            if (code & TRANSPARENT_BLOCKS && !has_alpha) {
+                DecodeRuns(bits, blocks.colour_done, blocks.count, [&] { return bits.Read(1); }, [&](const uint32_t i, uint32_t) {
+                    // Three colour mode, every pixel transparent black
+                    uint32_t* block = blocks.Block(i);
+                    block[0] = 0xfffffffe;
+                    block[1] = 0xffffffff;
+                    blocks.alpha_done[i] = 1;
+                    blocks.colour_done[i] = 1;
+                });
+            }
+            if (code & (ALPHA_4_BITS | ALPHA_8_BITS) && has_alpha) {
+                // Runs of blocks with no alpha (1), the section's one alpha (2), or left to the DXT data (0)
+                uint32_t alpha[3][2] = {};
+                if (code & ALPHA_4_BITS && game_format == GameFormat::Dxt3) {
+                    const uint32_t value = bits.Read(4) * 0x11111111;
+                    alpha[2][0] = alpha[2][1] = value;
+                    const auto read = [&] { return bits.Read(1) ? 1 + bits.Read(1) : 0; };
+                    DecodeRuns(bits, blocks.alpha_done.data(), blocks.count, read, [&](const uint32_t i, const uint32_t value_index) {
+                        uint32_t* block = blocks.Block(i);
+                        block[0] = alpha[value_index][0];
+                        block[1] = alpha[value_index][1];
+                        blocks.alpha_done[i] = 1;
+                    });
+                }
+                if (code & ALPHA_8_BITS && game_format == GameFormat::Dxt5) {
+                    // Both DXT5 end points the one value, every index 0
+                    const uint32_t value = bits.Read(8);
+                    alpha[2][0] = value << 8 | value;
+                    alpha[2][1] = 0;
+                    const auto read = [&] { return bits.Read(1) ? 1 + bits.Read(1) : 0; };
+                    DecodeRuns(bits, blocks.alpha_done.data(), blocks.count, read, [&](const uint32_t i, const uint32_t value_index) {
+                        uint32_t* block = blocks.Block(i);
+                        block[0] = alpha[value_index][0];
+                        block[1] = alpha[value_index][1];
+                        blocks.alpha_done[i] = 1;
+                    });
+                }
+            }
+            if (code & PLAIN_COLOUR) {
+                uint32_t colour[2];
+                PlainColourBlock(bits.Read(24), game_format == GameFormat::Dxt1, colour);
+                DecodeRuns(bits, blocks.colour_done, blocks.count, [&] { return bits.Read(1); }, [&](const uint32_t i, uint32_t) {
+                    uint32_t* block = blocks.Block(i) + blocks.colour_offset;
+                    block[0] = colour[0];
+                    block[1] = colour[1];
+                    blocks.colour_done[i] = 1;
+                });
+            }
+            // The DXT data starts with the last word the sections' reader loaded
+            pos = bits.Position() - 1;
+        }
+
+        const auto take = [&](uint32_t& word) {
+            if (pos >= words)
+                return false;
+            word = LoadU32(p + pos++ * 4);
+            return true;
+        };
+        const auto truncated = [&] {
+            error = "Truncated ATEX data";
+            return Result::Corrupt;
+        };
+        if (has_alpha) {
+            for (uint32_t i = 0; i < blocks.count; i++) {
+                if (blocks.alpha_done[i])
+                    continue;
+                uint32_t* block = blocks.Block(i);
+                if (!take(block[0]) || !take(block[1]))
+                    return truncated();
+            }
+        }
+        // Every block's colours, then every block's indices
+        for (uint32_t half = 0; half < 2; half++) {
+            for (uint32_t i = 0; i < blocks.count; i++) {
+                if (!blocks.colour_done[i] && !take(blocks.Block(i)[blocks.colour_offset + half]))
+                    return truncated();
+            }
+        }
+        if (mirrored_edges) {
+            FillMirroredEdges(blocks);
+        }
+
+        out.resize(blocks.words.size() * 4);
+        for (size_t i = 0; i < blocks.words.size(); i++) {
+            const uint32_t word = blocks.words[i];
+            out[i * 4] = static_cast<uint8_t>(word);
+            out[i * 4 + 1] = static_cast<uint8_t>(word >> 8);
+            out[i * 4 + 2] = static_cast<uint8_t>(word >> 16);
+            out[i * 4 + 3] = static_cast<uint8_t>(word >> 24);
+        }
+        return Result::Ok;
+    }
+
+    Result DecodeAtex(const std::span<const uint8_t> data, Image& out, std::string& error, const Options& options)
+    {
+        AtexInfo info;
+        if (const auto result = ReadAtexHeader(data, info, error); result != Result::Ok)
+            return result;
+        if (info.width > options.max_dimension || info.height > options.max_dimension) {
+            error = std::to_string(info.width) + "x" + std::to_string(info.height) + " is larger than " + std::to_string(options.max_dimension) + " pixels";
+            return Result::TooLarge;
+        }
+        std::vector<uint8_t> blocks;
+        if (const auto result = DecompressAtex(data, info, blocks, error); result != Result::Ok)
+            return result;
+        out.width = info.width;
+        out.height = info.height;
+        out.levels = {{info.width, info.height, 0}};
+        out.pixels.resize(static_cast<size_t>(info.width) * info.height * 4);
+        DecodeDxt(info.dxt_format, blocks.data(), info.width, info.height, out.pixels.data(), static_cast<size_t>(info.width) * 4);
+        return Result::Ok;
+    }
+} // namespace ImageDecoder
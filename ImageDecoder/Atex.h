@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Dxt.h"
+#include "ImageDecoder.h"
+
+// =============================================================================
+// ATEX textures
+//
+// Guild Wars' own texture files (ATEX, or ATTX), as found in Gw.dat. A 12 byte
+// header ('ATEX', 'DXT' and a format character, 16 bit width and height) is
+// followed by each level's size, a compression code and the level's data:
+// optional compressed sections that fill in whole blocks at a time (blocks of
+// one colour, of one alpha, transparent ones, and the mirrored tile edges of
+// 256x256 textures), then the DXT blocks the sections left out.
+//
+// DecompressAtex rebuilds the full size level's DXT blocks exactly as the
+// game's decoder does; AtexBench checks that against digests taken from the
+// original routines. Formats other than DXT1 to DXT5 (DXTA, DXTL, DXTN) are
+// Unsupported, for the game to decode.
+// =============================================================================
+
+namespace ImageDecoder {
+    struct AtexInfo {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        char format = 0; // '1' to '5' for DXT1 to DXT5
+        DxtFormat dxt_format = DxtFormat::Dxt1;
+    };
+
+    Result ReadAtexHeader(std::span<const uint8_t> data, AtexInfo& info, std::string& error);
+    // The full size level as (width / 4) * (height / 4) DXT blocks, row by row
+    Result DecompressAtex(std::span<const uint8_t> data, AtexInfo& info, std::vector<uint8_t>& blocks, std::string& error);
+    // The full size level as BGRA pixels
+    Result DecodeAtex(std::span<const uint8_t> data, Image& out, std::string& error, const Options& options = {});
+} // namespace ImageDecoder
@@ -0,0 +1,141 @@
+#include "stdafx.h"
+
+#include "AtlasAllocator.h"
+
+AtlasAllocator::AtlasAllocator(const uint32_t page_width, const uint32_t page_height, const uint32_t max_pages)
+    : page_width(page_width), page_height(page_height), max_pages(max_pages) {}
+
+bool AtlasAllocator::TakeSlot(Shelf& shelf, uint32_t& slot)
+{
+    if (!shelf.free_slots.empty()) {
+        slot = shelf.free_slots.back();
+        shelf.free_slots.pop_back();
+    }
+    else if (shelf.next_unused < shelf.slot_count) {
+        slot = shelf.next_unused++;
+    }
+    else {
+        return false;
+    }
+    shelf.used++;
+    return true;
+}
+
+bool AtlasAllocator::AddShelf(Page& page, const uint32_t width, const uint32_t height, uint32_t& shelf_index)
+{
+    // Tightest free strip it fits in, so the tall ones are left for tall shelves
+    const auto span = std::ranges::min_element(page.free_spans, {}, [height](const Span& s) {
+        return s.height >= height ? s.height : UINT32_MAX;
+    });
+    if (span == page.free_spans.end() || span->height < height)
+        return false;
+
+    const auto unused = std::ranges::find(page.shelves, 0u, &Shelf::height);
+    shelf_index = static_cast<uint32_t>(unused - page.shelves.begin());
+    if (unused == page.shelves.end()) {
+        page.shelves.emplace_back();
+    }
+    auto& shelf = page.shelves[shelf_index];
+    shelf.y = span->y;
+    shelf.height = height;
+    shelf.slot_width = width;
+    shelf.slot_count = page_width / width;
+
+    span->y += height;
+    span->height -= height;
+    if (!span->height) {
+        page.free_spans.erase(span);
+    }
+    return true;
+}
+
+void AtlasAllocator::GiveBack(Page& page, const Span span)
+{
+    auto& spans = page.free_spans;
+    auto next = std::ranges::upper_bound(spans, span.y, {}, &Span::y);
+    next = spans.insert(next, span);
+    // Merge with the strip below, then the one above
+    if (const auto below = next + 1; below != spans.end() && next->y + next->height == below->y) {
+        next->height += below->height;
+        spans.erase(below);
+    }
+    if (next != spans.begin()) {
+        if (const auto above = next - 1; above->y + above->height == next->y) {
+            above->height += next->height;
+            spans.erase(next);
+        }
+    }
+}
+
+bool AtlasAllocator::Allocate(const uint32_t width, const uint32_t height, Allocation& out)
+{
+    if (!width || !height || width > page_width || height > page_height)
+        return false;
+
+    const auto fill = [&](const uint32_t page, const uint32_t shelf_index, const uint32_t slot) {
+        const auto& shelf = pages[page].shelves[shelf_index];
+        out = {page, slot * shelf.slot_width, shelf.y, width, height, shelf_index, slot};
+        allocations++;
+        used_area += static_cast<uint64_t>(width) * height;
+        return true;
+    };
+
+    uint32_t slot = 0;
+    for (uint32_t page = 0; page < pages.size(); page++) {
+        auto& shelves = pages[page].shelves;
+        for (uint32_t shelf = 0; shelf < shelves.size(); shelf++) {
+            if (shelves[shelf].height == height && shelves[shelf].slot_width == width && TakeSlot(shelves[shelf], slot))
+                return fill(page, shelf, slot);
+        }
+    }
+
+    uint32_t shelf = 0;
+    for (uint32_t page = 0; page < pages.size(); page++) {
+        if (AddShelf(pages[page], width, height, shelf)) {
+            TakeSlot(pages[page].shelves[shelf], slot);
+            return fill(page, shelf, slot);
+        }
+    }
+
+    if (pages.size() >= max_pages)
+        return false;
+    auto& page = pages.emplace_back();
+    page.free_spans.push_back({0, page_height});
+    AddShelf(page, width, height, shelf);
+    TakeSlot(page.shelves[shelf], slot);
+    return fill(static_cast<uint32_t>(pages.size() - 1), shelf, slot);
+}
+
+void AtlasAllocator::Free(const Allocation& allocation)
+{
+    assert(allocation.page < pages.size());
+    auto& page = pages[allocation.page];
+    assert(allocation.shelf < page.shelves.size());
+    auto& shelf = page.shelves[allocation.shelf];
+    assert(shelf.height == allocation.height && shelf.slot_width == allocation.width && allocation.slot < shelf.next_unused);
+
+    allocations--;
+    used_area -= static_cast<uint64_t>(allocation.width) * allocation.height;
+    if (--shelf.used == 0) {
+        GiveBack(page, {shelf.y, shelf.height});
+        shelf = {};
+    }
+    else {
+        shelf.free_slots.push_back(allocation.slot);
+    }
+}
+
+AtlasAllocator::Stats AtlasAllocator::GetStats() const
+{
+    Stats stats;
+    stats.pages = pages.size();
+    stats.allocations = allocations;
+    stats.used_area = used_area;
+    stats.page_area = static_cast<uint64_t>(page_width) * page_height * pages.size();
+    for (const auto& page : pages) {
+        for (const auto& shelf : page.shelves) {
+            stats.reserved_area += static_cast<uint64_t>(shelf.height) * page_width;
+        }
+    }
+    return stats;
+}
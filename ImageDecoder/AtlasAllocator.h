@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// =============================================================================
+// AtlasAllocator
+//
+// Places rectangles in fixed size pages, for packing many small images into a
+// few big textures. Pages are cut into shelves: full width strips exactly as
+// tall as the rectangles on them, each holding one rectangle size in equal
+// slots. That suits icons, which come in a handful of sizes; rectangles of a
+// new size start a new shelf. A freed slot is reused by the next rectangle of
+// its size, and a shelf left empty gives its strip back to the page, merged
+// with any free strips next to it.
+//
+// Only bookkeeping; the caller owns the pixels. Not thread safe.
+// =============================================================================
+
+class AtlasAllocator {
+public:
+    struct Allocation {
+        uint32_t page = 0;
+        uint32_t x = 0; // top left within the page
+        uint32_t y = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t shelf = 0;
+        uint32_t slot = 0;
+    };
+
+    struct Stats {
+        size_t pages = 0;
+        size_t allocations = 0;
+        uint64_t used_area = 0;     // covered by allocations
+        uint64_t reserved_area = 0; // covered by shelves; the rest of a shelf is slots waiting for reuse or never handed out
+        uint64_t page_area = 0;
+    };
+
+    AtlasAllocator(uint32_t page_width, uint32_t page_height, uint32_t max_pages);
+
+    // False if it's bigger than a page, or every page is full
+    bool Allocate(uint32_t width, uint32_t height, Allocation& out);
+    void Free(const Allocation& allocation);
+
+    uint32_t GetPageWidth() const { return page_width; }
+    uint32_t GetPageHeight() const { return page_height; }
+    size_t GetPageCount() const { return pages.size(); }
+    Stats GetStats() const;
+
+private:
+    struct Shelf {
+        uint32_t y = 0;
+        uint32_t height = 0; // 0 for a strip that has been given back; its entry is reused so shelf numbers stay put
+        uint32_t slot_width = 0;
+        uint32_t slot_count = 0;
+        uint32_t used = 0;
+        uint32_t next_unused = 0;         // slots from here on have never been handed out
+        std::vector<uint32_t> free_slots; // freed ones below next_unused
+    };
+    struct Span {
+        uint32_t y = 0;
+        uint32_t height = 0;
+    };
+    struct Page {
+        std::vector<Shelf> shelves;
+        std::vector<Span> free_spans; // sorted by y, never touching
+    };
+
+    static bool TakeSlot(Shelf& shelf, uint32_t& slot);
+    bool AddShelf(Page& page, uint32_t width, uint32_t height, uint32_t& shelf_index);
+    static void GiveBack(Page& page, Span span);
+
+    uint32_t page_width;
+    uint32_t page_height;
+    uint32_t max_pages;
+    std::vector<Page> pages;
+    size_t allocations = 0;
+    uint64_t used_area = 0;
+};
@@ -0,0 +1,221 @@
+#include "stdafx.h"
+
+#include "Dxt.h"
+#include "DxtKernels.h"
+
+#if IMAGE_DECODER_DXT_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ImageDecoder {
+    namespace {
+        using namespace detail;
+
+        SimdLevel DetectSimdLevel()
+        {
+#if !IMAGE_DECODER_DXT_X86
+            return SimdLevel::Scalar;
+#elif defined(_MSC_VER)
+            // AVX2 needs the CPU flag, AVX, and the OS saving the YMM registers
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7)
+                return SimdLevel::SSE2;
+            __cpuid(info, 1);
+            const bool avx = (info[2] & (1 << 28)) && (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+            __cpuidex(info, 7, 0);
+            return avx && (info[1] & (1 << 5)) ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#else
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#endif
+        }
+
+        std::atomic<SimdLevel>& CurrentLevel()
+        {
+            static std::atomic<SimdLevel> level = GetBestSimdLevel();
+            return level;
+        }
+
+        // -------------------------------------------------------------------------
+        // Scalar
+        // -------------------------------------------------------------------------
+
+        void ColourPalette(const uint8_t* colour_block, const bool three_colour, uint32_t palette[4])
+        {
+            const uint32_t c0 = Expand565(LoadU16(colour_block));
+            const uint32_t c1 = Expand565(LoadU16(colour_block + 2));
+            palette[0] = c0;
+            palette[1] = c1;
+            palette[2] = palette[3] = 0;
+            for (uint32_t shift = 0; shift < 32; shift += 8) {
+                const uint32_t a = c0 >> shift & 0xff;
+                const uint32_t b = c1 >> shift & 0xff;
+                if (three_colour) {
+                    palette[2] |= (a + b) / 2 << shift;
+                }
+                else {
+                    palette[2] |= (2 * a + b) / 3 << shift;
+                    palette[3] |= (a + 2 * b) / 3 << shift;
+                }
+            }
+        }
+
+        void DecodeBlockScalar(const DxtFormat format, const uint8_t* block, uint8_t* out, const size_t stride)
+        {
+            const uint8_t* colour_block = format == DxtFormat::Dxt1 ? block : block + 8;
+            uint32_t colours[4];
+            ColourPalette(colour_block, IsThreeColour(format, colour_block), colours);
+            uint32_t indices = LoadU32(colour_block + 4);
+
+            uint32_t alphas[8];
+            uint64_t alpha_bits = 0;
+            if (format == DxtFormat::Dxt3) {
+                alpha_bits = LoadU64(block);
+            }
+            else if (format == DxtFormat::Dxt5) {
+                AlphaPalette(block, alphas);
+                alpha_bits = LoadU64(block) >> 16;
+            }
+
+            for (uint32_t y = 0; y < 4; y++) {
+                uint32_t row[4];
+                for (uint32_t x = 0; x < 4; x++) {
+                    row[x] = colours[indices & 3];
+                    indices >>= 2;
+                    if (format == DxtFormat::Dxt3) {
+                        row[x] = (row[x] & 0x00ffffff) | static_cast<uint32_t>(alpha_bits & 15) * 0x11000000;
+                        alpha_bits >>= 4;
+                    }
+                    else if (format == DxtFormat::Dxt5) {
+                        row[x] = (row[x] & 0x00ffffff) | alphas[alpha_bits & 7];
+                        alpha_bits >>= 3;
+                    }
+                }
+                memcpy(out + y * stride, row, sizeof(row));
+            }
+        }
+
+#if IMAGE_DECODER_DXT_X86
+        // -------------------------------------------------------------------------
+        // SSE2; a row of 4 pixels at a time. Without a byte shuffle, each pixel's
+        // index is moved to the top of its lane by a multiply and the colour picked
+        // with masks
+        // -------------------------------------------------------------------------
+
+        __m128i Select(const __m128i mask, const __m128i a, const __m128i b)
+        {
+            return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+        }
+
+        void DecodeBlockSse2(const DxtFormat format, const uint8_t* block, uint8_t* out, const size_t stride)
+        {
+            const uint8_t* colour_block = format == DxtFormat::Dxt1 ? block : block + 8;
+            const __m128i palette = ColourPaletteSse2(colour_block, IsThreeColour(format, colour_block));
+            const __m128i c0 = _mm_shuffle_epi32(palette, _MM_SHUFFLE(0, 0, 0, 0));
+            const __m128i c1 = _mm_shuffle_epi32(palette, _MM_SHUFFLE(1, 1, 1, 1));
+            const __m128i c2 = _mm_shuffle_epi32(palette, _MM_SHUFFLE(2, 2, 2, 2));
+            const __m128i c3 = _mm_shuffle_epi32(palette, _MM_SHUFFLE(3, 3, 3, 3));
+            // Pixel x's 2 bit index to the top of lane x
+            const __m128i index_shifts = _mm_set_epi16(1 << 8, 0, 1 << 10, 0, 1 << 12, 0, 1 << 14, 0);
+            // Pixel x's 4 bit alpha to the top of lane x
+            const __m128i alpha_shifts = _mm_set_epi16(1, 0, 1 << 4, 0, 1 << 8, 0, 1 << 12, 0);
+            const __m128i colour_mask = _mm_set1_epi32(0x00ffffff);
+            const uint32_t indices = LoadU32(colour_block + 4);
+
+            uint32_t alphas[8];
+            uint64_t alpha_bits = 0;
+            if (format == DxtFormat::Dxt3) {
+                alpha_bits = LoadU64(block);
+            }
+            else if (format == DxtFormat::Dxt5) {
+                AlphaPalette(block, alphas);
+                alpha_bits = LoadU64(block) >> 16;
+            }
+
+            for (uint32_t y = 0; y < 4; y++) {
+                const auto row_indices = static_cast<short>(indices >> (y * 8) & 0xff);
+                const __m128i spread = _mm_mullo_epi16(_mm_set1_epi16(row_indices), index_shifts);
+                const __m128i high = _mm_srai_epi32(spread, 31);
+                const __m128i low = _mm_srai_epi32(_mm_slli_epi32(spread, 1), 31);
+                __m128i row = Select(low, Select(high, c3, c1), Select(high, c2, c0));
+                if (format == DxtFormat::Dxt3) {
+                    const auto row_alphas = static_cast<short>(alpha_bits >> (y * 16) & 0xffff);
+                    __m128i alpha = _mm_and_si128(_mm_mullo_epi16(_mm_set1_epi16(row_alphas), alpha_shifts), _mm_set1_epi32(static_cast<int>(0xf0000000)));
+                    alpha = _mm_or_si128(alpha, _mm_srli_epi32(alpha, 4));
+                    row = _mm_or_si128(_mm_and_si128(row, colour_mask), alpha);
+                }
+                else if (format == DxtFormat::Dxt5) {
+                    const auto row_alphas = static_cast<uint32_t>(alpha_bits >> (y * 12));
+                    const __m128i alpha = _mm_set_epi32(static_cast<int>(alphas[row_alphas >> 9 & 7]), static_cast<int>(alphas[row_alphas >> 6 & 7]),
+                                                        static_cast<int>(alphas[row_alphas >> 3 & 7]), static_cast<int>(alphas[row_alphas & 7]));
+                    row = _mm_or_si128(_mm_and_si128(row, colour_mask), alpha);
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + y * stride), row);
+            }
+        }
+#endif
+
+        template <typename DecodeBlock>
+        void DecodeBlocks(const DxtFormat format, const uint8_t* blocks, const uint32_t width, const uint32_t height, uint8_t* out, const size_t stride, DecodeBlock decode_block)
+        {
+            const size_t block_size = GetDxtBlockSize(format);
+            for (uint32_t y = 0; y < height; y += 4) {
+                uint8_t* row = out + y * stride;
+                for (uint32_t x = 0; x < width; x += 4, blocks += block_size) {
+                    decode_block(format, blocks, row + x * 4, stride);
+                }
+            }
+        }
+    } // namespace
+
+    SimdLevel GetBestSimdLevel()
+    {
+        static const SimdLevel best = DetectSimdLevel();
+        return best;
+    }
+
+    SimdLevel GetSimdLevel()
+    {
+        return CurrentLevel().load(std::memory_order_relaxed);
+    }
+
+    void SetSimdLevel(const SimdLevel level)
+    {
+        CurrentLevel() = std::min(level, GetBestSimdLevel());
+    }
+
+    const char* GetSimdLevelName(const SimdLevel level)
+    {
+        switch (level) {
+            case SimdLevel::SSE2:
+                return "sse2";
+            case SimdLevel::AVX2:
+                return "avx2";
+            default:
+                return "scalar";
+        }
+    }
+
+    size_t GetDxtBlockSize(const DxtFormat format)
+    {
+        return format == DxtFormat::Dxt1 ? 8 : 16;
+    }
+
+    void DecodeDxt(const DxtFormat format, const uint8_t* blocks, const uint32_t width, const uint32_t height, uint8_t* out, const size_t stride)
+    {
+        assert(width % 4 == 0 && height % 4 == 0);
+        switch (GetSimdLevel()) {
+#if IMAGE_DECODER_DXT_X86
+            case SimdLevel::AVX2:
+                DecodeDxtAvx2(format, blocks, width, height, out, stride);
+                break;
+            case SimdLevel::SSE2:
+                DecodeBlocks(format, blocks, width, height, out, stride, DecodeBlockSse2);
+                break;
+#endif
+            default:
+                DecodeBlocks(format, blocks, width, height, out, stride, DecodeBlockScalar);
+        }
+    }
+} // namespace ImageDecoder
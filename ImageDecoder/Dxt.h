@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// =============================================================================
+// DXT (S3TC) block decoding
+//
+// Expands DXT1, DXT3 and DXT5 blocks into 8 bit BGRA pixels, for textures that
+// are wanted as plain pixels rather than uploaded compressed. Colours follow
+// the D3D rules: 5:6:5 endpoints widened by repeating their top bits, the
+// in-between colours at a third and two thirds (rounded down), and DXT1 blocks
+// whose first colour isn't the greater having a half way colour and
+// transparent black instead. DXT2 and DXT4 blocks are laid out as DXT3 and
+// DXT5; their premultiplied colours come out as stored.
+//
+// There are scalar, SSE2 and AVX2 versions giving identical pixels; the best
+// the CPU supports is used unless SetSimdLevel() asks for a lower one.
+// AtexBench checks each against the scalar one.
+// =============================================================================
+
+namespace ImageDecoder {
+    enum class DxtFormat : uint8_t { Dxt1, Dxt3, Dxt5 };
+
+    enum class SimdLevel : uint8_t { Scalar, SSE2, AVX2 };
+
+    // Best level this build and CPU support
+    SimdLevel GetBestSimdLevel();
+    SimdLevel GetSimdLevel();
+    // Clamped to GetBestSimdLevel()
+    void SetSimdLevel(SimdLevel level);
+    const char* GetSimdLevelName(SimdLevel level);
+
+    // 8 for DXT1, 16 for the others
+    size_t GetDxtBlockSize(DxtFormat format);
+
+    // Blocks are row by row, (width / 4) * (height / 4) of them; width and height must be multiples of 4.
+    // Rows of the output start stride bytes apart.
+    void DecodeDxt(DxtFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* out, size_t stride);
+} // namespace ImageDecoder
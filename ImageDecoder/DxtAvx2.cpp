@@ -0,0 +1,70 @@
+// Compiled with AVX2 enabled (/arch:AVX2, -mavx2); only called after Dxt.cpp found AVX2 on the CPU.
+// Doesn't include stdafx.h so no standard library code gets compiled for AVX2 here.
+
+#include "DxtKernels.h"
+
+#if IMAGE_DECODER_DXT_X86
+#include <immintrin.h>
+
+namespace {
+    using namespace ImageDecoder;
+    using namespace ImageDecoder::detail;
+
+    // Two rows of 4 pixels per register. A lane's index is shifted down to the bottom of it and
+    // looked up in the palette with a permute: colours for all 16 pixels, and DXT5's alphas too.
+    void DecodeBlock(const DxtFormat format, const uint8_t* block, uint8_t* out, const size_t stride)
+    {
+        const uint8_t* colour_block = format == DxtFormat::Dxt1 ? block : block + 8;
+        const __m256i colours = _mm256_broadcastsi128_si256(ColourPaletteSse2(colour_block, IsThreeColour(format, colour_block)));
+        const __m256i index_shifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+        const __m256i indices = _mm256_set1_epi32(static_cast<int>(LoadU32(colour_block + 4)));
+        const __m256i two_bits = _mm256_set1_epi32(3);
+        __m256i top = _mm256_permutevar8x32_epi32(colours, _mm256_and_si256(_mm256_srlv_epi32(indices, index_shifts), two_bits));
+        __m256i bottom = _mm256_permutevar8x32_epi32(colours, _mm256_and_si256(_mm256_srli_epi32(_mm256_srlv_epi32(indices, index_shifts), 16), two_bits));
+
+        if (format == DxtFormat::Dxt3) {
+            const uint64_t alpha_bits = LoadU64(block);
+            const __m256i alpha_shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+            const __m256i four_bits = _mm256_set1_epi32(15);
+            __m256i top_alpha = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(alpha_bits)), alpha_shifts), four_bits);
+            __m256i bottom_alpha = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(alpha_bits >> 32)), alpha_shifts), four_bits);
+            top_alpha = _mm256_slli_epi32(_mm256_or_si256(top_alpha, _mm256_slli_epi32(top_alpha, 4)), 24);
+            bottom_alpha = _mm256_slli_epi32(_mm256_or_si256(bottom_alpha, _mm256_slli_epi32(bottom_alpha, 4)), 24);
+            const __m256i colour_mask = _mm256_set1_epi32(0x00ffffff);
+            top = _mm256_or_si256(_mm256_and_si256(top, colour_mask), top_alpha);
+            bottom = _mm256_or_si256(_mm256_and_si256(bottom, colour_mask), bottom_alpha);
+        }
+        else if (format == DxtFormat::Dxt5) {
+            uint32_t palette[8];
+            AlphaPalette(block, palette);
+            const __m256i alphas = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(palette));
+            const uint64_t alpha_bits = LoadU64(block) >> 16;
+            const __m256i alpha_shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+            const __m256i three_bits = _mm256_set1_epi32(7);
+            const __m256i top_indices = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(alpha_bits & 0xffffff)), alpha_shifts), three_bits);
+            const __m256i bottom_indices = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(alpha_bits >> 24)), alpha_shifts), three_bits);
+            const __m256i colour_mask = _mm256_set1_epi32(0x00ffffff);
+            top = _mm256_or_si256(_mm256_and_si256(top, colour_mask), _mm256_permutevar8x32_epi32(alphas, top_indices));
+            bottom = _mm256_or_si256(_mm256_and_si256(bottom, colour_mask), _mm256_permutevar8x32_epi32(alphas, bottom_indices));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(top));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + stride), _mm256_extracti128_si256(top, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * stride), _mm256_castsi256_si128(bottom));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 3 * stride), _mm256_extracti128_si256(bottom, 1));
+    }
+} // namespace
+
+namespace ImageDecoder::detail {
+    void DecodeDxtAvx2(const DxtFormat format, const uint8_t* blocks, const uint32_t width, const uint32_t height, uint8_t* out, const size_t stride)
+    {
+        const size_t block_size = format == DxtFormat::Dxt1 ? 8 : 16;
+        for (uint32_t y = 0; y < height; y += 4) {
+            uint8_t* row = out + y * stride;
+            for (uint32_t x = 0; x < width; x += 4, blocks += block_size) {
+                DecodeBlock(format, blocks, row + x * 4, stride);
+            }
+        }
+    }
+} // namespace ImageDecoder::detail
+#endif
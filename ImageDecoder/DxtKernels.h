@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "Dxt.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define IMAGE_DECODER_DXT_X86 1
+#include <emmintrin.h>
+#else
+#define IMAGE_DECODER_DXT_X86 0
+#endif
+
+// =============================================================================
+// DXT decoding pieces shared by Dxt.cpp (scalar and SSE2) and DxtAvx2.cpp,
+// which is compiled for AVX2. Everything here is static so each file gets its
+// own copy, and the linker can't hand code built for AVX2 to the others.
+// =============================================================================
+
+namespace ImageDecoder::detail {
+    static inline uint16_t LoadU16(const uint8_t* p)
+    {
+        uint16_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline uint32_t LoadU32(const uint8_t* p)
+    {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline uint64_t LoadU64(const uint8_t* p)
+    {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    // 5:6:5 to opaque BGRA, each channel widened by repeating its top bits
+    static inline uint32_t Expand565(const uint32_t c)
+    {
+        const uint32_t r = (c >> 11) & 31;
+        const uint32_t g = (c >> 5) & 63;
+        const uint32_t b = c & 31;
+        return 0xff000000 | ((r << 3 | r >> 2) << 16) | ((g << 2 | g >> 4) << 8) | (b << 3 | b >> 2);
+    }
+
+    // A DXT1 block whose first colour isn't the greater has three colours and transparent black
+    static inline bool IsThreeColour(const DxtFormat format, const uint8_t* colour_block)
+    {
+        return format == DxtFormat::Dxt1 && LoadU16(colour_block) <= LoadU16(colour_block + 2);
+    }
+
+    // DXT5's eight alphas, in the top byte where they go in a BGRA pixel
+    static inline void AlphaPalette(const uint8_t* alpha_block, uint32_t palette[8])
+    {
+        const uint32_t a0 = alpha_block[0];
+        const uint32_t a1 = alpha_block[1];
+        palette[0] = a0 << 24;
+        palette[1] = a1 << 24;
+        if (a0 > a1) {
+            for (uint32_t i = 2; i < 8; i++) {
+                palette[i] = (((8 - i) * a0 + (i - 1) * a1) / 7) << 24;
+            }
+        }
+        else {
+            for (uint32_t i = 2; i < 6; i++) {
+                palette[i] = (((6 - i) * a0 + (i - 1) * a1) / 5) << 24;
+            }
+            palette[6] = 0;
+            palette[7] = 0xff000000;
+        }
+    }
+
+#if IMAGE_DECODER_DXT_X86
+    // The block's four BGRA colours, one per 32 bit lane
+    static inline __m128i ColourPaletteSse2(const uint8_t* colour_block, const bool three_colour)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        // 16 bit channels: the two end colours in lanes 0-3 and 4-7, and the same the other way round
+        const auto c0 = static_cast<int>(Expand565(LoadU16(colour_block)));
+        const auto c1 = static_cast<int>(Expand565(LoadU16(colour_block + 2)));
+        const __m128i ends = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, c1, c0), zero);
+        const __m128i swapped = _mm_shuffle_epi32(ends, _MM_SHUFFLE(1, 0, 3, 2));
+        __m128i between;
+        if (three_colour) {
+            // Half way, then transparent black
+            between = _mm_srli_epi16(_mm_add_epi16(ends, swapped), 1);
+            between = _mm_unpacklo_epi64(between, zero);
+        }
+        else {
+            // (2 * c0 + c1) / 3 and (c0 + 2 * c1) / 3; x * 0xAAAB >> 17 is x / 3 for anything up to 3 * 255
+            const __m128i sums = _mm_add_epi16(_mm_add_epi16(ends, ends), swapped);
+            between = _mm_srli_epi16(_mm_mulhi_epu16(sums, _mm_set1_epi16(static_cast<short>(0xaaab))), 1);
+        }
+        return _mm_packus_epi16(ends, between);
+    }
+#endif
+
+#if IMAGE_DECODER_DXT_X86
+    void DecodeDxtAvx2(DxtFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* out, size_t stride);
+#endif
+} // namespace ImageDecoder::detail
@@ -0,0 +1,425 @@
+#include "stdafx.h"
+
+#include <png.h>
+#include <jpeglib.h>
+
+#include "ImageDecoder.h"
+#include "Atex.h"
+
+#ifdef _MSC_VER
+// Nothing with a destructor is in scope between DecodeJpeg's setjmp and the longjmp back to it
+#pragma warning(disable : 4611) // interaction between '_setjmp' and C++ object destruction is non-portable
+#endif
+
+namespace ImageDecoder {
+    namespace {
+        constexpr size_t BYTES_PER_PIXEL = 4;
+
+        void StartImage(Image& out, const uint32_t width, const uint32_t height)
+        {
+            out.width = width;
+            out.height = height;
+            out.levels = {{width, height, 0}};
+            out.pixels.resize(static_cast<size_t>(width) * height * BYTES_PER_PIXEL);
+        }
+
+        Result TooLarge(const uint32_t width, const uint32_t height, const Options& options, std::string& error)
+        {
+            error = std::to_string(width) + "x" + std::to_string(height) + " is larger than " + std::to_string(options.max_dimension) + " pixels";
+            return Result::TooLarge;
+        }
+
+        // -------------------------------------------------------------------------
+        // PNG; libpng's simplified API does the palette, grey, 16 bit and tRNS conversions
+        // -------------------------------------------------------------------------
+
+        Result DecodePng(const std::span<const uint8_t> data, Image& out, std::string& error, const Options& options)
+        {
+            png_image png{};
+            png.version = PNG_IMAGE_VERSION;
+            if (!png_image_begin_read_from_memory(&png, data.data(), data.size())) {
+                error = png.message;
+                png_image_free(&png);
+                return Result::Corrupt;
+            }
+            if (png.width > options.max_dimension || png.height > options.max_dimension) {
+                png_image_free(&png);
+                return TooLarge(png.width, png.height, options, error);
+            }
+            png.format = PNG_FORMAT_BGRA;
+            StartImage(out, png.width, png.height);
+            // Frees png whether or not it succeeds
+            if (!png_image_finish_read(&png, nullptr, out.pixels.data(), 0, nullptr)) {
+                error = png.message;
+                return Result::Corrupt;
+            }
+            return Result::Ok;
+        }
+
+        // -------------------------------------------------------------------------
+        // JPEG; libjpeg reports errors by calling error_exit, which mustn't return
+        // -------------------------------------------------------------------------
+
+        struct JpegError {
+            jpeg_error_mgr mgr;
+            jmp_buf jump;
+            char message[JMSG_LENGTH_MAX];
+        };
+
+        void OnJpegError(const j_common_ptr cinfo)
+        {
+            const auto err = reinterpret_cast<JpegError*>(cinfo->err);
+            cinfo->err->format_message(cinfo, err->message);
+            longjmp(err->jump, 1);
+        }
+
+        // Warnings, e.g. about stray bytes after the image; the default prints them to stderr
+        void OnJpegMessage(j_common_ptr) {}
+
+        Result DecodeJpeg(const std::span<const uint8_t> data, Image& out, std::string& error, const Options& options)
+        {
+            jpeg_decompress_struct cinfo{};
+            JpegError err{};
+            cinfo.err = jpeg_std_error(&err.mgr);
+            err.mgr.error_exit = OnJpegError;
+            err.mgr.output_message = OnJpegMessage;
+            if (setjmp(err.jump)) {
+                jpeg_destroy_decompress(&cinfo);
+                error = err.message;
+                return Result::Corrupt;
+            }
+            jpeg_create_decompress(&cinfo);
+            jpeg_mem_src(&cinfo, data.data(), static_cast<unsigned long>(data.size()));
+            jpeg_read_header(&cinfo, TRUE);
+            if (cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK) {
+                jpeg_destroy_decompress(&cinfo);
+                error = "CMYK JPEGs aren't supported";
+                return Result::Unsupported;
+            }
+            if (cinfo.image_width > options.max_dimension || cinfo.image_height > options.max_dimension) {
+                jpeg_destroy_decompress(&cinfo);
+                return TooLarge(cinfo.image_width, cinfo.image_height, options, error);
+            }
+            // libjpeg-turbo's extended colour spaces write the alpha byte as 0xff
+            cinfo.out_color_space = JCS_EXT_BGRA;
+            jpeg_start_decompress(&cinfo);
+            StartImage(out, cinfo.output_width, cinfo.output_height);
+            const size_t stride = static_cast<size_t>(cinfo.output_width) * BYTES_PER_PIXEL;
+            while (cinfo.output_scanline < cinfo.output_height) {
+                JSAMPROW row = out.pixels.data() + cinfo.output_scanline * stride;
+                jpeg_read_scanlines(&cinfo, &row, 1);
+            }
+            jpeg_finish_decompress(&cinfo);
+            jpeg_destroy_decompress(&cinfo);
+            return Result::Ok;
+        }
+
+        // -------------------------------------------------------------------------
+        // BMP; uncompressed 1, 4, 8, 16, 24 and 32 bit, with or without bit field masks
+        // -------------------------------------------------------------------------
+
+        constexpr size_t BMP_FILE_HEADER_SIZE = 14;
+        constexpr uint32_t BMP_INFO_HEADER_SIZE = 40;
+        constexpr uint32_t BI_RGB = 0;
+        constexpr uint32_t BI_BITFIELDS = 3;
+        constexpr uint32_t BI_ALPHABITFIELDS = 6;
+
+        uint16_t ReadU16(const uint8_t* p)
+        {
+            return static_cast<uint16_t>(p[0] | p[1] << 8);
+        }
+
+        uint32_t ReadU32(const uint8_t* p)
+        {
+            return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+        }
+
+        // One channel of a 16 or 32 bit pixel, scaled to 8 bits
+        struct MaskChannel {
+            uint32_t mask = 0;
+            int shift = 0;
+            uint32_t max = 0;
+
+            MaskChannel(const uint32_t mask)
+                : mask(mask)
+            {
+                if (!mask) return;
+                shift = std::countr_zero(mask);
+                max = mask >> shift;
+            }
+
+            uint8_t Get(const uint32_t pixel, const uint8_t if_no_mask) const
+            {
+                if (!mask) return if_no_mask;
+                const uint64_t value = (pixel & mask) >> shift;
+                return static_cast<uint8_t>(max == 0xff ? value : (value * 255 + max / 2) / max);
+            }
+        };
+
+        Result DecodeBmp(const std::span<const uint8_t> data, Image& out, std::string& error, const Options& options)
+        {
+            const auto p = data.data();
+            if (data.size() < BMP_FILE_HEADER_SIZE + 4) {
+                error = "Truncated bitmap header";
+                return Result::Corrupt;
+            }
+            const uint32_t header_size = ReadU32(p + BMP_FILE_HEADER_SIZE);
+            if (header_size < BMP_INFO_HEADER_SIZE) {
+                error = "OS/2 bitmap headers aren't supported";
+                return Result::Unsupported;
+            }
+            if (data.size() - BMP_FILE_HEADER_SIZE < header_size) {
+                error = "Truncated bitmap header";
+                return Result::Corrupt;
+            }
+            const uint32_t pixel_offset = ReadU32(p + 10);
+            const auto width = static_cast<int32_t>(ReadU32(p + 18));
+            const auto signed_height = static_cast<int32_t>(ReadU32(p + 22));
+            const uint16_t bpp = ReadU16(p + 28);
+            const uint32_t compression = ReadU32(p + 30);
+            const uint32_t colors_used = ReadU32(p + 46);
+            if (width <= 0 || signed_height == 0 || signed_height == INT32_MIN) {
+                error = "Bad bitmap size";
+                return Result::Corrupt;
+            }
+            // Rows are stored bottom up unless the height is negative
+            const bool top_down = signed_height < 0;
+            const auto height = static_cast<uint32_t>(top_down ? -signed_height : signed_height);
+            if (static_cast<uint32_t>(width) > options.max_dimension || height > options.max_dimension) {
+                return TooLarge(width, height, options, error);
+            }
+
+            uint32_t masks[4] = {};
+            if (compression == BI_BITFIELDS || compression == BI_ALPHABITFIELDS) {
+                if (bpp != 16 && bpp != 32) {
+                    error = "Bit field masks on a " + std::to_string(bpp) + " bit bitmap";
+                    return Result::Corrupt;
+                }
+                // Part of V4/V5 headers, otherwise straight after the info header
+                const size_t mask_count = compression == BI_ALPHABITFIELDS || header_size > BMP_INFO_HEADER_SIZE ? 4 : 3;
+                if (data.size() < BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE + mask_count * 4) {
+                    error = "Truncated bit field masks";
+                    return Result::Corrupt;
+                }
+                for (size_t i = 0; i < mask_count; i++) {
+                    masks[i] = ReadU32(p + BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE + i * 4);
+                }
+            }
+            else if (compression != BI_RGB) {
+                error = "Compressed bitmaps aren't supported";
+                return Result::Unsupported;
+            }
+            else if (bpp == 32) {
+                // The fourth byte is unused, not alpha
+                masks[0] = 0xff0000;
+                masks[1] = 0xff00;
+                masks[2] = 0xff;
+            }
+            else if (bpp == 16) {
+                masks[0] = 0x7c00;
+                masks[1] = 0x3e0;
+                masks[2] = 0x1f;
+            }
+            else if (bpp != 1 && bpp != 4 && bpp != 8 && bpp != 24) {
+                error = std::to_string(bpp) + " bit bitmaps aren't supported";
+                return Result::Unsupported;
+            }
+
+            // Palette entries are BGRX, straight after the headers
+            uint32_t palette[256] = {};
+            if (bpp <= 8) {
+                const size_t max_colors = size_t{1} << bpp;
+                const size_t colors = colors_used && colors_used < max_colors ? colors_used : max_colors;
+                const size_t palette_offset = BMP_FILE_HEADER_SIZE + header_size;
+                if (data.size() < palette_offset + colors * 4) {
+                    error = "Truncated palette";
+                    return Result::Corrupt;
+                }
+                for (size_t i = 0; i < colors; i++) {
+                    palette[i] = ReadU32(p + palette_offset + i * 4);
+                }
+            }
+
+            const uint64_t stride = (static_cast<uint64_t>(width) * bpp + 31) / 32 * 4;
+            if (pixel_offset > data.size() || (data.size() - pixel_offset) / stride < height) {
+                error = "Truncated pixel data";
+                return Result::Corrupt;
+            }
+
+            StartImage(out, width, height);
+            const MaskChannel red(masks[0]), green(masks[1]), blue(masks[2]), alpha(masks[3]);
+            for (uint32_t y = 0; y < height; y++) {
+                const uint8_t* src = p + pixel_offset + stride * (top_down ? y : height - 1 - y);
+                uint8_t* dst = out.pixels.data() + static_cast<size_t>(y) * width * BYTES_PER_PIXEL;
+                for (int32_t x = 0; x < width; x++, dst += BYTES_PER_PIXEL) {
+                    uint32_t pixel;
+                    switch (bpp) {
+                        case 24:
+                            dst[0] = src[x * 3];
+                            dst[1] = src[x * 3 + 1];
+                            dst[2] = src[x * 3 + 2];
+                            dst[3] = 0xff;
+                            continue;
+                        case 32:
+                            pixel = ReadU32(src + x * 4);
+                            break;
+                        case 16:
+                            pixel = ReadU16(src + x * 2);
+                            break;
+                        default: {
+                            // Leftmost pixel in the most significant bits
+                            const uint32_t bit = static_cast<uint32_t>(x) * bpp;
+                            const uint32_t index = (src[bit / 8] >> (8 - bpp - bit % 8)) & ((1u << bpp) - 1);
+                            pixel = palette[index];
+                            dst[0] = static_cast<uint8_t>(pixel);
+                            dst[1] = static_cast<uint8_t>(pixel >> 8);
+                            dst[2] = static_cast<uint8_t>(pixel >> 16);
+                            dst[3] = 0xff;
+                            continue;
+                        }
+                    }
+                    dst[0] = blue.Get(pixel, 0);
+                    dst[1] = green.Get(pixel, 0);
+                    dst[2] = red.Get(pixel, 0);
+                    dst[3] = alpha.Get(pixel, 0xff);
+                }
+            }
+            return Result::Ok;
+        }
+
+        // Each destination pixel is the average of the 2x2 block above it; odd edges repeat their last row or column
+        void Downsample(const uint8_t* src, const Level& from, uint8_t* dst, const Level& to)
+        {
+            for (uint32_t y = 0; y < to.height; y++) {
+                const uint8_t* row0 = src + static_cast<size_t>(std::min(y * 2, from.height - 1)) * from.width * BYTES_PER_PIXEL;
+                const uint8_t* row1 = src + static_cast<size_t>(std::min(y * 2 + 1, from.height - 1)) * from.width * BYTES_PER_PIXEL;
+                for (uint32_t x = 0; x < to.width; x++, dst += BYTES_PER_PIXEL) {
+                    const size_t x0 = std::min(x * 2, from.width - 1) * BYTES_PER_PIXEL;
+                    const size_t x1 = std::min(x * 2 + 1, from.width - 1) * BYTES_PER_PIXEL;
+                    for (size_t c = 0; c < BYTES_PER_PIXEL; c++) {
+                        dst[c] = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+                    }
+                }
+            }
+        }
+    } // namespace
+
+    Format DetectFormat(const std::span<const uint8_t> data)
+    {
+        static constexpr uint8_t png_signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        if (data.size() >= sizeof(png_signature) && memcmp(data.data(), png_signature, sizeof(png_signature)) == 0)
+            return Format::Png;
+        if (data.size() >= 3 && data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff)
+            return Format::Jpeg;
+        if (data.size() >= 2 && data[0] == 'B' && data[1] == 'M')
+            return Format::Bmp;
+        if (data.size() >= 4 && memcmp(data.data(), "DDS ", 4) == 0)
+            return Format::Dds;
+        if (data.size() >= 4 && (memcmp(data.data(), "ATEX", 4) == 0 || memcmp(data.data(), "ATTX", 4) == 0))
+            return Format::Atex;
+        return Format::Unknown;
+    }
+
+    Result Decode(const std::span<const uint8_t> data, Image& out, std::string& error, const Options& options)
+    {
+        out = {};
+        error.clear();
+        Result result;
+        switch (DetectFormat(data)) {
+            case Format::Png:
+                result = DecodePng(data, out, error, options);
+                break;
+            case Format::Jpeg:
+                result = DecodeJpeg(data, out, error, options);
+                break;
+            case Format::Bmp:
+                result = DecodeBmp(data, out, error, options);
+                break;
+            case Format::Atex:
+                result = DecodeAtex(data, out, error, options);
+                break;
+            case Format::Dds:
+                error = "DDS files are uploaded without decoding";
+                return Result::Unsupported;
+            default:
+                error = "Unrecognised image format";
+                return Result::Unsupported;
+        }
+        if (result != Result::Ok) {
+            out = {};
+            return result;
+        }
+        if (options.mips) {
+            GenerateMips(out);
+        }
+        return Result::Ok;
+    }
+
+    void GenerateMips(Image& image)
+    {
+        if (image.levels.empty())
+            return;
+        image.levels.resize(1);
+        uint32_t width = image.width;
+        uint32_t height = image.height;
+        size_t offset = static_cast<size_t>(width) * height * BYTES_PER_PIXEL;
+        while (width > 1 || height > 1) {
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+            image.levels.push_back({width, height, offset});
+            offset += static_cast<size_t>(width) * height * BYTES_PER_PIXEL;
+        }
+        image.pixels.resize(offset);
+        for (size_t i = 1; i < image.levels.size(); i++) {
+            const auto& from = image.levels[i - 1];
+            const auto& to = image.levels[i];
+            Downsample(image.pixels.data() + from.offset, from, image.pixels.data() + to.offset, to);
+        }
+    }
+
+    bool ReadFile(const std::filesystem::path& path, std::vector<uint8_t>& out)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+            return false;
+        const auto size = file.tellg();
+        if (size < 0)
+            return false;
+        out.resize(static_cast<size_t>(size));
+        file.seekg(0);
+        return file.read(reinterpret_cast<char*>(out.data()), size).good() || out.empty();
+    }
+
+    const char* ToString(const Format format)
+    {
+        switch (format) {
+            case Format::Png:
+                return "PNG";
+            case Format::Jpeg:
+                return "JPEG";
+            case Format::Bmp:
+                return "BMP";
+            case Format::Dds:
+                return "DDS";
+            case Format::Atex:
+                return "ATEX";
+            default:
+                return "Unknown";
+        }
+    }
+
+    const char* ToString(const Result result)
+    {
+        switch (result) {
+            case Result::Ok:
+                return "Ok";
+            case Result::Unsupported:
+                return "Unsupported";
+            case Result::Corrupt:
+                return "Corrupt";
+            case Result::TooLarge:
+                return "TooLarge";
+        }
+        return "Unknown";
+    }
+} // namespace ImageDecoder
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// ImageDecoder
+//
+// Decodes PNG, JPEG and BMP files into 8 bit BGRA pixels, the memory layout of
+// D3DFMT_A8R8G8B8, so a texture can be filled with a plain copy. Decoding needs
+// no device and is safe on any thread; the toolbox does it on its workers and
+// leaves only the upload to the render thread.
+//
+// Guild Wars' ATEX textures (DXT1 to DXT5) are decompressed and decoded too;
+// see Atex.h. DDS files are recognised but not decoded: their blocks go to the
+// GPU as is.
+// =============================================================================
+
+namespace ImageDecoder {
+    enum class Format : uint8_t {
+        Unknown,
+        Png,
+        Jpeg,
+        Bmp,
+        Dds,
+        Atex
+    };
+
+    enum class Result : uint8_t {
+        Ok,
+        Unsupported, // a format or variant not handled here (DDS, CMYK JPEG, RLE BMP...); hand the file to another loader
+        Corrupt,     // truncated or malformed
+        TooLarge     // wider or taller than Options::max_dimension
+    };
+
+    struct Options {
+        uint32_t max_dimension = 4096;
+        // Box filtered levels after the full size one, down to 1x1
+        bool mips = false;
+    };
+
+    struct Level {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        size_t offset = 0; // into Image::pixels; rows are width * 4 bytes with no padding
+    };
+
+    struct Image {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<Level> levels;
+        std::vector<uint8_t> pixels; // every level back to back
+
+        const uint8_t* LevelPixels(const size_t level) const { return pixels.data() + levels[level].offset; }
+    };
+
+    Format DetectFormat(std::span<const uint8_t> data);
+    // error has the decoder's message when the result isn't Ok
+    Result Decode(std::span<const uint8_t> data, Image& out, std::string& error, const Options& options = {});
+    // Appends the levels below the first; any already generated are replaced
+    void GenerateMips(Image& image);
+
+    bool ReadFile(const std::filesystem::path& path, std::vector<uint8_t>& out);
+
+    const char* ToString(Format format);
+    const char* ToString(Result result);
+} // namespace ImageDecoder
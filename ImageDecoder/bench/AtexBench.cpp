@@ -0,0 +1,458 @@
+// Checks the ATEX and DXT decoders and measures how fast they are at each SIMD level.
+//
+// Usage:
+//   AtexBench [options] [directory]...
+//
+// Options:
+//   --iterations N         times each texture is decoded per measurement (default 20)
+//   --write-corpus DIR     save the synthetic textures to DIR, e.g. to check another decoder against them
+//
+// Checks that
+//   - a synthetic corpus of ATEX textures, covering DXT1 to DXT5 with every
+//     compression section, decompresses to the same DXT blocks as the game's
+//     decoder: the digests below were taken by running the routines in
+//     GWToolboxdll/Unused/GWDatBrowser/AtexAsm.cpp on the same textures
+//   - truncated and malformed textures are Corrupt, other formats Unsupported
+//   - every SIMD level decodes random DXT blocks exactly as the scalar code
+//     does, and the scalar code matches a per pixel decoder written from the
+//     format's description
+// The corpus, and any ATEX files in the directories given (such as textures
+// extracted from Gw.dat), are then decoded at each SIMD level. Exits non-zero
+// if any check fails.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <Atex.h>
+#include <Dxt.h>
+#include <ImageDecoder.h>
+
+namespace {
+    using namespace ImageDecoder;
+    using Clock = std::chrono::steady_clock;
+
+    struct BenchOptions {
+        uint32_t iterations = 20;
+        std::filesystem::path write_corpus;
+    };
+
+    int failures = 0;
+
+    void Check(const bool ok, const std::string& what)
+    {
+        if (ok) return;
+        failures++;
+        printf("FAILED: %s\n", what.c_str());
+    }
+
+    double ElapsedMs(const Clock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    }
+
+    uint64_t Fnv1a(const uint8_t* data, const size_t size, uint64_t hash = 0xcbf29ce484222325)
+    {
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ data[i]) * 0x100000001b3;
+        }
+        return hash;
+    }
+
+    void PutU32(std::vector<uint8_t>& out, const uint32_t v)
+    {
+        for (uint32_t shift = 0; shift < 32; shift += 8) {
+            out.push_back(static_cast<uint8_t>(v >> shift));
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    // Synthetic ATEX textures. Only the generator's raw output is used, so the
+    // corpus is the same with any standard library.
+    // -------------------------------------------------------------------------
+
+    constexpr char FORMATS[] = {'1', '2', '3', '4', '5'};
+    constexpr uint16_t SIZES[][2] = {{4, 4}, {8, 4}, {12, 20}, {64, 32}, {256, 256}, {512, 256}};
+    // No sections, each on its own, the mirrored edges with each, and all of them
+    constexpr uint32_t CODES[] = {0, 1, 2, 4, 8, 0x12, 0x18, 0x1a, 0x1f};
+
+    // What the game's decoder made of each format and size's textures, all codes and densities in turn
+    constexpr uint64_t EXPECTED[std::size(FORMATS)][std::size(SIZES)] = {
+        {0xe3c10f25b85e3b2c, 0x404cdbba6d24e65e, 0x3496e7928710ffb4, 0xb73ba3d10606dbe9, 0x82bd24395f7254a8, 0x4cd45cd24bb51cc7},
+        {0xc71c00b7d06a02bf, 0xda20e3b1ae24fa82, 0x55929ff056c90705, 0xfbf0ca0a847b8607, 0xeab71ce9cb0c1fd0, 0xe14c0c41288598cb},
+        {0x4898d25e090838cc, 0x3b5a5bbf7f108d38, 0xf9cc440074f9ef6d, 0xadff22210b0f2fa7, 0xf848c5555f529115, 0x3707dfaf7136a29b},
+        {0xcf31edfa7f04c4e7, 0xc0e7d8c73028082c, 0x3ace7850d6fe1f0e, 0x9d863fa344b75c4c, 0xcc9fceffd93b733c, 0xcc2edd5dfaf28eb2},
+        {0x29241d66b35fc3c5, 0xdaee773156e294eb, 0x838c7f683e39a4fd, 0x0a13c0f780c77a5b, 0xc6fa430e09e79689, 0xae331cf71bde2112},
+    };
+
+    // Words with about half their bits set (density 0), mostly clear (1) or mostly set (2), for short and long runs
+    uint32_t RandomWord(std::mt19937& rng, const uint32_t density)
+    {
+        switch (density) {
+            case 1:
+                return rng() & rng() & rng();
+            case 2:
+                return rng() | rng() | rng();
+            default:
+                return rng();
+        }
+    }
+
+    // More data than any sections and blocks could need, so a texture never runs out
+    std::vector<uint8_t> MakeAtex(std::mt19937& rng, const char format, const uint16_t width, const uint16_t height, const uint32_t code, const uint32_t density)
+    {
+        const uint32_t blocks = width * height / 16;
+        const uint32_t block_words = format == '1' ? 2 : 4;
+        const uint32_t data_words = blocks * (block_words + 1) + 8;
+        std::vector<uint8_t> out = {'A', 'T', 'E', 'X', 'D', 'X', 'T', static_cast<uint8_t>(format)};
+        out.push_back(static_cast<uint8_t>(width));
+        out.push_back(static_cast<uint8_t>(width >> 8));
+        out.push_back(static_cast<uint8_t>(height));
+        out.push_back(static_cast<uint8_t>(height >> 8));
+        PutU32(out, 8 + data_words * 4);
+        PutU32(out, code);
+        for (uint32_t i = 0; i < data_words; i++) {
+            PutU32(out, RandomWord(rng, density));
+        }
+        return out;
+    }
+
+    struct CorpusTexture {
+        std::string name;
+        size_t format = 0;
+        size_t size = 0;
+        std::vector<uint8_t> data;
+    };
+
+    std::vector<CorpusTexture> MakeCorpus()
+    {
+        std::vector<CorpusTexture> corpus;
+        std::mt19937 rng(1);
+        for (size_t f = 0; f < std::size(FORMATS); f++) {
+            for (size_t s = 0; s < std::size(SIZES); s++) {
+                for (const auto code : CODES) {
+                    for (uint32_t density = 0; density < 3; density++) {
+                        const auto [width, height] = SIZES[s];
+                        char name[64];
+                        snprintf(name, sizeof(name), "dxt%c_%ux%u_%02x_%u.atex", FORMATS[f], width, height, code, density);
+                        corpus.push_back({name, f, s, MakeAtex(rng, FORMATS[f], width, height, code, density)});
+                    }
+                }
+            }
+        }
+        return corpus;
+    }
+
+    void CheckCorpus(const std::vector<CorpusTexture>& corpus)
+    {
+        uint64_t digests[std::size(FORMATS)][std::size(SIZES)];
+        for (auto& row : digests) {
+            std::ranges::fill(row, 0xcbf29ce484222325);
+        }
+        for (const auto& texture : corpus) {
+            AtexInfo info;
+            std::vector<uint8_t> blocks;
+            std::string error;
+            const auto result = DecompressAtex(texture.data, info, blocks, error);
+            Check(result == Result::Ok, texture.name + ": " + ToString(result) + " " + error);
+            auto& digest = digests[texture.format][texture.size];
+            digest = Fnv1a(blocks.data(), blocks.size(), digest);
+        }
+        for (size_t f = 0; f < std::size(FORMATS); f++) {
+            for (size_t s = 0; s < std::size(SIZES); s++) {
+                const bool ok = digests[f][s] == EXPECTED[f][s];
+                Check(ok, "corpus DXT" + std::string(1, FORMATS[f]) + " " + std::to_string(SIZES[s][0]) + "x" + std::to_string(SIZES[s][1]) + " doesn't match the game's decoder");
+                if (!ok) printf("  digest 0x%016llx\n", static_cast<unsigned long long>(digests[f][s]));
+            }
+        }
+        printf("corpus       %zu textures decompressed\n", corpus.size());
+    }
+
+    void CheckErrors(const std::vector<CorpusTexture>& corpus)
+    {
+        Image image;
+        std::string error;
+        const auto& texture = corpus.back().data;
+        Check(DetectFormat(texture) == Format::Atex, "ATEX is recognised");
+        Check(Decode(texture, image, error) == Result::Ok && image.width == 512 && image.height == 256, "ATEX decodes through Decode: " + error);
+
+        auto attx = texture;
+        memcpy(attx.data(), "ATTX", 4);
+        Check(Decode(attx, image, error) == Result::Ok, "ATTX decodes");
+
+        auto truncated = texture;
+        truncated.resize(16);
+        Check(Decode(truncated, image, error) == Result::Corrupt, "truncated header is Corrupt");
+
+        // The level claims more than the file has
+        auto oversized = texture;
+        oversized[14] = 0xff;
+        Check(Decode(oversized, image, error) == Result::Corrupt, "oversized level is Corrupt");
+
+        // Level size and sections fine, but the blocks cut short
+        auto short_blocks = texture;
+        short_blocks.resize(short_blocks.size() / 2);
+        short_blocks[12] = short_blocks[13] = short_blocks[14] = short_blocks[15] = 0;
+        const uint32_t level_size = static_cast<uint32_t>(short_blocks.size() - 12);
+        memcpy(&short_blocks[12], &level_size, 4);
+        short_blocks[16] = short_blocks[17] = short_blocks[18] = short_blocks[19] = 0;
+        Check(Decode(short_blocks, image, error) == Result::Corrupt, "truncated blocks are Corrupt");
+
+        for (const char format : {'A', 'L', 'N'}) {
+            auto other = texture;
+            other[7] = static_cast<uint8_t>(format);
+            Check(Decode(other, image, error) == Result::Unsupported, std::string("DXT") + format + " is Unsupported");
+        }
+        auto odd = texture;
+        odd[8] = 6;
+        odd[9] = 0;
+        Check(Decode(odd, image, error) == Result::Unsupported, "width not a multiple of 4 is Unsupported");
+
+        Options small;
+        small.max_dimension = 256;
+        Check(Decode(texture, image, error, small) == Result::TooLarge, "max_dimension");
+    }
+
+    // -------------------------------------------------------------------------
+    // DXT
+    // -------------------------------------------------------------------------
+
+    const char* FormatName(const DxtFormat format)
+    {
+        switch (format) {
+            case DxtFormat::Dxt1:
+                return "DXT1";
+            case DxtFormat::Dxt3:
+                return "DXT3";
+            default:
+                return "DXT5";
+        }
+    }
+
+    // One pixel of a block, straight from the format's description
+    uint32_t ReferencePixel(const DxtFormat format, const uint8_t* block, const uint32_t x, const uint32_t y)
+    {
+        const uint8_t* colour_block = format == DxtFormat::Dxt1 ? block : block + 8;
+        const uint32_t c[2] = {static_cast<uint32_t>(colour_block[0] | colour_block[1] << 8), static_cast<uint32_t>(colour_block[2] | colour_block[3] << 8)};
+        const uint32_t index = colour_block[4 + y] >> (x * 2) & 3;
+        uint32_t rgb[4][3];
+        for (int i = 0; i < 2; i++) {
+            // Widened by repeating the top bits, as D3D does
+            rgb[i][0] = (c[i] >> 11) * 33 / 4;
+            rgb[i][1] = (c[i] >> 5 & 63) * 65 / 16;
+            rgb[i][2] = (c[i] & 31) * 33 / 4;
+        }
+        const bool three_colour = format == DxtFormat::Dxt1 && c[0] <= c[1];
+        for (int channel = 0; channel < 3; channel++) {
+            const uint32_t a = rgb[0][channel];
+            const uint32_t b = rgb[1][channel];
+            rgb[2][channel] = three_colour ? (a + b) / 2 : (2 * a + b) / 3;
+            rgb[3][channel] = three_colour ? 0 : (a + 2 * b) / 3;
+        }
+        uint32_t alpha = three_colour && index == 3 ? 0 : 255;
+        const uint32_t pixel = y * 4 + x;
+        if (format == DxtFormat::Dxt3) {
+            alpha = (block[pixel / 2] >> (pixel % 2 * 4) & 15) * 17;
+        }
+        else if (format == DxtFormat::Dxt5) {
+            const uint32_t a0 = block[0];
+            const uint32_t a1 = block[1];
+            const uint32_t bit = 16 + pixel * 3;
+            const uint32_t code = (block[bit / 8] | (bit / 8 + 1 < 8 ? block[bit / 8 + 1] << 8 : 0)) >> (bit % 8) & 7;
+            if (code == 0) alpha = a0;
+            else if (code == 1) alpha = a1;
+            else if (a0 > a1) alpha = ((8 - code) * a0 + (code - 1) * a1) / 7;
+            else if (code < 6) alpha = ((6 - code) * a0 + (code - 1) * a1) / 5;
+            else alpha = code == 6 ? 0 : 255;
+        }
+        return alpha << 24 | rgb[index][0] << 16 | rgb[index][1] << 8 | rgb[index][2];
+    }
+
+    // Random blocks, some with equal end points
+    std::vector<uint8_t> RandomBlocks(std::mt19937& rng, const DxtFormat format, const size_t count)
+    {
+        const size_t size = GetDxtBlockSize(format);
+        std::vector<uint8_t> blocks(count * size);
+        for (auto& b : blocks) {
+            b = static_cast<uint8_t>(rng());
+        }
+        for (size_t i = 0; i < count; i += 7) {
+            uint8_t* block = &blocks[i * size];
+            uint8_t* colour_block = format == DxtFormat::Dxt1 ? block : block + 8;
+            colour_block[2] = colour_block[0];
+            colour_block[3] = colour_block[1];
+            block[1] = block[0];
+        }
+        return blocks;
+    }
+
+    void CheckDxt()
+    {
+        constexpr uint32_t width = 64;
+        constexpr uint32_t height = 32;
+        constexpr size_t stride = width * 4 + 12; // rows with padding
+        std::mt19937 rng(2);
+        for (const auto format : {DxtFormat::Dxt1, DxtFormat::Dxt3, DxtFormat::Dxt5}) {
+            const auto blocks = RandomBlocks(rng, format, width * height / 16);
+            std::vector<uint8_t> scalar(stride * height, 0xcd);
+            SetSimdLevel(SimdLevel::Scalar);
+            DecodeDxt(format, blocks.data(), width, height, scalar.data(), stride);
+            bool matches = true;
+            for (uint32_t y = 0; y < height && matches; y++) {
+                for (uint32_t x = 0; x < width && matches; x++) {
+                    const uint8_t* block = &blocks[((y / 4) * (width / 4) + x / 4) * GetDxtBlockSize(format)];
+                    const uint32_t expected = ReferencePixel(format, block, x % 4, y % 4);
+                    uint32_t pixel;
+                    memcpy(&pixel, &scalar[y * stride + x * 4], 4);
+                    matches = pixel == expected;
+                }
+            }
+            Check(matches, std::string(FormatName(format)) + ": scalar doesn't match the reference");
+            Check(scalar[stride - 1] == 0xcd, std::string(FormatName(format)) + ": wrote past the row");
+
+            for (auto level = SimdLevel::SSE2; level <= GetBestSimdLevel(); level = static_cast<SimdLevel>(static_cast<int>(level) + 1)) {
+                std::vector<uint8_t> pixels(stride * height, 0xcd);
+                SetSimdLevel(level);
+                DecodeDxt(format, blocks.data(), width, height, pixels.data(), stride);
+                Check(pixels == scalar, std::string(FormatName(format)) + ": " + GetSimdLevelName(level) + " doesn't match scalar");
+            }
+        }
+        SetSimdLevel(GetBestSimdLevel());
+        printf("dxt          scalar checked against the reference, levels up to %s against scalar\n", GetSimdLevelName(GetBestSimdLevel()));
+    }
+
+    // -------------------------------------------------------------------------
+    // Measurements
+    // -------------------------------------------------------------------------
+
+    void AddFiles(const std::filesystem::path& path, std::vector<std::vector<uint8_t>>& textures)
+    {
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(path, ec)) {
+            std::vector<uint8_t> data;
+            if (!entry.is_regular_file() || !ReadFile(entry.path(), data) || DetectFormat(data) != Format::Atex)
+                continue;
+            AtexInfo info;
+            std::string error;
+            if (ReadAtexHeader(data, info, error) == Result::Ok) {
+                textures.push_back(std::move(data));
+            }
+        }
+        if (ec) {
+            fprintf(stderr, "%s: %s\n", path.string().c_str(), ec.message().c_str());
+        }
+    }
+
+    void Measure(const char* name, const std::vector<std::vector<uint8_t>>& textures, const BenchOptions& options)
+    {
+        // Decompressed once, for the DXT only measurement
+        std::vector<AtexInfo> infos(textures.size());
+        std::vector<std::vector<uint8_t>> blocks(textures.size());
+        double megapixels = 0;
+        size_t decoded = 0;
+        for (size_t i = 0; i < textures.size(); i++) {
+            std::string error;
+            const auto result = DecompressAtex(textures[i], infos[i], blocks[i], error);
+            if (result != Result::Ok) {
+                printf("  %s\n", error.c_str());
+                blocks[i].clear();
+                continue;
+            }
+            megapixels += static_cast<double>(infos[i].width) * infos[i].height / 1e6;
+            decoded++;
+        }
+        if (!decoded) return;
+        printf("%-12s %zu textures, %.1f megapixels\n", name, decoded, megapixels);
+
+        std::vector<uint8_t> pixels;
+        for (auto level = SimdLevel::Scalar; level <= GetBestSimdLevel(); level = static_cast<SimdLevel>(static_cast<int>(level) + 1)) {
+            SetSimdLevel(level);
+            Image image;
+            std::string error;
+            auto started = Clock::now();
+            for (uint32_t n = 0; n < options.iterations; n++) {
+                for (size_t i = 0; i < textures.size(); i++) {
+                    if (!blocks[i].empty()) DecodeAtex(textures[i], image, error);
+                }
+            }
+            const double atex_ms = ElapsedMs(started);
+
+            started = Clock::now();
+            for (uint32_t n = 0; n < options.iterations; n++) {
+                for (size_t i = 0; i < textures.size(); i++) {
+                    if (blocks[i].empty()) continue;
+                    pixels.resize(static_cast<size_t>(infos[i].width) * infos[i].height * 4);
+                    DecodeDxt(infos[i].dxt_format, blocks[i].data(), infos[i].width, infos[i].height, pixels.data(), infos[i].width * 4);
+                }
+            }
+            const double dxt_ms = ElapsedMs(started);
+            printf("  %-8s ATEX %8.1f MP/s   DXT only %8.1f MP/s\n", GetSimdLevelName(level), megapixels * options.iterations / (atex_ms / 1000),
+                   megapixels * options.iterations / (dxt_ms / 1000));
+        }
+        SetSimdLevel(GetBestSimdLevel());
+    }
+
+    bool WriteCorpus(const std::filesystem::path& dir, const std::vector<CorpusTexture>& corpus)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        for (const auto& texture : corpus) {
+            std::ofstream file(dir / texture.name, std::ios::binary);
+            if (!file.write(reinterpret_cast<const char*>(texture.data.data()), static_cast<std::streamsize>(texture.data.size())))
+                return false;
+        }
+        return true;
+    }
+} // namespace
+
+int main(const int argc, char** argv)
+{
+    BenchOptions options;
+    std::vector<std::filesystem::path> dirs;
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (has_value && strcmp(argv[i], "--iterations") == 0) options.iterations = std::max(atoi(argv[++i]), 1);
+        else if (has_value && strcmp(argv[i], "--write-corpus") == 0) options.write_corpus = argv[++i];
+        else if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage: %s [--iterations N] [--write-corpus DIR] [directory]...\n", argv[0]);
+            return 1;
+        }
+        else dirs.emplace_back(argv[i]);
+    }
+
+    const auto corpus = MakeCorpus();
+    if (!options.write_corpus.empty()) {
+        if (!WriteCorpus(options.write_corpus, corpus)) {
+            fprintf(stderr, "Couldn't write to %s\n", options.write_corpus.string().c_str());
+            return 1;
+        }
+        printf("wrote %zu textures to %s\n", corpus.size(), options.write_corpus.string().c_str());
+    }
+    CheckCorpus(corpus);
+    CheckErrors(corpus);
+    CheckDxt();
+
+    std::vector<std::vector<uint8_t>> synthetic;
+    for (const auto& texture : corpus) {
+        synthetic.push_back(texture.data);
+    }
+    Measure("corpus", synthetic, options);
+    for (const auto& dir : dirs) {
+        std::vector<std::vector<uint8_t>> textures;
+        AddFiles(dir, textures);
+        if (textures.empty()) {
+            printf("%s: no DXT1 to DXT5 ATEX textures\n", dir.string().c_str());
+            continue;
+        }
+        Measure(dir.filename().string().c_str(), textures, options);
+    }
+    printf("%s\n", failures ? "FAILED" : "ok");
+    return failures ? 2 : 0;
+}
@@ -0,0 +1,212 @@
+// Checks AtlasAllocator's packing and measures it.
+//
+// Usage:
+//   AtlasBench [--page N] [--pages N] [--operations N] [--seed N]
+//
+// Icon sizes are 32, 48, 64 and 128 pixels plus the 1 pixel border the toolbox's
+// texture atlas puts round each. Checks that
+//   - one size fills every page completely, and frees back to empty pages
+//   - mixed sizes filled until nothing fits cover most of the pages
+//   - when the pages are full and the least recently used icon of the size
+//     wanted (or, failing that, of any size) is evicted to make room,
+//     allocations never overlap and most of the pages stay covered
+// Exits non-zero if any check fails.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <AtlasAllocator.h>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr uint32_t SIZES[] = {34, 50, 66, 130};
+    constexpr uint32_t WEIGHTS[] = {2, 3, 10, 1}; // mostly 64px skill and item icons
+
+    struct Options {
+        uint32_t page = 1024;
+        uint32_t pages = 4;
+        uint32_t operations = 200000;
+        uint32_t seed = 1;
+    };
+
+    int failures = 0;
+
+    void Check(const bool ok, const std::string& what)
+    {
+        if (ok) return;
+        failures++;
+        printf("FAILED: %s\n", what.c_str());
+    }
+
+    double Coverage(const AtlasAllocator& atlas)
+    {
+        const auto stats = atlas.GetStats();
+        return stats.page_area ? static_cast<double>(stats.used_area) / stats.page_area : 0.0;
+    }
+
+    // Every allocation inside its page and none overlapping
+    bool Disjoint(const AtlasAllocator& atlas, const std::deque<AtlasAllocator::Allocation>& live)
+    {
+        const uint32_t w = atlas.GetPageWidth();
+        const uint32_t h = atlas.GetPageHeight();
+        std::vector<uint8_t> covered(static_cast<size_t>(w) * h * atlas.GetPageCount());
+        for (const auto& a : live) {
+            if (a.page >= atlas.GetPageCount() || a.x + a.width > w || a.y + a.height > h) return false;
+            for (uint32_t y = a.y; y < a.y + a.height; y++) {
+                const auto row = &covered[(static_cast<size_t>(a.page) * h + y) * w];
+                for (uint32_t x = a.x; x < a.x + a.width; x++) {
+                    if (row[x]++) return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Every page can take a rectangle its own size, i.e. all of its strips merged back together
+    bool AllPagesEmpty(AtlasAllocator& atlas)
+    {
+        std::vector<AtlasAllocator::Allocation> whole(atlas.GetPageCount());
+        for (auto& a : whole) {
+            if (!atlas.Allocate(atlas.GetPageWidth(), atlas.GetPageHeight(), a)) return false;
+        }
+        for (const auto& a : whole) {
+            atlas.Free(a);
+        }
+        return atlas.GetStats().reserved_area == 0;
+    }
+
+    void CheckUniform(const Options& options)
+    {
+        AtlasAllocator atlas(options.page, options.page, options.pages);
+        const uint32_t size = 66;
+        const uint32_t per_page = (options.page / size) * (options.page / size);
+        std::deque<AtlasAllocator::Allocation> live;
+        AtlasAllocator::Allocation a;
+        while (atlas.Allocate(size, size, a)) {
+            live.push_back(a);
+        }
+        Check(live.size() == static_cast<size_t>(per_page) * options.pages, "uniform: " + std::to_string(live.size()) + " fit, expected " + std::to_string(per_page * options.pages));
+        Check(Disjoint(atlas, live), "uniform: overlapping allocations");
+        printf("uniform      %6zu icons of %ux%u in %u pages, %5.1f%% covered\n", live.size(), size, size, options.pages, Coverage(atlas) * 100);
+
+        // Freeing every other one and refilling takes the same slots back
+        for (size_t i = 0; i < live.size(); i += 2) {
+            atlas.Free(live[i]);
+        }
+        for (size_t i = 0; i < live.size(); i += 2) {
+            Check(atlas.Allocate(size, size, live[i]), "uniform: refill");
+        }
+        Check(!atlas.Allocate(size, size, a), "uniform: more fit after refilling than before");
+        Check(Disjoint(atlas, live), "uniform: overlapping after refill");
+
+        for (const auto& l : live) {
+            atlas.Free(l);
+        }
+        Check(atlas.GetStats().allocations == 0 && atlas.GetStats().used_area == 0, "uniform: counts after freeing everything");
+        Check(AllPagesEmpty(atlas), "uniform: pages not empty after freeing everything");
+    }
+
+    uint32_t RandomSize(std::mt19937& rng)
+    {
+        static std::discrete_distribution<size_t> pick(std::begin(WEIGHTS), std::end(WEIGHTS));
+        return SIZES[pick(rng)];
+    }
+
+    void CheckMixed(const Options& options)
+    {
+        AtlasAllocator atlas(options.page, options.page, options.pages);
+        std::mt19937 rng(options.seed);
+        std::deque<AtlasAllocator::Allocation> live;
+        AtlasAllocator::Allocation a;
+        // Until 100 in a row don't fit
+        for (int misses = 0; misses < 100;) {
+            const auto size = RandomSize(rng);
+            if (atlas.Allocate(size, size, a)) {
+                live.push_back(a);
+                misses = 0;
+            }
+            else {
+                misses++;
+            }
+        }
+        const auto coverage = Coverage(atlas);
+        printf("mixed fill   %6zu icons, %5.1f%% covered\n", live.size(), coverage * 100);
+        Check(coverage >= 0.85, "mixed fill: only " + std::to_string(coverage * 100) + "% covered");
+        Check(Disjoint(atlas, live), "mixed fill: overlapping allocations");
+    }
+
+    void CheckEviction(const Options& options)
+    {
+        AtlasAllocator atlas(options.page, options.page, options.pages);
+        std::mt19937 rng(options.seed + 1);
+        std::deque<AtlasAllocator::Allocation> live; // oldest first
+        uint64_t evictions = 0;
+        double min_coverage = 1.0;
+        bool full = false;
+        double allocate_ns = 0;
+        AtlasAllocator::Allocation a;
+        for (uint32_t i = 0; i < options.operations; i++) {
+            const auto size = RandomSize(rng);
+            const auto started = Clock::now();
+            while (!atlas.Allocate(size, size, a)) {
+                // Least recently used of the same size frees a slot that fits; otherwise the least recently used of all,
+                // until a whole shelf comes free
+                auto evict = std::ranges::find_if(live, [size](const auto& l) { return l.width == size; });
+                if (evict == live.end()) evict = live.begin();
+                atlas.Free(*evict);
+                live.erase(evict);
+                evictions++;
+                full = true;
+            }
+            allocate_ns += std::chrono::duration<double, std::nano>(Clock::now() - started).count();
+            live.push_back(a);
+            // Only once the pages have filled up
+            if (full) min_coverage = std::min(min_coverage, Coverage(atlas));
+            if (i % 20000 == 0) Check(Disjoint(atlas, live), "eviction: overlapping allocations after " + std::to_string(i) + " operations");
+        }
+        Check(Disjoint(atlas, live), "eviction: overlapping allocations at the end");
+        printf("eviction     %6u allocations, %llu evicted, %5.1f%% covered at least, %5.1f%% at the end, %.0f ns per allocation\n", options.operations,
+               static_cast<unsigned long long>(evictions), min_coverage * 100, Coverage(atlas) * 100, allocate_ns / options.operations);
+        Check(evictions > 0, "eviction: pages never filled up; use more operations");
+        Check(min_coverage >= 0.80, "eviction: coverage fell to " + std::to_string(min_coverage * 100) + "%");
+
+        for (const auto& l : live) {
+            atlas.Free(l);
+        }
+        Check(AllPagesEmpty(atlas), "eviction: pages not empty after freeing everything");
+    }
+} // namespace
+
+int main(const int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (has_value && strcmp(argv[i], "--page") == 0) options.page = atoi(argv[++i]);
+        else if (has_value && strcmp(argv[i], "--pages") == 0) options.pages = atoi(argv[++i]);
+        else if (has_value && strcmp(argv[i], "--operations") == 0) options.operations = atoi(argv[++i]);
+        else if (has_value && strcmp(argv[i], "--seed") == 0) options.seed = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "Usage: %s [--page N] [--pages N] [--operations N] [--seed N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (options.page < SIZES[std::size(SIZES) - 1] || !options.pages) {
+        fprintf(stderr, "Pages must fit a %u pixel icon\n", SIZES[std::size(SIZES) - 1]);
+        return 1;
+    }
+    CheckUniform(options);
+    CheckMixed(options);
+    CheckEviction(options);
+    printf("%s\n", failures ? "FAILED" : "ok");
+    return failures ? 2 : 0;
+}
@@ -0,0 +1,342 @@
+// Checks ImageDecoder and measures how fast it decodes a set of images.
+//
+// Usage:
+//   ImageDecodeBench [options] <image | directory>...
+//
+// Options:
+//   --iterations N   times each image is decoded per measurement (default 50)
+//   --threads T      threads for the parallel measurement, as Resources' workers would (default: one per core)
+//   --mips           generate mip levels too
+//
+// Synthetic images are encoded and decoded back first, and every given file
+// is decoded whole and truncated. Exits non-zero if any check fails.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <png.h>
+
+#include <ImageDecoder.h>
+
+namespace {
+    using namespace ImageDecoder;
+    using Clock = std::chrono::steady_clock;
+
+    int failures = 0;
+
+    void Check(const bool ok, const char* what, const std::string& detail = {})
+    {
+        if (ok) return;
+        failures++;
+        printf("FAILED: %s %s\n", what, detail.c_str());
+    }
+
+    double ElapsedMs(const Clock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    }
+
+    // BGRA test card with every alpha value somewhere
+    std::vector<uint8_t> MakePixels(const uint32_t width, const uint32_t height, const bool opaque)
+    {
+        std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                const auto p = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+                p[0] = static_cast<uint8_t>(x * 7 + y);
+                p[1] = static_cast<uint8_t>(y * 13);
+                p[2] = static_cast<uint8_t>(x ^ y);
+                p[3] = opaque ? 0xff : static_cast<uint8_t>(x + y * width);
+            }
+        }
+        return pixels;
+    }
+
+    void PutU16(std::vector<uint8_t>& out, const uint16_t v)
+    {
+        out.push_back(static_cast<uint8_t>(v));
+        out.push_back(static_cast<uint8_t>(v >> 8));
+    }
+
+    void PutU32(std::vector<uint8_t>& out, const uint32_t v)
+    {
+        PutU16(out, static_cast<uint16_t>(v));
+        PutU16(out, static_cast<uint16_t>(v >> 16));
+    }
+
+    // bpp 24 or 32 (with alpha bit fields), or 1/4/8 with a palette of (index * 37) grey levels
+    std::vector<uint8_t> EncodeBmp(const std::vector<uint8_t>& bgra, const uint32_t width, const uint32_t height, const uint16_t bpp, const bool top_down)
+    {
+        const uint32_t stride = (width * bpp + 31) / 32 * 4;
+        const uint32_t colors = bpp <= 8 ? 1u << bpp : 0;
+        const uint32_t masks = bpp == 32 ? 16 : 0;
+        const uint32_t pixel_offset = 14 + 40 + masks + colors * 4;
+        std::vector<uint8_t> out;
+        out.push_back('B');
+        out.push_back('M');
+        PutU32(out, pixel_offset + stride * height);
+        PutU32(out, 0);
+        PutU32(out, pixel_offset);
+        PutU32(out, 40);
+        PutU32(out, width);
+        PutU32(out, top_down ? static_cast<uint32_t>(-static_cast<int32_t>(height)) : height);
+        PutU16(out, 1);
+        PutU16(out, bpp);
+        PutU32(out, bpp == 32 ? 6 : 0); // BI_ALPHABITFIELDS or BI_RGB
+        PutU32(out, stride * height);
+        PutU32(out, 2835);
+        PutU32(out, 2835);
+        PutU32(out, colors);
+        PutU32(out, 0);
+        if (bpp == 32) {
+            PutU32(out, 0xff0000);
+            PutU32(out, 0xff00);
+            PutU32(out, 0xff);
+            PutU32(out, 0xff000000);
+        }
+        for (uint32_t i = 0; i < colors; i++) {
+            const auto grey = static_cast<uint8_t>(i * 37);
+            PutU32(out, grey | grey << 8 | grey << 16);
+        }
+        for (uint32_t row = 0; row < height; row++) {
+            const uint32_t y = top_down ? row : height - 1 - row;
+            std::vector<uint8_t> line(stride);
+            for (uint32_t x = 0; x < width; x++) {
+                const auto p = &bgra[(static_cast<size_t>(y) * width + x) * 4];
+                if (bpp == 24 || bpp == 32) {
+                    memcpy(&line[x * (bpp / 8)], p, bpp / 8);
+                }
+                else {
+                    const uint32_t index = p[0] % colors;
+                    const uint32_t bit = x * bpp;
+                    line[bit / 8] |= static_cast<uint8_t>(index << (8 - bpp - bit % 8));
+                }
+            }
+            out.insert(out.end(), line.begin(), line.end());
+        }
+        return out;
+    }
+
+    std::vector<uint8_t> EncodePng(const std::vector<uint8_t>& bgra, const uint32_t width, const uint32_t height)
+    {
+        png_image png{};
+        png.version = PNG_IMAGE_VERSION;
+        png.width = width;
+        png.height = height;
+        png.format = PNG_FORMAT_BGRA;
+        png_alloc_size_t size = 0;
+        png_image_write_to_memory(&png, nullptr, &size, 0, bgra.data(), 0, nullptr);
+        std::vector<uint8_t> out(size);
+        if (!png_image_write_to_memory(&png, out.data(), &size, 0, bgra.data(), 0, nullptr)) return {};
+        out.resize(size);
+        return out;
+    }
+
+    void CheckRoundTrip(const char* name, const std::vector<uint8_t>& file, const std::vector<uint8_t>& expected, const uint32_t width, const uint32_t height)
+    {
+        Image image;
+        std::string error;
+        const auto result = Decode(file, image, error);
+        Check(result == Result::Ok, name, ToString(result) + std::string(" ") + error);
+        Check(image.width == width && image.height == height && image.levels.size() == 1, name, "size");
+        Check(image.pixels == expected, name, "pixels");
+    }
+
+    void CheckSynthetic()
+    {
+        constexpr uint32_t width = 13; // odd, so rows need padding
+        constexpr uint32_t height = 7;
+        const auto pixels = MakePixels(width, height, false);
+        const auto opaque = MakePixels(width, height, true);
+
+        CheckRoundTrip("png", EncodePng(pixels, width, height), pixels, width, height);
+        CheckRoundTrip("bmp 32 bit bit fields", EncodeBmp(pixels, width, height, 32, true), pixels, width, height);
+        CheckRoundTrip("bmp 24 bit bottom up", EncodeBmp(opaque, width, height, 24, false), opaque, width, height);
+        CheckRoundTrip("bmp 24 bit top down", EncodeBmp(opaque, width, height, 24, true), opaque, width, height);
+        for (const uint16_t bpp : {1, 4, 8}) {
+            const uint32_t colors = 1u << bpp;
+            auto expected = opaque;
+            for (size_t i = 0; i < expected.size(); i += 4) {
+                const auto grey = static_cast<uint8_t>(expected[i] % colors * 37);
+                expected[i] = expected[i + 1] = expected[i + 2] = grey;
+            }
+            const auto name = "bmp " + std::to_string(bpp) + " bit palette";
+            CheckRoundTrip(name.c_str(), EncodeBmp(opaque, width, height, bpp, false), expected, width, height);
+        }
+
+        // Levels halve down to 1x1 and average their 2x2 blocks
+        Image image;
+        image.width = 4;
+        image.height = 2;
+        image.levels = {{4, 2, 0}};
+        image.pixels = {
+            0, 0, 0, 0, 4, 4, 4, 4, 100, 0, 0, 255, 200, 0, 0, 255,
+            8, 8, 8, 8, 4, 4, 4, 4, 100, 0, 0, 255, 200, 0, 0, 255};
+        GenerateMips(image);
+        Check(image.levels.size() == 3, "mip level count");
+        if (image.levels.size() == 3) {
+            Check(image.levels[1].width == 2 && image.levels[1].height == 1 && image.levels[2].width == 1 && image.levels[2].height == 1, "mip sizes");
+            const auto level1 = image.LevelPixels(1);
+            const auto level2 = image.LevelPixels(2);
+            Check(level1[0] == 4 && level1[3] == 4 && level1[4] == 150 && level1[7] == 255, "mip level 1");
+            Check(level2[0] == 77 && level2[3] == 130, "mip level 2");
+            Check(image.pixels.size() == (8 + 2 + 1) * 4, "mip buffer size");
+        }
+
+        std::string error;
+        Check(Decode(std::vector<uint8_t>{'D', 'D', 'S', ' ', 0, 0}, image, error) == Result::Unsupported, "dds is left to the dds loader");
+        Check(Decode(std::vector<uint8_t>{1, 2, 3}, image, error) == Result::Unsupported, "unknown format");
+        Options small;
+        small.max_dimension = 8;
+        Check(Decode(EncodePng(pixels, width, height), image, error, small) == Result::TooLarge, "max_dimension");
+    }
+
+    struct Sample {
+        std::filesystem::path path;
+        std::vector<uint8_t> data;
+        Format format = Format::Unknown;
+        uint64_t pixels = 0;
+    };
+
+    // Decodes the file, then truncations of it; none may crash, and PNGs and BMPs cut in half must fail.
+    // libjpeg pads a cut JPEG out with grey, and a PNG cut after its image data is still whole.
+    void CheckSample(Sample& sample, const Options& options)
+    {
+        const auto name = sample.path.filename().string();
+        Image image;
+        std::string error;
+        const auto result = Decode(sample.data, image, error, options);
+        Check(result == Result::Ok, name.c_str(), ToString(result) + std::string(" ") + error);
+        if (result != Result::Ok) return;
+        sample.pixels = static_cast<uint64_t>(image.width) * image.height;
+        const auto& top = image.levels[0];
+        Check(top.width == image.width && top.height == image.height && image.pixels.size() >= sample.pixels * 4, name.c_str(), "levels");
+
+        for (const auto fraction : {2, 3, 4, 8}) {
+            const auto cut = std::span(sample.data).first(sample.data.size() - sample.data.size() / fraction);
+            const auto cut_result = Decode(cut, image, error, options);
+            if (fraction == 2 && (sample.format == Format::Png || sample.format == Format::Bmp)) {
+                Check(cut_result == Result::Corrupt, name.c_str(), "truncated to " + std::to_string(cut.size()) + " bytes: " + ToString(cut_result));
+            }
+        }
+    }
+
+    double DecodeAll(const std::vector<const Sample*>& samples, const int iterations, const unsigned threads, const Options& options)
+    {
+        std::atomic<size_t> next = 0;
+        const size_t total = samples.size() * iterations;
+        const auto started = Clock::now();
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < threads; i++) {
+            workers.emplace_back([&] {
+                Image image;
+                std::string error;
+                for (size_t job; (job = next++) < total;) {
+                    if (Decode(samples[job % samples.size()]->data, image, error, options) != Result::Ok) {
+                        failures++;
+                    }
+                }
+            });
+        }
+        for (auto& t : workers) {
+            t.join();
+        }
+        return ElapsedMs(started);
+    }
+
+    void PrintRate(const char* label, const std::vector<const Sample*>& samples, const int iterations, const double ms)
+    {
+        uint64_t pixels = 0;
+        for (const auto s : samples) {
+            pixels += s->pixels;
+        }
+        const double images = static_cast<double>(samples.size()) * iterations;
+        printf("%-12s %5zu images %9.1f us/image %9.1f MP/s\n", label, samples.size(), ms * 1000 / images, pixels * iterations / (ms * 1000));
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int iterations = 50;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    Options options;
+    std::vector<std::filesystem::path> paths;
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (has_value && strcmp(argv[i], "--iterations") == 0) iterations = std::max(1, atoi(argv[++i]));
+        else if (has_value && strcmp(argv[i], "--threads") == 0) threads = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--mips") == 0) options.mips = true;
+        else if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage: %s [--iterations N] [--threads T] [--mips] <image | directory>...\n", argv[0]);
+            return 1;
+        }
+        else paths.emplace_back(argv[i]);
+    }
+
+    CheckSynthetic();
+    printf("synthetic checks: %s\n", failures ? "FAILED" : "ok");
+
+    std::vector<Sample> samples;
+    for (const auto& path : paths) {
+        std::vector<std::filesystem::path> files;
+        if (std::filesystem::is_directory(path)) {
+            for (const auto& entry : std::filesystem::directory_iterator(path)) {
+                if (entry.is_regular_file()) files.push_back(entry.path());
+            }
+            std::ranges::sort(files);
+        }
+        else {
+            files.push_back(path);
+        }
+        for (const auto& file : files) {
+            Sample sample;
+            sample.path = file;
+            if (!ReadFile(file, sample.data)) {
+                Check(false, "read", file.string());
+                continue;
+            }
+            sample.format = DetectFormat(sample.data);
+            if (sample.format == Format::Unknown || sample.format == Format::Dds) continue;
+            samples.push_back(std::move(sample));
+        }
+    }
+
+    std::map<Format, std::vector<const Sample*>> by_format;
+    std::vector<const Sample*> all;
+    for (auto& sample : samples) {
+        CheckSample(sample, options);
+        if (!sample.pixels) continue;
+        by_format[sample.format].push_back(&sample);
+        all.push_back(&sample);
+    }
+    printf("%zu sample images checked%s\n", all.size(), failures ? ", FAILED" : "");
+    if (all.empty()) return failures ? 2 : 0;
+
+    for (const auto& [format, list] : by_format) {
+        PrintRate(ToString(format), list, iterations, DecodeAll(list, iterations, 1, options));
+    }
+    PrintRate("all", all, iterations, DecodeAll(all, iterations, 1, options));
+    const auto label = std::to_string(threads) + " threads";
+    PrintRate(label.c_str(), all, iterations, DecodeAll(all, iterations, threads, options));
+
+    // What a worker does per texture: read the file, then decode it
+    const auto started = Clock::now();
+    for (const auto sample : all) {
+        std::vector<uint8_t> data;
+        Image image;
+        std::string error;
+        if (!ReadFile(sample->path, data) || Decode(data, image, error, options) != Result::Ok) failures++;
+    }
+    PrintRate("read+decode", all, 1, ElapsedMs(started));
+
+    return failures ? 2 : 0;
+}
@@ -0,0 +1 @@
+#include "stdafx.h"
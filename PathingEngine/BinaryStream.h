@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <initializer_list>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// =============================================================================
+// Helpers for the engine's binary files (graph cache, map pack)
+//
+// Writer appends raw values and arrays (uint32 count + elements) to a buffer;
+// Reader reads them back with bounds checks, turning ok() false on the first
+// short read. Nested arrays are stored as count, count + 1 offsets, then the
+// flattened elements. Values are stored in native byte order.
+//
+// WriteFileReplacing() writes a whole file via a temporary one, so a crash
+// never leaves a half written file behind.
+// =============================================================================
+
+namespace Pathing {
+    namespace detail {
+        inline uint64_t Hash64(const void* data, size_t size, uint64_t h = 0xcbf29ce484222325ull)
+        {
+            constexpr uint64_t prime = 0x100000001b3ull;
+            const auto* bytes = static_cast<const uint8_t*>(data);
+            for (; size >= 8; size -= 8, bytes += 8) {
+                uint64_t word;
+                memcpy(&word, bytes, 8);
+                h = (h ^ word) * prime;
+                h ^= h >> 29;
+            }
+            for (; size; --size, ++bytes) {
+                h = (h ^ *bytes) * prime;
+            }
+            return h;
+        }
+
+        template <typename T>
+        uint64_t HashValue(const T& value, uint64_t h)
+        {
+            static_assert(std::has_unique_object_representations_v<T> || std::is_floating_point_v<T>);
+            return Hash64(&value, sizeof(value), h);
+        }
+
+        class Writer {
+        public:
+            std::vector<uint8_t> buffer;
+
+            template <typename T>
+            void Put(const T& value)
+            {
+                static_assert(std::is_trivially_copyable_v<T>);
+                const auto* p = reinterpret_cast<const uint8_t*>(&value);
+                buffer.insert(buffer.end(), p, p + sizeof(T));
+            }
+
+            template <typename T>
+            void PutArray(const std::vector<T>& values)
+            {
+                static_assert(std::is_trivially_copyable_v<T>);
+                Put(static_cast<uint32_t>(values.size()));
+                const auto* p = reinterpret_cast<const uint8_t*>(values.data());
+                buffer.insert(buffer.end(), p, p + values.size() * sizeof(T));
+            }
+
+            template <typename T>
+            void PutNested(std::span<const std::vector<T>> values)
+            {
+                Put(static_cast<uint32_t>(values.size()));
+                uint32_t offset = 0;
+                for (const auto& inner : values) {
+                    Put(offset);
+                    offset += static_cast<uint32_t>(inner.size());
+                }
+                Put(offset);
+                for (const auto& inner : values) {
+                    const auto* p = reinterpret_cast<const uint8_t*>(inner.data());
+                    buffer.insert(buffer.end(), p, p + inner.size() * sizeof(T));
+                }
+            }
+        };
+
+        class Reader {
+        public:
+            Reader(const uint8_t* data, size_t size) : m_data(data), m_left(size) {}
+
+            bool ok() const { return m_ok; }
+            bool done() const { return m_ok && m_left == 0; }
+
+            template <typename T>
+            bool Get(T& out)
+            {
+                static_assert(std::is_trivially_copyable_v<T>);
+                if (!Take(sizeof(T))) return false;
+                memcpy(&out, m_data - sizeof(T), sizeof(T));
+                return true;
+            }
+
+            template <typename T>
+            bool GetArray(std::vector<T>& out)
+            {
+                uint32_t count;
+                if (!Get(count) || static_cast<uint64_t>(count) * sizeof(T) > m_left) return m_ok = false;
+                out.resize(count);
+                memcpy(out.data(), m_data, count * sizeof(T));
+                return Take(count * sizeof(T));
+            }
+
+            template <typename T>
+            bool GetNested(std::vector<std::vector<T>>& out)
+            {
+                uint32_t count;
+                if (!Get(count) || (static_cast<uint64_t>(count) + 1) * sizeof(uint32_t) > m_left) return m_ok = false;
+                std::vector<uint32_t> offsets(count + 1);
+                memcpy(offsets.data(), m_data, offsets.size() * sizeof(uint32_t));
+                Take(offsets.size() * sizeof(uint32_t));
+                if (offsets[0] != 0 || static_cast<uint64_t>(offsets[count]) * sizeof(T) > m_left) return m_ok = false;
+
+                out.resize(count);
+                const auto* base = m_data;
+                for (uint32_t i = 0; i < count; ++i) {
+                    if (offsets[i + 1] < offsets[i]) return m_ok = false;
+                    out[i].resize(offsets[i + 1] - offsets[i]);
+                    memcpy(out[i].data(), base + offsets[i] * sizeof(T), out[i].size() * sizeof(T));
+                }
+                return Take(offsets[count] * sizeof(T));
+            }
+
+        private:
+            bool Take(size_t size)
+            {
+                if (!m_ok || size > m_left) return m_ok = false;
+                m_data += size;
+                m_left -= size;
+                return true;
+            }
+
+            const uint8_t* m_data;
+            size_t m_left;
+            bool m_ok = true;
+        };
+
+        inline bool WriteFileReplacing(const std::filesystem::path& path, std::initializer_list<std::span<const uint8_t>> parts)
+        {
+            auto tmp_path = path;
+            tmp_path += ".tmp";
+            FILE* fp = nullptr;
+#ifdef _WIN32
+            if (_wfopen_s(&fp, tmp_path.c_str(), L"wb") != 0) fp = nullptr;
+#else
+            fp = fopen(tmp_path.c_str(), "wb");
+#endif
+            if (!fp) return false;
+            bool written = true;
+            for (const auto& part : parts) {
+                written = written && fwrite(part.data(), 1, part.size(), fp) == part.size();
+            }
+            std::error_code ec;
+            if (fclose(fp) != 0 || !written) {
+                std::filesystem::remove(tmp_path, ec);
+                return false;
+            }
+            std::filesystem::rename(tmp_path, path, ec);
+            if (ec) {
+                std::filesystem::remove(tmp_path, ec);
+                return false;
+            }
+            return true;
+        }
+    } // namespace detail
+} // namespace Pathing
@@ -0,0 +1,193 @@
+#include "stdafx.h"
+
+#include "CorridorSearch.h"
+
+namespace {
+    using namespace Pathing;
+
+    typedef std::pair<float, uint32_t> PQElement;
+    class MyPQueue : public std::priority_queue<PQElement, std::vector<PQElement>, std::greater<PQElement>> {
+    public:
+        MyPQueue(size_t reserve_size) { this->c.reserve(reserve_size); }
+    };
+
+    Vec2f GetCentre(const Trapezoid& t)
+    {
+        return {(t.XTL + t.XTR + t.XBL + t.XBR) * .25f, (t.YT + t.YB) * .5f};
+    }
+
+    // Where the straight line from -> to crosses the portal a - b, or the closest end of it
+    Vec2f GetCrossingPoint(const Vec2f& from, const Vec2f& to, const Vec2f& a, const Vec2f& b)
+    {
+        const auto ab = b - a;
+        const auto d = to - from;
+        const float denom = Cross(d, ab);
+        if (denom == 0.f) {
+            return GetDistance(from, a) + GetDistance(a, to) <= GetDistance(from, b) + GetDistance(b, to) ? a : b;
+        }
+        const float t = std::clamp(Cross(a - from, d) / denom, 0.f, 1.f);
+        return a + t * ab;
+    }
+} // namespace
+
+namespace Pathing {
+    CorridorSearch::CorridorSearch(PathingMapData map)
+        : m_graph(std::move(map)) {}
+
+    bool CorridorSearch::Build()
+    {
+        m_ready = false;
+        if (!m_graph.BuildPortals()) return false;
+
+        // Only needed while building
+        m_graph.ptneighbours = {};
+        m_graph.m_neighbours_visited = {};
+        m_graph.portal_portal_map = {};
+
+        m_ready = true;
+        return true;
+    }
+
+    // A* over trapezoids; g is the length of the path through the chosen crossing points, which the funnel then shortens
+    bool CorridorSearch::FindCorridor(const QueryPoint& start, const QueryPoint& goal, const BlockedPlaneBitset& blocked_planes, std::vector<Crossing>& out) const
+    {
+        const auto& g = m_graph;
+        const auto trapezoid_count = g.m_trapezoid_plane.size();
+        std::vector<float> cost(trapezoid_count, INFINITY);
+        std::vector<Vec2f> entry(trapezoid_count);
+        std::vector<PortalId> came_from(trapezoid_count, INVALID_INDEX16); // portal crossed into the trapezoid, on its side
+
+        MyPQueue open(256);
+        cost[start.trapezoid] = 0.f;
+        entry[start.trapezoid] = start.pos;
+        open.emplace(GetDistance(start.pos, goal.pos), start.trapezoid);
+
+        bool found = false;
+        while (!open.empty()) {
+            const auto [f, current] = open.top();
+            open.pop();
+            if (current == goal.trapezoid) {
+                found = true;
+                break;
+            }
+            if (f > cost[current] + GetDistance(entry[current], goal.pos)) continue; // stale
+
+            for (const auto portal_id : g.pt_portal_map[current]) {
+                const auto& portal = g.portals[portal_id];
+                const auto& other = g.portals[portal.other_id];
+                if (other.layer && blocked_planes[other.layer]) continue;
+
+                const auto next = other.trapezoid;
+                const auto crossing = GetCrossingPoint(entry[current], goal.pos, g.points[portal.points[0]].pos, g.points[portal.points[1]].pos);
+                const float new_cost = cost[current] + GetDistance(entry[current], crossing);
+                if (new_cost >= cost[next]) continue;
+
+                cost[next] = new_cost;
+                entry[next] = crossing;
+                came_from[next] = portal.other_id;
+                open.emplace(new_cost + GetDistance(crossing, goal.pos), next);
+            }
+        }
+        if (!found) return false;
+
+        out.clear();
+        for (auto current = goal.trapezoid; current != start.trapezoid;) {
+            const auto& portal = g.portals[came_from[current]];
+            const auto& other = g.portals[portal.other_id];
+            const auto from = other.trapezoid;
+            const auto& a = g.points[portal.points[0]].pos;
+            const auto& b = g.points[portal.points[1]].pos;
+            // Seen from the trapezoid we come from, the left end is anticlockwise of the right one
+            const auto direction = GetCentre(g.GetTrapezoid(current)) - GetCentre(g.GetTrapezoid(from));
+            const uint32_t zplane = std::max(portal.layer, other.layer);
+            if (Cross(direction, b - a) > 0.f) {
+                out.push_back({b, a, zplane});
+            }
+            else {
+                out.push_back({a, b, zplane});
+            }
+            current = from;
+        }
+        std::ranges::reverse(out);
+        return true;
+    }
+
+    // Simple stupid funnel: http://digestingduck.blogspot.com/2010/03/simple-stupid-funnel-algorithm.html
+    void CorridorSearch::StringPull(const MapPos& start_pos, const MapPos& goal_pos, const std::vector<Crossing>& corridor, PathResult& out)
+    {
+        const auto start = ToVec2f(start_pos);
+        const auto goal = ToVec2f(goal_pos);
+        // Index 0 is the start, corridor.size() + 1 the goal
+        const auto size = corridor.size() + 2;
+        const auto left_of = [&](size_t i) { return i == 0 ? start : i == size - 1 ? goal : corridor[i - 1].left; };
+        const auto right_of = [&](size_t i) { return i == 0 ? start : i == size - 1 ? goal : corridor[i - 1].right; };
+
+        out.points = {start_pos};
+        // Portals sharing an end point can make the same corner twice; the goal is added last
+        const auto add_corner = [&](const Vec2f& corner, size_t index) {
+            if (index == size - 1 || ToVec2f(out.points.back()) == corner) return;
+            out.points.push_back({corner.x, corner.y, corridor[index - 1].zplane});
+        };
+        Vec2f apex = start, left = start, right = start;
+        size_t apex_index = 0, left_index = 0, right_index = 0;
+
+        for (size_t i = 1; i < size; ++i) {
+            const auto new_left = left_of(i);
+            const auto new_right = right_of(i);
+
+            // Narrow the funnel from the right; if it crosses over the left side, the left side is a corner
+            if (Cross(right - apex, new_right - apex) >= 0.f) {
+                if (apex == right || Cross(left - apex, new_right - apex) < 0.f) {
+                    right = new_right;
+                    right_index = i;
+                }
+                else {
+                    add_corner(left, left_index);
+                    apex = right = left;
+                    apex_index = right_index = left_index;
+                    i = apex_index;
+                    continue;
+                }
+            }
+
+            if (Cross(left - apex, new_left - apex) <= 0.f) {
+                if (apex == left || Cross(right - apex, new_left - apex) > 0.f) {
+                    left = new_left;
+                    left_index = i;
+                }
+                else {
+                    add_corner(right, right_index);
+                    apex = left = right;
+                    apex_index = left_index = right_index;
+                    i = apex_index;
+                    continue;
+                }
+            }
+        }
+        out.points.push_back(goal_pos);
+
+        out.cost = 0.f;
+        for (size_t i = 1; i < out.points.size(); ++i) {
+            out.cost += GetDistance(ToVec2f(out.points[i - 1]), ToVec2f(out.points[i]));
+        }
+    }
+
+    Error CorridorSearch::Search(const MapPos& _start_pos, const MapPos& _goal_pos, const BlockedPlaneBitset& blocked_planes, PathResult& out) const
+    {
+        out = {};
+        if (!m_ready) return Error::FailedToFinializePath;
+
+        auto start_pos = _start_pos;
+        auto goal_pos = _goal_pos;
+        QueryPoint start, goal;
+        if (!m_graph.LocateQueryPoint(start_pos, 0, start)) return Error::FailedToFindStartPathingTrapezoid;
+        if (!m_graph.LocateQueryPoint(goal_pos, 0, goal)) return Error::FailedToFindGoalPathingTrapezoid;
+        // Standing on a blocked plane blocks every way out, as in VisGraph::Search
+        if ((start.layer && blocked_planes[start.layer]) || (goal.layer && blocked_planes[goal.layer])) return Error::FailedToFinializePath;
+
+        std::vector<Crossing> corridor;
+        if (!FindCorridor(start, goal, blocked_planes, corridor)) return Error::FailedToFinializePath;
+        StringPull(start_pos, goal_pos, corridor, out);
+        return Error::OK;
+    }
+} // namespace Pathing
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+#include "VisGraph.h"
+
+// =============================================================================
+// CorridorSearch
+//
+// Path finding straight on the trapezoids, without a visibility graph. A*
+// finds a corridor of trapezoids from start to goal, crossing each portal at
+// the point closest to the straight line towards the goal, then a simple
+// stupid funnel (Mononen, 2010) pulls the path tight within that corridor.
+//
+// Build() only links neighbouring trapezoids, which takes milliseconds where
+// the visibility graph takes seconds, so this can answer queries right after
+// map load while VisGraph::Build() is still running. The corridor picked by
+// A* isn't always the one the shortest path takes, so paths can come out a
+// bit longer than VisGraph::Search. Teleports are not used.
+//
+// Owns its copy of the map data. Build() once, then Search() from any number
+// of threads.
+// =============================================================================
+
+namespace Pathing {
+    class CorridorSearch {
+    public:
+        explicit CorridorSearch(PathingMapData map);
+
+        // Blocking, but quick enough to run right after map load.
+        bool Build();
+        bool IsReady() const { return m_ready; }
+
+        // Same arguments and errors as VisGraph::Search
+        Error Search(const MapPos& start_pos, const MapPos& goal_pos, const BlockedPlaneBitset& blocked_planes, PathResult& out) const;
+
+        size_t GetTrapezoidCount() const { return m_graph.m_trapezoid_plane.size(); }
+        size_t GetPortalCount() const { return m_graph.portals.size(); }
+        // Approximate heap usage, in bytes
+        size_t GetMemoryUsage() const { return m_graph.GetMemoryUsage(); }
+
+    private:
+        using QueryPoint = VisGraph::QueryPoint;
+
+        // Portal crossed by the path, as seen walking through it
+        struct Crossing {
+            Vec2f left;
+            Vec2f right;
+            uint32_t zplane;
+        };
+
+        bool FindCorridor(const QueryPoint& start, const QueryPoint& goal, const BlockedPlaneBitset& blocked_planes, std::vector<Crossing>& out) const;
+        static void StringPull(const MapPos& start_pos, const MapPos& goal_pos, const std::vector<Crossing>& corridor, PathResult& out);
+
+        VisGraph m_graph; // only built up to the portals
+        std::atomic<bool> m_ready = false;
+    };
+} // namespace Pathing
@@ -0,0 +1,450 @@
+#include "stdafx.h"
+
+#include "HierarchicalGraph.h"
+
+namespace {
+    using namespace Pathing;
+
+    typedef std::pair<float, uint32_t> QueueEntry;
+    typedef std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> Queue;
+
+    uint32_t FindRoot(std::vector<uint32_t>& parent, uint32_t i)
+    {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+} // namespace
+
+namespace Pathing {
+    struct HierarchicalGraph::ClusterScratch {
+        std::vector<float> dist;                 // PointId
+        std::vector<uint8_t> in_cluster;         // PointId
+        std::vector<BlockedPlaneBitset> masks;   // PointId; planes crossed on the way, if track_masks
+        std::vector<QueueEntry> open;
+        bool track_masks = false;
+
+        void init(size_t point_count, bool with_masks)
+        {
+            dist.assign(point_count, INFINITY);
+            in_cluster.assign(point_count, 0);
+            track_masks = with_masks;
+            if (with_masks) masks.resize(point_count);
+        }
+    };
+
+    HierarchicalGraph::HierarchicalGraph(const VisGraph& graph)
+        : m_graph(graph) {}
+
+    void HierarchicalGraph::ClusterDijkstra(uint32_t cluster, std::span<const Seed> seeds, const std::vector<uint8_t>& mask_blocked, ClusterScratch& scratch) const
+    {
+        auto& dist = scratch.dist;
+        for (const auto p : GetClusterPoints(cluster)) {
+            dist[p] = INFINITY;
+        }
+        auto& open = scratch.open;
+        open.clear();
+        const auto push = [&](PointId p, float d) {
+            dist[p] = d;
+            open.emplace_back(d, p);
+            std::ranges::push_heap(open, std::greater<QueueEntry>{});
+        };
+        for (const auto& seed : seeds) {
+            if (!scratch.in_cluster[seed.point] || seed.distance >= dist[seed.point]) continue;
+            if (scratch.track_masks) scratch.masks[seed.point].reset();
+            push(seed.point, seed.distance);
+        }
+
+        while (!open.empty()) {
+            std::ranges::pop_heap(open, std::greater<QueueEntry>{});
+            const auto [d, current] = open.back();
+            open.pop_back();
+            if (d > dist[current]) continue;
+            for (const auto& edge : m_graph.GetEdges(static_cast<PointId>(current))) {
+                if (!scratch.in_cluster[edge.point_id] || mask_blocked[edge.blocked_planes]) continue;
+                const float new_dist = d + edge.distance;
+                if (new_dist >= dist[edge.point_id]) continue;
+                if (scratch.track_masks) scratch.masks[edge.point_id] = scratch.masks[current] | m_graph.m_blocked_plane_masks[edge.blocked_planes];
+                push(edge.point_id, new_dist);
+            }
+        }
+    }
+
+    void HierarchicalGraph::CrossCluster(uint32_t entrance, uint32_t cluster, const BlockedPlaneBitset& blocked_planes, const std::vector<uint8_t>& mask_blocked, ClusterScratch& scratch, std::vector<Crossing>& out) const
+    {
+        const uint64_t key = static_cast<uint64_t>(entrance) << 32 | cluster;
+        {
+            std::lock_guard lock(m_crossings_mutex);
+            if (m_crossings_planes != blocked_planes) {
+                m_crossings.clear();
+                m_crossings_planes = blocked_planes;
+            }
+            else if (const auto found = m_crossings.find(key); found != m_crossings.end()) {
+                out = found->second;
+                return;
+            }
+        }
+
+        out.clear();
+        const auto cluster_points = GetClusterPoints(cluster);
+        for (const auto p : cluster_points) {
+            scratch.in_cluster[p] = 1;
+        }
+        const Seed seed{m_entrances[entrance], 0.f};
+        ClusterDijkstra(cluster, {&seed, 1}, mask_blocked, scratch);
+        for (const auto p : cluster_points) {
+            scratch.in_cluster[p] = 0;
+            if (p != seed.point && m_entrance_index[p] != INVALID_INDEX && !std::isinf(scratch.dist[p])) out.push_back({m_entrance_index[p], scratch.dist[p]});
+        }
+
+        std::lock_guard lock(m_crossings_mutex);
+        if (m_crossings_planes == blocked_planes) m_crossings.emplace(key, out);
+    }
+
+    bool HierarchicalGraph::Build(float trapezoids_per_cluster)
+    {
+        m_ready = false;
+        if (!m_graph.IsReady()) return false;
+
+        const auto& points = m_graph.points;
+        const auto& portals = m_graph.portals;
+        const auto point_count = static_cast<uint32_t>(points.size());
+        const auto trapezoid_count = static_cast<uint32_t>(m_graph.m_trapezoid_plane.size());
+
+        m_masks.assign(1, {});
+        m_trapezoid_cluster.clear();
+        m_point_cluster_offsets.assign(point_count + 1, 0);
+        m_point_clusters.clear();
+        m_cluster_point_offsets.assign(1, 0);
+        m_cluster_points.clear();
+        m_entrances.clear();
+        m_entrance_index.assign(point_count, INVALID_INDEX);
+        m_abstract_edge_offsets.assign(1, 0);
+        m_abstract_edges.clear();
+        {
+            std::lock_guard lock(m_crossings_mutex);
+            m_crossings.clear();
+        }
+
+        // Teleports make paths asymmetric and skip across the map; not worth it for the handful of maps that have them
+        if (!m_graph.m_teleports.empty() || !trapezoid_count) {
+            m_ready = true;
+            return true;
+        }
+
+        // Coarse grid over trapezoid centres, sized for the requested number of trapezoids per cell
+        std::vector<Vec2f> centres(trapezoid_count);
+        float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+        for (uint32_t t = 0; t < trapezoid_count; ++t) {
+            const auto& trapezoid = m_graph.GetTrapezoid(t);
+            centres[t] = {(trapezoid.XTL + trapezoid.XTR + trapezoid.XBL + trapezoid.XBR) * .25f, (trapezoid.YT + trapezoid.YB) * .5f};
+            min_x = std::min(min_x, centres[t].x);
+            min_y = std::min(min_y, centres[t].y);
+            max_x = std::max(max_x, centres[t].x);
+            max_y = std::max(max_y, centres[t].y);
+        }
+        const float w = std::max(max_x - min_x, 1.f), h = std::max(max_y - min_y, 1.f);
+        const float cell_size = std::max(sqrtf(w * h * std::max(trapezoids_per_cluster, 1.f) / trapezoid_count), 1.f);
+        const auto grid_width = static_cast<uint32_t>(w / cell_size) + 1;
+        const auto cell_of = [&](uint32_t t) {
+            return static_cast<uint32_t>((centres[t].y - min_y) / cell_size) * grid_width + static_cast<uint32_t>((centres[t].x - min_x) / cell_size);
+        };
+
+        // Clusters: trapezoids joined by portals within one cell
+        std::vector<uint32_t> parent(trapezoid_count);
+        for (uint32_t t = 0; t < trapezoid_count; ++t) {
+            parent[t] = t;
+        }
+        for (const auto& portal : portals) {
+            const uint32_t a = portal.trapezoid, b = portals[portal.other_id].trapezoid;
+            if (cell_of(a) != cell_of(b)) continue;
+            parent[FindRoot(parent, a)] = FindRoot(parent, b);
+        }
+        m_trapezoid_cluster.assign(trapezoid_count, INVALID_INDEX);
+        uint32_t cluster_count = 0;
+        for (uint32_t t = 0; t < trapezoid_count; ++t) {
+            const auto root = FindRoot(parent, t);
+            if (m_trapezoid_cluster[root] == INVALID_INDEX) m_trapezoid_cluster[root] = cluster_count++;
+            m_trapezoid_cluster[t] = m_trapezoid_cluster[root];
+        }
+
+        // Clusters of each point: those of the trapezoids on both sides of its portals
+        for (uint32_t p = 0; p < point_count; ++p) {
+            // Appended straight to the list and deduplicated there; a point on a cell corner can be in any number of clusters
+            const auto first = m_point_clusters.size();
+            for (const auto portal_id : points[p].portals) {
+                const auto& portal = portals[portal_id];
+                m_point_clusters.push_back(m_trapezoid_cluster[portal.trapezoid]);
+                m_point_clusters.push_back(m_trapezoid_cluster[portals[portal.other_id].trapezoid]);
+            }
+            const auto begin = m_point_clusters.begin() + static_cast<ptrdiff_t>(first);
+            std::sort(begin, m_point_clusters.end());
+            m_point_clusters.erase(std::unique(begin, m_point_clusters.end()), m_point_clusters.end());
+            const auto count = m_point_clusters.size() - first;
+            m_point_cluster_offsets[p + 1] = static_cast<uint32_t>(m_point_clusters.size());
+            if (count > 1 && points[p].is_viable) {
+                m_entrance_index[p] = static_cast<uint32_t>(m_entrances.size());
+                m_entrances.push_back(static_cast<PointId>(p));
+            }
+        }
+        m_cluster_point_offsets.assign(cluster_count + 1, 0);
+        for (const auto cluster : m_point_clusters) {
+            m_cluster_point_offsets[cluster + 1]++;
+        }
+        for (uint32_t c = 0; c < cluster_count; ++c) {
+            m_cluster_point_offsets[c + 1] += m_cluster_point_offsets[c];
+        }
+        m_cluster_points.resize(m_point_clusters.size());
+        {
+            std::vector<uint32_t> fill(m_cluster_point_offsets.begin(), m_cluster_point_offsets.end() - 1);
+            for (uint32_t p = 0; p < point_count; ++p) {
+                for (const auto cluster : GetPointClusters(static_cast<PointId>(p))) {
+                    m_cluster_points[fill[cluster]++] = static_cast<PointId>(p);
+                }
+            }
+        }
+
+        // Abstract edges: paths between the entrances of each cluster, plus direct lines between entrances with no cluster in common
+        std::unordered_map<BlockedPlaneBitset, uint32_t> interned{{BlockedPlaneBitset{}, 0}};
+        const auto intern = [&](const BlockedPlaneBitset& mask) {
+            const auto [it, added] = interned.emplace(mask, static_cast<uint32_t>(m_masks.size()));
+            if (added) m_masks.push_back(mask);
+            return it->second;
+        };
+        std::vector<std::pair<uint32_t, AbstractEdge>> edges;
+        const std::vector<uint8_t> nothing_blocked(m_graph.m_blocked_plane_masks.size(), 0);
+        ClusterScratch scratch;
+        scratch.init(point_count, true);
+        std::vector<uint32_t> cluster_entrances;
+        for (uint32_t c = 0; c < cluster_count; ++c) {
+            if (m_graph.m_cancel) return false;
+            const auto cluster_points = GetClusterPoints(c);
+            cluster_entrances.clear();
+            for (const auto p : cluster_points) {
+                scratch.in_cluster[p] = 1;
+                if (m_entrance_index[p] != INVALID_INDEX) cluster_entrances.push_back(p);
+            }
+            for (const auto from : cluster_entrances) {
+                const Seed seed{static_cast<PointId>(from), 0.f};
+                ClusterDijkstra(c, {&seed, 1}, nothing_blocked, scratch);
+                for (const auto to : cluster_entrances) {
+                    if (to == from || std::isinf(scratch.dist[to])) continue;
+                    edges.push_back({m_entrance_index[from], {scratch.dist[to], m_entrance_index[to], c, intern(scratch.masks[to])}});
+                }
+            }
+            for (const auto p : cluster_points) {
+                scratch.in_cluster[p] = 0;
+            }
+        }
+        for (const auto from : m_entrances) {
+            const auto from_clusters = GetPointClusters(from);
+            for (const auto& edge : m_graph.GetEdges(from)) {
+                if (m_entrance_index[edge.point_id] == INVALID_INDEX) continue;
+                const auto to_clusters = GetPointClusters(edge.point_id);
+                if (std::ranges::find_first_of(from_clusters, to_clusters) != from_clusters.end()) continue;
+                edges.push_back({m_entrance_index[from], {edge.distance, m_entrance_index[edge.point_id], INVALID_INDEX, intern(m_graph.m_blocked_plane_masks[edge.blocked_planes])}});
+            }
+        }
+
+        std::ranges::stable_sort(edges, {}, &std::pair<uint32_t, AbstractEdge>::first);
+        m_abstract_edge_offsets.assign(m_entrances.size() + 1, 0);
+        m_abstract_edges.reserve(edges.size());
+        for (const auto& [from, edge] : edges) {
+            m_abstract_edge_offsets[from + 1]++;
+            m_abstract_edges.push_back(edge);
+        }
+        for (size_t i = 0; i < m_entrances.size(); ++i) {
+            m_abstract_edge_offsets[i + 1] += m_abstract_edge_offsets[i];
+        }
+        m_ready = true;
+        return true;
+    }
+
+    Error HierarchicalGraph::Search(const MapPos& _start_pos, const MapPos& _goal_pos, const BlockedPlaneBitset& blocked_planes, PathResult& out) const
+    {
+        out = {};
+        if (!m_ready || m_entrances.empty()) return m_graph.Search(_start_pos, _goal_pos, blocked_planes, out);
+
+        const auto& points = m_graph.points;
+        const auto point_count = static_cast<uint32_t>(points.size());
+        auto start_pos = _start_pos;
+        auto goal_pos = _goal_pos;
+        QueryPoint start, goal;
+        if (!m_graph.LocateQueryPoint(start_pos, static_cast<PointId>(point_count), start)) return Error::FailedToFindStartPathingTrapezoid;
+        if (!m_graph.LocateQueryPoint(goal_pos, static_cast<PointId>(point_count + 1), goal)) return Error::FailedToFindGoalPathingTrapezoid;
+
+        // Nearby; the full search won't expand much
+        const auto start_cluster = m_trapezoid_cluster[start.trapezoid];
+        const auto goal_cluster = m_trapezoid_cluster[goal.trapezoid];
+        if (start_cluster == goal_cluster) return m_graph.Search(_start_pos, _goal_pos, blocked_planes, out);
+
+        std::vector<VisElement> start_edges;
+        std::vector<VisElement> goal_edges; // visibility is symmetric, so these are the edges into the goal
+        std::optional<BlockedPlaneBitset> direct;
+        {
+            m_graph.QueryPointVisibility(start, {&goal, 1}, start_edges, {&direct, 1});
+            std::optional<BlockedPlaneBitset> direct_from_goal;
+            m_graph.QueryPointVisibility(goal, {&start, 1}, goal_edges, {&direct_from_goal, 1});
+            if (!direct) direct = direct_from_goal;
+        }
+        if (direct && (*direct & blocked_planes).none()) {
+            out.points = {start_pos, goal_pos};
+            out.cost = GetDistance(start.pos, goal.pos);
+            return Error::OK;
+        }
+        std::erase_if(start_edges, [&](const VisElement& e) { return (e.blocked_planes & blocked_planes).any(); });
+        std::erase_if(goal_edges, [&](const VisElement& e) { return (e.blocked_planes & blocked_planes).any(); });
+
+        std::vector<uint8_t> mask_blocked(m_graph.m_blocked_plane_masks.size());
+        for (size_t i = 0; i < mask_blocked.size(); ++i) {
+            mask_blocked[i] = (m_graph.m_blocked_plane_masks[i] & blocked_planes).any();
+        }
+        std::vector<uint8_t> abstract_blocked(m_masks.size());
+        for (size_t i = 0; i < m_masks.size(); ++i) {
+            abstract_blocked[i] = (m_masks[i] & blocked_planes).any();
+        }
+
+        // Hook start and goal into the abstract graph: through their own cluster, or straight to entrances they can see
+        const auto entrance_count = static_cast<uint32_t>(m_entrances.size());
+        const uint32_t abstract_start = entrance_count, abstract_goal = entrance_count + 1;
+        std::vector<std::pair<uint32_t, float>> from_start;
+        std::vector<float> to_goal(entrance_count, INFINITY);
+        ClusterScratch scratch;
+        scratch.init(point_count, false);
+        {
+            std::vector<Seed> seeds;
+            const auto connect = [&](uint32_t cluster, const std::vector<VisElement>& vis, auto&& add) {
+                seeds.clear();
+                for (const auto& e : vis) {
+                    seeds.push_back({e.point_id, e.distance});
+                    if (m_entrance_index[e.point_id] != INVALID_INDEX) add(m_entrance_index[e.point_id], e.distance);
+                }
+                const auto cluster_points = GetClusterPoints(cluster);
+                for (const auto p : cluster_points) {
+                    scratch.in_cluster[p] = 1;
+                }
+                ClusterDijkstra(cluster, seeds, mask_blocked, scratch);
+                for (const auto p : cluster_points) {
+                    scratch.in_cluster[p] = 0;
+                    if (m_entrance_index[p] != INVALID_INDEX && !std::isinf(scratch.dist[p])) add(m_entrance_index[p], scratch.dist[p]);
+                }
+            };
+            connect(start_cluster, start_edges, [&](uint32_t entrance, float d) {
+                from_start.emplace_back(entrance, d);
+            });
+            connect(goal_cluster, goal_edges, [&](uint32_t entrance, float d) {
+                to_goal[entrance] = std::min(to_goal[entrance], d);
+            });
+        }
+
+        // A* over the entrances
+        std::vector<float> cost(entrance_count + 2, INFINITY);
+        std::vector<uint32_t> came_from(entrance_count + 2, INVALID_INDEX);
+        {
+            const auto heuristic = [&](uint32_t entrance) {
+                return GetDistance(points[m_entrances[entrance]].pos, goal.pos);
+            };
+            Queue open;
+            std::vector<uint32_t> repair; // clusters to cross again from the current entrance
+            std::vector<Crossing> crossings;
+            const auto relax = [&](uint32_t from, uint32_t to, float new_cost) {
+                if (new_cost >= cost[to]) return;
+                cost[to] = new_cost;
+                came_from[to] = from;
+                open.emplace(new_cost + (to == abstract_goal ? 0.f : heuristic(to)), to);
+            };
+            cost[abstract_start] = 0.f;
+            for (const auto& [entrance, d] : from_start) {
+                relax(abstract_start, entrance, d);
+            }
+            while (!open.empty()) {
+                const auto [priority, current] = open.top();
+                open.pop();
+                if (current == abstract_goal) break;
+                if (priority > cost[current] + heuristic(current)) continue; // stale
+                repair.clear();
+                for (const auto& edge : GetAbstractEdges(current)) {
+                    if (!abstract_blocked[edge.mask]) {
+                        relax(current, edge.to, cost[current] + edge.distance);
+                    }
+                    else if (edge.cluster != INVALID_INDEX && std::ranges::find(repair, edge.cluster) == repair.end()) {
+                        repair.push_back(edge.cluster);
+                    }
+                }
+                // The precomputed way across crosses a blocked plane; look for another one with the planes blocked now
+                for (const auto cluster : repair) {
+                    CrossCluster(current, cluster, blocked_planes, mask_blocked, scratch, crossings);
+                    for (const auto& crossing : crossings) {
+                        relax(current, crossing.entrance, cost[current] + crossing.distance);
+                    }
+                }
+                if (!std::isinf(to_goal[current])) relax(current, abstract_goal, cost[current] + to_goal[current]);
+            }
+        }
+        if (std::isinf(cost[abstract_goal])) return Error::FailedToFinializePath;
+
+        // Refine: the full search, on the points of the clusters the abstract path went through
+        std::vector<uint8_t> in_corridor(point_count, 0);
+        const auto add_cluster = [&](uint32_t cluster) {
+            for (const auto p : GetClusterPoints(cluster)) {
+                in_corridor[p] = 1;
+            }
+        };
+        add_cluster(start_cluster);
+        add_cluster(goal_cluster);
+        for (auto node = came_from[abstract_goal]; node != abstract_start; node = came_from[node]) {
+            for (const auto cluster : GetPointClusters(m_entrances[node])) {
+                add_cluster(cluster);
+            }
+        }
+
+        std::vector<uint32_t> goal_edge_index(point_count, INVALID_INDEX);
+        for (uint32_t i = 0; i < goal_edges.size(); ++i) {
+            goal_edge_index[goal_edges[i].point_id] = i;
+        }
+        std::vector<float> cost_so_far(point_count + 2, INFINITY);
+        std::vector<PointId> point_came_from(point_count + 2);
+        Queue open;
+        const auto relax = [&](PointId from, float new_cost, PointId to) {
+            if (new_cost >= cost_so_far[to]) return;
+            cost_so_far[to] = new_cost;
+            point_came_from[to] = from;
+            open.emplace(new_cost + (to == goal.id ? 0.f : GetDistance(points[to].pos, goal.pos)), to);
+        };
+        cost_so_far[start.id] = 0.f;
+        point_came_from[start.id] = start.id;
+        for (const auto& e : start_edges) {
+            if (in_corridor[e.point_id]) relax(start.id, e.distance, e.point_id);
+        }
+        while (!open.empty()) {
+            const auto [priority, current] = open.top();
+            open.pop();
+            if (current == goal.id) break;
+            if (priority > cost_so_far[current] + GetDistance(points[current].pos, goal.pos)) continue; // stale
+            const auto p = static_cast<PointId>(current);
+            for (const auto& edge : m_graph.GetEdges(p)) {
+                if (in_corridor[edge.point_id] && !mask_blocked[edge.blocked_planes]) relax(p, cost_so_far[p] + edge.distance, edge.point_id);
+            }
+            if (goal_edge_index[p] != INVALID_INDEX) relax(p, cost_so_far[p] + goal_edges[goal_edge_index[p]].distance, goal.id);
+        }
+        if (std::isinf(cost_so_far[goal.id])) return m_graph.Search(_start_pos, _goal_pos, blocked_planes, out);
+
+        out.cost = cost_so_far[goal.id];
+        const auto res = m_graph.BuildPath(start, goal, point_came_from, out);
+        if (res == Error::OK) {
+            out.points.front() = start_pos;
+            out.points.back() = goal_pos;
+        }
+        return res;
+    }
+
+    size_t HierarchicalGraph::GetMemoryUsage() const
+    {
+        return m_trapezoid_cluster.capacity() * sizeof(uint32_t) + m_point_cluster_offsets.capacity() * sizeof(uint32_t) + m_point_clusters.capacity() * sizeof(uint32_t)
+               + m_cluster_point_offsets.capacity() * sizeof(uint32_t) + m_cluster_points.capacity() * sizeof(PointId) + m_entrances.capacity() * sizeof(PointId)
+               + m_entrance_index.capacity() * sizeof(uint32_t) + m_abstract_edge_offsets.capacity() * sizeof(uint32_t) + m_abstract_edges.capacity() * sizeof(AbstractEdge)
+               + m_masks.capacity() * sizeof(BlockedPlaneBitset);
+    }
+} // namespace Pathing
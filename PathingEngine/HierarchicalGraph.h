@@ -0,0 +1,103 @@
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "VisGraph.h"
+
+// =============================================================================
+// HierarchicalGraph
+//
+// Cluster level abstraction over a built VisGraph for long queries, in the
+// spirit of HPA* (Botea, Mueller & Schaeffer, 2004).
+//
+// Trapezoids that are joined by portals and lie in the same cell of a coarse
+// grid form a cluster. Graph points on portals between clusters are the
+// entrances; Build() precomputes the shortest path between every pair of
+// entrances of a cluster, staying inside it. Search() first searches those
+// entrances only, then runs the real search restricted to the clusters the
+// abstract path passed through. Paths are usually within a few percent of
+// VisGraph::Search.
+//
+// Queries within one cluster and maps with teleports are passed straight to
+// VisGraph::Search. Paths across a cluster are precomputed with nothing
+// blocked; where one crosses a plane blocked at query time, the search looks
+// for another way across that cluster there and then. If the corridor turns
+// out to have no path after all, the query falls back to the full search.
+//
+// Build() once, then Search() from any number of threads. The graph must be
+// built first and outlive this object.
+// =============================================================================
+
+namespace Pathing {
+    class HierarchicalGraph {
+    public:
+        explicit HierarchicalGraph(const VisGraph& graph);
+
+        // Blocking; run on a worker thread. Larger clusters mean fewer entrances but more work per query.
+        bool Build(float trapezoids_per_cluster = 48.f);
+        bool IsReady() const { return m_ready; }
+
+        // Same results as VisGraph::Search, except that long paths may be a little longer
+        Error Search(const MapPos& start_pos, const MapPos& goal_pos, const BlockedPlaneBitset& blocked_planes, PathResult& out) const;
+
+        size_t GetClusterCount() const { return m_cluster_point_offsets.empty() ? 0 : m_cluster_point_offsets.size() - 1; }
+        size_t GetEntranceCount() const { return m_entrances.size(); }
+        size_t GetAbstractEdgeCount() const { return m_abstract_edges.size(); }
+        // Approximate heap usage, in bytes
+        size_t GetMemoryUsage() const;
+
+    private:
+        using QueryPoint = VisGraph::QueryPoint;
+        using VisElement = VisGraph::VisElement;
+
+        // Shortest path between two entrances of one cluster, or a direct line between entrances of different clusters
+        struct AbstractEdge {
+            float distance;
+            uint32_t to;      // entrance index
+            uint32_t cluster; // INVALID_INDEX for a direct line
+            uint32_t mask;    // index into m_masks; planes the path crosses
+        };
+
+        struct Seed {
+            PointId point;
+            float distance;
+        };
+
+        // Entrance reached across a cluster
+        struct Crossing {
+            uint32_t entrance;
+            float distance;
+        };
+
+        struct ClusterScratch;
+
+        void ClusterDijkstra(uint32_t cluster, std::span<const Seed> seeds, const std::vector<uint8_t>& mask_blocked, ClusterScratch& scratch) const;
+        void CrossCluster(uint32_t entrance, uint32_t cluster, const BlockedPlaneBitset& blocked_planes, const std::vector<uint8_t>& mask_blocked, ClusterScratch& scratch, std::vector<Crossing>& out) const;
+        std::span<const uint32_t> GetPointClusters(PointId id) const { return {m_point_clusters.data() + m_point_cluster_offsets[id], m_point_clusters.data() + m_point_cluster_offsets[id + 1]}; }
+        std::span<const PointId> GetClusterPoints(uint32_t cluster) const { return {m_cluster_points.data() + m_cluster_point_offsets[cluster], m_cluster_points.data() + m_cluster_point_offsets[cluster + 1]}; }
+        std::span<const AbstractEdge> GetAbstractEdges(uint32_t entrance) const { return {m_abstract_edges.data() + m_abstract_edge_offsets[entrance], m_abstract_edges.data() + m_abstract_edge_offsets[entrance + 1]}; }
+
+        const VisGraph& m_graph;
+
+        std::vector<uint32_t> m_trapezoid_cluster;   // global trapezoid id -> cluster
+        std::vector<uint32_t> m_point_cluster_offsets; // PointId; a point on a portal between clusters is in each of them
+        std::vector<uint32_t> m_point_clusters;
+        std::vector<uint32_t> m_cluster_point_offsets;
+        std::vector<PointId> m_cluster_points;
+
+        std::vector<PointId> m_entrances;
+        std::vector<uint32_t> m_entrance_index; // PointId -> entrance index, INVALID_INDEX if not an entrance
+        std::vector<uint32_t> m_abstract_edge_offsets;
+        std::vector<AbstractEdge> m_abstract_edges;
+        std::vector<BlockedPlaneBitset> m_masks; // [0] blocks nothing
+
+        // Ways across clusters found by CrossCluster, kept while the same planes stay blocked; doors don't change often
+        mutable std::mutex m_crossings_mutex;
+        mutable BlockedPlaneBitset m_crossings_planes;
+        mutable std::unordered_map<uint64_t, std::vector<Crossing>> m_crossings; // entrance << 32 | cluster
+
+        std::atomic<bool> m_ready = false;
+    };
+} // namespace Pathing
@@ -0,0 +1,433 @@
+#include "stdafx.h"
+
+#include "IncrementalSearch.h"
+
+// D* Lite, optimized variant; see Koenig & Likhachev, "D* Lite" (AAAI 2002).
+// g is the distance to the goal as of the last expansion, rhs the one step lookahead from the successors.
+// A node is queued while the two disagree.
+
+namespace {
+    // Coincident points are joined by zero length edges. D* Lite needs positive costs: with a zero cost cycle
+    // two points can keep each other's stale distance alive after the way on to the goal got blocked.
+    constexpr float MIN_EDGE_COST = 1e-3f;
+
+    float EdgeCost(float distance, bool blocked)
+    {
+        return blocked ? INFINITY : std::max(distance, MIN_EDGE_COST);
+    }
+} // namespace
+
+namespace Pathing {
+    IncrementalSearch::IncrementalSearch(const VisGraph& graph)
+        : m_graph(graph) {}
+
+    void IncrementalSearch::Reset()
+    {
+        m_has_goal = false;
+        m_has_start = false;
+    }
+
+    void IncrementalSearch::BuildReverseEdges()
+    {
+        const auto point_count = static_cast<uint32_t>(m_graph.points.size());
+        m_start_id = static_cast<PointId>(point_count);
+        m_goal_id = static_cast<PointId>(point_count + 1);
+        m_use_heuristic = m_graph.m_teleports.empty();
+
+        m_in_offsets.assign(point_count + 1, 0);
+        for (const auto& edge : m_graph.m_edges) {
+            m_in_offsets[edge.point_id + 1]++;
+        }
+        for (uint32_t i = 0; i < point_count; ++i) {
+            m_in_offsets[i + 1] += m_in_offsets[i];
+        }
+        m_mask_edge_count.assign(m_graph.m_blocked_plane_masks.size(), 0);
+        for (const auto& edge : m_graph.m_edges) {
+            m_mask_edge_count[edge.blocked_planes]++;
+        }
+
+        m_in_edges.resize(m_graph.m_edges.size());
+        std::vector<uint32_t> fill(m_in_offsets.begin(), m_in_offsets.end() - 1);
+        for (uint32_t from = 0; from < point_count; ++from) {
+            for (const auto& edge : m_graph.GetEdges(static_cast<PointId>(from))) {
+                m_in_edges[fill[edge.point_id]++] = {edge.distance, static_cast<PointId>(from), edge.blocked_planes};
+            }
+        }
+
+        m_goal_edge_index.assign(point_count, INVALID_INDEX);
+        m_start_edge_index.assign(point_count, INVALID_INDEX);
+        m_came_from.resize(point_count + 2);
+    }
+
+    bool IncrementalSearch::SetGoal(const MapPos& goal_pos)
+    {
+        auto pos = goal_pos;
+        QueryPoint goal;
+        if (!m_graph.LocateQueryPoint(pos, m_goal_id, goal)) return false;
+
+        for (const auto& e : m_goal_edges) {
+            m_goal_edge_index[e.point_id] = INVALID_INDEX;
+        }
+        m_goal_pos = goal_pos;
+        m_goal_on_map = pos;
+        m_goal = goal;
+
+        // The direct line to the start is checked when the start is set
+        m_goal_edges.clear();
+        m_graph.QueryPointVisibility(m_goal, {}, m_goal_edges, {});
+        for (uint32_t i = 0; i < m_goal_edges.size(); ++i) {
+            m_goal_edge_index[m_goal_edges[i].point_id] = i;
+        }
+
+        const size_t node_count = m_graph.points.size() + 2;
+        m_g.assign(node_count, INFINITY);
+        m_rhs.assign(node_count, INFINITY);
+        m_rhs[m_goal_id] = 0.f;
+        m_open.clear();
+        m_open_index.assign(node_count, INVALID_INDEX);
+        m_km = 0.f;
+        m_has_goal = true;
+        m_has_start = false;
+        return true;
+    }
+
+    bool IncrementalSearch::SetStart(const MapPos& start_pos)
+    {
+        auto pos = start_pos;
+        QueryPoint start;
+        if (!m_graph.LocateQueryPoint(pos, m_start_id, start)) return false;
+        // Keys already queued were computed from the old start; the heuristic can have dropped by at most this much
+        if (m_has_start && m_use_heuristic) m_km += GetDistance(m_start.pos, start.pos);
+
+        for (const auto& e : m_start_edges) {
+            m_start_edge_index[e.point_id] = INVALID_INDEX;
+        }
+        m_start_pos = start_pos;
+        m_start_on_map = pos;
+        m_start = start;
+        m_start_edges.clear();
+        m_direct.reset();
+        m_graph.QueryPointVisibility(m_start, {&m_goal, 1}, m_start_edges, {&m_direct, 1});
+        if (!m_direct) {
+            // Same as VisGraph::Search: the line of sight may only be found walking from the goal
+            std::vector<VisElement> unused;
+            m_graph.QueryPointVisibility(m_goal, {&m_start, 1}, unused, {&m_direct, 1});
+        }
+        for (uint32_t i = 0; i < m_start_edges.size(); ++i) {
+            m_start_edge_index[m_start_edges[i].point_id] = i;
+        }
+
+        // Nothing leads into the start, so only its own lookahead changes
+        m_rhs[m_start_id] = ComputeRhs(m_start_id);
+        UpdateVertex(m_start_id);
+        m_has_start = true;
+        return true;
+    }
+
+    void IncrementalSearch::SetBlockedPlanes(const BlockedPlaneBitset& blocked_planes)
+    {
+        if (blocked_planes == m_blocked_planes && m_mask_blocked.size() == m_graph.m_blocked_plane_masks.size()) return;
+
+        const auto old_blocked_planes = m_blocked_planes;
+        const auto old_mask_blocked = std::move(m_mask_blocked);
+        m_blocked_planes = blocked_planes;
+        m_mask_blocked.resize(m_graph.m_blocked_plane_masks.size());
+        bool any_mask_changed = false;
+        for (size_t i = 0; i < m_mask_blocked.size(); ++i) {
+            m_mask_blocked[i] = (m_graph.m_blocked_plane_masks[i] & blocked_planes).any();
+            any_mask_changed |= old_mask_blocked.empty() || old_mask_blocked[i] != m_mask_blocked[i];
+        }
+        // First call, or the tree is going to be rebuilt anyway
+        if (old_mask_blocked.empty() || !m_has_goal || !m_has_start) return;
+
+        if (any_mask_changed) {
+            for (PointId from = 0; from < m_start_id; ++from) {
+                for (const auto& edge : m_graph.GetEdges(from)) {
+                    const bool was = old_mask_blocked[edge.blocked_planes], is = m_mask_blocked[edge.blocked_planes];
+                    if (was != is) EdgeChanged(from, edge.point_id, EdgeCost(edge.distance, was), EdgeCost(edge.distance, is));
+                }
+            }
+        }
+        // Start and goal edges keep their full masks
+        const auto vis_changed = [&](PointId from, PointId to, const BlockedPlaneBitset& planes, float distance) {
+            const bool was = (planes & old_blocked_planes).any(), is = (planes & blocked_planes).any();
+            if (was != is) EdgeChanged(from, to, EdgeCost(distance, was), EdgeCost(distance, is));
+        };
+        for (const auto& e : m_goal_edges) {
+            vis_changed(e.point_id, m_goal_id, e.blocked_planes, e.distance);
+        }
+        for (const auto& e : m_start_edges) {
+            vis_changed(m_start_id, e.point_id, e.blocked_planes, e.distance);
+        }
+        if (m_direct) vis_changed(m_start_id, m_goal_id, *m_direct, GetDistance(m_start.pos, m_goal.pos));
+    }
+
+    // Repairing costs more per changed edge than searching from scratch does per edge; past a point starting over is cheaper.
+    bool IncrementalSearch::IsLargeChange(const BlockedPlaneBitset& blocked_planes) const
+    {
+        if (m_mask_blocked.size() != m_graph.m_blocked_plane_masks.size() || blocked_planes == m_blocked_planes) return false;
+        size_t changed = 0;
+        for (size_t i = 0; i < m_mask_blocked.size(); ++i) {
+            if ((m_graph.m_blocked_plane_masks[i] & blocked_planes).any() != static_cast<bool>(m_mask_blocked[i])) changed += m_mask_edge_count[i];
+        }
+        return changed > m_graph.m_edges.size() / 8;
+    }
+
+    const Vec2f& IncrementalSearch::Position(PointId id) const
+    {
+        if (id == m_start_id) return m_start.pos;
+        if (id == m_goal_id) return m_goal.pos;
+        return m_graph.points[id].pos;
+    }
+
+    float IncrementalSearch::Heuristic(PointId id) const
+    {
+        return m_use_heuristic ? GetDistance(Position(id), m_start.pos) : 0.f;
+    }
+
+    IncrementalSearch::Key IncrementalSearch::CalculateKey(PointId id) const
+    {
+        const float m = std::min(m_g[id], m_rhs[id]);
+        return {m + Heuristic(id) + m_km, m};
+    }
+
+    template <typename F>
+    void IncrementalSearch::ForEachSuccessor(PointId id, F&& f) const
+    {
+        const auto vis_cost = [&](const VisElement& e) { return EdgeCost(e.distance, (e.blocked_planes & m_blocked_planes).any()); };
+        if (id == m_start_id) {
+            for (const auto& e : m_start_edges) {
+                f(e.point_id, vis_cost(e));
+            }
+            if (m_direct) f(m_goal_id, EdgeCost(GetDistance(m_start.pos, m_goal.pos), (*m_direct & m_blocked_planes).any()));
+            return;
+        }
+        if (id == m_goal_id) return;
+        for (const auto& edge : m_graph.GetEdges(id)) {
+            f(edge.point_id, EdgeCost(edge.distance, m_mask_blocked[edge.blocked_planes]));
+        }
+        if (m_goal_edge_index[id] != INVALID_INDEX) f(m_goal_id, vis_cost(m_goal_edges[m_goal_edge_index[id]]));
+    }
+
+    template <typename F>
+    void IncrementalSearch::ForEachPredecessor(PointId id, F&& f) const
+    {
+        const auto vis_cost = [&](const VisElement& e) { return EdgeCost(e.distance, (e.blocked_planes & m_blocked_planes).any()); };
+        if (id == m_start_id) return;
+        if (id == m_goal_id) {
+            for (const auto& e : m_goal_edges) {
+                f(e.point_id, vis_cost(e));
+            }
+            if (m_direct) f(m_start_id, EdgeCost(GetDistance(m_start.pos, m_goal.pos), (*m_direct & m_blocked_planes).any()));
+            return;
+        }
+        for (uint32_t i = m_in_offsets[id]; i < m_in_offsets[id + 1]; ++i) {
+            const auto& edge = m_in_edges[i];
+            f(edge.from, EdgeCost(edge.distance, m_mask_blocked[edge.blocked_planes]));
+        }
+        if (m_start_edge_index[id] != INVALID_INDEX) f(m_start_id, vis_cost(m_start_edges[m_start_edge_index[id]]));
+    }
+
+    float IncrementalSearch::ComputeRhs(PointId id) const
+    {
+        if (id == m_goal_id) return 0.f;
+        float rhs = INFINITY;
+        ForEachSuccessor(id, [&](PointId to, float cost) {
+            rhs = std::min(rhs, cost + m_g[to]);
+        });
+        return rhs;
+    }
+
+    void IncrementalSearch::UpdateVertex(PointId id)
+    {
+        if (m_g[id] != m_rhs[id]) {
+            OpenPush(id, CalculateKey(id));
+        }
+        else {
+            OpenRemove(id);
+        }
+    }
+
+    void IncrementalSearch::EdgeChanged(PointId from, PointId to, float old_cost, float new_cost)
+    {
+        if (from == m_goal_id) return;
+        if (old_cost > new_cost) {
+            m_rhs[from] = std::min(m_rhs[from], new_cost + m_g[to]);
+        }
+        else if (m_rhs[from] == old_cost + m_g[to]) {
+            m_rhs[from] = ComputeRhs(from);
+        }
+        UpdateVertex(from);
+    }
+
+    void IncrementalSearch::ComputeShortestPath()
+    {
+        while (!m_open.empty()) {
+            const auto top = m_open.front();
+            if (!(top.key < CalculateKey(m_start_id)) && m_rhs[m_start_id] == m_g[m_start_id]) break;
+
+            const auto u = top.id;
+            const auto key = CalculateKey(u);
+            if (top.key < key) {
+                // Queued before the start moved
+                OpenPush(u, key);
+                continue;
+            }
+            m_expanded++;
+            if (m_g[u] > m_rhs[u]) {
+                m_g[u] = m_rhs[u];
+                OpenRemove(u);
+                ForEachPredecessor(u, [&](PointId p, float cost) {
+                    if (p != m_goal_id) m_rhs[p] = std::min(m_rhs[p], cost + m_g[u]);
+                    UpdateVertex(p);
+                });
+            }
+            else {
+                const float g_old = m_g[u];
+                m_g[u] = INFINITY;
+                ForEachPredecessor(u, [&](PointId p, float cost) {
+                    if (p != m_goal_id && m_rhs[p] == cost + g_old) m_rhs[p] = ComputeRhs(p);
+                    UpdateVertex(p);
+                });
+                UpdateVertex(u);
+            }
+        }
+    }
+
+    Error IncrementalSearch::ExtractPath(PathResult& out)
+    {
+        if (m_rhs[m_start_id] == INFINITY) return Error::FailedToFinializePath;
+
+        // Follow the cheapest successor from the start; g is exact along the way once the search has settled.
+        // Points can coincide, so on ties prefer the successor closer to the goal, or zero length edges could loop.
+        PointId current = m_start_id;
+        float total = 0.f;
+        int count = 0;
+        while (current != m_goal_id) {
+            if (count++ > 256) return Error::BuildPathLengthExceeded;
+            float best = INFINITY, best_cost = 0.f;
+            PointId next = current;
+            ForEachSuccessor(current, [&](PointId to, float cost) {
+                const float value = cost + m_g[to];
+                if (value < best || (value == best && m_g[to] < m_g[next])) {
+                    best = value;
+                    best_cost = cost;
+                    next = to;
+                }
+            });
+            if (best == INFINITY) return Error::FailedToFinializePath;
+            m_came_from[next] = current;
+            total += best_cost;
+            current = next;
+        }
+
+        out.cost = total;
+        const auto res = m_graph.BuildPath(m_start, m_goal, m_came_from, out);
+        if (res == Error::OK) {
+            // Keep the caller's requested height layer info for the end points
+            out.points.front() = m_start_on_map;
+            out.points.back() = m_goal_on_map;
+        }
+        return res;
+    }
+
+    Error IncrementalSearch::Plan(const MapPos& start_pos, const MapPos& goal_pos, const BlockedPlaneBitset& blocked_planes, PathResult& out)
+    {
+        out = {};
+        m_expanded = 0;
+        if (!m_graph.IsReady()) return Error::FailedToFinializePath;
+        if (m_in_offsets.empty()) BuildReverseEdges();
+
+        const bool new_tree = !m_has_goal || !(goal_pos == m_goal_pos) || IsLargeChange(blocked_planes);
+        if (new_tree) {
+            if (!SetGoal(goal_pos)) {
+                m_has_goal = false;
+                return Error::FailedToFindGoalPathingTrapezoid;
+            }
+        }
+        SetBlockedPlanes(blocked_planes);
+        if (!m_has_start || !(start_pos == m_start_pos)) {
+            if (!SetStart(start_pos)) {
+                if (new_tree) m_has_goal = false;
+                return Error::FailedToFindStartPathingTrapezoid;
+            }
+        }
+        // The goal is queued once the start is known, so its key uses the right heuristic
+        if (new_tree) UpdateVertex(m_goal_id);
+
+        // Check if points have a direct line of sight
+        if (m_direct && (*m_direct & m_blocked_planes).none()) {
+            out.points = {m_start_on_map, m_goal_on_map};
+            out.cost = GetDistance(m_start.pos, m_goal.pos);
+            return Error::OK;
+        }
+
+        ComputeShortestPath();
+        return ExtractPath(out);
+    }
+
+    void IncrementalSearch::OpenPush(PointId id, const Key& key)
+    {
+        auto i = m_open_index[id];
+        if (i == INVALID_INDEX) {
+            i = static_cast<uint32_t>(m_open.size());
+            m_open.push_back({key, id});
+            m_open_index[id] = i;
+            OpenSiftUp(i);
+            return;
+        }
+        const bool decreased = key < m_open[i].key;
+        m_open[i].key = key;
+        if (decreased) {
+            OpenSiftUp(i);
+        }
+        else {
+            OpenSiftDown(i);
+        }
+    }
+
+    void IncrementalSearch::OpenRemove(PointId id)
+    {
+        const auto i = m_open_index[id];
+        if (i == INVALID_INDEX) return;
+        const auto last = m_open.size() - 1;
+        if (i != last) OpenSwap(i, last);
+        m_open.pop_back();
+        m_open_index[id] = INVALID_INDEX;
+        if (i < m_open.size()) {
+            const auto moved = m_open[i].id;
+            OpenSiftUp(i);
+            OpenSiftDown(m_open_index[moved]);
+        }
+    }
+
+    void IncrementalSearch::OpenSiftUp(size_t i)
+    {
+        while (i) {
+            const size_t parent = (i - 1) / 2;
+            if (!(m_open[i].key < m_open[parent].key)) break;
+            OpenSwap(i, parent);
+            i = parent;
+        }
+    }
+
+    void IncrementalSearch::OpenSiftDown(size_t i)
+    {
+        for (;;) {
+            const size_t left = i * 2 + 1, right = left + 1;
+            size_t smallest = i;
+            if (left < m_open.size() && m_open[left].key < m_open[smallest].key) smallest = left;
+            if (right < m_open.size() && m_open[right].key < m_open[smallest].key) smallest = right;
+            if (smallest == i) return;
+            OpenSwap(i, smallest);
+            i = smallest;
+        }
+    }
+
+    void IncrementalSearch::OpenSwap(size_t a, size_t b)
+    {
+        std::swap(m_open[a], m_open[b]);
+        m_open_index[m_open[a].id] = static_cast<uint32_t>(a);
+        m_open_index[m_open[b].id] = static_cast<uint32_t>(b);
+    }
+} // namespace Pathing
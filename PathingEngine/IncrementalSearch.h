@@ -0,0 +1,117 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "VisGraph.h"
+
+// =============================================================================
+// IncrementalSearch
+//
+// Repeated searches towards one goal on a built VisGraph, keeping the search
+// tree between calls (D* Lite: the search runs backwards from the goal, so
+// the start can move freely). When the start moves or blocked planes toggle,
+// Plan() only repairs the part of the tree affected by the change instead of
+// searching from scratch. A new goal, or blocked planes changing a large part
+// of the graph, starts a new tree.
+//
+// Finds shortest paths, so costs match VisGraph::Search on maps without
+// teleports. Not thread safe; use one per consumer. The graph must be built
+// before the first Plan() and outlive this object.
+// =============================================================================
+
+namespace Pathing {
+    class IncrementalSearch {
+    public:
+        explicit IncrementalSearch(const VisGraph& graph);
+
+        Error Plan(const MapPos& start_pos, const MapPos& goal_pos, const BlockedPlaneBitset& blocked_planes, PathResult& out);
+        // Drops the search tree; the next Plan() searches from scratch.
+        void Reset();
+
+        // Nodes expanded by the last Plan()
+        size_t GetExpandedCount() const { return m_expanded; }
+
+    private:
+        using QueryPoint = VisGraph::QueryPoint;
+        using VisElement = VisGraph::VisElement;
+
+        struct InEdge {
+            float distance;
+            PointId from;
+            uint16_t blocked_planes; // index into the graph's blocked plane masks
+        };
+
+        struct Key {
+            float k1, k2;
+            bool operator<(const Key& o) const { return k1 < o.k1 || (k1 == o.k1 && k2 < o.k2); }
+        };
+
+        struct OpenEntry {
+            Key key;
+            PointId id;
+        };
+
+        void BuildReverseEdges();
+        bool SetGoal(const MapPos& goal_pos);
+        bool SetStart(const MapPos& start_pos);
+        void SetBlockedPlanes(const BlockedPlaneBitset& blocked_planes);
+        bool IsLargeChange(const BlockedPlaneBitset& blocked_planes) const;
+        void ComputeShortestPath();
+        Error ExtractPath(PathResult& out);
+
+        const Vec2f& Position(PointId id) const;
+        float Heuristic(PointId id) const;
+        Key CalculateKey(PointId id) const;
+        float ComputeRhs(PointId id) const;
+        void UpdateVertex(PointId id);
+        void EdgeChanged(PointId from, PointId to, float old_cost, float new_cost);
+        template <typename F>
+        void ForEachSuccessor(PointId id, F&& f) const;
+        template <typename F>
+        void ForEachPredecessor(PointId id, F&& f) const;
+
+        // Open list: binary heap with a position index, so entries can be updated and removed
+        void OpenPush(PointId id, const Key& key);
+        void OpenRemove(PointId id);
+        void OpenSiftUp(size_t i);
+        void OpenSiftDown(size_t i);
+        void OpenSwap(size_t a, size_t b);
+
+        const VisGraph& m_graph;
+        PointId m_start_id = 0; // query points get the ids after the last point of the graph
+        PointId m_goal_id = 0;
+        bool m_use_heuristic = true; // teleports make straight line distance overestimate
+
+        // Graph edges reversed; built on the first Plan()
+        std::vector<uint32_t> m_in_offsets;
+        std::vector<InEdge> m_in_edges;
+        std::vector<uint32_t> m_mask_edge_count; // graph edges per blocked plane mask
+
+        bool m_has_goal = false;
+        MapPos m_goal_pos;    // as requested
+        MapPos m_goal_on_map; // moved onto the closest trapezoid
+        QueryPoint m_goal{};
+        std::vector<VisElement> m_goal_edges; // edges into the goal
+        std::vector<uint32_t> m_goal_edge_index;
+
+        bool m_has_start = false;
+        MapPos m_start_pos;
+        MapPos m_start_on_map;
+        QueryPoint m_start{};
+        std::vector<VisElement> m_start_edges;
+        std::vector<uint32_t> m_start_edge_index;
+        std::optional<BlockedPlaneBitset> m_direct; // direct line of sight between start and goal
+
+        BlockedPlaneBitset m_blocked_planes;
+        std::vector<uint8_t> m_mask_blocked; // per blocked plane mask of the graph
+
+        std::vector<float> m_g;
+        std::vector<float> m_rhs;
+        float m_km = 0.f;
+        std::vector<OpenEntry> m_open;
+        std::vector<uint32_t> m_open_index; // PointId -> position in m_open
+        std::vector<PointId> m_came_from;
+        size_t m_expanded = 0;
+    };
+} // namespace Pathing
@@ -0,0 +1,232 @@
+#include "stdafx.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "BinaryStream.h"
+#include "MapPack.h"
+#include "PathingMapBinary.h"
+#include "PathingMapDataParser.h"
+
+namespace {
+    using namespace Pathing;
+    using detail::Writer;
+    using detail::WriteFileReplacing;
+
+    // Bump when the layout of the pack changes; the maps in it carry their own version.
+    constexpr uint32_t PACK_VERSION = 2;
+    constexpr char PACK_MAGIC[4] = {'G', 'W', 'M', 'P'};
+    // Raw map files read ahead per parsing thread; bounds memory use when the reads are faster than the parsing
+    constexpr size_t READ_AHEAD_PER_THREAD = 2;
+
+    struct MapPackHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t layout; // sizes of the raw structs, catches ABI differences
+        uint32_t map_count;
+    };
+
+    struct MapPackEntry {
+        uint32_t map_file_id;
+        uint32_t reserved;
+        uint64_t offset; // from the start of the file, 8 byte aligned
+        uint64_t size;
+    };
+    static_assert(sizeof(MapPackHeader) == 16 && sizeof(MapPackEntry) == 24);
+
+    // maps: (map file id, binary map), any order; the first of duplicate ids is kept
+    bool WritePack(const std::filesystem::path& path, std::vector<std::pair<uint32_t, std::vector<uint8_t>>>& maps, uint64_t* bytes_written)
+    {
+        std::ranges::stable_sort(maps, {}, [](const auto& m) { return m.first; });
+        const auto [first, last] = std::ranges::unique(maps, {}, [](const auto& m) { return m.first; });
+        maps.erase(first, last);
+
+        MapPackHeader header{};
+        memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+        header.version = PACK_VERSION;
+        header.layout = sizeof(MapPackEntry);
+        header.map_count = static_cast<uint32_t>(maps.size());
+
+        std::vector<MapPackEntry> entries(maps.size());
+        Writer body;
+        uint64_t offset = sizeof(header) + entries.size() * sizeof(MapPackEntry);
+        for (size_t i = 0; i < maps.size(); ++i) {
+            const auto& bytes = maps[i].second;
+            // Binary maps are a multiple of 8 bytes long, so every map stays aligned for use in place
+            entries[i] = {maps[i].first, 0, offset, bytes.size()};
+            body.buffer.insert(body.buffer.end(), bytes.begin(), bytes.end());
+            offset += bytes.size();
+        }
+
+        const auto header_bytes = std::span(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+        const auto entry_bytes = std::span(reinterpret_cast<const uint8_t*>(entries.data()), entries.size() * sizeof(MapPackEntry));
+        if (!WriteFileReplacing(path, {header_bytes, entry_bytes, body.buffer})) return false;
+        if (bytes_written) *bytes_written = offset;
+        return true;
+    }
+} // namespace
+
+namespace Pathing {
+    bool WriteMapPack(const std::filesystem::path& path, std::span<const PathingMapData> maps)
+    {
+        std::vector<std::pair<uint32_t, std::vector<uint8_t>>> encoded;
+        encoded.reserve(maps.size());
+        for (const auto& map : maps) {
+            encoded.emplace_back(map.map_file_id, EncodeBinaryMap(map));
+        }
+        return WritePack(path, encoded, nullptr);
+    }
+
+    bool BuildMapPack(const std::filesystem::path& path, std::span<const uint32_t> map_file_ids, const MapFileReader& read, uint32_t thread_count, MapPackStats* stats,
+                      const std::function<bool()>& stop)
+    {
+        std::vector<uint32_t> ids(map_file_ids.begin(), map_file_ids.end());
+        std::ranges::sort(ids);
+        const auto [first, last] = std::ranges::unique(ids);
+        ids.erase(first, last);
+
+        if (!thread_count) thread_count = std::max(1u, std::thread::hardware_concurrency());
+        thread_count = std::min<uint32_t>(thread_count, std::max<size_t>(1, ids.size()));
+
+        MapPackStats result;
+        std::vector<std::vector<uint8_t>> encoded(ids.size());
+        std::atomic<uint32_t> without_pathing = 0;
+
+        // Reading and parsing overlap: this thread queues raw files, the workers parse them
+        std::mutex mutex;
+        std::condition_variable has_work, has_space;
+        std::deque<std::pair<size_t, std::vector<uint8_t>>> queue;
+        bool reading_done = false;
+        const size_t capacity = thread_count * READ_AHEAD_PER_THREAD;
+
+        const auto worker = [&] {
+            for (;;) {
+                std::unique_lock lock(mutex);
+                has_work.wait(lock, [&] { return !queue.empty() || reading_done; });
+                if (queue.empty()) return;
+                auto [index, bytes] = std::move(queue.front());
+                queue.pop_front();
+                lock.unlock();
+                has_space.notify_one();
+
+                PathingMapData map;
+                if (LoadPathingMapDataFromFFNA(bytes.data(), bytes.size(), ids[index], &map)) {
+                    encoded[index] = EncodeBinaryMap(map);
+                }
+                else {
+                    without_pathing++;
+                }
+            }
+        };
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count);
+        for (uint32_t i = 0; i < thread_count; ++i) {
+            threads.emplace_back(worker);
+        }
+
+        bool stopped = false;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (stop && stop()) {
+                stopped = true;
+                break;
+            }
+            std::vector<uint8_t> bytes;
+            if (!read(ids[i], bytes)) {
+                result.unreadable++;
+                continue;
+            }
+            result.bytes_read += bytes.size();
+            std::unique_lock lock(mutex);
+            has_space.wait(lock, [&] { return queue.size() < capacity; });
+            queue.emplace_back(i, std::move(bytes));
+            lock.unlock();
+            has_work.notify_one();
+        }
+        {
+            std::lock_guard lock(mutex);
+            reading_done = true;
+            // Nothing queued is needed any more
+            if (stopped) queue.clear();
+        }
+        has_work.notify_all();
+        for (auto& t : threads) {
+            t.join();
+        }
+        if (stopped) return false;
+
+        std::vector<std::pair<uint32_t, std::vector<uint8_t>>> maps;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (!encoded[i].empty()) maps.emplace_back(ids[i], std::move(encoded[i]));
+        }
+        result.maps = static_cast<uint32_t>(maps.size());
+        result.without_pathing = without_pathing;
+        const bool ok = WritePack(path, maps, &result.bytes_written);
+        if (stats) *stats = result;
+        return ok;
+    }
+
+    bool MapPack::Open(const std::filesystem::path& path)
+    {
+        Close();
+        if (!m_file.Open(path)) return false;
+
+        const auto valid = [&] {
+            MapPackHeader header;
+            if (m_file.size() < sizeof(header)) return false;
+            memcpy(&header, m_file.data(), sizeof(header));
+            if (memcmp(header.magic, PACK_MAGIC, sizeof(header.magic)) != 0) return false;
+            if (header.version != PACK_VERSION || header.layout != sizeof(MapPackEntry)) return false;
+            if (sizeof(header) + static_cast<uint64_t>(header.map_count) * sizeof(MapPackEntry) > m_file.size()) return false;
+
+            std::vector<MapPackEntry> entries(header.map_count);
+            memcpy(entries.data(), m_file.data() + sizeof(header), entries.size() * sizeof(MapPackEntry));
+            for (size_t i = 0; i < entries.size(); ++i) {
+                const auto& e = entries[i];
+                if (i && e.map_file_id <= entries[i - 1].map_file_id) return false;
+                if (e.offset % 8 != 0 || e.offset > m_file.size() || e.size > m_file.size() - e.offset) return false;
+                m_map_file_ids.push_back(e.map_file_id);
+                m_locations.push_back({e.offset, e.size});
+            }
+            return true;
+        };
+        if (!valid()) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void MapPack::Close()
+    {
+        m_file.Close();
+        m_map_file_ids.clear();
+        m_locations.clear();
+    }
+
+    bool MapPack::Contains(uint32_t map_file_id) const
+    {
+        return std::ranges::binary_search(m_map_file_ids, map_file_id);
+    }
+
+    bool MapPack::GetView(uint32_t map_file_id, PathingMapView& out, bool verify_checksum) const
+    {
+        out.Reset();
+        const auto found = std::ranges::lower_bound(m_map_file_ids, map_file_id);
+        if (found == m_map_file_ids.end() || *found != map_file_id) return false;
+        const auto& location = m_locations[found - m_map_file_ids.begin()];
+        if (!out.Attach(m_file.data() + location.offset, static_cast<size_t>(location.size), verify_checksum) || out.GetMapFileId() != map_file_id) {
+            out.Reset();
+            return false;
+        }
+        return true;
+    }
+
+    bool MapPack::Load(uint32_t map_file_id, PathingMapData& out) const
+    {
+        PathingMapView view;
+        if (!GetView(map_file_id, view)) return false;
+        out = view.ToMapData();
+        return true;
+    }
+} // namespace Pathing
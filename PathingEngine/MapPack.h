@@ -0,0 +1,73 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "MappedFile.h"
+#include "PathingMapBinary.h"
+
+// =============================================================================
+// MapPack
+//
+// Pathing data of many maps in one file. An index of map file ids at the
+// front gives the offset of each map, so loading one map is a lookup and a
+// single read of its bytes; offline tools can go over the whole game at once.
+//
+// File layout: MapPackHeader, map_count MapPackEntry sorted by map file id,
+// then the maps in the format of PathingMapBinary.h, 8 byte aligned so they
+// can be viewed in place. Each map has its own checksum, so a damaged map
+// doesn't take the rest of the pack with it.
+// =============================================================================
+
+namespace Pathing {
+    // Reads the raw FFNA map file of a map file id; false if there is no such map
+    using MapFileReader = std::function<bool(uint32_t map_file_id, std::vector<uint8_t>& out)>;
+
+    struct MapPackStats {
+        uint32_t maps = 0;           // written to the pack
+        uint32_t unreadable = 0;     // MapFileReader failed
+        uint32_t without_pathing = 0; // read, but no pathing data in it
+        uint64_t bytes_read = 0;
+        uint64_t bytes_written = 0;
+    };
+
+    // Writes the given maps to a pack at path, replacing it
+    bool WriteMapPack(const std::filesystem::path& path, std::span<const PathingMapData> maps);
+
+    // Reads the map files one at a time on the calling thread (DAT access isn't assumed to be thread safe) and
+    // parses them on thread_count threads (0 = one per core) while the next ones are read. Duplicate ids are skipped.
+    // Files without pathing data are skipped, not an error; false only if the pack can't be written.
+    // stop is asked before each read; once it returns true nothing more is read, nothing is written and false is returned.
+    bool BuildMapPack(const std::filesystem::path& path, std::span<const uint32_t> map_file_ids, const MapFileReader& read, uint32_t thread_count = 0, MapPackStats* stats = nullptr,
+                      const std::function<bool()>& stop = nullptr);
+
+    class MapPack {
+    public:
+        // Maps the file and reads the index; false if it's missing or not a map pack of this version
+        bool Open(const std::filesystem::path& path);
+        void Close();
+        bool IsOpen() const { return m_file.data() != nullptr; }
+
+        size_t GetMapCount() const { return m_map_file_ids.size(); }
+        // Ascending
+        const std::vector<uint32_t>& GetMapFileIds() const { return m_map_file_ids; }
+        bool Contains(uint32_t map_file_id) const;
+
+        // False if the map isn't in the pack or its data is damaged. Thread safe.
+        bool Load(uint32_t map_file_id, PathingMapData& out) const;
+        // As Load, without copying; the view is valid while the pack is open
+        bool GetView(uint32_t map_file_id, PathingMapView& out, bool verify_checksum = true) const;
+
+    private:
+        struct Location {
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        MappedFile m_file;
+        std::vector<uint32_t> m_map_file_ids;
+        std::vector<Location> m_locations; // same order as m_map_file_ids
+    };
+} // namespace Pathing
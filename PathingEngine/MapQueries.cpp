@@ -0,0 +1,113 @@
+#include "stdafx.h"
+
+#include "MapQueries.h"
+
+namespace Pathing {
+    bool IsOnTrapezoid(const Trapezoid& t, const Vec2f& p)
+    {
+        if (t.YT < p.y || t.YB > p.y) return false;
+        if (t.XBL > p.x && t.XTL > p.x) return false;
+        if (t.XBR < p.x && t.XTR < p.x) return false;
+        const Vec2f a{t.XTL, t.YT}, b{t.XBL, t.YB}, c{t.XBR, t.YB}, d{t.XTR, t.YT};
+        const Vec2f ab = b - a, cd = d - c;
+        const Vec2f pa = p - a, pc = p - c;
+        constexpr float tolerance = -1.0f;
+        if (Cross(ab, pa) < tolerance) return false;
+        if (Cross(cd, pc) < tolerance) return false;
+        return true;
+    }
+
+    float GetDistanceFromLine(const Vec2f& a1, const Vec2f& a2, const Vec2f& p)
+    {
+        const auto ba = a2 - a1, pa = p - a1;
+        const float len = Dot(ba, ba);
+        // Degenerate edge (e.g. the top of a triangle shaped trapezoid)
+        const float h = len > 0.f ? std::clamp(Dot(pa, ba) / len, 0.0f, 1.0f) : 0.f;
+        const auto q = pa - h * ba;
+        return sqrtf(Dot(q, q));
+    }
+
+    float GetDistanceFromTrapezoid(const Trapezoid& t, const Vec2f& p, uint32_t* closest_edge)
+    {
+        const Vec2f corners[] = {{t.XTL, t.YT}, {t.XTR, t.YT}, {t.XBR, t.YB}, {t.XBL, t.YB}};
+        float closest = GetDistanceFromLine(corners[0], corners[1], p);
+        uint32_t edge = 0;
+        for (uint32_t i = 1; i < 4; ++i) {
+            const float d = GetDistanceFromLine(corners[i], corners[(i + 1) % 4], p);
+            if (d < closest) {
+                closest = d;
+                edge = i;
+            }
+        }
+        if (closest_edge) *closest_edge = edge;
+        return closest;
+    }
+
+    Vec2f ProjectOntoTrapezoidEdge(const Trapezoid& t, uint32_t edge, const Vec2f& p)
+    {
+        const Vec2f corners[] = {{t.XTL, t.YT}, {t.XTR, t.YT}, {t.XBR, t.YB}, {t.XBL, t.YB}};
+        const auto p0 = corners[edge % 4], p1 = corners[(edge + 1) % 4];
+        const auto ba = p1 - p0, pa = p - p0;
+        const float len = Dot(ba, ba);
+        const float h = len > 0.f ? std::clamp(Dot(pa, ba) / len, 0.0f, 1.0f) : 0.f;
+        return p0 + h * ba;
+    }
+
+    TrapezoidRef FindTrapezoid(const PathingMapData& map, const MapPos& pos)
+    {
+        const Vec2f p = ToVec2f(pos);
+        const auto find_on_plane = [&](uint32_t plane) -> TrapezoidRef {
+            const auto& trapezoids = map.planes[plane].trapezoids;
+            for (uint32_t i = 0; i < trapezoids.size(); ++i) {
+                if (IsOnTrapezoid(trapezoids[i], p)) return {plane, i};
+            }
+            return {};
+        };
+
+        const auto plane_count = static_cast<uint32_t>(map.planes.size());
+        if (pos.zplane < plane_count) {
+            const auto found = find_on_plane(pos.zplane);
+            if (found.IsValid()) return found;
+        }
+        for (uint32_t plane = 0; plane < plane_count; ++plane) {
+            if (plane == pos.zplane) continue;
+            const auto found = find_on_plane(plane);
+            if (found.IsValid()) return found;
+        }
+        return {};
+    }
+
+    TrapezoidRef FindClosestPositionOnTrapezoid(const PathingMapData& map, MapPos& pos)
+    {
+        auto found = FindTrapezoid(map, pos);
+        if (found.IsValid()) {
+            pos.zplane = found.plane;
+            return found;
+        }
+
+        const Vec2f p = ToVec2f(pos);
+        float closest_dist = std::numeric_limits<float>::infinity();
+        uint32_t closest_edge = 0;
+        for (uint32_t z = 0; z < map.planes.size(); ++z) {
+            const auto& trapezoids = map.planes[z].trapezoids;
+            for (uint32_t i = 0; i < trapezoids.size(); ++i) {
+                uint32_t edge;
+                const float d = GetDistanceFromTrapezoid(trapezoids[i], p, &edge);
+                if (closest_dist > d) {
+                    closest_dist = d;
+                    closest_edge = edge;
+                    found = {z, i};
+                }
+            }
+        }
+        if (!found.IsValid()) return found;
+
+        // Located outside pathing trapezoids. Project onto the closest edge of the closest trapezoid.
+        const auto projected = ProjectOntoTrapezoidEdge(map.planes[found.plane].trapezoids[found.index], closest_edge, p);
+        pos.x = projected.x;
+        pos.y = projected.y;
+        pos.zplane = found.plane;
+
+        return found;
+    }
+} // namespace Pathing
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "PathingTypes.h"
+
+// =============================================================================
+// Point location on PathingMapData
+//
+// Trapezoids are addressed by (plane, index) into PathingMapData::planes.
+// =============================================================================
+
+namespace Pathing {
+    struct TrapezoidRef {
+        uint32_t plane = INVALID_INDEX;
+        uint32_t index = INVALID_INDEX;
+
+        bool IsValid() const { return plane != INVALID_INDEX && index != INVALID_INDEX; }
+    };
+
+    // Same tolerance as the game side check; points slightly outside an edge still count as inside.
+    bool IsOnTrapezoid(const Trapezoid& t, const Vec2f& p);
+
+    float GetDistanceFromLine(const Vec2f& a1, const Vec2f& a2, const Vec2f& p);
+
+    // Shortest distance from p to any of the four edges of the trapezoid.
+    // closest_edge receives the edge it was measured to: 0 top, 1 right, 2 bottom, 3 left (first one on ties).
+    float GetDistanceFromTrapezoid(const Trapezoid& t, const Vec2f& p, uint32_t* closest_edge = nullptr);
+
+    // Closest point to p on the given edge of the trapezoid (same numbering as GetDistanceFromTrapezoid)
+    Vec2f ProjectOntoTrapezoidEdge(const Trapezoid& t, uint32_t edge, const Vec2f& p);
+
+    // Linear scans over every trapezoid; see TrapezoidGrid for the indexed versions used by VisGraph.
+
+    // Returns the trapezoid containing pos, checking pos.zplane first.
+    TrapezoidRef FindTrapezoid(const PathingMapData& map, const MapPos& pos);
+
+    // Like FindTrapezoid, but if pos isn't on any trapezoid it is moved onto the closest edge of the closest one.
+    // pos.zplane is updated to the plane of the returned trapezoid.
+    TrapezoidRef FindClosestPositionOnTrapezoid(const PathingMapData& map, MapPos& pos);
+} // namespace Pathing
@@ -0,0 +1,177 @@
+#include "stdafx.h"
+
+#include "BinaryStream.h"
+#include "PathCache.h"
+
+namespace {
+    using namespace Pathing;
+
+    // Waypoints of path, other than its start and goal, that an end point can see.
+    // Graph points don't keep their id in a PathResult, so they are matched by position.
+    std::vector<uint8_t> GetVisibleWaypoints(const PathResult& path, const std::vector<VisGraph::VisElement>& visible, const std::vector<VisGraph::Point>& graph_points, const BlockedPlaneBitset& blocked_planes)
+    {
+        std::vector<uint8_t> out(path.points.size(), 0);
+        for (const auto& vis : visible) {
+            if ((vis.blocked_planes & blocked_planes).any()) continue;
+            const auto& pos = graph_points[vis.point_id].pos;
+            for (size_t i = 1; i + 1 < path.points.size(); ++i) {
+                if (ToVec2f(path.points[i]) == pos) out[i] = 1;
+            }
+        }
+        return out;
+    }
+} // namespace
+
+namespace Pathing {
+    PathCache::PathCache(const VisGraph& graph, size_t capacity, float cell_size)
+        : m_graph(graph), m_capacity(std::max<size_t>(1, capacity)), m_cell_size(cell_size) {}
+
+    uint64_t PathCache::GetKey(const MapPos& goal_pos) const
+    {
+        const auto cell = [this](float v) { return static_cast<int32_t>(std::floor(v / m_cell_size)); };
+        const int32_t cells[] = {cell(goal_pos.x), cell(goal_pos.y), static_cast<int32_t>(goal_pos.zplane)};
+        return detail::Hash64(cells, sizeof(cells));
+    }
+
+    // The entry towards the goal cell with the closest start, if that is within a cell. Planes aren't compared;
+    // walking over a plane boundary is a small move too, and Reattach() checks the new start can see the path.
+    std::list<PathCache::Entry>::iterator PathCache::FindEntry(uint64_t key, const MapPos& start_pos)
+    {
+        auto best = m_entries.end();
+        float best_distance = m_cell_size;
+        const auto [first, last] = m_index.equal_range(key);
+        for (auto it = first; it != last; ++it) {
+            const auto& entry = *it->second;
+            const float distance = GetDistance(ToVec2f(entry.start), ToVec2f(start_pos));
+            if (distance <= best_distance) {
+                best_distance = distance;
+                best = it->second;
+            }
+        }
+        return best;
+    }
+
+    bool PathCache::SetBlockedPlanes(const BlockedPlaneBitset& blocked_planes)
+    {
+        if (blocked_planes == m_blocked_planes) return false;
+        if (!m_entries.empty()) m_stats.invalidations++;
+        Clear();
+        m_blocked_planes = blocked_planes;
+        return true;
+    }
+
+    void PathCache::Clear()
+    {
+        m_entries.clear();
+        m_index.clear();
+    }
+
+    bool PathCache::Find(const MapPos& start_pos, const MapPos& goal_pos, const BlockedPlaneBitset& blocked_planes, PathResult& out)
+    {
+        SetBlockedPlanes(blocked_planes);
+        const auto entry = FindEntry(GetKey(goal_pos), start_pos);
+        if (entry == m_entries.end()) {
+            m_stats.misses++;
+            return false;
+        }
+        m_entries.splice(m_entries.begin(), m_entries, entry);
+        if (entry->start == start_pos && entry->goal == goal_pos) {
+            m_stats.hits++;
+            out = entry->path;
+            return true;
+        }
+
+        PathResult reattached;
+        if (!Reattach(entry->path, start_pos, goal_pos, !(entry->goal == goal_pos), blocked_planes, reattached)) {
+            m_stats.misses++;
+            return false;
+        }
+        m_stats.reattached++;
+        // The next small move starts from here
+        entry->start = start_pos;
+        entry->goal = goal_pos;
+        entry->path = reattached;
+        out = std::move(reattached);
+        return true;
+    }
+
+    void PathCache::Insert(const MapPos& start_pos, const MapPos& goal_pos, const BlockedPlaneBitset& blocked_planes, const PathResult& path)
+    {
+        SetBlockedPlanes(blocked_planes);
+        if (path.points.size() < 2) return;
+        const auto key = GetKey(goal_pos);
+        if (const auto found = FindEntry(key, start_pos); found != m_entries.end()) {
+            Erase(found);
+        }
+        m_entries.push_front({key, start_pos, goal_pos, path});
+        m_index.emplace(key, m_entries.begin());
+        if (m_entries.size() > m_capacity) {
+            Erase(std::prev(m_entries.end()));
+        }
+    }
+
+    void PathCache::Erase(std::list<Entry>::iterator entry)
+    {
+        const auto [first, last] = m_index.equal_range(entry->key);
+        for (auto it = first; it != last; ++it) {
+            if (it->second == entry) {
+                m_index.erase(it);
+                break;
+            }
+        }
+        m_entries.erase(entry);
+    }
+
+    // New path: start -> the furthest waypoint the start sees ... the first waypoint from there that the goal sees -> goal
+    bool PathCache::Reattach(const PathResult& path, const MapPos& _start_pos, const MapPos& _goal_pos, bool goal_moved, const BlockedPlaneBitset& blocked_planes, PathResult& out) const
+    {
+        const auto& g = m_graph;
+        const auto point_count = g.points.size();
+        auto start_pos = _start_pos;
+        auto goal_pos = _goal_pos;
+        QueryPoint start, goal;
+        if (!g.LocateQueryPoint(start_pos, static_cast<PointId>(point_count), start)) return false;
+        if (!g.LocateQueryPoint(goal_pos, static_cast<PointId>(point_count + 1), goal)) return false;
+
+        std::vector<VisElement> start_edges, goal_edges;
+        std::optional<BlockedPlaneBitset> direct;
+        g.QueryPointVisibility(start, {&goal, 1}, start_edges, {&direct, 1});
+        // Only the start moved: the last waypoint still sees the goal, since the planes are the same
+        const bool walk_goal = goal_moved || path.points.size() == 2;
+        if (walk_goal) {
+            std::optional<BlockedPlaneBitset> direct_from_goal;
+            g.QueryPointVisibility(goal, {&start, 1}, goal_edges, {&direct_from_goal, 1});
+            if (!direct) direct = direct_from_goal;
+        }
+
+        out.points.clear();
+        if (direct && (*direct & blocked_planes).none()) {
+            out.points = {start_pos, goal_pos};
+        }
+        else {
+            const auto from_start = GetVisibleWaypoints(path, start_edges, g.points, blocked_planes);
+            size_t first = path.points.size() - 2;
+            while (first > 0 && !from_start[first]) first--;
+            if (first == 0) return false;
+
+            size_t last = path.points.size() - 2;
+            if (walk_goal) {
+                const auto from_goal = GetVisibleWaypoints(path, goal_edges, g.points, blocked_planes);
+                last = first;
+                while (last + 1 < path.points.size() - 1 && !from_goal[last]) last++;
+                if (!from_goal[last]) return false;
+            }
+
+            out.points.reserve(last - first + 3);
+            out.points.push_back(start_pos);
+            out.points.insert(out.points.end(), path.points.begin() + first, path.points.begin() + last + 1);
+            out.points.push_back(goal_pos);
+        }
+
+        out.cost = 0.f;
+        for (size_t i = 1; i < out.points.size(); ++i) {
+            out.cost += GetDistance(ToVec2f(out.points[i - 1]), ToVec2f(out.points[i]));
+        }
+        return true;
+    }
+} // namespace Pathing
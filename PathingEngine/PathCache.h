@@ -0,0 +1,74 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+
+#include "VisGraph.h"
+
+// =============================================================================
+// PathCache
+//
+// Recent search results on a built VisGraph, most recently used first.
+// Entries are found by the goal position rounded to a grid of cell_size
+// units on its plane, then by the closest stored start within cell_size, so
+// a player walking towards the same target keeps hitting the same entry:
+//   - same start and goal: the stored path is returned as is
+//   - start or goal moved a little: the new end is re-attached to the
+//     furthest waypoint of the stored path it can see, using the graph's own
+//     visibility walk, and the entry is updated to the new path
+// Re-attached paths follow the stored one, so they can be slightly longer
+// than a fresh search.
+//
+// Entries are only valid for the blocked planes they were found with; a call
+// with different blocked planes drops all of them.
+//
+// Not thread safe. The graph must be built before the first call and outlive
+// this object.
+// =============================================================================
+
+namespace Pathing {
+    class PathCache {
+    public:
+        struct Stats {
+            size_t hits = 0;       // same start and goal
+            size_t reattached = 0; // start or goal moved a little
+            size_t misses = 0;
+            size_t invalidations = 0; // blocked planes changed
+        };
+
+        explicit PathCache(const VisGraph& graph, size_t capacity = 64, float cell_size = 256.f);
+
+        // True if out was answered from the cache
+        bool Find(const MapPos& start_pos, const MapPos& goal_pos, const BlockedPlaneBitset& blocked_planes, PathResult& out);
+        // Stores the result of a search; blocked_planes must be what it was searched with
+        void Insert(const MapPos& start_pos, const MapPos& goal_pos, const BlockedPlaneBitset& blocked_planes, const PathResult& path);
+        void Clear();
+
+        size_t GetSize() const { return m_entries.size(); }
+        const Stats& GetStats() const { return m_stats; }
+
+    private:
+        using QueryPoint = VisGraph::QueryPoint;
+        using VisElement = VisGraph::VisElement;
+
+        struct Entry {
+            uint64_t key; // goal cell
+            MapPos start, goal; // as asked for
+            PathResult path;
+        };
+
+        uint64_t GetKey(const MapPos& goal_pos) const;
+        std::list<Entry>::iterator FindEntry(uint64_t key, const MapPos& start_pos);
+        void Erase(std::list<Entry>::iterator entry);
+        bool SetBlockedPlanes(const BlockedPlaneBitset& blocked_planes);
+        bool Reattach(const PathResult& path, const MapPos& start_pos, const MapPos& goal_pos, bool goal_moved, const BlockedPlaneBitset& blocked_planes, PathResult& out) const;
+
+        const VisGraph& m_graph;
+        const size_t m_capacity;
+        const float m_cell_size;
+        BlockedPlaneBitset m_blocked_planes;
+        std::list<Entry> m_entries; // most recently used first
+        std::unordered_multimap<uint64_t, std::list<Entry>::iterator> m_index; // by goal cell
+        Stats m_stats;
+    };
+} // namespace Pathing
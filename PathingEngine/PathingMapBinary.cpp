@@ -0,0 +1,225 @@
+#include "stdafx.h"
+
+#include <bit>
+
+#include "BinaryStream.h"
+#include "PathingMapBinary.h"
+
+namespace {
+    using namespace Pathing;
+    using detail::Hash64;
+    using detail::WriteFileReplacing;
+
+    static_assert(std::endian::native == std::endian::little, "binary maps are little-endian and used in place");
+
+    // Bump when the layout of the file changes.
+    constexpr uint32_t BINARY_MAP_VERSION = 1;
+    constexpr char BINARY_MAP_MAGIC[4] = {'G', 'W', 'P', 'M'};
+    constexpr size_t ARRAY_ALIGNMENT = 8;
+
+    struct BinaryMapHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t layout; // sizes of the raw structs, catches ABI differences
+        uint32_t map_file_id;
+        Vec2f bounds_min;
+        Vec2f bounds_max;
+        uint32_t plane_count;
+        uint32_t reserved;
+        uint64_t size;     // of the whole map, header included
+        uint64_t checksum; // of the whole map, with this field zero
+    };
+
+    struct BinaryPlaneEntry {
+        uint32_t zplane;
+        uint32_t trapezoid_count;
+        uint32_t portal_count;
+        uint32_t index_count;
+        uint64_t trapezoids_offset; // from the start of the header
+        uint64_t portals_offset;
+        uint64_t indices_offset;
+    };
+    static_assert(sizeof(BinaryMapHeader) == 56 && sizeof(BinaryPlaneEntry) == 40);
+    static_assert(std::is_trivially_copyable_v<Trapezoid> && std::is_trivially_copyable_v<Portal>);
+    static_assert(alignof(Trapezoid) <= ARRAY_ALIGNMENT && alignof(Portal) <= ARRAY_ALIGNMENT && alignof(BinaryPlaneEntry) <= ARRAY_ALIGNMENT);
+
+    uint32_t GetLayout()
+    {
+        return static_cast<uint32_t>(sizeof(Trapezoid) | sizeof(Portal) << 8 | sizeof(Vec2f) << 16);
+    }
+
+    size_t AlignUp(size_t offset)
+    {
+        return (offset + ARRAY_ALIGNMENT - 1) & ~(ARRAY_ALIGNMENT - 1);
+    }
+
+    uint64_t GetChecksum(const uint8_t* data, size_t size)
+    {
+        BinaryMapHeader header;
+        memcpy(&header, data, sizeof(header));
+        header.checksum = 0;
+        return Hash64(data + sizeof(header), size - sizeof(header), Hash64(&header, sizeof(header)));
+    }
+
+    // The array of count T at offset lies inside size bytes and is aligned for T
+    template <typename T>
+    bool IsValidArray(uint64_t offset, uint64_t count, size_t size)
+    {
+        return offset % alignof(T) == 0 && offset <= size && count <= (size - offset) / sizeof(T);
+    }
+} // namespace
+
+namespace Pathing {
+    std::vector<uint8_t> EncodeBinaryMap(const PathingMapData& map)
+    {
+        // Lay the arrays out first so the buffer is sized once
+        std::vector<BinaryPlaneEntry> entries(map.planes.size());
+        size_t offset = sizeof(BinaryMapHeader) + entries.size() * sizeof(BinaryPlaneEntry);
+        for (size_t i = 0; i < map.planes.size(); ++i) {
+            const auto& plane = map.planes[i];
+            auto& e = entries[i];
+            e.zplane = plane.zplane;
+            e.trapezoid_count = static_cast<uint32_t>(plane.trapezoids.size());
+            e.portal_count = static_cast<uint32_t>(plane.portals.size());
+            e.index_count = static_cast<uint32_t>(plane.portal_trapezoid_indices.size());
+            e.trapezoids_offset = offset = AlignUp(offset);
+            offset += plane.trapezoids.size() * sizeof(Trapezoid);
+            e.portals_offset = offset = AlignUp(offset);
+            offset += plane.portals.size() * sizeof(Portal);
+            e.indices_offset = offset = AlignUp(offset);
+            offset += plane.portal_trapezoid_indices.size() * sizeof(uint32_t);
+        }
+        // Zero filled, so padding inside and between the structs doesn't change the checksum
+        std::vector<uint8_t> out(AlignUp(offset), 0);
+
+        BinaryMapHeader header{};
+        memcpy(header.magic, BINARY_MAP_MAGIC, sizeof(header.magic));
+        header.version = BINARY_MAP_VERSION;
+        header.layout = GetLayout();
+        header.map_file_id = map.map_file_id;
+        header.bounds_min = map.bounds_min;
+        header.bounds_max = map.bounds_max;
+        header.plane_count = static_cast<uint32_t>(map.planes.size());
+        header.size = out.size();
+        memcpy(out.data(), &header, sizeof(header));
+        memcpy(out.data() + sizeof(header), entries.data(), entries.size() * sizeof(BinaryPlaneEntry));
+
+        for (size_t i = 0; i < map.planes.size(); ++i) {
+            const auto& plane = map.planes[i];
+            const auto& e = entries[i];
+            memcpy(out.data() + e.trapezoids_offset, plane.trapezoids.data(), plane.trapezoids.size() * sizeof(Trapezoid));
+            // Field by field; Portal has a padding byte
+            for (size_t j = 0; j < plane.portals.size(); ++j) {
+                const auto& p = plane.portals[j];
+                auto* dst = out.data() + e.portals_offset + j * sizeof(Portal);
+                memcpy(dst + offsetof(Portal, trapezoid_count), &p.trapezoid_count, sizeof(p.trapezoid_count));
+                memcpy(dst + offsetof(Portal, trapezoid_index_start), &p.trapezoid_index_start, sizeof(p.trapezoid_index_start));
+                memcpy(dst + offsetof(Portal, neighbor_plane), &p.neighbor_plane, sizeof(p.neighbor_plane));
+                memcpy(dst + offsetof(Portal, shared_id), &p.shared_id, sizeof(p.shared_id));
+                memcpy(dst + offsetof(Portal, flags), &p.flags, sizeof(p.flags));
+            }
+            memcpy(out.data() + e.indices_offset, plane.portal_trapezoid_indices.data(), plane.portal_trapezoid_indices.size() * sizeof(uint32_t));
+        }
+
+        const auto checksum = GetChecksum(out.data(), out.size());
+        memcpy(out.data() + offsetof(BinaryMapHeader, checksum), &checksum, sizeof(checksum));
+        return out;
+    }
+
+    bool WriteBinaryMap(const std::filesystem::path& path, const PathingMapData& map)
+    {
+        const auto bytes = EncodeBinaryMap(map);
+        return WriteFileReplacing(path, {bytes});
+    }
+
+    bool PathingMapView::Attach(const uint8_t* data, size_t size, bool verify_checksum)
+    {
+        Reset();
+        if (!data || reinterpret_cast<uintptr_t>(data) % ARRAY_ALIGNMENT != 0) return false;
+
+        BinaryMapHeader header;
+        if (size < sizeof(header)) return false;
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, BINARY_MAP_MAGIC, sizeof(header.magic)) != 0) return false;
+        if (header.version != BINARY_MAP_VERSION || header.layout != GetLayout()) return false;
+        // Trailing bytes are allowed, e.g. padding in a map pack
+        if (header.size < sizeof(header) || header.size > size) return false;
+        size = static_cast<size_t>(header.size);
+        if (!IsValidArray<BinaryPlaneEntry>(sizeof(header), header.plane_count, size)) return false;
+        if (verify_checksum && GetChecksum(data, size) != header.checksum) return false;
+
+        const auto* entries = reinterpret_cast<const BinaryPlaneEntry*>(data + sizeof(header));
+        std::vector<NavPlaneView> planes(header.plane_count);
+        for (size_t i = 0; i < planes.size(); ++i) {
+            const auto& e = entries[i];
+            if (!IsValidArray<Trapezoid>(e.trapezoids_offset, e.trapezoid_count, size)) return false;
+            if (!IsValidArray<Portal>(e.portals_offset, e.portal_count, size)) return false;
+            if (!IsValidArray<uint32_t>(e.indices_offset, e.index_count, size)) return false;
+            planes[i].zplane = e.zplane;
+            planes[i].trapezoids = {reinterpret_cast<const Trapezoid*>(data + e.trapezoids_offset), e.trapezoid_count};
+            planes[i].portals = {reinterpret_cast<const Portal*>(data + e.portals_offset), e.portal_count};
+            planes[i].portal_trapezoid_indices = {reinterpret_cast<const uint32_t*>(data + e.indices_offset), e.index_count};
+        }
+
+        m_data = data;
+        m_size = size;
+        m_map_file_id = header.map_file_id;
+        m_bounds_min = header.bounds_min;
+        m_bounds_max = header.bounds_max;
+        m_planes = std::move(planes);
+        return true;
+    }
+
+    void PathingMapView::Reset()
+    {
+        m_data = nullptr;
+        m_size = 0;
+        m_map_file_id = 0;
+        m_bounds_min = m_bounds_max = {};
+        m_planes.clear();
+    }
+
+    size_t PathingMapView::GetTotalTrapezoidCount() const
+    {
+        size_t total = 0;
+        for (const auto& plane : m_planes) {
+            total += plane.trapezoids.size();
+        }
+        return total;
+    }
+
+    PathingMapData PathingMapView::ToMapData() const
+    {
+        PathingMapData map;
+        map.map_file_id = m_map_file_id;
+        map.bounds_min = m_bounds_min;
+        map.bounds_max = m_bounds_max;
+        map.planes.resize(m_planes.size());
+        for (size_t i = 0; i < m_planes.size(); ++i) {
+            const auto& src = m_planes[i];
+            auto& dst = map.planes[i];
+            dst.zplane = src.zplane;
+            dst.trapezoids.assign(src.trapezoids.begin(), src.trapezoids.end());
+            dst.portals.assign(src.portals.begin(), src.portals.end());
+            dst.portal_trapezoid_indices.assign(src.portal_trapezoid_indices.begin(), src.portal_trapezoid_indices.end());
+        }
+        return map;
+    }
+
+    bool PathingMapFile::Open(const std::filesystem::path& path, bool verify_checksum)
+    {
+        Close();
+        if (!m_file.Open(path)) return false;
+        if (!m_view.Attach(m_file.data(), m_file.size(), verify_checksum)) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void PathingMapFile::Close()
+    {
+        m_view.Reset();
+        m_file.Close();
+    }
+} // namespace Pathing
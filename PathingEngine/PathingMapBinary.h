@@ -0,0 +1,80 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include "MappedFile.h"
+#include "PathingMapData.h"
+
+// =============================================================================
+// Binary PathingMapData
+//
+// Versioned little-endian layout that is used in place: a header, one entry
+// per plane with the offsets of its arrays, then the Trapezoid, Portal and
+// portal trapezoid index arrays exactly as they are laid out in memory, each
+// 8 byte aligned. A PathingMapView over a memory mapped file or a buffer reads
+// the arrays without copying them; ToMapData() copies them into a
+// PathingMapData for code that owns its map (VisGraph, CorridorSearch).
+//
+// File layout:
+//   BinaryMapHeader                 magic, version, struct sizes, map info,
+//                                   total size and checksum of what follows
+//   BinaryPlaneEntry[plane_count]   zplane, counts, offsets from the header
+//   arrays                          per plane: trapezoids, portals, indices
+// =============================================================================
+
+namespace Pathing {
+    // One plane of a binary map; the spans point into the viewed bytes
+    struct NavPlaneView {
+        uint32_t zplane = 0;
+        std::span<const Trapezoid> trapezoids;
+        std::span<const Portal> portals;
+        std::span<const uint32_t> portal_trapezoid_indices;
+    };
+
+    std::vector<uint8_t> EncodeBinaryMap(const PathingMapData& map);
+    // Writes the map to path, replacing it
+    bool WriteBinaryMap(const std::filesystem::path& path, const PathingMapData& map);
+
+    class PathingMapView {
+    public:
+        // data must be 8 byte aligned and outlive the view. Checks the header and that every array lies inside
+        // size bytes; verify_checksum also hashes the whole map, which costs about as much as copying it.
+        bool Attach(const uint8_t* data, size_t size, bool verify_checksum = true);
+        void Reset();
+        bool IsValid() const { return m_data != nullptr; }
+
+        uint32_t GetMapFileId() const { return m_map_file_id; }
+        const Vec2f& GetBoundsMin() const { return m_bounds_min; }
+        const Vec2f& GetBoundsMax() const { return m_bounds_max; }
+        size_t GetPlaneCount() const { return m_planes.size(); }
+        const NavPlaneView& GetPlane(size_t index) const { return m_planes[index]; }
+        size_t GetTotalTrapezoidCount() const;
+        // Bytes of the map, header included
+        size_t GetSize() const { return m_size; }
+
+        PathingMapData ToMapData() const;
+
+    private:
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+        uint32_t m_map_file_id = 0;
+        Vec2f m_bounds_min{}, m_bounds_max{};
+        std::vector<NavPlaneView> m_planes;
+    };
+
+    // A binary map file mapped into memory
+    class PathingMapFile {
+    public:
+        bool Open(const std::filesystem::path& path, bool verify_checksum = true);
+        void Close();
+
+        // Valid while the file is open
+        const PathingMapView& GetView() const { return m_view; }
+
+    private:
+        MappedFile m_file;
+        PathingMapView m_view;
+    };
+} // namespace Pathing
@@ -39,7 +39,7 @@ namespace Pathing {
         float YB;       // Y coord of bottom edge
 
         // Neighbor connectivity (indices into same plane's trapezoid array)
-        // Order: [top, right, bottom, left]
+        // Order: [top left, top right, bottom left, bottom right]
         uint32_t neighbors[4];
 
         // Portal indices for cross-plane connections
@@ -53,9 +53,9 @@ namespace Pathing {
         uint16_t trapezoid_index_start; // Start index in portal_trapezoid_indices array
         uint16_t neighbor_plane;        // Index of connected plane
         uint16_t shared_id;             // ID shared between portal pairs
-        uint8_t flags;                  // Portal flags (0x1 = blocked)
+        uint8_t flags;                  // Portal flags (0x4 = not used for path finding)
 
-        bool IsBlocked() const { return (flags & 0x1) != 0; }
+        bool IsBlocked() const { return (flags & 0x4) != 0; }
     };
 
     // Navigation plane (one height layer)
@@ -0,0 +1,85 @@
+#include "stdafx.h"
+
+#include "PathingMapDataParser.h"
+
+namespace Pathing {
+
+    bool ParsePathingChunk(const uint8_t* chunk_data, size_t chunk_size, PathingMapData* out)
+    {
+        if (!(chunk_data && out)) return false;
+
+        // Header: signature(4) + version(4) + sequence(4)
+        uint32_t signature, version, sequence;
+        if (!detail::read_u32(chunk_data, 0, chunk_size, signature)) return false;
+        if (!detail::read_u32(chunk_data, 4, chunk_size, version)) return false;
+        if (!detail::read_u32(chunk_data, 8, chunk_size, sequence)) return false;
+
+        // Verify signature
+        if (signature != 0xEEFE704C) return false;
+
+        size_t off = 12;
+
+        // --- Tag 7: Preamble (skip) ---
+        uint8_t tag;
+        uint32_t tag_size;
+        if (!detail::read_tag(chunk_data, off, chunk_size, tag, tag_size)) return false;
+        if (tag != 7) return false;
+        off += 5 + tag_size;
+
+        // --- Tag 8: All planes ---
+        if (!detail::read_tag(chunk_data, off, chunk_size, tag, tag_size)) return false;
+        if (tag != 8) return false;
+        off += 5;
+
+        uint32_t plane_count;
+        if (!detail::read_u32(chunk_data, off, chunk_size, plane_count)) return false;
+        off += 4;
+
+        // Sanity check
+        if (plane_count > 256) return false;
+
+        PathingMapData result;
+        result.planes.resize(plane_count);
+
+        // Parse each plane
+        for (uint32_t i = 0; i < plane_count; ++i) {
+            if (!detail::parse_plane(chunk_data, off, chunk_size, result.planes[i])) {
+                return false;
+            }
+
+            // Set zplane (plane 0 = ground = UINT32_MAX, others = 0, 1, 2, ...)
+            result.planes[i].zplane = (i == 0) ? UINT32_MAX : (i - 1);
+        }
+
+        // Skip remaining tags (12, 13, 14, terminator) - we don't need them for pathfinding
+        // They contain obstacle data that can be processed separately if needed
+
+        out->planes = std::move(result.planes);
+        return true;
+    }
+
+    bool LoadPathingMapDataFromFFNA(const uint8_t* data, size_t length, uint32_t map_file_id, PathingMapData* out)
+    {
+        if (!(data && out)) return false;
+        if (length < 5 || memcmp(data, "ffna", 4) != 0) return false;
+
+        size_t payload_offset;
+        uint32_t payload_size;
+        if (!detail::find_pathing_chunk(data, length, payload_offset, payload_size)) return false;
+
+        PathingMapData result;
+        if (!ParsePathingChunk(data + payload_offset, payload_size, &result)) return false;
+
+        // Map info chunk: signature(4) + version(1) + bounds min/max (4 floats)
+        if (!detail::find_chunk(data, length, 0x2000000C, payload_offset, payload_size)) return false;
+        if (!detail::read_f32(data, payload_offset + 5, payload_offset + payload_size, result.bounds_min.x)) return false;
+        if (!detail::read_f32(data, payload_offset + 9, payload_offset + payload_size, result.bounds_min.y)) return false;
+        if (!detail::read_f32(data, payload_offset + 13, payload_offset + payload_size, result.bounds_max.x)) return false;
+        if (!detail::read_f32(data, payload_offset + 17, payload_offset + payload_size, result.bounds_max.y)) return false;
+
+        result.map_file_id = map_file_id;
+        *out = std::move(result);
+        return true;
+    }
+
+} // namespace Pathing
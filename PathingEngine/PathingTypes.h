@@ -0,0 +1,78 @@
+#pragma once
+
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+
+#include "PathingMapData.h"
+
+// =============================================================================
+// Shared types for the pathing engine.
+//
+// Nothing in here depends on GWCA or Windows, so the engine can be built and
+// benchmarked on any platform from a PathingMapData alone.
+// =============================================================================
+
+namespace Pathing {
+    #define PATHING_MAX_PLANE_COUNT 192 // Be sure to ASSERT if this is ever higher!
+
+    using BlockedPlaneBitset = std::bitset<PATHING_MAX_PLANE_COUNT>;
+
+    enum class Error : uint32_t {
+        OK,
+        Unknown,
+        FailedToFindStartPathingTrapezoid,
+        FailedToFindGoalPathingTrapezoid,
+        FailedToFinializePath,
+        InvalidMapContext,
+        BuildPathLengthExceeded,
+        FailedToGetPathingMapBlock
+    };
+
+    typedef uint16_t PointId;
+
+    // Position on the pathing map; zplane is the index of the plane in PathingMapData::planes
+    struct MapPos {
+        float x = 0.f;
+        float y = 0.f;
+        uint32_t zplane = 0;
+    };
+
+    // Map specific shortcut between two positions, e.g. the Crystal Desert teleporters
+    struct Teleport {
+        MapPos enter;
+        MapPos exit;
+        bool both_ways = true;
+    };
+
+    inline Vec2f operator+(const Vec2f& lhs, const Vec2f& rhs) { return {lhs.x + rhs.x, lhs.y + rhs.y}; }
+    inline Vec2f operator-(const Vec2f& lhs, const Vec2f& rhs) { return {lhs.x - rhs.x, lhs.y - rhs.y}; }
+    inline Vec2f operator*(float lhs, const Vec2f& rhs) { return {lhs * rhs.x, lhs * rhs.y}; }
+    inline bool operator==(const Vec2f& lhs, const Vec2f& rhs) { return lhs.x == rhs.x && lhs.y == rhs.y; }
+    inline bool operator==(const MapPos& lhs, const MapPos& rhs) { return lhs.x == rhs.x && lhs.y == rhs.y && lhs.zplane == rhs.zplane; }
+
+    inline float Cross(const Vec2f& lhs, const Vec2f& rhs)
+    {
+        return (lhs.x * rhs.y) - (lhs.y * rhs.x);
+    }
+
+    inline float Dot(const Vec2f& lhs, const Vec2f& rhs)
+    {
+        return (lhs.x * rhs.x) + (lhs.y * rhs.y);
+    }
+
+    inline float GetSquareDistance(const Vec2f& a, const Vec2f& b)
+    {
+        return Dot(a - b, a - b);
+    }
+
+    inline float GetDistance(const Vec2f& a, const Vec2f& b)
+    {
+        return sqrtf(GetSquareDistance(a, b));
+    }
+
+    inline Vec2f ToVec2f(const MapPos& pos)
+    {
+        return {pos.x, pos.y};
+    }
+} // namespace Pathing
@@ -0,0 +1,113 @@
+#include "stdafx.h"
+
+#include <fstream>
+#include <sstream>
+
+#include "BinaryStream.h"
+#include "PathingMapBinary.h"
+#include "QueryCorpus.h"
+
+namespace {
+    using namespace Pathing;
+    using nlohmann::json;
+
+    constexpr uint32_t CORPUS_VERSION = 1;
+
+    json PosToJson(const MapPos& pos)
+    {
+        return json::array({pos.x, pos.y, pos.zplane});
+    }
+
+    bool PosFromJson(const json& j, MapPos& out)
+    {
+        if (!(j.is_array() && j.size() == 3 && j[0].is_number() && j[1].is_number() && j[2].is_number_unsigned())) return false;
+        out = {j[0].get<float>(), j[1].get<float>(), j[2].get<uint32_t>()};
+        return true;
+    }
+
+    bool QueryFromJson(const json& j, CorpusQuery& out)
+    {
+        if (!j.is_object()) return false;
+        if (!(j.contains("start") && PosFromJson(j["start"], out.start))) return false;
+        if (!(j.contains("goal") && PosFromJson(j["goal"], out.goal))) return false;
+        out.blocked_planes.reset();
+        if (j.contains("blocked_planes")) {
+            const auto& planes = j["blocked_planes"];
+            if (!planes.is_array()) return false;
+            for (const auto& plane : planes) {
+                if (!(plane.is_number_unsigned() && plane.get<uint32_t>() < out.blocked_planes.size())) return false;
+                out.blocked_planes.set(plane.get<uint32_t>());
+            }
+        }
+        const auto error = j.value("error", json(0));
+        if (!error.is_number_unsigned()) return false;
+        out.error = static_cast<Error>(error.get<uint32_t>());
+        const auto cost = j.value("cost", json(0.f));
+        if (!cost.is_number()) return false;
+        out.cost = cost.get<float>();
+        return true;
+    }
+} // namespace
+
+namespace Pathing {
+    void SetExpectedResults(const VisGraph& graph, std::span<CorpusQuery> queries)
+    {
+        PathResult result;
+        for (auto& query : queries) {
+            query.error = graph.Search(query.start, query.goal, query.blocked_planes, result);
+            query.cost = query.error == Error::OK ? result.cost : 0.f;
+        }
+    }
+
+    bool WriteQueryCorpus(const std::filesystem::path& folder, const std::string& name, const PathingMapData& map, std::span<const CorpusQuery> queries)
+    {
+        const auto map_name = name + ".gwpm";
+        if (!WriteBinaryMap(folder / map_name, map)) return false;
+
+        // Ordered, so the keys come out as in the header comment
+        nlohmann::ordered_json j_queries = nlohmann::ordered_json::array();
+        for (const auto& query : queries) {
+            json blocked_planes = json::array();
+            for (size_t plane = 0; plane < query.blocked_planes.size(); ++plane) {
+                if (query.blocked_planes[plane]) blocked_planes.push_back(plane);
+            }
+            j_queries.push_back(nlohmann::ordered_json{
+                {"start", PosToJson(query.start)},
+                {"goal", PosToJson(query.goal)},
+                {"blocked_planes", blocked_planes},
+                {"error", static_cast<uint32_t>(query.error)},
+                {"cost", query.cost}
+            });
+        }
+        // One query per line keeps diffs between recordings readable
+        std::string text = "{\"version\": " + std::to_string(CORPUS_VERSION) + ", \"map\": " + json(map_name).dump() + ", \"map_file_id\": " + std::to_string(map.map_file_id) + ", \"queries\": [\n";
+        for (size_t i = 0; i < j_queries.size(); ++i) {
+            text += "  " + j_queries[i].dump() + (i + 1 < j_queries.size() ? ",\n" : "\n");
+        }
+        text += "]}\n";
+        return detail::WriteFileReplacing(folder / (name + CORPUS_QUERIES_EXTENSION), {{reinterpret_cast<const uint8_t*>(text.data()), text.size()}});
+    }
+
+    bool ReadQueryCorpus(const std::filesystem::path& queries_path, PathingMapData& map, std::vector<CorpusQuery>& queries)
+    {
+        std::ifstream file(queries_path, std::ios::binary);
+        if (!file) return false;
+        std::stringstream text;
+        text << file.rdbuf();
+        const auto j = json::parse(text.str(), nullptr, false);
+        if (j.is_discarded() || !j.is_object()) return false;
+        if (!(j.contains("version") && j["version"] == CORPUS_VERSION)) return false;
+        if (!(j.contains("map") && j["map"].is_string() && j.contains("queries") && j["queries"].is_array())) return false;
+
+        queries.clear();
+        queries.reserve(j["queries"].size());
+        for (const auto& j_query : j["queries"]) {
+            if (!QueryFromJson(j_query, queries.emplace_back())) return false;
+        }
+
+        PathingMapFile map_file;
+        if (!map_file.Open(queries_path.parent_path() / j["map"].get<std::string>())) return false;
+        map = map_file.GetView().ToMapData();
+        return true;
+    }
+} // namespace Pathing
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "VisGraph.h"
+
+// =============================================================================
+// Query corpus
+//
+// Recorded searches on one map with the result they are expected to give,
+// for replaying against later versions of the engine (bench/PathingCorpus).
+// A corpus is two files side by side:
+//   <name>.gwpm           the map, as written by WriteBinaryMap()
+//   <name>.queries.json   the queries, e.g.
+//     {"version": 1, "map": "<name>.gwpm", "map_file_id": 1234,
+//      "queries": [{"start": [x, y, plane], "goal": [x, y, plane],
+//                   "blocked_planes": [3], "error": 0, "cost": 1234.5}]}
+// The queries file is plain JSON so queries can be added or looked at by
+// hand; error is the Pathing::Error value and cost only counts when it is 0.
+// =============================================================================
+
+namespace Pathing {
+    struct CorpusQuery {
+        MapPos start;
+        MapPos goal;
+        BlockedPlaneBitset blocked_planes;
+        // Expected result of VisGraph::Search
+        Error error = Error::OK;
+        float cost = 0.f;
+    };
+
+    constexpr const char* CORPUS_QUERIES_EXTENSION = ".queries.json";
+
+    // Sets the expected result of every query to what graph.Search gives now; the graph must be built
+    void SetExpectedResults(const VisGraph& graph, std::span<CorpusQuery> queries);
+
+    // Writes <folder>/<name>.gwpm and <folder>/<name>.queries.json, replacing them
+    bool WriteQueryCorpus(const std::filesystem::path& folder, const std::string& name, const PathingMapData& map, std::span<const CorpusQuery> queries);
+    // queries_path is a .queries.json file; the map is read from the file it names, in the same folder
+    bool ReadQueryCorpus(const std::filesystem::path& queries_path, PathingMapData& map, std::vector<CorpusQuery>& queries);
+} // namespace Pathing
@@ -0,0 +1,234 @@
+#include "stdafx.h"
+
+#include "RouteOptimizer.h"
+
+namespace {
+    using namespace Pathing;
+
+    // Stand-in for pairs without a path (one way teleports), so that moves can still be compared
+    constexpr double UNREACHABLE_COST = 1e12;
+    // Ignore improvements smaller than this, so float noise can't make the moves cycle
+    constexpr double MIN_IMPROVEMENT = 1e-3;
+    constexpr uint32_t MAX_PASSES = 1000;
+    constexpr uint32_t MAX_OR_OPT_SEGMENT = 3;
+
+    class Tour {
+    public:
+        Tour(const DistanceMatrix& matrix, std::vector<uint32_t> nodes)
+            : m_n(matrix.source_count), m_cost(static_cast<size_t>(m_n) * m_n), m_nodes(std::move(nodes))
+        {
+            for (size_t i = 0; i < m_cost.size(); ++i) {
+                m_cost[i] = std::isinf(matrix.distances[i]) ? UNREACHABLE_COST : matrix.distances[i];
+            }
+            UpdatePrefix();
+        }
+
+        const std::vector<uint32_t>& Nodes() const { return m_nodes; }
+
+        // Reverses a segment of the walk; the start never moves
+        bool TwoOpt()
+        {
+            const auto& t = m_nodes;
+            const size_t last = t.size() - 1;
+            for (size_t i = 1; i < last; ++i) {
+                for (size_t j = i + 1; j <= last; ++j) {
+                    double delta = Cost(t[i - 1], t[j]) - Cost(t[i - 1], t[i]);
+                    delta += (m_backward[j] - m_backward[i]) - (m_forward[j] - m_forward[i]);
+                    if (j < last) delta += Cost(t[i], t[j + 1]) - Cost(t[j], t[j + 1]);
+                    if (delta < -MIN_IMPROVEMENT) {
+                        std::reverse(m_nodes.begin() + i, m_nodes.begin() + j + 1);
+                        UpdatePrefix();
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        // Moves a run of up to MAX_OR_OPT_SEGMENT waypoints elsewhere in the walk, either way round
+        bool OrOpt()
+        {
+            const auto& t = m_nodes;
+            const size_t last = t.size() - 1;
+            for (size_t len = 1; len <= MAX_OR_OPT_SEGMENT; ++len) {
+                for (size_t i = 1; i + len - 1 <= last; ++i) {
+                    const size_t j = i + len - 1; // last node of the segment
+                    const uint32_t prev = t[i - 1];
+                    double removed = Cost(prev, t[i]);
+                    if (j < last) removed += Cost(t[j], t[j + 1]) - Cost(prev, t[j + 1]);
+                    const double reversal = (m_backward[j] - m_backward[i]) - (m_forward[j] - m_forward[i]);
+
+                    for (size_t k = 0; k <= last; ++k) {
+                        if (k + 1 >= i && k <= j) continue; // same place, or inside the segment
+                        const uint32_t a = t[k];
+                        const bool has_b = k < last;
+                        const double gap = has_b ? Cost(a, t[k + 1]) : 0.0;
+                        const double forward = Cost(a, t[i]) + (has_b ? Cost(t[j], t[k + 1]) : 0.0) - gap;
+                        const double backward = Cost(a, t[j]) + (has_b ? Cost(t[i], t[k + 1]) : 0.0) - gap + reversal;
+                        const bool reverse = backward < forward;
+                        if (std::min(forward, backward) - removed < -MIN_IMPROVEMENT) {
+                            std::vector<uint32_t> segment(t.begin() + i, t.begin() + j + 1);
+                            if (reverse) std::ranges::reverse(segment);
+                            m_nodes.erase(m_nodes.begin() + i, m_nodes.begin() + j + 1);
+                            const size_t insert_at = k < i ? k + 1 : k + 1 - len;
+                            m_nodes.insert(m_nodes.begin() + insert_at, segment.begin(), segment.end());
+                            UpdatePrefix();
+                            return true;
+                        }
+                    }
+                }
+            }
+            return false;
+        }
+
+    private:
+        double Cost(uint32_t from, uint32_t to) const { return m_cost[static_cast<size_t>(from) * m_n + to]; }
+
+        // Walking a stretch of the tour either way round is a difference of these
+        void UpdatePrefix()
+        {
+            m_forward.assign(m_nodes.size(), 0.0);
+            m_backward.assign(m_nodes.size(), 0.0);
+            for (size_t i = 1; i < m_nodes.size(); ++i) {
+                m_forward[i] = m_forward[i - 1] + Cost(m_nodes[i - 1], m_nodes[i]);
+                m_backward[i] = m_backward[i - 1] + Cost(m_nodes[i], m_nodes[i - 1]);
+            }
+        }
+
+        uint32_t m_n;
+        std::vector<double> m_cost;
+        std::vector<uint32_t> m_nodes; // m_nodes[0] is the start
+        std::vector<double> m_forward;
+        std::vector<double> m_backward;
+    };
+} // namespace
+
+namespace Pathing {
+    RouteOptimizer::RouteOptimizer(const VisGraph& graph)
+        : m_graph(graph) {}
+
+    void RouteOptimizer::SetWaypoints(std::span<const MapPos> waypoints)
+    {
+        m_waypoints.assign(waypoints.begin(), waypoints.end());
+        m_enabled.assign(m_waypoints.size(), 1);
+        m_has_distances = false;
+    }
+
+    void RouteOptimizer::SetEnabled(uint32_t waypoint, bool enabled)
+    {
+        if (waypoint < m_enabled.size()) m_enabled[waypoint] = enabled;
+    }
+
+    void RouteOptimizer::UpdateWaypoints(std::span<const MapPos> waypoints, std::vector<uint32_t>& index)
+    {
+        index.assign(waypoints.size(), 0);
+        std::vector<uint8_t> taken(m_waypoints.size(), 0);
+        bool subset = true;
+        for (size_t i = 0; i < waypoints.size() && subset; ++i) {
+            subset = false;
+            for (uint32_t j = 0; j < m_waypoints.size(); ++j) {
+                if (taken[j] || m_waypoints[j] != waypoints[i]) continue;
+                taken[j] = 1;
+                index[i] = j;
+                subset = true;
+                break;
+            }
+        }
+        if (!subset) {
+            SetWaypoints(waypoints);
+            for (uint32_t i = 0; i < index.size(); ++i) index[i] = i;
+            return;
+        }
+        m_enabled = std::move(taken);
+    }
+
+    Error RouteOptimizer::Optimize(const MapPos& start, const BlockedPlaneBitset& blocked_planes, Route& out)
+    {
+        out = {};
+        if (!m_has_distances || m_blocked_planes != blocked_planes) {
+            const auto res = m_graph.ComputeDistanceMatrix(m_waypoints, m_waypoints, blocked_planes, m_distances);
+            if (res != Error::OK) return res;
+            m_blocked_planes = blocked_planes;
+            m_has_distances = true;
+        }
+
+        std::vector<uint32_t> enabled;
+        std::vector<MapPos> targets;
+        for (uint32_t i = 0; i < m_waypoints.size(); ++i) {
+            if (!m_enabled[i]) continue;
+            enabled.push_back(i);
+            targets.push_back(m_waypoints[i]);
+        }
+        DistanceMatrix from_start;
+        const auto res = m_graph.ComputeDistanceMatrix({&start, 1}, targets, blocked_planes, from_start);
+        if (res != Error::OK) return res;
+
+        // Start first, then the enabled waypoints
+        const auto n = static_cast<uint32_t>(enabled.size() + 1);
+        DistanceMatrix matrix;
+        matrix.source_count = matrix.target_count = n;
+        matrix.distances.assign(static_cast<size_t>(n) * n, INFINITY);
+        for (uint32_t j = 1; j < n; ++j) {
+            matrix.distances[j] = from_start.Distance(0, j - 1);
+        }
+        for (uint32_t i = 1; i < n; ++i) {
+            for (uint32_t j = 1; j < n; ++j) {
+                matrix.distances[static_cast<size_t>(i) * n + j] = m_distances.Distance(enabled[i - 1], enabled[j - 1]);
+            }
+        }
+
+        Optimize(matrix, out);
+        for (auto& i : out.order) i = enabled[i];
+        for (auto& i : out.unreachable) i = enabled[i];
+        return Error::OK;
+    }
+
+    void RouteOptimizer::Optimize(const DistanceMatrix& matrix, Route& out)
+    {
+        out = {};
+        const uint32_t n = matrix.source_count;
+        if (n < 2 || matrix.target_count != n) return;
+
+        std::vector<uint8_t> visited(n, 0);
+        uint32_t remaining = 0;
+        for (uint32_t i = 1; i < n; ++i) {
+            if (std::isinf(matrix.Distance(0, i))) {
+                out.unreachable.push_back(i - 1);
+                visited[i] = 1;
+            }
+            else {
+                remaining++;
+            }
+        }
+
+        // Nearest neighbour
+        std::vector<uint32_t> nodes{0};
+        nodes.reserve(remaining + 1);
+        for (; remaining; --remaining) {
+            const uint32_t from = nodes.back();
+            uint32_t best = 0;
+            float best_distance = INFINITY;
+            for (uint32_t i = 1; i < n; ++i) {
+                if (visited[i]) continue;
+                if (!best || matrix.Distance(from, i) < best_distance) {
+                    best = i;
+                    best_distance = matrix.Distance(from, i);
+                }
+            }
+            visited[best] = 1;
+            nodes.push_back(best);
+        }
+
+        Tour tour(matrix, std::move(nodes));
+        for (uint32_t pass = 0; pass < MAX_PASSES; ++pass) {
+            if (!tour.TwoOpt() && !tour.OrOpt()) break;
+        }
+
+        const auto& result = tour.Nodes();
+        out.order.reserve(result.size() - 1);
+        for (size_t i = 1; i < result.size(); ++i) {
+            out.order.push_back(result[i] - 1);
+            out.cost += matrix.Distance(result[i - 1], result[i]);
+        }
+    }
+} // namespace Pathing
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "VisGraph.h"
+
+// =============================================================================
+// RouteOptimizer
+//
+// Orders a set of waypoints into a short walk from a start position, by path
+// length on the VisGraph rather than straight line distance. The walk ends at
+// the last waypoint; it doesn't return to the start.
+//
+// Travelling salesman heuristic: nearest neighbour to get going, then 2-opt
+// and Or-opt moves until neither improves the route. Not optimal, but usually
+// within a percent or so, and well under a millisecond for 100 waypoints.
+//
+// Walking distances between the waypoints are the expensive part; they are
+// kept until the waypoints or blocked planes change, so rerunning Optimize()
+// as the player moves and waypoints get dropped only costs one Dijkstra from
+// the new start. Not thread safe; the graph must outlive this object.
+// =============================================================================
+
+namespace Pathing {
+    struct Route {
+        std::vector<uint32_t> order;       // indices into the waypoints, in visiting order
+        std::vector<uint32_t> unreachable; // waypoints that can't be walked to from the start
+        float cost = 0.f;                  // walking distance from the start through all reachable waypoints
+    };
+
+    class RouteOptimizer {
+    public:
+        explicit RouteOptimizer(const VisGraph& graph);
+
+        // Walking distances between all the waypoints are computed by the next Optimize(). All waypoints start enabled.
+        void SetWaypoints(std::span<const MapPos> waypoints);
+        const std::vector<MapPos>& GetWaypoints() const { return m_waypoints; }
+        // Disabled waypoints are left out of the route (e.g. the group there is dead); cheap.
+        void SetEnabled(uint32_t waypoint, bool enabled);
+        // Enables just these waypoints, keeping the distances if they are all among the current ones; otherwise
+        // the same as SetWaypoints. index[i] is set to the optimizer's index of waypoints[i]; repeated positions
+        // each get a copy of their own, so every waypoint shows up in the route once.
+        void UpdateWaypoints(std::span<const MapPos> waypoints, std::vector<uint32_t>& index);
+
+        Error Optimize(const MapPos& start, const BlockedPlaneBitset& blocked_planes, Route& out);
+
+        // The heuristic itself, on known distances: node 0 is the start, node i + 1 is waypoint i.
+        // matrix must be square; it doesn't need to be symmetric, and distances into the start are ignored.
+        static void Optimize(const DistanceMatrix& matrix, Route& out);
+
+    private:
+        const VisGraph& m_graph;
+        std::vector<MapPos> m_waypoints;
+        std::vector<uint8_t> m_enabled;
+        DistanceMatrix m_distances; // between waypoints
+        BlockedPlaneBitset m_blocked_planes;
+        bool m_has_distances = false;
+    };
+} // namespace Pathing
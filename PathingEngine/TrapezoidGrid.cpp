@@ -0,0 +1,221 @@
+#include "stdafx.h"
+
+#include "TrapezoidGrid.h"
+
+namespace {
+    using namespace Pathing;
+
+    // Cells per axis are capped so that huge, sparse planes don't blow up memory
+    constexpr uint32_t MAX_CELLS_PER_AXIS = 1024;
+
+    float DistanceToBox(const Vec2f& p, float min_x, float min_y, float max_x, float max_y)
+    {
+        const float dx = std::max({min_x - p.x, 0.f, p.x - max_x});
+        const float dy = std::max({min_y - p.y, 0.f, p.y - max_y});
+        return sqrtf(dx * dx + dy * dy);
+    }
+} // namespace
+
+namespace Pathing {
+    uint32_t TrapezoidGrid::PlaneGrid::CellX(float x) const
+    {
+        const float f = (x - bounds.min_x) / cell_size;
+        if (!(f > 0.f)) return 0;
+        return std::min(static_cast<uint32_t>(f), width - 1);
+    }
+
+    uint32_t TrapezoidGrid::PlaneGrid::CellY(float y) const
+    {
+        const float f = (y - bounds.min_y) / cell_size;
+        if (!(f > 0.f)) return 0;
+        return std::min(static_cast<uint32_t>(f), height - 1);
+    }
+
+    TrapezoidGrid::TrapezoidGrid(const PathingMapData& map)
+        : m_map(&map)
+    {
+        m_planes.resize(map.planes.size());
+        for (size_t z = 0; z < map.planes.size(); ++z) {
+            const auto& trapezoids = map.planes[z].trapezoids;
+            auto& grid = m_planes[z];
+            if (trapezoids.empty()) {
+                grid.width = grid.height = 0;
+                continue;
+            }
+
+            std::vector<Bounds> trapezoid_bounds;
+            trapezoid_bounds.reserve(trapezoids.size());
+            Bounds& b = grid.bounds;
+            b = {INFINITY, INFINITY, -INFINITY, -INFINITY};
+            for (const auto& t : trapezoids) {
+                const Bounds tb{std::min(t.XTL, t.XBL), t.YB, std::max(t.XTR, t.XBR), t.YT};
+                trapezoid_bounds.push_back(tb);
+                b.min_x = std::min(b.min_x, tb.min_x);
+                b.min_y = std::min(b.min_y, tb.min_y);
+                b.max_x = std::max(b.max_x, tb.max_x);
+                b.max_y = std::max(b.max_y, tb.max_y);
+            }
+
+            // Roughly a couple of trapezoids per cell
+            const float w = std::max(b.max_x - b.min_x, 1.f);
+            const float h = std::max(b.max_y - b.min_y, 1.f);
+            grid.cell_size = std::max({sqrtf(w * h / trapezoids.size()) * 1.5f, w / MAX_CELLS_PER_AXIS, h / MAX_CELLS_PER_AXIS, 1.f});
+            grid.width = std::clamp(static_cast<uint32_t>(w / grid.cell_size) + 1, 1u, MAX_CELLS_PER_AXIS);
+            grid.height = std::clamp(static_cast<uint32_t>(h / grid.cell_size) + 1, 1u, MAX_CELLS_PER_AXIS);
+
+            // Two passes: count per cell, then fill. Trapezoids are visited in index order so every cell list is sorted.
+            const size_t cell_count = static_cast<size_t>(grid.width) * grid.height;
+            grid.cell_offsets.assign(cell_count + 1, 0);
+            const auto for_each_cell = [&grid](const Bounds& tb, auto&& f) {
+                const auto x0 = grid.CellX(tb.min_x), x1 = grid.CellX(tb.max_x);
+                const auto y0 = grid.CellY(tb.min_y), y1 = grid.CellY(tb.max_y);
+                for (uint32_t y = y0; y <= y1; ++y) {
+                    for (uint32_t x = x0; x <= x1; ++x) {
+                        f(static_cast<size_t>(y) * grid.width + x);
+                    }
+                }
+            };
+            for (const auto& tb : trapezoid_bounds) {
+                for_each_cell(tb, [&](size_t cell) {
+                    grid.cell_offsets[cell + 1]++;
+                });
+            }
+            for (size_t i = 0; i < cell_count; ++i) {
+                grid.cell_offsets[i + 1] += grid.cell_offsets[i];
+            }
+            grid.trapezoids.resize(grid.cell_offsets[cell_count]);
+            std::vector<uint32_t> fill(grid.cell_offsets.begin(), grid.cell_offsets.end() - 1);
+            for (uint32_t i = 0; i < trapezoid_bounds.size(); ++i) {
+                for_each_cell(trapezoid_bounds[i], [&](size_t cell) {
+                    grid.trapezoids[fill[cell]++] = i;
+                });
+            }
+            grid.cell_geometry.Reserve(grid.trapezoids.size());
+            for (const auto index : grid.trapezoids) {
+                grid.cell_geometry.Push(trapezoids[index]);
+            }
+            grid.cell_geometry.Finish();
+        }
+    }
+
+    TrapezoidRef TrapezoidGrid::FindOnPlane(uint32_t plane, const Vec2f& p) const
+    {
+        const auto& grid = m_planes[plane];
+        if (!grid.width) return {};
+        // IsOnTrapezoid never accepts points outside the trapezoid's bounding box
+        const auto& b = grid.bounds;
+        if (p.x < b.min_x || p.x > b.max_x || p.y < b.min_y || p.y > b.max_y) return {};
+
+        const size_t cell = static_cast<size_t>(grid.CellY(p.y)) * grid.width + grid.CellX(p.x);
+        const auto i = FindContainingTrapezoid(grid.cell_geometry, grid.cell_offsets[cell], grid.cell_offsets[cell + 1], p);
+        if (i == INVALID_INDEX) return {};
+        return {plane, grid.trapezoids[i]};
+    }
+
+    TrapezoidRef TrapezoidGrid::FindTrapezoid(const MapPos& pos) const
+    {
+        if (!m_map) return {};
+        const Vec2f p = ToVec2f(pos);
+        const auto plane_count = static_cast<uint32_t>(m_planes.size());
+        if (pos.zplane < plane_count) {
+            const auto found = FindOnPlane(pos.zplane, p);
+            if (found.IsValid()) return found;
+        }
+        for (uint32_t plane = 0; plane < plane_count; ++plane) {
+            if (plane == pos.zplane) continue;
+            const auto found = FindOnPlane(plane, p);
+            if (found.IsValid()) return found;
+        }
+        return {};
+    }
+
+    TrapezoidRef TrapezoidGrid::FindClosestPositionOnTrapezoid(MapPos& pos) const
+    {
+        auto found = FindTrapezoid(pos);
+        if (found.IsValid()) {
+            pos.zplane = found.plane;
+            return found;
+        }
+        if (!m_map) return found;
+
+        // Nearest trapezoid: search outwards from the cell of p ring by ring, until everything not yet looked at
+        // is further away than the best so far. Ties go to the lowest (plane, index), like the linear scan.
+        const Vec2f p = ToVec2f(pos);
+        float closest_dist = std::numeric_limits<float>::infinity();
+        uint32_t closest_edge = 0;
+        const auto consider = [&](uint32_t plane, uint32_t index, uint32_t edge, float d) {
+            if (d < closest_dist || (d == closest_dist && (plane < found.plane || (plane == found.plane && index < found.index)))) {
+                closest_dist = d;
+                closest_edge = edge;
+                found = {plane, index};
+            }
+        };
+
+        for (uint32_t plane = 0; plane < m_planes.size(); ++plane) {
+            const auto& grid = m_planes[plane];
+            if (!grid.width) continue;
+
+            const auto cx = static_cast<int>(grid.CellX(p.x));
+            const auto cy = static_cast<int>(grid.CellY(p.y));
+            const int w = static_cast<int>(grid.width), h = static_cast<int>(grid.height);
+            const float gx0 = grid.bounds.min_x, gy0 = grid.bounds.min_y;
+            const float gx1 = gx0 + w * grid.cell_size, gy1 = gy0 + h * grid.cell_size;
+
+            for (int r = 0;; ++r) {
+                if (r > 0) {
+                    // Distance to the cells outside the square searched so far
+                    const float sx0 = gx0 + std::max(cx - r + 1, 0) * grid.cell_size;
+                    const float sx1 = gx0 + (std::min(cx + r - 1, w - 1) + 1) * grid.cell_size;
+                    const float sy0 = gy0 + std::max(cy - r + 1, 0) * grid.cell_size;
+                    const float sy1 = gy0 + (std::min(cy + r - 1, h - 1) + 1) * grid.cell_size;
+                    float outside = INFINITY;
+                    if (cx - r + 1 > 0) outside = std::min(outside, DistanceToBox(p, gx0, gy0, sx0, gy1));
+                    if (cx + r - 1 < w - 1) outside = std::min(outside, DistanceToBox(p, sx1, gy0, gx1, gy1));
+                    if (cy - r + 1 > 0) outside = std::min(outside, DistanceToBox(p, gx0, gy0, gx1, sy0));
+                    if (cy + r - 1 < h - 1) outside = std::min(outside, DistanceToBox(p, gx0, sy1, gx1, gy1));
+                    if (outside > closest_dist) break;
+                }
+
+                const auto visit_cell = [&](int x, int y) {
+                    if (x < 0 || y < 0 || x >= w || y >= h) return;
+                    const size_t cell = static_cast<size_t>(y) * grid.width + x;
+                    // Closest in the cell, lowest index on ties since cell lists are sorted
+                    const auto closest = FindClosestTrapezoid(grid.cell_geometry, grid.cell_offsets[cell], grid.cell_offsets[cell + 1], p);
+                    if (closest.index != INVALID_INDEX) {
+                        consider(plane, grid.trapezoids[closest.index], closest.edge, closest.distance);
+                    }
+                };
+                if (r == 0) {
+                    visit_cell(cx, cy);
+                }
+                else {
+                    for (int x = cx - r; x <= cx + r; ++x) {
+                        visit_cell(x, cy - r);
+                        visit_cell(x, cy + r);
+                    }
+                    for (int y = cy - r + 1; y <= cy + r - 1; ++y) {
+                        visit_cell(cx - r, y);
+                        visit_cell(cx + r, y);
+                    }
+                }
+            }
+        }
+        if (!found.IsValid()) return found;
+
+        // Located outside pathing trapezoids. Project onto the closest edge of the closest trapezoid.
+        const auto projected = ProjectOntoTrapezoidEdge(m_map->planes[found.plane].trapezoids[found.index], closest_edge, p);
+        pos.x = projected.x;
+        pos.y = projected.y;
+        pos.zplane = found.plane;
+        return found;
+    }
+
+    size_t TrapezoidGrid::GetMemoryUsage() const
+    {
+        size_t total = m_planes.capacity() * sizeof(PlaneGrid);
+        for (const auto& grid : m_planes) {
+            total += grid.cell_offsets.capacity() * sizeof(uint32_t) + grid.trapezoids.capacity() * sizeof(uint32_t) + grid.cell_geometry.GetMemoryUsage();
+        }
+        return total;
+    }
+} // namespace Pathing
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include "MapQueries.h"
+#include "TrapezoidKernels.h"
+
+// =============================================================================
+// TrapezoidGrid
+//
+// Per plane uniform grid over trapezoid bounding boxes. Each cell lists the
+// trapezoids whose bounds overlap it, in ascending index order, so lookups
+// return exactly what the linear scans in MapQueries.h return. Each cell's
+// geometry is copied next to its list so the SIMD kernels in
+// TrapezoidKernels.h can test a whole cell at once.
+//
+// Immutable once constructed; safe to query from several threads.
+// =============================================================================
+
+namespace Pathing {
+    class TrapezoidGrid {
+    public:
+        TrapezoidGrid() = default;
+        explicit TrapezoidGrid(const PathingMapData& map);
+
+        // Same result as FindTrapezoid(map, pos)
+        TrapezoidRef FindTrapezoid(const MapPos& pos) const;
+        // Same result as FindClosestPositionOnTrapezoid(map, pos)
+        TrapezoidRef FindClosestPositionOnTrapezoid(MapPos& pos) const;
+
+        size_t GetMemoryUsage() const;
+
+    private:
+        struct Bounds {
+            float min_x, min_y, max_x, max_y;
+        };
+
+        struct PlaneGrid {
+            Bounds bounds;
+            float cell_size;
+            uint32_t width, height;            // in cells
+            std::vector<uint32_t> cell_offsets; // width * height + 1 offsets into trapezoids
+            std::vector<uint32_t> trapezoids;   // trapezoid indices, grouped by cell
+            TrapezoidStreams cell_geometry;     // geometry of the trapezoids above, in the same order
+
+            uint32_t CellX(float x) const;
+            uint32_t CellY(float y) const;
+        };
+
+        TrapezoidRef FindOnPlane(uint32_t plane, const Vec2f& p) const;
+
+        const PathingMapData* m_map = nullptr;
+        std::vector<PlaneGrid> m_planes;
+    };
+} // namespace Pathing
@@ -0,0 +1,190 @@
+#include "stdafx.h"
+
+#include "TrapezoidKernels.h"
+#include "TrapezoidKernelsSimd.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PATHING_KERNELS_X86 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define PATHING_KERNELS_X86 0
+#endif
+
+namespace {
+    using namespace Pathing;
+
+    static_assert(detail::NO_INDEX == INVALID_INDEX);
+
+#if PATHING_KERNELS_X86
+    struct Sse2 {
+        using Type = __m128;
+        static constexpr uint32_t width = 4;
+        static __m128 Load(const float* p) { return _mm_loadu_ps(p); }
+        static void Store(float* p, __m128 v) { _mm_storeu_ps(p, v); }
+        static __m128 Set1(float v) { return _mm_set1_ps(v); }
+        static __m128 Add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+        static __m128 Sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+        static __m128 Mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+        static __m128 Div(__m128 a, __m128 b) { return _mm_div_ps(a, b); }
+        static __m128 Sqrt(__m128 a) { return _mm_sqrt_ps(a); }
+        static __m128 Lt(__m128 a, __m128 b) { return _mm_cmplt_ps(a, b); }
+        static __m128 And(__m128 a, __m128 b) { return _mm_and_ps(a, b); }
+        static __m128 Or(__m128 a, __m128 b) { return _mm_or_ps(a, b); }
+        static __m128 Select(__m128 mask, __m128 a, __m128 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+        static uint32_t MoveMask(__m128 mask) { return static_cast<uint32_t>(_mm_movemask_ps(mask)); }
+    };
+#endif
+
+    KernelLevel DetectKernelLevel()
+    {
+#if !PATHING_KERNELS_X86
+        return KernelLevel::Scalar;
+#elif defined(_MSC_VER)
+        // AVX needs the CPU flag and the OS saving the YMM registers
+        int info[4];
+        __cpuid(info, 1);
+        const bool avx = (info[2] & (1 << 28)) && (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+        return avx ? KernelLevel::AVX : KernelLevel::SSE2;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx") ? KernelLevel::AVX : KernelLevel::SSE2;
+#endif
+    }
+
+    std::atomic<KernelLevel>& CurrentLevel()
+    {
+        static std::atomic<KernelLevel> level = GetBestKernelLevel();
+        return level;
+    }
+
+    detail::StreamPointers GetPointers(const TrapezoidStreams& s)
+    {
+        return {s.xtl.data(), s.xtr.data(), s.yt.data(), s.xbl.data(), s.xbr.data(), s.yb.data()};
+    }
+} // namespace
+
+namespace Pathing {
+    KernelLevel GetBestKernelLevel()
+    {
+        static const KernelLevel best = DetectKernelLevel();
+        return best;
+    }
+
+    KernelLevel GetKernelLevel()
+    {
+        return CurrentLevel().load(std::memory_order_relaxed);
+    }
+
+    void SetKernelLevel(KernelLevel level)
+    {
+        CurrentLevel() = std::min(level, GetBestKernelLevel());
+    }
+
+    const char* GetKernelLevelName(KernelLevel level)
+    {
+        switch (level) {
+            case KernelLevel::SSE2:
+                return "sse2";
+            case KernelLevel::AVX:
+                return "avx";
+            default:
+                return "scalar";
+        }
+    }
+
+    void TrapezoidStreams::Reserve(size_t count)
+    {
+        for (auto* stream : {&xtl, &xtr, &yt, &xbl, &xbr, &yb}) {
+            stream->reserve(count + PADDING);
+        }
+    }
+
+    void TrapezoidStreams::Push(const Trapezoid& t)
+    {
+        xtl.push_back(t.XTL);
+        xtr.push_back(t.XTR);
+        yt.push_back(t.YT);
+        xbl.push_back(t.XBL);
+        xbr.push_back(t.XBR);
+        yb.push_back(t.YB);
+        m_size++;
+    }
+
+    void TrapezoidStreams::Finish()
+    {
+        // Empty: the top below the bottom
+        for (size_t i = 0; i < PADDING; ++i) {
+            xtl.push_back(0.f);
+            xtr.push_back(0.f);
+            yt.push_back(-INFINITY);
+            xbl.push_back(0.f);
+            xbr.push_back(0.f);
+            yb.push_back(INFINITY);
+        }
+    }
+
+    Trapezoid TrapezoidStreams::Get(size_t index) const
+    {
+        Trapezoid t{};
+        t.XTL = xtl[index];
+        t.XTR = xtr[index];
+        t.YT = yt[index];
+        t.XBL = xbl[index];
+        t.XBR = xbr[index];
+        t.YB = yb[index];
+        return t;
+    }
+
+    size_t TrapezoidStreams::GetMemoryUsage() const
+    {
+        return (xtl.capacity() + xtr.capacity() + yt.capacity() + xbl.capacity() + xbr.capacity() + yb.capacity()) * sizeof(float);
+    }
+
+    uint32_t FindContainingTrapezoid(const TrapezoidStreams& streams, uint32_t begin, uint32_t end, const Vec2f& p)
+    {
+        end = std::min(end, static_cast<uint32_t>(streams.size()));
+        if (begin >= end) return INVALID_INDEX;
+        switch (GetKernelLevel()) {
+#if PATHING_KERNELS_X86
+            case KernelLevel::AVX:
+                return detail::FindContainingAvx(GetPointers(streams), begin, end, p.x, p.y);
+            case KernelLevel::SSE2:
+                return detail::FindContaining<Sse2>(GetPointers(streams), begin, end, p.x, p.y);
+#endif
+            default:
+                for (uint32_t i = begin; i < end; ++i) {
+                    if (IsOnTrapezoid(streams.Get(i), p)) return i;
+                }
+                return INVALID_INDEX;
+        }
+    }
+
+    ClosestTrapezoid FindClosestTrapezoid(const TrapezoidStreams& streams, uint32_t begin, uint32_t end, const Vec2f& p)
+    {
+        end = std::min(end, static_cast<uint32_t>(streams.size()));
+        if (begin >= end) return {};
+        detail::ClosestLane closest;
+        switch (GetKernelLevel()) {
+#if PATHING_KERNELS_X86
+            case KernelLevel::AVX:
+                closest = detail::FindClosestAvx(GetPointers(streams), begin, end, p.x, p.y);
+                break;
+            case KernelLevel::SSE2:
+                closest = detail::FindClosest<Sse2>(GetPointers(streams), begin, end, p.x, p.y);
+                break;
+#endif
+            default: {
+                closest = {INVALID_INDEX, 0, INFINITY};
+                for (uint32_t i = begin; i < end; ++i) {
+                    uint32_t edge;
+                    const float d = GetDistanceFromTrapezoid(streams.Get(i), p, &edge);
+                    if (d < closest.distance) closest = {i, edge, d};
+                }
+            }
+        }
+        return {closest.index, closest.edge, closest.distance};
+    }
+} // namespace Pathing
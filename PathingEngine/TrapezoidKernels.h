@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+#include "MapQueries.h"
+
+// =============================================================================
+// Trapezoid kernels
+//
+// Trapezoid geometry as structure of arrays: one stream per coordinate
+// (XTL, XTR, YT, XBL, XBR, YB), so containment and edge distance can be
+// worked out for 4 (SSE2) or 8 (AVX) trapezoids at once.
+//
+// The SIMD kernels do the same float operations in the same order as
+// IsOnTrapezoid() and GetDistanceFromTrapezoid(), so every level returns
+// exactly what the scalar code returns; PathingBench --lookups checks this.
+// The level is picked from the CPU at startup; SetKernelLevel() forces a
+// lower one for comparing.
+// =============================================================================
+
+namespace Pathing {
+    enum class KernelLevel : uint8_t { Scalar, SSE2, AVX };
+
+    // Best level this build and CPU support
+    KernelLevel GetBestKernelLevel();
+    KernelLevel GetKernelLevel();
+    // Clamped to GetBestKernelLevel()
+    void SetKernelLevel(KernelLevel level);
+    const char* GetKernelLevelName(KernelLevel level);
+
+    class TrapezoidStreams {
+    public:
+        // Kernels read whole vectors; the streams end in this many padding trapezoids
+        static constexpr size_t PADDING = 8;
+
+        void Reserve(size_t count);
+        void Push(const Trapezoid& t);
+        // Call once after the last Push()
+        void Finish();
+
+        size_t size() const { return m_size; }
+        Trapezoid Get(size_t index) const;
+        size_t GetMemoryUsage() const;
+
+        std::vector<float> xtl, xtr, yt, xbl, xbr, yb;
+
+    private:
+        size_t m_size = 0;
+    };
+
+    struct ClosestTrapezoid {
+        uint32_t index = INVALID_INDEX; // into the streams
+        uint32_t edge = 0;              // as in GetDistanceFromTrapezoid
+        float distance = INFINITY;
+    };
+
+    // First index in [begin, end) whose trapezoid contains p (IsOnTrapezoid), or INVALID_INDEX
+    uint32_t FindContainingTrapezoid(const TrapezoidStreams& streams, uint32_t begin, uint32_t end, const Vec2f& p);
+    // Closest trapezoid in [begin, end) by GetDistanceFromTrapezoid; the lowest index on ties
+    ClosestTrapezoid FindClosestTrapezoid(const TrapezoidStreams& streams, uint32_t begin, uint32_t end, const Vec2f& p);
+} // namespace Pathing
@@ -0,0 +1,40 @@
+// Compiled with AVX enabled (/arch:AVX, -mavx); only called after TrapezoidKernels.cpp found AVX on the CPU.
+// Doesn't include stdafx.h so no standard library code gets compiled for AVX here.
+
+#include "TrapezoidKernelsSimd.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <immintrin.h>
+
+namespace {
+    struct Avx {
+        using Type = __m256;
+        static constexpr uint32_t width = 8;
+        static __m256 Load(const float* p) { return _mm256_loadu_ps(p); }
+        static void Store(float* p, __m256 v) { _mm256_storeu_ps(p, v); }
+        static __m256 Set1(float v) { return _mm256_set1_ps(v); }
+        static __m256 Add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+        static __m256 Sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+        static __m256 Mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+        static __m256 Div(__m256 a, __m256 b) { return _mm256_div_ps(a, b); }
+        static __m256 Sqrt(__m256 a) { return _mm256_sqrt_ps(a); }
+        static __m256 Lt(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static __m256 And(__m256 a, __m256 b) { return _mm256_and_ps(a, b); }
+        static __m256 Or(__m256 a, __m256 b) { return _mm256_or_ps(a, b); }
+        static __m256 Select(__m256 mask, __m256 a, __m256 b) { return _mm256_or_ps(_mm256_and_ps(mask, a), _mm256_andnot_ps(mask, b)); }
+        static uint32_t MoveMask(__m256 mask) { return static_cast<uint32_t>(_mm256_movemask_ps(mask)); }
+    };
+} // namespace
+
+namespace Pathing::detail {
+    uint32_t FindContainingAvx(const StreamPointers& s, uint32_t begin, uint32_t end, float x, float y)
+    {
+        return FindContaining<Avx>(s, begin, end, x, y);
+    }
+
+    ClosestLane FindClosestAvx(const StreamPointers& s, uint32_t begin, uint32_t end, float x, float y)
+    {
+        return FindClosest<Avx>(s, begin, end, x, y);
+    }
+} // namespace Pathing::detail
+#endif
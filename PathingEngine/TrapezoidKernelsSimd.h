@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// =============================================================================
+// SIMD trapezoid kernels, shared by the SSE2 and AVX builds.
+//
+// Included by TrapezoidKernels.cpp (SSE2) and TrapezoidKernelsAvx.cpp, which
+// is compiled for AVX. Everything here is a template over a vector type V
+// supplied by the including file, so nothing compiled for AVX can end up
+// being called on a CPU without it. Don't use the standard library in here
+// for the same reason.
+//
+// V provides: width, Load, Set1, arithmetic and comparison operators as
+// static functions (Add, Sub, Mul, Div, Sqrt, Lt, And, Or, Select(mask, a, b),
+// Store, MoveMask).
+// =============================================================================
+
+namespace Pathing::detail {
+    // INVALID_INDEX, without including PathingMapData.h here
+    constexpr uint32_t NO_INDEX = 0xFFFFFFFF;
+
+    struct StreamPointers {
+        const float* xtl;
+        const float* xtr;
+        const float* yt;
+        const float* xbl;
+        const float* xbr;
+        const float* yb;
+    };
+
+    struct ClosestLane {
+        uint32_t index;
+        uint32_t edge;
+        float distance;
+    };
+
+    // Lanes at and past count are off. Templates, like everything else in here, so each build has its own copy.
+    template <uint32_t width>
+    uint32_t LaneMask(uint32_t count)
+    {
+        return count >= width ? (1u << width) - 1 : (1u << count) - 1;
+    }
+
+    template <uint32_t width>
+    uint32_t LowestLane(uint32_t mask)
+    {
+        uint32_t lane = 0;
+        while (!(mask & 1u)) {
+            mask >>= 1;
+            lane++;
+        }
+        return lane;
+    }
+
+    // IsOnTrapezoid, lane by lane
+    template <typename V>
+    uint32_t FindContaining(const StreamPointers& s, uint32_t begin, uint32_t end, float x, float y)
+    {
+        using T = typename V::Type;
+        const T px = V::Set1(x), py = V::Set1(y);
+        const T tolerance = V::Set1(-1.0f);
+        for (uint32_t i = begin; i < end; i += V::width) {
+            const T xtl = V::Load(s.xtl + i), xtr = V::Load(s.xtr + i), yt = V::Load(s.yt + i);
+            const T xbl = V::Load(s.xbl + i), xbr = V::Load(s.xbr + i), yb = V::Load(s.yb + i);
+
+            T fail = V::Or(V::Lt(yt, py), V::Lt(py, yb));
+            fail = V::Or(fail, V::And(V::Lt(px, xbl), V::Lt(px, xtl)));
+            fail = V::Or(fail, V::And(V::Lt(xbr, px), V::Lt(xtr, px)));
+            // Cross(b - a, p - a) with a top left, b bottom left
+            const T ab_x = V::Sub(xbl, xtl), ab_y = V::Sub(yb, yt);
+            const T pa_x = V::Sub(px, xtl), pa_y = V::Sub(py, yt);
+            fail = V::Or(fail, V::Lt(V::Sub(V::Mul(ab_x, pa_y), V::Mul(ab_y, pa_x)), tolerance));
+            // Cross(d - c, p - c) with c bottom right, d top right
+            const T cd_x = V::Sub(xtr, xbr), cd_y = V::Sub(yt, yb);
+            const T pc_x = V::Sub(px, xbr), pc_y = V::Sub(py, yb);
+            fail = V::Or(fail, V::Lt(V::Sub(V::Mul(cd_x, pc_y), V::Mul(cd_y, pc_x)), tolerance));
+
+            const uint32_t inside = ~V::MoveMask(fail) & LaneMask<V::width>(end - i);
+            if (inside) return i + LowestLane<V::width>(inside);
+        }
+        return NO_INDEX;
+    }
+
+    // GetDistanceFromLine, lane by lane
+    template <typename V>
+    typename V::Type LineDistance(typename V::Type a1_x, typename V::Type a1_y, typename V::Type a2_x, typename V::Type a2_y, typename V::Type px, typename V::Type py)
+    {
+        using T = typename V::Type;
+        const T zero = V::Set1(0.f), one = V::Set1(1.f);
+        const T ba_x = V::Sub(a2_x, a1_x), ba_y = V::Sub(a2_y, a1_y);
+        const T pa_x = V::Sub(px, a1_x), pa_y = V::Sub(py, a1_y);
+        const T len = V::Add(V::Mul(ba_x, ba_x), V::Mul(ba_y, ba_y));
+        const T v = V::Div(V::Add(V::Mul(pa_x, ba_x), V::Mul(pa_y, ba_y)), len);
+        // std::clamp(v, 0, 1), including which zero it gives back
+        const T clamped = V::Select(V::Lt(v, zero), zero, V::Select(V::Lt(one, v), one, v));
+        const T h = V::Select(V::Lt(zero, len), clamped, zero);
+        const T q_x = V::Sub(pa_x, V::Mul(h, ba_x)), q_y = V::Sub(pa_y, V::Mul(h, ba_y));
+        return V::Sqrt(V::Add(V::Mul(q_x, q_x), V::Mul(q_y, q_y)));
+    }
+
+    // GetDistanceFromTrapezoid, lane by lane. Each lane keeps the first closest trapezoid it saw; the lanes are
+    // reduced once at the end, lowest index on ties, which is what a scan in index order finds.
+    // Indices are carried as floats, exact below 2^24.
+    template <typename V>
+    ClosestLane FindClosest(const StreamPointers& s, uint32_t begin, uint32_t end, float x, float y)
+    {
+        using T = typename V::Type;
+        const T px = V::Set1(x), py = V::Set1(y);
+        const T last = V::Set1(static_cast<float>(end));
+        T best_distance = V::Set1(INFINITY), best_index = V::Set1(0.f), best_edge = V::Set1(0.f);
+        alignas(32) float lane_offsets[V::width];
+        for (uint32_t lane = 0; lane < V::width; ++lane) {
+            lane_offsets[lane] = static_cast<float>(lane);
+        }
+        T index = V::Add(V::Set1(static_cast<float>(begin)), V::Load(lane_offsets));
+        const T step = V::Set1(static_cast<float>(V::width));
+        for (uint32_t i = begin; i < end; i += V::width) {
+            const T xtl = V::Load(s.xtl + i), xtr = V::Load(s.xtr + i), yt = V::Load(s.yt + i);
+            const T xbl = V::Load(s.xbl + i), xbr = V::Load(s.xbr + i), yb = V::Load(s.yb + i);
+
+            // Edges in the order of GetDistanceFromTrapezoid: top, right, bottom, left
+            T closest = LineDistance<V>(xtl, yt, xtr, yt, px, py);
+            T edge = V::Set1(0.f);
+            const T d1 = LineDistance<V>(xtr, yt, xbr, yb, px, py);
+            T closer = V::Lt(d1, closest);
+            closest = V::Select(closer, d1, closest);
+            edge = V::Select(closer, V::Set1(1.f), edge);
+            const T d2 = LineDistance<V>(xbr, yb, xbl, yb, px, py);
+            closer = V::Lt(d2, closest);
+            closest = V::Select(closer, d2, closest);
+            edge = V::Select(closer, V::Set1(2.f), edge);
+            const T d3 = LineDistance<V>(xbl, yb, xtl, yt, px, py);
+            closer = V::Lt(d3, closest);
+            closest = V::Select(closer, d3, closest);
+            edge = V::Select(closer, V::Set1(3.f), edge);
+
+            const T better = V::And(V::Lt(closest, best_distance), V::Lt(index, last));
+            best_distance = V::Select(better, closest, best_distance);
+            best_index = V::Select(better, index, best_index);
+            best_edge = V::Select(better, edge, best_edge);
+            index = V::Add(index, step);
+        }
+
+        alignas(32) float distances[V::width];
+        alignas(32) float indices[V::width];
+        alignas(32) float edges[V::width];
+        V::Store(distances, best_distance);
+        V::Store(indices, best_index);
+        V::Store(edges, best_edge);
+        ClosestLane best{NO_INDEX, 0, INFINITY};
+        for (uint32_t lane = 0; lane < V::width; ++lane) {
+            const auto lane_index = static_cast<uint32_t>(indices[lane]);
+            if (distances[lane] < best.distance || (distances[lane] == best.distance && lane_index < best.index)) {
+                best = {lane_index, static_cast<uint32_t>(edges[lane]), distances[lane]};
+            }
+        }
+        return best;
+    }
+
+    // Defined in TrapezoidKernelsAvx.cpp; only call when the CPU has AVX
+    uint32_t FindContainingAvx(const StreamPointers& s, uint32_t begin, uint32_t end, float x, float y);
+    ClosestLane FindClosestAvx(const StreamPointers& s, uint32_t begin, uint32_t end, float x, float y);
+} // namespace Pathing::detail
@@ -0,0 +1,1232 @@
+#include "stdafx.h"
+
+#include "VisGraph.h"
+
+namespace {
+    using namespace Pathing;
+
+    // Portals flagged with this are not used for path finding by the game either
+    constexpr uint8_t PORTAL_FLAG_NOT_PATHABLE = 0x4;
+
+    // Source points per unit of work when generating the visibility graph
+    constexpr uint32_t VIS_GRAPH_BATCH_SIZE = 64;
+
+    // Given three collinear points p, q, r, the function checks if
+    // point q lies on line segment 'pr'
+    inline bool onSegment(const Vec2f& p, const Vec2f& q, const Vec2f& r)
+    {
+        return q.x <= std::max(p.x, r.x) && q.x >= std::min(p.x, r.x) && q.y <= std::max(p.y, r.y) && q.y >= std::min(p.y, r.y);
+    }
+
+    inline bool between(float x, float min, float max)
+    {
+        if (min <= max)
+            return min <= x && x <= max;
+        return min >= x && x >= max;
+    }
+
+    inline bool IsDegenerate(const Trapezoid& t)
+    {
+        return t.YB == t.YT;
+    }
+
+    typedef std::pair<float, PointId> PQElement;
+    class MyPQueue : public std::priority_queue<PQElement, std::vector<PQElement>, std::greater<PQElement>> {
+    public:
+        MyPQueue(size_t reserve_size) { this->c.reserve(reserve_size); }
+    };
+} // namespace
+
+namespace Pathing {
+    struct VisGraph::Node {
+        BlockedPlaneBitset blocked_planes;
+        size_t visited_checkpoint; // rollback checkpoint
+        Vec2f funnel[2];
+        PortalId next;
+    };
+
+    struct VisGraph::VisitedState {
+        std::vector<uint16_t> visited; // size = portals.size()
+        std::vector<PortalId> stack;   // change history
+        uint16_t stamp = 1;
+
+        void init(size_t n)
+        {
+            visited.resize(n);
+            stack.reserve(2048);
+            stamp = 1;
+        }
+
+        bool is_visited(PortalId id) const { return visited[id] == stamp; }
+
+        void visit(PortalId id)
+        {
+            if (visited[id] != stamp) {
+                visited[id] = stamp;
+                stack.push_back(id);
+            }
+        }
+
+        // Starts a new search without clearing the visited array
+        void next()
+        {
+            stack.clear();
+            if (++stamp == 0) { // overflow safety
+                std::ranges::fill(visited, 0);
+                stamp = 1;
+            }
+        }
+
+        size_t checkpoint() const { return stack.size(); }
+
+        void rollback(size_t checkpoint)
+        {
+            while (stack.size() > checkpoint) {
+                visited[stack.back()] = 0;
+                stack.pop_back();
+            }
+        }
+    };
+
+    struct VisGraph::VisitedPoints {
+        std::vector<uint32_t> gen;
+        uint32_t cur = 1;
+
+        void init(size_t n)
+        {
+            gen.resize(n);
+            cur = 1;
+        }
+
+        void reset()
+        {
+            ++cur;
+            if (cur == 0) { // overflow safety
+                std::ranges::fill(gen, 0);
+                cur = 1;
+            }
+        }
+
+        bool test_and_set(PointId id)
+        {
+            if (gen[id] == cur) return false;
+            gen[id] = cur;
+            return true;
+        }
+    };
+
+    struct VisGraph::VisibilityScratch {
+        std::vector<Node> open;   // DFS stack
+        VisitedState visited;     // portals (rollback)
+        VisitedPoints vis_points; // points (per source)
+
+        void init(size_t portal_count, size_t point_count)
+        {
+            open.resize(2000); // max DFS depth
+            visited.init(portal_count);
+            vis_points.init(point_count);
+        }
+    };
+
+    // Edges of one batch of source points. Until merged, GraphEdge::blocked_planes indexes the batch's own masks.
+    struct VisGraph::EdgeBatch {
+        std::vector<GraphEdge> edges;
+        std::vector<BlockedPlaneBitset> masks;
+    };
+
+    VisGraph::VisGraph(PathingMapData map)
+        : m_map(std::move(map)),
+          m_grid(m_map)
+    {
+        uint32_t total = 0;
+        m_plane_offsets.reserve(m_map.planes.size());
+        for (size_t i = 0; i < m_map.planes.size(); ++i) {
+            m_plane_offsets.push_back(total);
+            total += static_cast<uint32_t>(m_map.planes[i].trapezoids.size());
+            m_trapezoid_plane.resize(total, static_cast<uint8_t>(i));
+        }
+    }
+
+    uint32_t VisGraph::GetAdjacent(uint32_t id, uint32_t slot) const
+    {
+        const auto plane = m_trapezoid_plane[id];
+        const auto adjacent = GetTrapezoid(id).neighbors[slot];
+        if (adjacent >= m_map.planes[plane].trapezoids.size()) return INVALID_INDEX;
+        return m_plane_offsets[plane] + adjacent;
+    }
+
+    // Portals on different planes are paired by their shared id
+    void VisGraph::GeneratePortalPairs()
+    {
+        const auto key = [](uint64_t plane, uint64_t neighbor_plane, uint64_t shared_id) {
+            return (plane << 32) | (neighbor_plane << 16) | shared_id;
+        };
+        std::unordered_map<uint64_t, uint32_t> by_key;
+        for (size_t plane = 0; plane < m_map.planes.size(); ++plane) {
+            const auto& map_portals = m_map.planes[plane].portals;
+            for (uint32_t i = 0; i < map_portals.size(); ++i) {
+                if (map_portals[i].shared_id == INVALID_INDEX16) continue;
+                by_key.emplace(key(plane, map_portals[i].neighbor_plane, map_portals[i].shared_id), i);
+            }
+        }
+
+        m_portal_pairs.resize(m_map.planes.size());
+        for (size_t plane = 0; plane < m_map.planes.size(); ++plane) {
+            const auto& map_portals = m_map.planes[plane].portals;
+            m_portal_pairs[plane].assign(map_portals.size(), INVALID_INDEX);
+            for (uint32_t i = 0; i < map_portals.size(); ++i) {
+                const auto& portal = map_portals[i];
+                if (portal.shared_id == INVALID_INDEX16 || portal.neighbor_plane >= m_map.planes.size()) continue;
+                const auto found = by_key.find(key(portal.neighbor_plane, plane, portal.shared_id));
+                if (found != by_key.end()) m_portal_pairs[plane][i] = found->second;
+            }
+        }
+    }
+
+    void VisGraph::GetTrapezoidNeighbours(uint32_t id, std::vector<Neighbour>& neighbours)
+    {
+        const auto& trapezoid = GetTrapezoid(id);
+        if (IsDegenerate(trapezoid)) return;
+
+        auto& visited = m_neighbours_visited;
+        auto& to_explore = m_neighbours_to_explore;
+        if (++m_neighbours_stamp == 0) { // overflow safety
+            std::ranges::fill(visited, 0);
+            m_neighbours_stamp = 1;
+        }
+        const auto stamp = m_neighbours_stamp;
+
+        to_explore.clear();
+        to_explore.push_back(id);
+        visited[id] = stamp;
+
+        // Walks the trapezoids on the other side of a portal. is_left tells which side of trapezoid the portal is on.
+        const auto process_portal = [&](uint32_t plane, uint16_t portal_index, bool is_left) {
+            if (portal_index >= m_map.planes[plane].portals.size()) return;
+            const auto pair_index = m_portal_pairs[plane][portal_index];
+            if (pair_index == INVALID_INDEX) return;
+            const auto pair_plane = m_map.planes[plane].portals[portal_index].neighbor_plane;
+            const auto& pair_nav = m_map.planes[pair_plane];
+            const auto& pair = pair_nav.portals[pair_index];
+            if (pair.flags & PORTAL_FLAG_NOT_PATHABLE) return;
+
+            const uint32_t end = std::min<uint32_t>(pair.trapezoid_index_start + pair.trapezoid_count, static_cast<uint32_t>(pair_nav.portal_trapezoid_indices.size()));
+            for (uint32_t i = pair.trapezoid_index_start; i < end; ++i) {
+                const auto index = pair_nav.portal_trapezoid_indices[i];
+                if (index >= pair_nav.trapezoids.size()) continue;
+                const auto other_id = m_plane_offsets[pair_plane] + index;
+                if (visited[other_id] == stamp) continue;
+                const auto& other = pair_nav.trapezoids[index];
+                if (is_left) {
+                    if (IsDegenerate(other)) {
+                        if (between(trapezoid.XTL, other.XBL, other.XBR) || between(trapezoid.XTR, other.XBL, other.XBR) || between(other.XBR, trapezoid.XTL, trapezoid.XTR) || between(other.XBL, trapezoid.XTL, trapezoid.XTR)) {
+                            to_explore.push_back(other_id);
+                            visited[other_id] = stamp;
+                        }
+                    }
+                    else if (onSegment({trapezoid.XTL, trapezoid.YT}, {other.XTR, other.YT}, {trapezoid.XBL, trapezoid.YB}) || onSegment({trapezoid.XTL, trapezoid.YT}, {other.XBR, other.YB}, {trapezoid.XBL, trapezoid.YB}) ||
+                             onSegment({other.XTR, other.YT}, {trapezoid.XTL, trapezoid.YT}, {other.XBR, other.YB})) {
+                        neighbours.emplace_back(other_id, static_cast<uint8_t>(pair_plane), Edge::left);
+                        visited[other_id] = stamp;
+                    }
+                }
+                else {
+                    if (IsDegenerate(other)) {
+                        if (between(trapezoid.XBL, other.XTL, other.XTR) || between(trapezoid.XBR, other.XTL, other.XTR) || between(other.XTR, trapezoid.XBL, trapezoid.XBR) || between(other.XTL, trapezoid.XBL, trapezoid.XBR)) {
+                            to_explore.push_back(other_id);
+                            visited[other_id] = stamp;
+                        }
+                    }
+                    else if (onSegment({trapezoid.XTR, trapezoid.YT}, {other.XTL, other.YT}, {trapezoid.XBR, trapezoid.YB}) || onSegment({trapezoid.XTR, trapezoid.YT}, {other.XBL, other.YB}, {trapezoid.XBR, trapezoid.YB}) ||
+                             onSegment({other.XTL, other.YT}, {trapezoid.XTR, trapezoid.YT}, {other.XBL, other.YB})) {
+                        neighbours.emplace_back(other_id, static_cast<uint8_t>(pair_plane), Edge::right);
+                        visited[other_id] = stamp;
+                    }
+                }
+            }
+        };
+
+        while (!to_explore.empty()) {
+            const auto current = to_explore.back();
+            to_explore.pop_back();
+
+            const auto plane = m_trapezoid_plane[current];
+            const auto& t = GetTrapezoid(current);
+            process_portal(plane, t.portal_left, true);
+            process_portal(plane, t.portal_right, false);
+
+            for (uint32_t slot = 0; slot < 4; ++slot) {
+                const auto adjacent = GetAdjacent(current, slot);
+                if (adjacent == INVALID_INDEX || visited[adjacent] == stamp) continue;
+                visited[adjacent] = stamp;
+                if (IsDegenerate(GetTrapezoid(adjacent))) {
+                    to_explore.push_back(adjacent);
+                }
+                else {
+                    neighbours.emplace_back(adjacent, plane, slot < 2 ? Edge::top : Edge::bottom);
+                }
+            }
+        }
+    }
+
+    bool VisGraph::IsNeighbourOf(uint32_t id1, uint32_t id2)
+    {
+        if (id1 == INVALID_INDEX) return false;
+        auto& neighbours = m_is_neighbour_of;
+        neighbours.clear();
+        GetTrapezoidNeighbours(id1, neighbours);
+        return std::ranges::any_of(neighbours, [&](const auto& n) {
+            return n.trapezoid == id2;
+        });
+    }
+
+    void VisGraph::CreatePortalPair(uint32_t pt1, uint8_t pt1_layer, uint32_t pt2, uint8_t pt2_layer, Vec2f p1, bool p1_viability, Vec2f p2, bool p2_viability)
+    {
+        const auto id = static_cast<PortalId>(portals.size());
+        const auto p_id = static_cast<PointId>(points.size());
+
+        points.push_back({p1, {id, static_cast<PortalId>(id + 1)}, p_id, p1_viability});
+        points.push_back({p2, {id, static_cast<PortalId>(id + 1)}, static_cast<PointId>(p_id + 1), p2_viability});
+
+        portals.push_back({pt1, {p_id, static_cast<PointId>(p_id + 1)}, id, static_cast<PortalId>(id + 1), pt1_layer});
+        portals.push_back({pt2, {static_cast<PointId>(p_id + 1), p_id}, static_cast<PortalId>(id + 1), id, pt2_layer});
+
+        pt_portal_map[pt1].push_back(id);
+        pt_portal_map[pt2].push_back(id + 1);
+        portal_pt_map.push_back(pt1);
+        portal_pt_map.push_back(pt2);
+    }
+
+    void VisGraph::LinkTrapezoids(uint32_t id1, uint8_t pt1_layer, const Neighbour& n)
+    {
+        constexpr float tolerance = 0.1f;
+
+        const auto& pt1 = GetTrapezoid(id1);
+        const uint32_t id2 = n.trapezoid;
+        const auto& pt2 = GetTrapezoid(id2);
+        const uint8_t pt2_layer = n.layer;
+        const Edge edge = n.loc; // neighbour location relative to pt1
+
+        // adjacency slots of Trapezoid::neighbors
+        constexpr uint32_t top_left = 0, top_right = 1, bottom_left = 2, bottom_right = 3;
+
+        /* Definitions of portals and points
+                   \        \
+               _____\a......b\____
+               |                 a|___
+           ____|b                 .
+               .                  .
+               .                 b.___
+           ____.a                 |
+               |____b..........a__|
+                    /         /
+        */
+
+        bool point1_viability = false;
+        bool point2_viability = false;
+
+        if (edge == Edge::top) {
+            if (pt1.YT != pt2.YB) return;
+
+            const auto ax = std::max(pt1.XTL, pt2.XBL);
+            const auto bx = std::min(pt1.XTR, pt2.XBR);
+            if (fabsf(ax - bx) < tolerance) return;
+
+            const auto a = Vec2f{ax, pt1.YT};
+            const auto b = Vec2f{bx, pt1.YT};
+
+            if (pt1.XTL != pt2.XBL) { // Top left trapezoid is longer or shorter than pt1.
+                point1_viability = true;
+            }
+            else {
+                const auto dtl = Vec2f{pt2.XTL, pt2.YT} - a;
+                const auto dbl = Vec2f{pt1.XBL, pt1.YB} - a;
+                point1_viability = Cross(dtl, dbl) > tolerance; // determine if they form convex shape
+                if (Cross(dtl, dbl) < -tolerance) {
+                    point1_viability |= pt1.portal_left != INVALID_INDEX16;
+                    point1_viability |= pt2.portal_left != INVALID_INDEX16;
+                }
+            }
+
+            if (pt1.XTR != pt2.XBR) { // Top right trapezoid is longer or shorter than pt1.
+                point2_viability = true;
+            }
+            else {
+                const auto dtr = Vec2f{pt2.XTR, pt2.YT} - b;
+                const auto dbr = Vec2f{pt1.XBR, pt1.YB} - b;
+                point2_viability = Cross(dtr, dbr) < -tolerance; // determine if they form convex shape
+                if (Cross(dtr, dbr) > tolerance) {
+                    point2_viability |= pt1.portal_right != INVALID_INDEX16;
+                    point2_viability |= pt2.portal_right != INVALID_INDEX16;
+                }
+            }
+
+            CreatePortalPair(id1, pt1_layer, id2, pt2_layer, a, point1_viability, b, point2_viability);
+        }
+        else if (edge == Edge::bottom) {
+            if (pt1.YB != pt2.YT) return;
+
+            const auto ax = std::min(pt1.XBR, pt2.XTR);
+            const auto bx = std::max(pt1.XBL, pt2.XTL);
+            if (fabsf(ax - bx) < tolerance) return;
+
+            const auto a = Vec2f{ax, pt1.YB};
+            const auto b = Vec2f{bx, pt1.YB};
+
+            if (pt1.XBR != pt2.XTR) { // Bottom right trapezoid is longer or shorter than pt1.
+                point1_viability = true;
+            }
+            else {
+                const auto dtr = Vec2f{pt1.XTR, pt1.YT} - a;
+                const auto dbr = Vec2f{pt2.XBR, pt2.YB} - a;
+                point1_viability = Cross(dtr, dbr) < -tolerance;
+                if (Cross(dtr, dbr) > tolerance) {
+                    point1_viability |= pt1.portal_right != INVALID_INDEX16;
+                    point1_viability |= pt2.portal_right != INVALID_INDEX16;
+                }
+            }
+
+            if (pt1.XBL != pt2.XTL) { // Bottom left trapezoid is longer or shorter than pt1.
+                point2_viability = true;
+            }
+            else {
+                const auto dtl = Vec2f{pt1.XTL, pt1.YT} - b;
+                const auto dbl = Vec2f{pt2.XBL, pt2.YB} - b;
+                point2_viability = Cross(dtl, dbl) > tolerance;
+                if (Cross(dtl, dbl) < -tolerance) {
+                    point2_viability |= pt1.portal_left != INVALID_INDEX16;
+                    point2_viability |= pt2.portal_left != INVALID_INDEX16;
+                }
+            }
+
+            CreatePortalPair(id1, pt1_layer, id2, pt2_layer, a, point1_viability, b, point2_viability);
+        }
+        else if (edge == Edge::left) {
+            if (pt1.YT < pt2.YB || pt1.YB > pt2.YT) return;
+
+            const Vec2f a = pt1.YB <= pt2.YB ? Vec2f{pt2.XBR, pt2.YB} : Vec2f{pt1.XBL, pt1.YB};
+            const Vec2f b = pt1.YT <= pt2.YT ? Vec2f{pt1.XTL, pt1.YT} : Vec2f{pt2.XTR, pt2.YT};
+
+            if (pt1.YB < pt2.YB) { // bottom of trapezoid on left of pt1 is higher.
+                point1_viability = !(IsNeighbourOf(GetAdjacent(id2, bottom_left), id1) || IsNeighbourOf(GetAdjacent(id2, bottom_right), id1));
+            }
+            else if (pt1.YB > pt2.YB) { // bottom of trapezoid on left of pt1 is lower.
+                point1_viability = !(IsNeighbourOf(GetAdjacent(id1, bottom_left), id2) || IsNeighbourOf(GetAdjacent(id1, bottom_right), id2));
+            }
+            else {
+                point1_viability = pt1_layer != pt2_layer;
+            }
+
+            if (pt1.YT < pt2.YT) { // top of trapezoid on left of pt1 is higher.
+                point2_viability = !(IsNeighbourOf(GetAdjacent(id1, top_left), id2) || IsNeighbourOf(GetAdjacent(id1, top_right), id2));
+            }
+            else if (pt1.YT > pt2.YT) { // top of trapezoid on left of pt1 is lower.
+                point2_viability = !(IsNeighbourOf(GetAdjacent(id2, top_left), id1) || IsNeighbourOf(GetAdjacent(id2, top_right), id1));
+            }
+            else {
+                point2_viability = pt1_layer != pt2_layer;
+            }
+
+            CreatePortalPair(id1, pt1_layer, id2, pt2_layer, a, point1_viability, b, point2_viability);
+        }
+        else if (edge == Edge::right) {
+            if (pt1.YT < pt2.YB || pt1.YB > pt2.YT) return;
+
+            const Vec2f a = pt1.YT <= pt2.YT ? Vec2f{pt1.XTR, pt1.YT} : Vec2f{pt2.XTL, pt2.YT};
+            const Vec2f b = pt1.YB <= pt2.YB ? Vec2f{pt2.XBL, pt2.YB} : Vec2f{pt1.XBR, pt1.YB};
+
+            if (pt1.YT < pt2.YT) { // top of trapezoid on right of pt1 is higher.
+                point1_viability = !(IsNeighbourOf(GetAdjacent(id1, top_left), id2) || IsNeighbourOf(GetAdjacent(id1, top_right), id2));
+            }
+            else if (pt1.YT > pt2.YT) { // top of trapezoid on right of pt1 is lower.
+                point1_viability = !(IsNeighbourOf(GetAdjacent(id2, top_left), id1) || IsNeighbourOf(GetAdjacent(id2, top_right), id1));
+            }
+            else {
+                point1_viability = pt1_layer != pt2_layer;
+            }
+
+            if (pt1.YB < pt2.YB) { // bottom of trapezoid on right of pt1 is higher.
+                point2_viability = !(IsNeighbourOf(GetAdjacent(id2, bottom_left), id1) || IsNeighbourOf(GetAdjacent(id2, bottom_right), id1));
+            }
+            else if (pt1.YB > pt2.YB) { // bottom of trapezoid on right of pt1 is lower.
+                point2_viability = !(IsNeighbourOf(GetAdjacent(id1, bottom_left), id2) || IsNeighbourOf(GetAdjacent(id1, bottom_right), id2));
+            }
+            else {
+                point2_viability = pt1_layer != pt2_layer;
+            }
+
+            CreatePortalPair(id1, pt1_layer, id2, pt2_layer, a, point1_viability, b, point2_viability);
+        }
+    }
+
+    void VisGraph::GenerateTrapezoidNeighbours()
+    {
+        const auto trapezoid_count = m_trapezoid_plane.size();
+        m_neighbours_visited.assign(trapezoid_count, 0);
+        m_neighbours_stamp = 0;
+
+        ptneighbours.clear();
+        ptneighbours.resize(trapezoid_count);
+        for (uint32_t id = 0; id < trapezoid_count; ++id) {
+            GetTrapezoidNeighbours(id, ptneighbours[id]);
+        }
+    }
+
+    bool VisGraph::GeneratePortals()
+    {
+        const auto trapezoid_count = m_trapezoid_plane.size();
+        const auto reserved_points = static_cast<size_t>(trapezoid_count * 2.2) + m_teleports.size() * 2;
+        points.clear();
+        points.reserve(reserved_points);
+        portals.clear();
+        portals.reserve(reserved_points);
+        portal_pt_map.clear();
+        portal_pt_map.reserve(reserved_points);
+        pt_portal_map.clear();
+        pt_portal_map.resize(trapezoid_count);
+
+        // Each pair of neighbours is only linked once
+        std::unordered_set<uint64_t> linked;
+        linked.reserve(trapezoid_count * 4);
+
+        // PointId and PortalId are 16 bit; leave room for teleports plus start and goal
+        const size_t max_points = 0xFFFF - m_teleports.size() * 2 - 2;
+
+        for (uint32_t id = 0; id < trapezoid_count; ++id) {
+            for (const auto& n : ptneighbours[id]) {
+                const uint64_t lo = std::min(id, n.trapezoid), hi = std::max(id, n.trapezoid);
+                if (!linked.insert(lo << 32 | hi).second) continue;
+
+                LinkTrapezoids(id, m_trapezoid_plane[id], n);
+                if (points.size() > max_points) return false;
+            }
+        }
+
+        portal_portal_map.clear();
+        portal_portal_map.resize(portals.size());
+        for (size_t pid = 0; pid < portals.size(); ++pid) {
+            portal_portal_map[pid] = pt_portal_map[portal_pt_map[pid]];
+        }
+        return true;
+    }
+
+    // Generate distance graph among teleports
+    void VisGraph::GenerateTeleportGraph()
+    {
+        m_defferedPortalLinks.clear();
+        for (const auto& teleport : m_teleports) {
+            auto enter_pos = teleport.enter;
+            const auto enter = m_grid.FindClosestPositionOnTrapezoid(enter_pos);
+            if (!enter.IsValid()) continue;
+            auto exit_pos = teleport.exit;
+            const auto exit = m_grid.FindClosestPositionOnTrapezoid(exit_pos);
+            if (!exit.IsValid()) continue;
+
+            const auto enter_point = CreateSinglePointPortal(m_plane_offsets[enter.plane] + enter.index, enter_pos);
+            const auto exit_point = CreateSinglePointPortal(m_plane_offsets[exit.plane] + exit.index, exit_pos);
+            m_defferedPortalLinks.push_back({enter_point.id, exit_point.id, teleport.both_ways});
+        }
+
+        m_teleportGraph.clear();
+
+        const auto size = static_cast<uint32_t>(m_teleports.size());
+        for (uint32_t i = 0; i < size; ++i) {
+            const Vec2f p1_enter = ToVec2f(m_teleports[i].enter), p1_exit = ToVec2f(m_teleports[i].exit);
+            for (uint32_t j = i; j < size; ++j) {
+                const Vec2f p2_enter = ToVec2f(m_teleports[j].enter), p2_exit = ToVec2f(m_teleports[j].exit);
+
+                if (m_teleports[i].both_ways && m_teleports[j].both_ways) {
+                    const float dist = std::min({GetDistance(p1_enter, p2_exit), GetDistance(p1_exit, p2_enter), GetDistance(p1_exit, p2_exit), GetDistance(p1_enter, p2_enter)});
+                    m_teleportGraph.push_back({i, j, dist});
+                    if (i == j) continue;
+                    m_teleportGraph.push_back({j, i, dist});
+                }
+                else if (m_teleports[i].both_ways) {
+                    float dist = std::min(GetDistance(p1_enter, p2_enter), GetDistance(p1_exit, p2_enter));
+                    m_teleportGraph.push_back({i, j, dist});
+                    dist = std::min(GetDistance(p2_exit, p1_enter), GetDistance(p2_exit, p1_exit));
+                    m_teleportGraph.push_back({j, i, dist});
+                }
+                else if (m_teleports[j].both_ways) {
+                    float dist = std::min(GetDistance(p2_enter, p1_enter), GetDistance(p2_exit, p1_enter));
+                    m_teleportGraph.push_back({j, i, dist});
+                    dist = std::min(GetDistance(p1_exit, p2_enter), GetDistance(p1_exit, p2_exit));
+                    m_teleportGraph.push_back({i, j, dist});
+                }
+                else {
+                    float dist = GetDistance(p1_exit, p2_enter);
+                    m_teleportGraph.push_back({i, j, dist});
+                    if (i == j) continue;
+                    dist = GetDistance(p2_exit, p1_enter);
+                    m_teleportGraph.push_back({j, i, dist});
+                }
+            }
+        }
+    }
+
+    void VisGraph::ProcessPortal(std::vector<Node>& open, size_t& sp, VisitedState& visited, const Portal& portal, PortalId other_portal_id) const
+    {
+        const size_t checkpoint = visited.checkpoint();
+
+        visited.visit(portal.id);
+        visited.visit(other_portal_id);
+
+        for (const auto pid : portal_portal_map[portal.id]) {
+            if (pid == portal.id || pid == other_portal_id) continue;
+
+            if (sp >= open.size()) return; // safety guard
+
+            Node& n = open[sp++];
+            n.next = pid;
+            n.visited_checkpoint = checkpoint;
+
+            n.blocked_planes.reset();
+            if (portal.layer) n.blocked_planes.set(portal.layer, true);
+
+            n.funnel[0] = points[portals[pid].points[0]].pos;
+            n.funnel[1] = points[portals[pid].points[1]].pos;
+        }
+    }
+
+    void VisGraph::ProcessPoint(std::vector<Node>& open, size_t& sp, VisitedState& visited, const Point& point) const
+    {
+        ProcessPortal(open, sp, visited, portals[point.portals[0]], point.portals[1]);
+
+        if (point.portals[0] != point.portals[1]) {
+            ProcessPortal(open, sp, visited, portals[point.portals[1]], point.portals[0]);
+        }
+    }
+
+    VisGraph::Point VisGraph::CreateSinglePointPortal(uint32_t trapezoid, const MapPos& pos)
+    {
+        const auto point_id = static_cast<PointId>(points.size());
+        const auto id = static_cast<PortalId>(portals.size());
+        points.push_back({ToVec2f(pos), {id, id}, point_id, true});
+
+        portals.push_back({trapezoid, {point_id, point_id}, id, id, static_cast<uint8_t>(pos.zplane)});
+        portal_pt_map.push_back(trapezoid);
+        portal_portal_map.emplace_back();
+
+        for (const auto pid : pt_portal_map[trapezoid]) {
+            portal_portal_map[id].push_back(pid);
+            portal_portal_map[pid].push_back(id);
+        }
+        pt_portal_map[trapezoid].push_back(id);
+
+        return points[point_id];
+    }
+
+    // Depth first walk through the portals seeded on the open stack, narrowing the funnel as it goes.
+    // Every viable point seen from origin is appended to out, once. to_others[i] is set to the blocked planes on
+    // the way to others[i] as soon as that one is seen. Only reads shared state.
+    void VisGraph::WalkVisibility(const Vec2f& origin, size_t sp, VisibilityScratch& scratch, std::vector<VisElement>& out, std::span<const QueryPoint> others, std::span<std::optional<BlockedPlaneBitset>> to_others) const
+    {
+        auto& open = scratch.open;
+        auto& visited = scratch.visited;
+        auto& vis_points = scratch.vis_points;
+        constexpr float tolerance = 1.0f;
+
+        int cnt = 20000;
+        while (sp && --cnt) {
+            Node cur = open[--sp];
+
+            visited.rollback(cur.visited_checkpoint); // rollback to this node's state
+
+            const auto& portal = portals[cur.next];
+            if (visited.is_visited(portal.id)) continue;
+
+            visited.visit(portal.id);
+
+            if (portal.layer) cur.blocked_planes.set(portal.layer, true);
+
+            const auto& p0 = points[portal.points[0]];
+            const auto& p1 = points[portal.points[1]];
+
+            auto& f0 = cur.funnel[0];
+            auto& f1 = cur.funnel[1];
+
+            const auto fl = f0 - origin;     // funnel left direction
+            const auto fr = f1 - origin;     // funnel right direction
+            const auto nl = p0.pos - origin; // portal left direction
+            const auto nr = p1.pos - origin; // portal right direction
+
+            if (Cross(fr, nl) < -tolerance || Cross(fl, nr) > tolerance) continue;
+
+            if (Cross(fl, nl) <= tolerance) {
+                if (p0.is_viable && vis_points.test_and_set(p0.id)) {
+                    out.push_back({GetDistance(origin, p0.pos), cur.blocked_planes, p0.id});
+                }
+                f0 = p0.pos;
+            }
+
+            if (Cross(fr, nr) >= -tolerance) {
+                if (p1.is_viable && vis_points.test_and_set(p1.id)) {
+                    out.push_back({GetDistance(origin, p1.pos), cur.blocked_planes, p1.id});
+                }
+                f1 = p1.pos;
+            }
+
+            // Other query points aren't part of the graph; check them when entering their trapezoid
+            if (!others.empty()) {
+                const auto entered = portals[portal.other_id].trapezoid;
+                for (size_t i = 0; i < others.size(); ++i) {
+                    const auto& other = others[i];
+                    if (to_others[i] || other.trapezoid != entered) continue;
+                    const auto n = other.pos - origin;
+                    if (Cross(f1 - origin, n) >= -tolerance && Cross(f0 - origin, n) <= tolerance) {
+                        auto blocked = cur.blocked_planes;
+                        if (other.layer) blocked.set(other.layer, true);
+                        to_others[i] = blocked;
+                    }
+                }
+            }
+
+            const size_t checkpoint = visited.checkpoint();
+            visited.visit(portal.other_id);
+
+            for (const auto pid : portal_portal_map[portal.other_id]) {
+                if (visited.is_visited(pid)) continue;
+
+                if (sp >= open.size()) break;
+
+                Node& child = open[sp++];
+                child = cur;
+                child.next = pid;
+                child.visited_checkpoint = checkpoint;
+            }
+        }
+    }
+
+    // Visibility from a point of the graph; only reads shared state, so it can run on several threads at once.
+    void VisGraph::GeneratePointVisibility(const Point& p, VisibilityScratch& scratch, std::vector<VisElement>& out) const
+    {
+        size_t sp = 0;
+        scratch.vis_points.reset();
+        scratch.visited.next();
+
+        ProcessPoint(scratch.open, sp, scratch.visited, p);
+        WalkVisibility(p.pos, sp, scratch, out, {}, {});
+    }
+
+    // Visibility from a search start or goal, without adding it to the graph.
+    // Starts from every portal of the trapezoid the point is on, like a single point portal would.
+    void VisGraph::QueryPointVisibility(const QueryPoint& q, std::span<const QueryPoint> others, VisibilityScratch& scratch, std::vector<VisElement>& out, std::span<std::optional<BlockedPlaneBitset>> to_others) const
+    {
+        size_t sp = 0;
+        scratch.vis_points.reset();
+        scratch.visited.next();
+
+        BlockedPlaneBitset blocked_planes;
+        if (q.layer) blocked_planes.set(q.layer, true);
+
+        for (size_t i = 0; i < others.size(); ++i) {
+            if (q.trapezoid != others[i].trapezoid) continue;
+            to_others[i] = blocked_planes;
+            if (others[i].layer) to_others[i]->set(others[i].layer, true);
+        }
+
+        for (const auto pid : pt_portal_map[q.trapezoid]) {
+            if (sp >= scratch.open.size()) break;
+            Node& n = scratch.open[sp++];
+            n.next = pid;
+            n.visited_checkpoint = 0;
+            n.blocked_planes = blocked_planes;
+            n.funnel[0] = points[portals[pid].points[0]].pos;
+            n.funnel[1] = points[portals[pid].points[1]].pos;
+        }
+        WalkVisibility(q.pos, sp, scratch, out, others, to_others);
+    }
+
+    void VisGraph::QueryPointVisibility(const QueryPoint& q, std::span<const QueryPoint> others, std::vector<VisElement>& out, std::span<std::optional<BlockedPlaneBitset>> to_others) const
+    {
+        VisibilityScratch scratch;
+        scratch.init(portals.size(), points.size());
+        QueryPointVisibility(q, others, scratch, out, to_others);
+    }
+
+    bool VisGraph::GenerateVisGraph(uint32_t thread_count)
+    {
+        m_edge_offsets.clear();
+        m_edges.clear();
+        m_blocked_plane_masks.clear();
+
+        const auto size = static_cast<uint32_t>(points.size());
+        if (!thread_count) thread_count = std::max(1u, std::thread::hardware_concurrency());
+        thread_count = std::min(thread_count, std::max(1u, size / 64));
+
+        // Points are handed out in small batches; each batch is written by one worker only and the batches
+        // are concatenated in order afterwards, so the result doesn't depend on the thread count.
+        constexpr uint32_t batch_size = VIS_GRAPH_BATCH_SIZE;
+        std::vector<EdgeBatch> batches((size + batch_size - 1) / batch_size);
+        std::vector<uint32_t> edge_counts(size);
+        std::atomic<uint32_t> next_point = 0;
+        std::atomic<uint32_t> points_done = 0;
+        std::atomic<bool> too_many_masks = false;
+
+        const auto worker = [&] {
+            VisibilityScratch scratch;
+            scratch.init(portals.size(), points.size());
+            std::vector<VisElement> visible;
+            std::unordered_map<BlockedPlaneBitset, uint16_t> interned;
+
+            for (;;) {
+                const uint32_t begin = next_point.fetch_add(batch_size);
+                if (begin >= size || m_cancel || too_many_masks) return;
+                const uint32_t end = std::min(begin + batch_size, size);
+                auto& batch = batches[begin / batch_size];
+                interned.clear();
+                for (uint32_t i = begin; i < end; ++i) {
+                    const auto& point = points[i];
+                    if (!point.is_viable) continue;
+                    visible.clear();
+                    GeneratePointVisibility(point, scratch, visible);
+                    edge_counts[i] = static_cast<uint32_t>(visible.size());
+                    for (const auto& vis : visible) {
+                        const auto [it, inserted] = interned.try_emplace(vis.blocked_planes, static_cast<uint16_t>(batch.masks.size()));
+                        if (inserted) {
+                            if (batch.masks.size() > 0xFFFF) too_many_masks = true;
+                            batch.masks.push_back(vis.blocked_planes);
+                        }
+                        batch.edges.push_back({vis.distance, vis.point_id, it->second});
+                    }
+                }
+                const uint32_t done = points_done.fetch_add(end - begin) + (end - begin);
+                m_progress = static_cast<int>(10 + 89ull * done / size);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (uint32_t i = 1; i < thread_count; ++i) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (auto& t : workers) {
+            t.join();
+        }
+        if (m_cancel || too_many_masks) return false;
+
+        return MergeEdgeBatches(batches, edge_counts);
+    }
+
+    // Concatenates the batches into m_edges, interning their masks into one table, and appends the teleport links.
+    // Returns false if there are more distinct masks than a 16 bit index can address.
+    bool VisGraph::MergeEdgeBatches(std::vector<EdgeBatch>& batches, const std::vector<uint32_t>& edge_counts)
+    {
+        // could not link teleports earlier because the vis graph is generated after them
+        std::vector<std::pair<PointId, GraphEdge>> teleport_edges;
+        for (const auto& dp : m_defferedPortalLinks) {
+            const auto dist = GetDistance(points[dp.enter].pos, points[dp.exit].pos);
+            teleport_edges.push_back({dp.enter, {dist * 0.01f, dp.exit, 0}});
+            if (dp.both_ways) teleport_edges.push_back({dp.exit, {dist * 0.01f, dp.enter, 0}});
+        }
+        std::ranges::stable_sort(teleport_edges, {}, &std::pair<PointId, GraphEdge>::first);
+
+        size_t total = teleport_edges.size();
+        for (const auto& batch : batches) {
+            total += batch.edges.size();
+        }
+        if (total > std::numeric_limits<uint32_t>::max()) return false;
+
+        m_blocked_plane_masks = {BlockedPlaneBitset{}};
+        std::unordered_map<BlockedPlaneBitset, uint16_t> interned{{BlockedPlaneBitset{}, 0}};
+        std::vector<uint16_t> remap;
+
+        m_edges.reserve(total);
+        m_edge_offsets.reserve(points.size() + 1);
+        auto teleport_edge = teleport_edges.begin();
+        uint32_t point = 0;
+        for (auto& batch : batches) {
+            remap.clear();
+            for (const auto& mask : batch.masks) {
+                const auto [it, inserted] = interned.try_emplace(mask, static_cast<uint16_t>(m_blocked_plane_masks.size()));
+                if (inserted) {
+                    if (m_blocked_plane_masks.size() > 0xFFFF) return false;
+                    m_blocked_plane_masks.push_back(mask);
+                }
+                remap.push_back(it->second);
+            }
+
+            auto edge = batch.edges.begin();
+            for (const auto end = std::min<size_t>(point + VIS_GRAPH_BATCH_SIZE, points.size()); point < end; ++point) {
+                m_edge_offsets.push_back(static_cast<uint32_t>(m_edges.size()));
+                for (const auto last = edge + edge_counts[point]; edge != last; ++edge) {
+                    m_edges.push_back({edge->distance, edge->point_id, remap[edge->blocked_planes]});
+                }
+                for (; teleport_edge != teleport_edges.end() && teleport_edge->first == point; ++teleport_edge) {
+                    m_edges.push_back(teleport_edge->second);
+                }
+            }
+            batch = {};
+        }
+        m_edge_offsets.push_back(static_cast<uint32_t>(m_edges.size()));
+        return true;
+    }
+
+    // Everything up to the visibility graph: neighbouring trapezoids linked by portals, and the points on them
+    bool VisGraph::BuildPortals()
+    {
+        if (!m_map.IsValid() || m_map.planes.size() > PATHING_MAX_PLANE_COUNT) return false;
+
+        GeneratePortalPairs();
+        GenerateTrapezoidNeighbours();
+        if (m_cancel) return false;
+        m_progress = 5;
+
+        return GeneratePortals();
+    }
+
+    bool VisGraph::Build(std::vector<Teleport> teleports, uint32_t thread_count)
+    {
+        m_ready = false;
+        m_progress = 0;
+        m_teleports = std::move(teleports);
+
+        if (!BuildPortals()) return false;
+        if (m_cancel) return false;
+        GenerateTeleportGraph();
+        m_progress = 10;
+
+        if (!GenerateVisGraph(thread_count)) return false;
+
+        // Only needed while building
+        ptneighbours = {};
+        m_neighbours_visited = {};
+
+        m_ready = true;
+        m_progress = 100;
+        return true;
+    }
+
+    size_t VisGraph::GetMemoryUsage() const
+    {
+        const auto nested = []<typename T>(const std::vector<std::vector<T>>& v) {
+            size_t total = v.capacity() * sizeof(std::vector<T>);
+            for (const auto& inner : v) {
+                total += inner.capacity() * sizeof(T);
+            }
+            return total;
+        };
+        const size_t edges = m_edge_offsets.capacity() * sizeof(uint32_t) + m_edges.capacity() * sizeof(GraphEdge) + m_blocked_plane_masks.capacity() * sizeof(BlockedPlaneBitset);
+        return edges + nested(pt_portal_map) + nested(portal_portal_map) + points.capacity() * sizeof(Point) + portals.capacity() * sizeof(Portal) + portal_pt_map.capacity() * sizeof(uint32_t) + m_grid.GetMemoryUsage();
+    }
+
+    float VisGraph::TeleporterHeuristic(const Point& start, const Point& goal) const
+    {
+        if (m_teleports.empty()) return 0.0f;
+
+        float cost = INFINITY;
+        uint32_t ts = INVALID_INDEX;
+        uint32_t tg = INVALID_INDEX;
+        float dist_start = cost;
+        float dist_goal = cost;
+        for (uint32_t i = 0; i < m_teleports.size(); ++i) {
+            const auto& tp = m_teleports[i];
+            float dist = GetSquareDistance(start.pos, ToVec2f(tp.enter));
+            if (tp.both_ways) dist = std::min(dist, GetSquareDistance(start.pos, ToVec2f(tp.exit)));
+
+            if (dist_start > dist) {
+                dist_start = dist;
+                ts = i;
+            }
+
+            dist = GetSquareDistance(goal.pos, ToVec2f(tp.exit));
+            if (tp.both_ways) dist = std::min(dist, GetSquareDistance(goal.pos, ToVec2f(tp.enter)));
+
+            if (dist_goal > dist) {
+                dist_goal = dist;
+                tg = i;
+            }
+        }
+
+        for (const auto& ttd : m_teleportGraph) {
+            if (ttd.tp1 == ts && ttd.tp2 == tg) {
+                cost = sqrtf(dist_start);
+                break;
+            }
+        }
+        return cost;
+    }
+
+    MapPos VisGraph::GetPointMapPos(PointId id) const
+    {
+        // Finding zplane here and in this way is more of a workaround:
+        const auto& point = points[id];
+        const uint32_t zplane = std::max(portals[point.portals[0]].layer, portals[point.portals[1]].layer);
+        return {point.pos.x, point.pos.y, zplane};
+    }
+
+    // Moves pos onto the closest trapezoid if it's off the map; false if there is none
+    bool VisGraph::LocateQueryPoint(MapPos& pos, PointId id, QueryPoint& out) const
+    {
+        const auto found = m_grid.FindClosestPositionOnTrapezoid(pos);
+        if (!found.IsValid()) return false;
+        out = {ToVec2f(pos), m_plane_offsets[found.plane] + found.index, static_cast<uint8_t>(pos.zplane), id};
+        return true;
+    }
+
+    // https://github.com/Rikora/A-star/blob/master/src/AStar.cpp
+    Error VisGraph::BuildPath(const QueryPoint& start, const QueryPoint& goal, const std::vector<PointId>& came_from, PathResult& out) const
+    {
+        out.points.clear();
+        PointId current = goal.id;
+        int count = 0;
+        while (current != start.id) {
+            if (count++ > 256) {
+                return Error::BuildPathLengthExceeded;
+            }
+            if (current == goal.id) {
+                out.points.push_back({goal.pos.x, goal.pos.y, goal.layer});
+            }
+            else {
+                out.points.push_back(GetPointMapPos(current));
+            }
+            current = came_from[current];
+        }
+        out.points.push_back({start.pos.x, start.pos.y, start.layer});
+        std::ranges::reverse(out.points);
+        return Error::OK;
+    }
+
+    Error VisGraph::Search(const MapPos& _start_pos, const MapPos& _goal_pos, const BlockedPlaneBitset& blocked_planes, PathResult& out) const
+    {
+        out = {};
+        if (!m_ready) return Error::FailedToFinializePath;
+
+        // Start and goal only exist for this query; they get the ids right after the last point of the graph
+        const auto point_count = points.size();
+        auto start_pos = _start_pos;
+        auto goal_pos = _goal_pos;
+        QueryPoint start, goal;
+        if (!LocateQueryPoint(start_pos, static_cast<PointId>(point_count), start)) return Error::FailedToFindStartPathingTrapezoid;
+        if (!LocateQueryPoint(goal_pos, static_cast<PointId>(point_count + 1), goal)) return Error::FailedToFindGoalPathingTrapezoid;
+
+        std::vector<VisElement> start_edges;
+        std::vector<VisElement> goal_edges; // visibility is symmetric, so these are the edges into the goal
+        std::optional<BlockedPlaneBitset> direct;
+        {
+            VisibilityScratch scratch;
+            scratch.init(portals.size(), point_count);
+            QueryPointVisibility(start, {&goal, 1}, scratch, start_edges, {&direct, 1});
+            std::optional<BlockedPlaneBitset> direct_from_goal;
+            QueryPointVisibility(goal, {&start, 1}, scratch, goal_edges, {&direct_from_goal, 1});
+            if (!direct) direct = direct_from_goal;
+        }
+
+        // Check if points have a direct line of sight
+        if (direct && (*direct & blocked_planes).none()) {
+            out.points = {start_pos, goal_pos};
+            out.cost = GetDistance(start.pos, goal.pos);
+            return Error::OK;
+        }
+
+        std::vector<uint32_t> goal_edge_index(point_count, INVALID_INDEX);
+        for (uint32_t i = 0; i < goal_edges.size(); ++i) {
+            goal_edge_index[goal_edges[i].point_id] = i;
+        }
+
+        std::vector<float> cost_so_far;
+        std::vector<PointId> came_from;
+        MyPQueue open(point_count + 2);
+
+        cost_so_far.resize(point_count + 2, -INFINITY);
+        cost_so_far[start.id] = 0.0f;
+
+        came_from.resize(point_count + 2);
+        came_from[start.id] = start.id;
+        open.emplace(0.0f, start.id);
+
+        // Resolve every interned mask against the blocked planes once, instead of per edge
+        std::vector<uint8_t> mask_blocked(m_blocked_plane_masks.size());
+        for (size_t i = 0; i < m_blocked_plane_masks.size(); ++i) {
+            mask_blocked[i] = (m_blocked_plane_masks[i] & blocked_planes).any();
+        }
+
+        const Point goal_point{goal.pos, {}, goal.id, true};
+        const bool teleports = !m_teleports.empty();
+        const auto relax = [&](PointId from, float distance, PointId to) {
+            const float new_cost = cost_so_far[from] + distance;
+            if (cost_so_far[to] == -INFINITY || new_cost < cost_so_far[to]) {
+                cost_so_far[to] = new_cost;
+                came_from[to] = from;
+
+                float priority = new_cost;
+                if (teleports) {
+                    const auto& point = to == goal.id ? goal_point : points[to];
+                    const float tp_cost = TeleporterHeuristic(point, goal_point);
+                    priority += std::min(GetDistance(point.pos, goal.pos), tp_cost);
+                }
+                open.emplace(priority, to);
+            }
+        };
+
+        PointId current = 0;
+        while (!open.empty()) {
+            current = open.top().second;
+            open.pop();
+            if (current == goal.id) break;
+
+            if (current == start.id) {
+                for (const auto& vis : start_edges) {
+                    if ((vis.blocked_planes & blocked_planes).none()) relax(current, vis.distance, vis.point_id);
+                }
+                continue;
+            }
+            for (const auto& edge : GetEdges(current)) {
+                if (!mask_blocked[edge.blocked_planes]) relax(current, edge.distance, edge.point_id);
+            }
+            if (goal_edge_index[current] != INVALID_INDEX) {
+                const auto& vis = goal_edges[goal_edge_index[current]];
+                if ((vis.blocked_planes & blocked_planes).none()) relax(current, vis.distance, goal.id);
+            }
+        }
+
+        if (current != goal.id) return Error::FailedToFinializePath;
+
+        out.cost = cost_so_far[current];
+        const auto res = BuildPath(start, goal, came_from, out);
+        if (res == Error::OK) {
+            // Keep the caller's requested height layer info for the end points
+            out.points.front() = start_pos;
+            out.points.back() = goal_pos;
+        }
+        return res;
+    }
+
+    // Same costs as one Search per pair, but one Dijkstra per source settles all targets at once.
+    // Targets only have incoming edges, so paths never run through another target (or source), just like Search.
+    Error VisGraph::ComputeDistanceMatrix(std::span<const MapPos> sources, std::span<const MapPos> targets, const BlockedPlaneBitset& blocked_planes, DistanceMatrix& out) const
+    {
+        const auto source_count = static_cast<uint32_t>(sources.size());
+        const auto target_count = static_cast<uint32_t>(targets.size());
+        out.source_count = source_count;
+        out.target_count = target_count;
+        out.distances.assign(static_cast<size_t>(source_count) * target_count, INFINITY);
+        out.next_hops.resize(out.distances.size());
+        for (uint32_t s = 0; s < source_count; ++s) {
+            std::fill_n(out.next_hops.begin() + static_cast<size_t>(s) * target_count, target_count, sources[s]);
+        }
+        if (!m_ready) return Error::FailedToFinializePath;
+        if (!source_count || !target_count) return Error::OK;
+
+        // Query points get ids past the graph; they are only used to tell them apart during the walks.
+        // Positions that can't be placed on the map keep an invalid trapezoid and are skipped.
+        const auto point_count = static_cast<uint32_t>(points.size());
+        std::vector<MapPos> source_pos(sources.begin(), sources.end());
+        std::vector<MapPos> target_pos(targets.begin(), targets.end());
+        std::vector<QueryPoint> source_points(source_count, QueryPoint{{}, INVALID_INDEX, 0, 0});
+        std::vector<QueryPoint> target_points(target_count, QueryPoint{{}, INVALID_INDEX, 0, 0});
+        for (uint32_t s = 0; s < source_count; ++s) {
+            LocateQueryPoint(source_pos[s], static_cast<PointId>(point_count), source_points[s]);
+        }
+        for (uint32_t t = 0; t < target_count; ++t) {
+            LocateQueryPoint(target_pos[t], static_cast<PointId>(point_count + 1), target_points[t]);
+        }
+
+        VisibilityScratch scratch;
+        scratch.init(portals.size(), point_count);
+        std::vector<VisElement> visible;
+
+        // Edges into each target, grouped by graph point, and the direct lines of sight seen from the target side
+        struct TargetEdge {
+            float distance;
+            uint32_t target;
+        };
+        std::vector<uint32_t> target_edge_offsets(point_count + 1, 0);
+        std::vector<TargetEdge> target_edges;
+        std::vector<uint8_t> direct(out.distances.size(), 0);
+        {
+            std::vector<std::pair<PointId, TargetEdge>> unsorted;
+            std::vector<std::optional<BlockedPlaneBitset>> to_sources(source_count);
+            for (uint32_t t = 0; t < target_count; ++t) {
+                if (target_points[t].trapezoid == INVALID_INDEX) continue;
+                visible.clear();
+                std::ranges::fill(to_sources, std::nullopt);
+                QueryPointVisibility(target_points[t], source_points, scratch, visible, to_sources);
+                for (const auto& vis : visible) {
+                    if ((vis.blocked_planes & blocked_planes).none()) unsorted.push_back({vis.point_id, {vis.distance, t}});
+                }
+                for (uint32_t s = 0; s < source_count; ++s) {
+                    if (to_sources[s] && (*to_sources[s] & blocked_planes).none()) direct[static_cast<size_t>(s) * target_count + t] = 1;
+                }
+            }
+            for (const auto& [point_id, edge] : unsorted) {
+                target_edge_offsets[point_id + 1]++;
+            }
+            for (uint32_t i = 0; i < point_count; ++i) {
+                target_edge_offsets[i + 1] += target_edge_offsets[i];
+            }
+            target_edges.resize(unsorted.size());
+            std::vector<uint32_t> fill(target_edge_offsets.begin(), target_edge_offsets.end() - 1);
+            for (const auto& [point_id, edge] : unsorted) {
+                target_edges[fill[point_id]++] = edge;
+            }
+        }
+
+        std::vector<uint8_t> mask_blocked(m_blocked_plane_masks.size());
+        for (size_t i = 0; i < m_blocked_plane_masks.size(); ++i) {
+            mask_blocked[i] = (m_blocked_plane_masks[i] & blocked_planes).any();
+        }
+
+        // Graph points are nodes [0, point_count), target t is node point_count + t. Reused for every source.
+        typedef std::pair<float, uint32_t> Entry;
+        const uint32_t node_count = point_count + target_count;
+        std::vector<float> dist(node_count);
+        std::vector<uint32_t> first_hop(node_count);
+        std::vector<Entry> open;
+        std::vector<std::optional<BlockedPlaneBitset>> to_targets(target_count);
+
+        for (uint32_t s = 0; s < source_count; ++s) {
+            const auto& source = source_points[s];
+            if (source.trapezoid == INVALID_INDEX) continue;
+            const size_t row = static_cast<size_t>(s) * target_count;
+
+            std::ranges::fill(dist, INFINITY);
+            open.clear();
+            const auto relax = [&](uint32_t node, float cost, uint32_t hop) {
+                if (cost >= dist[node]) return;
+                dist[node] = cost;
+                first_hop[node] = hop;
+                open.emplace_back(cost, node);
+                std::ranges::push_heap(open, std::greater<Entry>{});
+            };
+
+            visible.clear();
+            std::ranges::fill(to_targets, std::nullopt);
+            QueryPointVisibility(source, target_points, scratch, visible, to_targets);
+            for (const auto& vis : visible) {
+                if ((vis.blocked_planes & blocked_planes).none()) relax(vis.point_id, vis.distance, vis.point_id);
+            }
+            uint32_t remaining = 0;
+            for (uint32_t t = 0; t < target_count; ++t) {
+                if (target_points[t].trapezoid == INVALID_INDEX) continue;
+                ++remaining;
+                if (direct[row + t] || (to_targets[t] && (*to_targets[t] & blocked_planes).none())) {
+                    relax(point_count + t, GetDistance(source.pos, target_points[t].pos), point_count + t);
+                }
+            }
+
+            while (!open.empty() && remaining) {
+                std::ranges::pop_heap(open, std::greater<Entry>{});
+                const auto [cost, node] = open.back();
+                open.pop_back();
+                if (cost > dist[node]) continue; // already settled with a lower cost
+
+                if (node >= point_count) {
+                    const uint32_t t = node - point_count;
+                    out.distances[row + t] = cost;
+                    out.next_hops[row + t] = first_hop[node] >= point_count ? target_pos[t] : GetPointMapPos(static_cast<PointId>(first_hop[node]));
+                    --remaining;
+                    continue;
+                }
+                const uint32_t hop = first_hop[node];
+                for (const auto& edge : GetEdges(static_cast<PointId>(node))) {
+                    if (!mask_blocked[edge.blocked_planes]) relax(edge.point_id, cost + edge.distance, hop);
+                }
+                for (uint32_t i = target_edge_offsets[node]; i < target_edge_offsets[node + 1]; ++i) {
+                    relax(point_count + target_edges[i].target, cost + target_edges[i].distance, hop);
+                }
+            }
+        }
+        return Error::OK;
+    }
+} // namespace Pathing
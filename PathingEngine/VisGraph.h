@@ -0,0 +1,206 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "MapQueries.h"
+#include "PathingTypes.h"
+#include "TrapezoidGrid.h"
+
+// =============================================================================
+// VisGraph
+//
+// Point to point visibility graph over a PathingMapData, plus A* search on it.
+//
+// Build() links neighbouring trapezoids (including across planes) with portals,
+// turns portal end points into graph points and connects every pair of points
+// that can see each other. Each edge remembers which planes it passes through,
+// so searches can skip edges crossing planes that are currently blocked
+// (e.g. closed doors).
+//
+// Owns its PathingMapData; has no dependency on the game client.
+// =============================================================================
+
+namespace Pathing {
+    typedef uint16_t PortalId;
+
+    struct PathResult {
+        std::vector<MapPos> points; // start to goal
+        float cost = 0.f;           // distance
+    };
+
+    // Shortest path lengths from every source to every target
+    struct DistanceMatrix {
+        uint32_t source_count = 0;
+        uint32_t target_count = 0;
+        std::vector<float> distances;  // [source * target_count + target]; INFINITY if unreachable
+        std::vector<MapPos> next_hops; // first waypoint after the source towards the target; the source itself if unreachable
+
+        float Distance(uint32_t source, uint32_t target) const { return distances[source * target_count + target]; }
+        const MapPos& NextHop(uint32_t source, uint32_t target) const { return next_hops[source * target_count + target]; }
+    };
+
+    class VisGraph {
+    public:
+        enum class Edge : uint8_t { top, right, bottom, left };
+
+        struct Portal {
+            uint32_t trapezoid; // global trapezoid id
+            PointId points[2];
+            PortalId id;
+            PortalId other_id;
+            uint8_t layer;
+        };
+
+        struct Point {
+            Vec2f pos;
+            PortalId portals[2];
+            PointId id;
+            bool is_viable;
+        };
+
+        struct VisElement {
+            float distance;
+            BlockedPlaneBitset blocked_planes;
+            PointId point_id; // other point
+        };
+
+        // Edge as stored in the graph; the blocked planes are interned, since most edges share a handful of masks
+        struct GraphEdge {
+            float distance;
+            PointId point_id;        // other point
+            uint16_t blocked_planes; // index into m_blocked_plane_masks
+        };
+
+        VisGraph(PathingMapData map);
+
+        // Generates portals, points and the visibility graph. Blocking; run on a worker thread.
+        // The visibility graph is spread over thread_count threads (0 = one per core), including the calling one.
+        // Returns false if cancelled or the map can't be represented.
+        bool Build(std::vector<Teleport> teleports = {}, uint32_t thread_count = 0);
+        // Signals Build() to stop early.
+        void Cancel() { m_cancel = true; }
+        // 0 - 100; 100 only once Build() has succeeded.
+        int Progress() const { return m_progress; }
+        bool IsReady() const { return m_ready; }
+
+        // Saves a built graph for LoadCache() on a later visit of the same map.
+        bool SaveCache(const std::filesystem::path& path) const;
+        // Alternative to Build(): restores the graph saved by SaveCache() if it was made from the same map data and teleports.
+        // Returns false (and leaves the graph unbuilt) if the file is missing, stale or damaged.
+        bool LoadCache(const std::filesystem::path& path, std::vector<Teleport> teleports = {});
+
+        // Thread safe once built; start and goal are kept in per query state and the graph itself is never modified.
+        Error Search(const MapPos& start_pos, const MapPos& goal_pos, const BlockedPlaneBitset& blocked_planes, PathResult& out) const;
+        // Many to many distances: one Dijkstra per source over the graph, stopping once every target is settled.
+        // Much cheaper than a Search per pair; thread safe like Search.
+        Error ComputeDistanceMatrix(std::span<const MapPos> sources, std::span<const MapPos> targets, const BlockedPlaneBitset& blocked_planes, DistanceMatrix& out) const;
+
+        const PathingMapData& GetMapData() const { return m_map; }
+        size_t GetPointCount() const { return points.size(); }
+        size_t GetEdgeCount() const { return m_edges.size(); }
+        size_t GetBlockedPlaneMaskCount() const { return m_blocked_plane_masks.size(); }
+        // Approximate heap usage of the generated graph, in bytes
+        size_t GetMemoryUsage() const;
+
+    private:
+        friend class CorridorSearch;
+        friend class IncrementalSearch;
+        friend class HierarchicalGraph;
+        friend class PathCache;
+
+        struct Neighbour {
+            uint32_t trapezoid; // global trapezoid id
+            uint8_t layer;
+            Edge loc;
+        };
+
+        struct DefferedTeleport {
+            PointId enter, exit;
+            bool both_ways;
+        };
+
+        struct TeleportNode {
+            uint32_t tp1;
+            uint32_t tp2;
+            float distance;
+        };
+
+        // Search start or goal; not part of the graph
+        struct QueryPoint {
+            Vec2f pos;
+            uint32_t trapezoid; // global trapezoid id
+            uint8_t layer;
+            PointId id;
+        };
+
+        struct Node;
+        struct VisitedState;
+        struct VisitedPoints;
+        struct VisibilityScratch;
+        struct EdgeBatch;
+
+        const Trapezoid& GetTrapezoid(uint32_t id) const { return m_map.planes[m_trapezoid_plane[id]].trapezoids[id - m_plane_offsets[m_trapezoid_plane[id]]]; }
+        uint32_t GetAdjacent(uint32_t id, uint32_t slot) const;
+        std::span<const GraphEdge> GetEdges(PointId id) const { return {m_edges.data() + m_edge_offsets[id], m_edges.data() + m_edge_offsets[id + 1]}; }
+
+        void GeneratePortalPairs();
+        void GetTrapezoidNeighbours(uint32_t id, std::vector<Neighbour>& neighbours);
+        bool IsNeighbourOf(uint32_t id1, uint32_t id2);
+        bool BuildPortals();
+        void CreatePortalPair(uint32_t pt1, uint8_t pt1_layer, uint32_t pt2, uint8_t pt2_layer, Vec2f p1, bool p1_viability, Vec2f p2, bool p2_viability);
+        void LinkTrapezoids(uint32_t pt1, uint8_t pt1_layer, const Neighbour& n);
+        void GenerateTrapezoidNeighbours();
+        bool GeneratePortals();
+        void GenerateTeleportGraph();
+        Point CreateSinglePointPortal(uint32_t trapezoid, const MapPos& pos);
+        void ProcessPortal(std::vector<Node>& open, size_t& sp, VisitedState& visited, const Portal& portal, PortalId other_portal_id) const;
+        void ProcessPoint(std::vector<Node>& open, size_t& sp, VisitedState& visited, const Point& point) const;
+        void WalkVisibility(const Vec2f& origin, size_t sp, VisibilityScratch& scratch, std::vector<VisElement>& out, std::span<const QueryPoint> others, std::span<std::optional<BlockedPlaneBitset>> to_others) const;
+        void GeneratePointVisibility(const Point& p, VisibilityScratch& scratch, std::vector<VisElement>& out) const;
+        void QueryPointVisibility(const QueryPoint& q, std::span<const QueryPoint> others, VisibilityScratch& scratch, std::vector<VisElement>& out, std::span<std::optional<BlockedPlaneBitset>> to_others) const;
+        void QueryPointVisibility(const QueryPoint& q, std::span<const QueryPoint> others, std::vector<VisElement>& out, std::span<std::optional<BlockedPlaneBitset>> to_others) const;
+        bool GenerateVisGraph(uint32_t thread_count);
+        bool MergeEdgeBatches(std::vector<EdgeBatch>& batches, const std::vector<uint32_t>& edge_counts);
+        static uint32_t GetCacheLayout();
+        uint64_t GetSourceHash() const;
+        MapPos GetPointMapPos(PointId id) const;
+        bool LocateQueryPoint(MapPos& pos, PointId id, QueryPoint& out) const;
+        float TeleporterHeuristic(const Point& start, const Point& goal) const;
+        Error BuildPath(const QueryPoint& start, const QueryPoint& goal, const std::vector<PointId>& came_from, PathResult& out) const;
+
+        PathingMapData m_map;
+        TrapezoidGrid m_grid;                    // point lookups on m_map
+        std::vector<Teleport> m_teleports;
+
+        std::vector<uint32_t> m_plane_offsets;   // plane index -> first global trapezoid id
+        std::vector<uint8_t> m_trapezoid_plane;  // global trapezoid id -> plane index
+        std::vector<std::vector<uint32_t>> m_portal_pairs; // [plane][map portal] -> map portal on neighbor_plane
+
+        // Visibility graph in compressed sparse row form: the edges of point i are m_edges[m_edge_offsets[i] .. m_edge_offsets[i + 1]]
+        std::vector<uint32_t> m_edge_offsets;                  // PointId, points.size() + 1 entries
+        std::vector<GraphEdge> m_edges;
+        std::vector<BlockedPlaneBitset> m_blocked_plane_masks; // GraphEdge::blocked_planes; [0] blocks nothing
+        std::vector<Point> points;                             // PointId
+        std::vector<Portal> portals;                           // PortalId
+        std::vector<std::vector<PortalId>> pt_portal_map;      // global trapezoid id
+        std::vector<uint32_t> portal_pt_map;                   // PortalId
+        std::vector<std::vector<PortalId>> portal_portal_map;  // PortalId
+        std::vector<std::vector<Neighbour>> ptneighbours;      // global trapezoid id
+        std::vector<TeleportNode> m_teleportGraph;
+        std::vector<DefferedTeleport> m_defferedPortalLinks;
+
+        // Scratch for GetTrapezoidNeighbours
+        std::vector<uint32_t> m_neighbours_visited;
+        uint32_t m_neighbours_stamp = 0;
+        std::vector<uint32_t> m_neighbours_to_explore;
+        std::vector<Neighbour> m_is_neighbour_of;
+
+        std::atomic<bool> m_cancel = false;
+        std::atomic<bool> m_ready = false;
+        std::atomic<int> m_progress = 0;
+    };
+} // namespace Pathing
@@ -0,0 +1,197 @@
+#include "stdafx.h"
+
+#include "BinaryStream.h"
+#include "MappedFile.h"
+#include "VisGraph.h"
+
+// =============================================================================
+// On-disk cache of a finished VisGraph
+//
+// File layout: CacheHeader followed by the payload. The payload is a
+// sequence of arrays (uint32 count + raw elements); nested arrays are
+// stored as count, count + 1 offsets, then the flattened elements.
+//
+// A cache file is only accepted if the version, struct layout, map file id
+// and a hash of the source geometry + teleports all match, and the payload
+// checksum is intact; otherwise the caller builds the graph as usual.
+// =============================================================================
+
+namespace {
+    using namespace Pathing;
+
+    // Bump when the file layout or the graph generation changes.
+    constexpr uint32_t CACHE_VERSION = 2;
+    constexpr char CACHE_MAGIC[4] = {'G', 'W', 'P', 'G'};
+
+    struct CacheHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t map_file_id;
+        uint32_t layout; // sizes of the raw structs, catches ABI differences
+        uint64_t source_hash;
+        uint64_t payload_size;
+        uint64_t payload_checksum;
+    };
+    static_assert(std::is_trivially_copyable_v<CacheHeader>);
+
+    using detail::Hash64;
+    using detail::HashValue;
+    using detail::Reader;
+    using detail::Writer;
+    using detail::WriteFileReplacing;
+} // namespace
+
+namespace Pathing {
+    uint32_t VisGraph::GetCacheLayout()
+    {
+        static_assert(std::is_trivially_copyable_v<Point> && std::is_trivially_copyable_v<Portal> && std::is_trivially_copyable_v<GraphEdge>);
+        static_assert(std::is_trivially_copyable_v<TeleportNode> && std::is_trivially_copyable_v<DefferedTeleport> && std::is_trivially_copyable_v<Teleport>);
+        static_assert(std::is_trivially_copyable_v<BlockedPlaneBitset>);
+        return static_cast<uint32_t>(sizeof(Point) | sizeof(Portal) << 8 | sizeof(GraphEdge) << 16 | sizeof(Teleport) << 24);
+    }
+
+    uint64_t VisGraph::GetSourceHash() const
+    {
+        uint64_t h = Hash64(nullptr, 0);
+        h = HashValue(static_cast<uint32_t>(m_map.planes.size()), h);
+        for (const auto& plane : m_map.planes) {
+            h = HashValue(static_cast<uint32_t>(plane.trapezoids.size()), h);
+            for (const auto& t : plane.trapezoids) {
+                const float geometry[] = {t.XTL, t.XTR, t.YT, t.XBL, t.XBR, t.YB};
+                h = Hash64(geometry, sizeof(geometry), h);
+                h = Hash64(t.neighbors, sizeof(t.neighbors), h);
+                h = HashValue(t.portal_left, h);
+                h = HashValue(t.portal_right, h);
+            }
+            h = HashValue(static_cast<uint32_t>(plane.portals.size()), h);
+            for (const auto& p : plane.portals) {
+                const uint16_t fields[] = {p.trapezoid_count, p.trapezoid_index_start, p.neighbor_plane, p.shared_id, p.flags};
+                h = Hash64(fields, sizeof(fields), h);
+            }
+            h = HashValue(static_cast<uint32_t>(plane.portal_trapezoid_indices.size()), h);
+            h = Hash64(plane.portal_trapezoid_indices.data(), plane.portal_trapezoid_indices.size() * sizeof(uint32_t), h);
+        }
+        h = HashValue(static_cast<uint32_t>(m_teleports.size()), h);
+        for (const auto& tp : m_teleports) {
+            const float positions[] = {tp.enter.x, tp.enter.y, tp.exit.x, tp.exit.y};
+            const uint32_t fields[] = {tp.enter.zplane, tp.exit.zplane, tp.both_ways ? 1u : 0u};
+            h = Hash64(positions, sizeof(positions), h);
+            h = Hash64(fields, sizeof(fields), h);
+        }
+        return h;
+    }
+
+    bool VisGraph::SaveCache(const std::filesystem::path& path) const
+    {
+        if (!m_ready) return false;
+
+        Writer w;
+        w.PutArray(points);
+        w.PutArray(portals);
+        w.PutArray(portal_pt_map);
+        w.PutNested<PortalId>(pt_portal_map);
+        w.PutNested<PortalId>(portal_portal_map);
+        w.PutArray(m_edge_offsets);
+        w.PutArray(m_edges);
+        w.PutArray(m_blocked_plane_masks);
+        w.PutArray(m_teleportGraph);
+        w.PutArray(m_defferedPortalLinks);
+
+        CacheHeader header{};
+        memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+        header.version = CACHE_VERSION;
+        header.map_file_id = m_map.map_file_id;
+        header.layout = GetCacheLayout();
+        header.source_hash = GetSourceHash();
+        header.payload_size = w.buffer.size();
+        header.payload_checksum = Hash64(w.buffer.data(), w.buffer.size());
+
+        const auto header_bytes = std::span(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+        return WriteFileReplacing(path, {header_bytes, w.buffer});
+    }
+
+    bool VisGraph::LoadCache(const std::filesystem::path& path, std::vector<Teleport> teleports)
+    {
+        m_ready = false;
+        m_progress = 0;
+        if (!m_map.IsValid()) return false;
+
+        MappedFile file;
+        if (!file.Open(path) || file.size() < sizeof(CacheHeader)) return false;
+
+        CacheHeader header;
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0) return false;
+        if (header.version != CACHE_VERSION || header.layout != GetCacheLayout()) return false;
+        if (header.map_file_id != m_map.map_file_id) return false;
+        if (header.payload_size != file.size() - sizeof(header)) return false;
+
+        m_teleports = std::move(teleports);
+        if (header.source_hash != GetSourceHash()) return false;
+
+        const uint8_t* payload = file.data() + sizeof(header);
+        if (header.payload_checksum != Hash64(payload, static_cast<size_t>(header.payload_size))) return false;
+
+        Reader r(payload, static_cast<size_t>(header.payload_size));
+        r.GetArray(points);
+        r.GetArray(portals);
+        r.GetArray(portal_pt_map);
+        r.GetNested(pt_portal_map);
+        r.GetNested(portal_portal_map);
+        r.GetArray(m_edge_offsets);
+        r.GetArray(m_edges);
+        r.GetArray(m_blocked_plane_masks);
+        r.GetArray(m_teleportGraph);
+        r.GetArray(m_defferedPortalLinks);
+
+        // The checksum only catches corruption; make sure the ids are usable with this map before trusting them
+        const auto valid = [&] {
+            if (!r.done()) return false;
+            if (pt_portal_map.size() != m_trapezoid_plane.size()) return false;
+            if (portal_pt_map.size() != portals.size() || portal_portal_map.size() != portals.size()) return false;
+            if (points.size() + 2 > 0xFFFF) return false;
+            for (const auto& p : points) {
+                if (p.portals[0] >= portals.size() || p.portals[1] >= portals.size()) return false;
+            }
+            for (const auto& p : portals) {
+                if (p.points[0] >= points.size() || p.points[1] >= points.size() || p.trapezoid >= m_trapezoid_plane.size() || p.other_id >= portals.size()) return false;
+            }
+            for (const auto t : portal_pt_map) {
+                if (t >= m_trapezoid_plane.size()) return false;
+            }
+            for (const auto& ids : pt_portal_map) {
+                if (std::ranges::any_of(ids, [&](const auto id) { return id >= portals.size(); })) return false;
+            }
+            for (const auto& ids : portal_portal_map) {
+                if (std::ranges::any_of(ids, [&](const auto id) { return id >= portals.size(); })) return false;
+            }
+            if (m_edge_offsets.size() != points.size() + 1 || m_edge_offsets.front() != 0 || m_edge_offsets.back() != m_edges.size()) return false;
+            if (!std::ranges::is_sorted(m_edge_offsets) || m_blocked_plane_masks.empty() || m_blocked_plane_masks.size() > 0x10000) return false;
+            if (std::ranges::any_of(m_edges, [&](const auto& e) { return e.point_id >= points.size() || e.blocked_planes >= m_blocked_plane_masks.size(); })) return false;
+            for (const auto& tp : m_teleportGraph) {
+                if (tp.tp1 >= m_teleports.size() || tp.tp2 >= m_teleports.size()) return false;
+            }
+            for (const auto& dp : m_defferedPortalLinks) {
+                if (dp.enter >= points.size() || dp.exit >= points.size()) return false;
+            }
+            return true;
+        };
+        if (!valid()) {
+            points = {};
+            portals = {};
+            portal_pt_map = {};
+            pt_portal_map = {};
+            portal_portal_map = {};
+            m_edge_offsets = {};
+            m_edges = {};
+            m_blocked_plane_masks = {};
+            m_teleportGraph = {};
+            m_defferedPortalLinks = {};
+            return false;
+        }
+
+        m_ready = true;
+        m_progress = 100;
+        return true;
+    }
+} // namespace Pathing
@@ -0,0 +1,302 @@
+#pragma once
+
+// Map sources shared by the offline pathing tools: map files and map packs on
+// disk and a synthetic map for when there are none at hand.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <MapPack.h>
+#include <PathingMapData.h>
+#include <PathingMapDataParser.h>
+#include <PathingTypes.h>
+
+namespace Pathing::Bench {
+    inline bool ReadFile(const std::filesystem::path& path, std::vector<uint8_t>& out)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    inline uint32_t FileIdFromName(const std::filesystem::path& path)
+    {
+        const auto stem = path.stem().string();
+        const auto hex = stem.find("0x");
+        if (hex != std::string::npos) return static_cast<uint32_t>(strtoul(stem.c_str() + hex + 2, nullptr, 16));
+        return static_cast<uint32_t>(strtoul(stem.c_str(), nullptr, 10));
+    }
+
+    // Two planes of brick rows, side by side, joined by one portal pair per row.
+    // Bricks only link to the rows above and below (at most 2 each, like the game's trapezoids);
+    // some bricks are left out so that paths have to go around walls.
+    inline PathingMapData MakeSyntheticMap(uint32_t bands, uint32_t bricks_per_band, uint32_t seed)
+    {
+        constexpr float brick_width = 200.f;
+        constexpr float band_height = 100.f;
+        const float half_width = brick_width * bricks_per_band;
+
+        PathingMapData map{};
+        map.map_file_id = 0;
+        map.bounds_min = {0.f, 0.f};
+        map.bounds_max = {half_width * 2, band_height * bands};
+        map.planes.resize(2);
+
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<uint32_t> hole(0, 3);
+
+        for (uint32_t p = 0; p < 2; ++p) {
+            auto& plane = map.planes[p];
+            plane.zplane = p == 0 ? UINT32_MAX : p - 1;
+            const float x0 = half_width * p;
+
+            // Brick x boundaries per band; odd bands are offset by half a brick
+            std::vector<std::vector<float>> edges(bands);
+            std::vector<std::vector<uint32_t>> ids(bands);
+            for (uint32_t b = 0; b < bands; ++b) {
+                auto& e = edges[b];
+                e.push_back(x0);
+                if (b & 1) e.push_back(x0 + brick_width / 2);
+                for (uint32_t k = 1; k < bricks_per_band; ++k)
+                    e.push_back(x0 + k * brick_width + ((b & 1) ? brick_width / 2 : 0.f));
+                if (e.back() != x0 + half_width) e.push_back(x0 + half_width);
+                std::ranges::sort(e);
+                e.erase(std::unique(e.begin(), e.end()), e.end());
+
+                for (size_t k = 0; k + 1 < e.size(); ++k) {
+                    // Keep the outer bricks so that every band has a portal to the other plane
+                    const bool outer = (p == 0 && k + 2 == e.size()) || (p == 1 && k == 0);
+                    if (!outer && hole(rng) == 0) {
+                        ids[b].push_back(INVALID_INDEX);
+                        continue;
+                    }
+                    ids[b].push_back(static_cast<uint32_t>(plane.trapezoids.size()));
+                    Trapezoid t{};
+                    t.YB = band_height * b;
+                    t.YT = t.YB + band_height;
+                    t.XBL = t.XTL = e[k];
+                    t.XBR = t.XTR = e[k + 1];
+                    std::ranges::fill(t.neighbors, INVALID_INDEX);
+                    t.portal_left = t.portal_right = INVALID_INDEX16;
+                    plane.trapezoids.push_back(t);
+                }
+            }
+
+            // Vertical links between overlapping bricks of neighbouring bands
+            for (uint32_t b = 0; b + 1 < bands; ++b) {
+                for (size_t i = 0; i < ids[b].size(); ++i) {
+                    if (ids[b][i] == INVALID_INDEX) continue;
+                    auto& lower = plane.trapezoids[ids[b][i]];
+                    uint32_t slot = 0;
+                    for (size_t j = 0; j < ids[b + 1].size(); ++j) {
+                        if (ids[b + 1][j] == INVALID_INDEX) continue;
+                        auto& upper = plane.trapezoids[ids[b + 1][j]];
+                        if (upper.XBR <= lower.XTL || upper.XBL >= lower.XTR || slot == 2) continue;
+                        lower.neighbors[slot++] = ids[b + 1][j];
+                        upper.neighbors[upper.neighbors[2] == INVALID_INDEX ? 2 : 3] = ids[b][i];
+                    }
+                }
+            }
+
+            // One portal per band on the shared edge, paired by band index
+            for (uint32_t b = 0; b < bands; ++b) {
+                const auto index = p == 0 ? ids[b].back() : ids[b].front();
+                Portal portal{};
+                portal.trapezoid_count = 1;
+                portal.trapezoid_index_start = static_cast<uint16_t>(plane.portal_trapezoid_indices.size());
+                portal.neighbor_plane = static_cast<uint16_t>(1 - p);
+                portal.shared_id = static_cast<uint16_t>(b);
+                portal.flags = b % 4 == 3 ? 0x4 : 0; // some of them aren't walkable
+                plane.portal_trapezoid_indices.push_back(index);
+                auto& t = plane.trapezoids[index];
+                (p == 0 ? t.portal_right : t.portal_left) = static_cast<uint16_t>(plane.portals.size());
+                plane.portals.push_back(portal);
+            }
+        }
+        return map;
+    }
+
+    // The map as a raw FFNA map file with just the chunks LoadPathingMapDataFromFFNA reads, for testing the tools
+    // that work on map files. Planes must be numbered the way the parser numbers them (see ParsePathingChunk).
+    inline std::vector<uint8_t> EncodeFFNA(const PathingMapData& map)
+    {
+        std::vector<uint8_t> out;
+        const auto put = [&out](const auto& value) {
+            const auto* p = reinterpret_cast<const uint8_t*>(&value);
+            out.insert(out.end(), p, p + sizeof(value));
+        };
+        const auto put_tag = [&](uint8_t tag, uint32_t size) {
+            put(tag);
+            put(size);
+        };
+        // Chunk sizes are patched in once the payload is written
+        const auto begin_chunk = [&](uint32_t id) {
+            put(id);
+            put(uint32_t{0});
+            return out.size();
+        };
+        const auto end_chunk = [&](size_t payload_start) {
+            const auto size = static_cast<uint32_t>(out.size() - payload_start);
+            memcpy(out.data() + payload_start - 4, &size, sizeof(size));
+        };
+
+        out.insert(out.end(), {'f', 'f', 'n', 'a', 3});
+
+        auto chunk = begin_chunk(0x2000000C); // map info
+        put(uint32_t{0});
+        put(uint8_t{0});
+        put(map.bounds_min);
+        put(map.bounds_max);
+        end_chunk(chunk);
+
+        chunk = begin_chunk(0x20000008); // pathing
+        put(uint32_t{0xEEFE704C});
+        put(uint32_t{0}); // version
+        put(uint32_t{0}); // sequence
+        put_tag(7, 0);
+        put_tag(8, 0);
+        put(static_cast<uint32_t>(map.planes.size()));
+        for (const auto& plane : map.planes) {
+            const auto trapezoid_count = static_cast<uint32_t>(plane.trapezoids.size());
+            const auto portal_count = static_cast<uint32_t>(plane.portals.size());
+            const auto index_count = static_cast<uint32_t>(plane.portal_trapezoid_indices.size());
+            put_tag(0, 32);
+            const uint32_t counts[8] = {0, 0, trapezoid_count, 0, 0, 0, portal_count, index_count};
+            put(counts);
+            put_tag(11, 0);
+            put_tag(1, 0);
+            put_tag(2, trapezoid_count * 44);
+            for (const auto& t : plane.trapezoids) {
+                put(t.neighbors);
+                put(t.portal_left);
+                put(t.portal_right);
+                const float coords[6] = {t.YT, t.YB, t.XTL, t.XTR, t.XBL, t.XBR};
+                put(coords);
+            }
+            for (uint8_t tag = 3; tag <= 6; ++tag) {
+                put_tag(tag, 0);
+            }
+            put_tag(10, index_count * 4);
+            for (const auto index : plane.portal_trapezoid_indices) {
+                put(index);
+            }
+            put_tag(9, portal_count * 9);
+            for (const auto& p : plane.portals) {
+                put(p.trapezoid_count);
+                put(p.trapezoid_index_start);
+                put(p.neighbor_plane);
+                put(static_cast<uint16_t>(p.shared_id + 1)); // 1 based in the file
+                put(p.flags);
+            }
+        }
+        end_chunk(chunk);
+        return out;
+    }
+
+    inline bool IsSameMapData(const PathingMapData& a, const PathingMapData& b)
+    {
+        const auto same_vec2 = [](const Vec2f& l, const Vec2f& r) { return l.x == r.x && l.y == r.y; };
+        if (a.map_file_id != b.map_file_id || !same_vec2(a.bounds_min, b.bounds_min) || !same_vec2(a.bounds_max, b.bounds_max)) return false;
+        if (a.planes.size() != b.planes.size()) return false;
+        for (size_t i = 0; i < a.planes.size(); ++i) {
+            const auto& pa = a.planes[i];
+            const auto& pb = b.planes[i];
+            if (pa.zplane != pb.zplane || pa.portal_trapezoid_indices != pb.portal_trapezoid_indices) return false;
+            if (pa.trapezoids.size() != pb.trapezoids.size() || memcmp(pa.trapezoids.data(), pb.trapezoids.data(), pa.trapezoids.size() * sizeof(Trapezoid)) != 0) return false;
+            if (!std::ranges::equal(pa.portals, pb.portals, [](const Portal& l, const Portal& r) {
+                    return l.trapezoid_count == r.trapezoid_count && l.trapezoid_index_start == r.trapezoid_index_start && l.neighbor_plane == r.neighbor_plane && l.shared_id == r.shared_id && l.flags == r.flags;
+                })) {
+                return false;
+            }
+        }
+        return true;
+    }
+    inline const char* ErrorName(Error err)
+    {
+        switch (err) {
+            case Error::OK:
+                return "OK";
+            case Error::FailedToFindStartPathingTrapezoid:
+                return "FailedToFindStartPathingTrapezoid";
+            case Error::FailedToFindGoalPathingTrapezoid:
+                return "FailedToFindGoalPathingTrapezoid";
+            case Error::FailedToFinializePath:
+                return "FailedToFinializePath";
+            case Error::InvalidMapContext:
+                return "InvalidMapContext";
+            case Error::BuildPathLengthExceeded:
+                return "BuildPathLengthExceeded";
+            case Error::FailedToGetPathingMapBlock:
+                return "FailedToGetPathingMapBlock";
+            default:
+                return "Unknown";
+        }
+    }
+
+    struct NamedMap {
+        std::string name;
+        PathingMapData map;
+    };
+
+    inline void LoadMapFile(const std::filesystem::path& path, std::vector<NamedMap>& maps)
+    {
+        if (path.extension() == ".gwmp") {
+            MapPack pack;
+            if (!pack.Open(path)) {
+                printf("%s: not a map pack\n", path.string().c_str());
+                return;
+            }
+            for (const auto map_file_id : pack.GetMapFileIds()) {
+                char name[32];
+                snprintf(name, sizeof(name), "%#x", map_file_id);
+                NamedMap named{name, {}};
+                if (!pack.Load(map_file_id, named.map)) {
+                    printf("%s: map %s is damaged\n", path.string().c_str(), name);
+                    continue;
+                }
+                maps.push_back(std::move(named));
+            }
+            return;
+        }
+
+        std::vector<uint8_t> bytes;
+        if (!ReadFile(path, bytes)) {
+            printf("%s: failed to read\n", path.string().c_str());
+            return;
+        }
+        NamedMap named{path.filename().string(), {}};
+        if (!LoadPathingMapDataFromFFNA(bytes.data(), bytes.size(), FileIdFromName(path), &named.map)) {
+            printf("%s: not a map file with pathing data\n", path.string().c_str());
+            return;
+        }
+        maps.push_back(std::move(named));
+    }
+
+    // Random position inside a random trapezoid
+    inline MapPos RandomPosition(const PathingMapData& map, std::mt19937& rng)
+    {
+        std::uniform_int_distribution<size_t> plane_dist(0, map.planes.size() - 1);
+        for (;;) {
+            const auto plane = static_cast<uint32_t>(plane_dist(rng));
+            const auto& trapezoids = map.planes[plane].trapezoids;
+            if (trapezoids.empty()) continue;
+            std::uniform_int_distribution<size_t> dist(0, trapezoids.size() - 1);
+            const auto& t = trapezoids[dist(rng)];
+            std::uniform_real_distribution<float> v(0.1f, 0.9f);
+            const float fy = v(rng), fx = v(rng);
+            const float y = t.YB + (t.YT - t.YB) * fy;
+            const float xl = t.XBL + (t.XTL - t.XBL) * fy;
+            const float xr = t.XBR + (t.XTR - t.XBR) * fy;
+            return {xl + (xr - xl) * fx, y, plane};
+        }
+    }
+} // namespace Pathing::Bench
@@ -0,0 +1,939 @@
+// Offline benchmark for the pathing engine.
+//
+// Usage:
+//   PathingBench [options] <map.ffna | maps.gwmp | directory>...
+//   PathingBench [options] --synthetic [bands] [bricks_per_band]
+//
+// Options:
+//   --queries N         number of random searches per map (default 1000)
+//   --seed S            seed for the synthetic map and the searches
+//   --threads T         threads used to build the graph (default: one per core)
+//   --search-threads T  also run the searches from T threads at once on the same graph
+//                       and check they give the same results as the sequential run
+//   --cache DIR         save each built graph to DIR, load it back and check that
+//                       searches on the loaded graph give the same results
+//   --replans N         walk N of the searches a few steps and toggle a blocked plane,
+//                       replanning incrementally and checking against full searches (default 50)
+//   --lookups N         number of random point lookups comparing the linear scans in
+//                       MapQueries.h against TrapezoidGrid, and the trapezoid kernels,
+//                       at every kernel level the CPU has (default 10000)
+//   --matrix N          distance matrix between N random sources and N random targets,
+//                       checked against one search per pair (default 16)
+//   --hierarchical N    N long searches through HierarchicalGraph against full searches,
+//                       with nothing and with one plane blocked (default 200)
+//   --corridor N        N searches through CorridorSearch against full searches, with nothing
+//                       and with one plane blocked (default 1000)
+//   --route N           order N random waypoints into a short walk, rerun it as waypoints get
+//                       dropped, and compare small routes against brute force (default 100)
+//   --path-cache N      walk N random paths, asking for the path to the same goal every step through
+//                       a PathCache and through full searches, closing a door halfway along every
+//                       other walk (default 10)
+//   --binary N          round trip the map through the binary format (PathingMapBinary.h) and
+//                       compare load times against parsing its JSON, best of N (default 5)
+//
+// Map files are raw FFNA map files as stored in the DAT (e.g. dumped from the
+// pathfinding window in a debug build as pathing_map_0x<file id>.ffna). The map
+// file id is taken from the first "0x" in the file name, or a leading decimal.
+// Map packs (.gwmp, see MapPack.h and PathingMapPack) add every map in them.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+#include <CorridorSearch.h>
+#include <HierarchicalGraph.h>
+#include <IncrementalSearch.h>
+#include <MapPack.h>
+#include <MapQueries.h>
+#include <PathCache.h>
+#include <PathingMapBinary.h>
+#include <PathingMapDataParser.h>
+#include <RouteOptimizer.h>
+#include <TrapezoidGrid.h>
+#include <TrapezoidKernels.h>
+#include <VisGraph.h>
+
+#include "BenchMaps.h"
+
+
+namespace {
+    using namespace Pathing;
+    using namespace Pathing::Bench;
+    using Clock = std::chrono::steady_clock;
+
+    double ElapsedMs(Clock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    }
+
+    size_t PeakRssKb()
+    {
+#ifdef __linux__
+        rusage usage{};
+        if (getrusage(RUSAGE_SELF, &usage) == 0) return static_cast<size_t>(usage.ru_maxrss);
+#endif
+        return 0;
+    }
+
+    // Point lookups through the linear scans and through the grid index must agree exactly.
+    // A quarter of the positions are around the map rather than on it, to exercise the closest trapezoid search.
+    // Throughput of the trapezoid kernels over whole planes; every level must match the scalar one exactly
+    bool RunKernels(const PathingMapData& map, const std::vector<MapPos>& positions)
+    {
+        std::vector<TrapezoidStreams> planes(map.planes.size());
+        size_t trapezoid_count = 0;
+        for (size_t z = 0; z < map.planes.size(); ++z) {
+            planes[z].Reserve(map.planes[z].trapezoids.size());
+            for (const auto& t : map.planes[z].trapezoids) {
+                planes[z].Push(t);
+            }
+            planes[z].Finish();
+            trapezoid_count += map.planes[z].trapezoids.size();
+        }
+        if (!trapezoid_count) return true;
+
+        std::vector<uint32_t> expected_containing;
+        std::vector<ClosestTrapezoid> expected_closest;
+        size_t mismatches = 0;
+        const auto best_level = GetBestKernelLevel();
+        for (auto level = KernelLevel::Scalar; level <= best_level; level = static_cast<KernelLevel>(static_cast<uint8_t>(level) + 1)) {
+            SetKernelLevel(level);
+            std::vector<uint32_t> containing;
+            std::vector<ClosestTrapezoid> closest;
+            containing.reserve(positions.size() * planes.size());
+            closest.reserve(positions.size() * planes.size());
+            auto start = Clock::now();
+            for (const auto& pos : positions) {
+                for (const auto& plane : planes) {
+                    containing.push_back(FindContainingTrapezoid(plane, 0, static_cast<uint32_t>(plane.size()), ToVec2f(pos)));
+                }
+            }
+            const double containing_ms = ElapsedMs(start);
+            start = Clock::now();
+            for (const auto& pos : positions) {
+                for (const auto& plane : planes) {
+                    closest.push_back(FindClosestTrapezoid(plane, 0, static_cast<uint32_t>(plane.size()), ToVec2f(pos)));
+                }
+            }
+            const double closest_ms = ElapsedMs(start);
+
+            if (level == KernelLevel::Scalar) {
+                expected_containing = containing;
+                expected_closest = closest;
+            }
+            size_t level_mismatches = 0;
+            for (size_t i = 0; i < containing.size(); ++i) {
+                const auto& a = expected_closest[i];
+                const auto& b = closest[i];
+                if (containing[i] != expected_containing[i] || a.index != b.index || a.edge != b.edge || a.distance != b.distance) level_mismatches++;
+            }
+            // Trapezoids tested per second; containment stops at the first hit so it tests fewer
+            const double tested = static_cast<double>(positions.size()) * trapezoid_count;
+            printf("   kernels (%s): contains %.1f M/s, distance %.1f M/s, %zu mismatches\n", GetKernelLevelName(level), tested / (containing_ms * 1000.0), tested / (closest_ms * 1000.0), level_mismatches);
+            mismatches += level_mismatches;
+        }
+        SetKernelLevel(best_level);
+        return mismatches == 0;
+    }
+
+    bool RunLookups(const PathingMapData& map, uint32_t lookups, uint32_t seed)
+    {
+        float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+        for (const auto& plane : map.planes) {
+            for (const auto& t : plane.trapezoids) {
+                min_x = std::min({min_x, t.XTL, t.XBL});
+                max_x = std::max({max_x, t.XTR, t.XBR});
+                min_y = std::min(min_y, t.YB);
+                max_y = std::max(max_y, t.YT);
+            }
+        }
+        if (!(min_x <= max_x)) return true;
+        const float margin_x = (max_x - min_x) * 0.1f, margin_y = (max_y - min_y) * 0.1f;
+
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> x_dist(min_x - margin_x, max_x + margin_x);
+        std::uniform_real_distribution<float> y_dist(min_y - margin_y, max_y + margin_y);
+        std::uniform_int_distribution<uint32_t> plane_dist(0, static_cast<uint32_t>(map.planes.size() - 1));
+        std::vector<MapPos> positions(lookups);
+        for (uint32_t i = 0; i < lookups; ++i) {
+            positions[i] = i % 4 == 0 ? MapPos{x_dist(rng), y_dist(rng), plane_dist(rng)} : RandomPosition(map, rng);
+        }
+
+        auto start = Clock::now();
+        const TrapezoidGrid grid(map);
+        const double index_ms = ElapsedMs(start);
+
+        std::vector<std::pair<TrapezoidRef, MapPos>> linear(lookups), indexed(lookups);
+        start = Clock::now();
+        for (uint32_t i = 0; i < lookups; ++i) {
+            linear[i].second = positions[i];
+            linear[i].first = FindClosestPositionOnTrapezoid(map, linear[i].second);
+        }
+        const double linear_ms = ElapsedMs(start);
+        printf("   lookups: linear %.0f/s, index %.1f ms, %.1f KB\n", lookups / (linear_ms / 1000.0), index_ms, grid.GetMemoryUsage() / 1024.0);
+
+        // The grid under every kernel level must give exactly what the linear scan gives
+        size_t mismatches = 0;
+        const auto best_level = GetBestKernelLevel();
+        for (auto level = KernelLevel::Scalar; level <= best_level; level = static_cast<KernelLevel>(static_cast<uint8_t>(level) + 1)) {
+            SetKernelLevel(level);
+            start = Clock::now();
+            for (uint32_t i = 0; i < lookups; ++i) {
+                indexed[i].second = positions[i];
+                indexed[i].first = grid.FindClosestPositionOnTrapezoid(indexed[i].second);
+            }
+            const double indexed_ms = ElapsedMs(start);
+
+            size_t level_mismatches = 0;
+            for (uint32_t i = 0; i < lookups; ++i) {
+                const auto& [a_ref, a_pos] = linear[i];
+                const auto& [b_ref, b_pos] = indexed[i];
+                if (a_ref.plane != b_ref.plane || a_ref.index != b_ref.index || a_pos.x != b_pos.x || a_pos.y != b_pos.y || a_pos.zplane != b_pos.zplane) level_mismatches++;
+            }
+            printf("   lookups: grid (%s) %.0f/s (%.1fx), %zu mismatches\n", GetKernelLevelName(level), lookups / (indexed_ms / 1000.0), linear_ms / std::max(indexed_ms, 1e-3), level_mismatches);
+            mismatches += level_mismatches;
+        }
+        SetKernelLevel(best_level);
+        return RunKernels(map, positions) && mismatches == 0;
+    }
+
+    // Runs the same queries from several threads at once on one graph; results must match the sequential run
+    bool RunConcurrentSearches(const VisGraph& graph, const std::vector<std::pair<MapPos, MapPos>>& pairs, const std::vector<float>& expected_costs, uint32_t search_threads)
+    {
+        std::atomic<size_t> next = 0;
+        std::atomic<size_t> mismatches = 0;
+        const auto start = Clock::now();
+        std::vector<std::thread> workers;
+        for (uint32_t t = 0; t < search_threads; ++t) {
+            workers.emplace_back([&] {
+                const BlockedPlaneBitset blocked_planes;
+                PathResult result;
+                for (size_t i = next++; i < pairs.size(); i = next++) {
+                    const auto err = graph.Search(pairs[i].first, pairs[i].second, blocked_planes, result);
+                    const float cost = err == Error::OK ? result.cost : -1.f;
+                    if (cost != expected_costs[i]) mismatches++;
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        const double ms = ElapsedMs(start);
+        printf("   concurrent search: %u threads, %.0f queries/s, %zu mismatches\n", search_threads, pairs.size() / (ms / 1000.0), mismatches.load());
+        return mismatches == 0;
+    }
+
+    // Moves the start along the path and toggles a plane on and off, replanning incrementally after each change.
+    // Every result must match a full search from scratch.
+    bool RunReplans(const VisGraph& graph, const std::vector<std::pair<MapPos, MapPos>>& pairs, uint32_t replans)
+    {
+        const auto plane_count = static_cast<uint32_t>(graph.GetMapData().planes.size());
+        IncrementalSearch planner(graph);
+        struct Stats {
+            const char* name;
+            size_t count = 0;
+            size_t expanded = 0;
+            double incremental_ms = 0.0;
+            double full_ms = 0.0;
+        };
+        Stats stats[] = {{"new goal"}, {"start moved"}, {"plane toggled"}};
+        size_t mismatches = 0;
+
+        const auto check = [&](const MapPos& from, const MapPos& to, const BlockedPlaneBitset& blocked_planes, Stats& s) {
+            PathResult incremental, full;
+            auto start = Clock::now();
+            const auto err_a = planner.Plan(from, to, blocked_planes, incremental);
+            s.incremental_ms += ElapsedMs(start);
+            s.expanded += planner.GetExpandedCount();
+            start = Clock::now();
+            const auto err_b = graph.Search(from, to, blocked_planes, full);
+            s.full_ms += ElapsedMs(start);
+            s.count++;
+            // Same shortest path length; summed in a different order, and ties may pick other points
+            if (err_a != err_b || (err_a == Error::OK && fabsf(incremental.cost - full.cost) > 1e-4f * std::max(1.f, full.cost))) mismatches++;
+            return full;
+        };
+
+        for (uint32_t i = 0; i < replans && i < pairs.size(); ++i) {
+            const auto& [from, to] = pairs[i];
+            const BlockedPlaneBitset none;
+            const auto path = check(from, to, none, stats[0]);
+            if (path.points.size() < 2) continue;
+
+            // Walk towards the first corner in a few steps
+            for (int step = 1; step <= 3; ++step) {
+                const float f = step / 4.f;
+                const auto& a = path.points[0];
+                const auto& b = path.points[1];
+                check({a.x + (b.x - a.x) * f, a.y + (b.y - a.y) * f, a.zplane}, to, none, stats[1]);
+            }
+            if (plane_count > 1) {
+                BlockedPlaneBitset blocked;
+                blocked.set(1 + i % (plane_count - 1));
+                check(from, to, none, stats[1]);
+                check(from, to, blocked, stats[2]);
+                check(from, to, none, stats[2]);
+            }
+        }
+        for (const auto& s : stats) {
+            if (!s.count) continue;
+            printf("   replan, %s: %zu plans, incremental %.2f ms (%.0f expanded), full search %.2f ms\n", s.name, s.count, s.incremental_ms / s.count, static_cast<double>(s.expanded) / s.count, s.full_ms / s.count);
+        }
+        printf("   replan: %zu mismatches\n", mismatches);
+        return mismatches == 0;
+    }
+
+    // One distance matrix against a search per pair, with nothing and with one plane blocked
+    bool RunMatrix(const VisGraph& graph, uint32_t size, uint32_t seed)
+    {
+        const auto& map = graph.GetMapData();
+        std::mt19937 rng(seed + 1);
+        std::vector<MapPos> sources(size), targets(size);
+        for (auto& pos : sources) pos = RandomPosition(map, rng);
+        for (auto& pos : targets) pos = RandomPosition(map, rng);
+
+        size_t mismatches = 0;
+        const auto plane_count = static_cast<uint32_t>(map.planes.size());
+        for (uint32_t blocked_plane = 0; blocked_plane < std::min(plane_count, 2u); ++blocked_plane) {
+            BlockedPlaneBitset blocked_planes;
+            if (blocked_plane) blocked_planes.set(blocked_plane);
+
+            DistanceMatrix matrix;
+            auto start = Clock::now();
+            const auto err = graph.ComputeDistanceMatrix(sources, targets, blocked_planes, matrix);
+            const double matrix_ms = ElapsedMs(start);
+            if (err != Error::OK) {
+                printf("   matrix: %s\n", ErrorName(err));
+                return false;
+            }
+
+            size_t unreachable = 0;
+            PathResult result;
+            start = Clock::now();
+            for (uint32_t s = 0; s < size; ++s) {
+                for (uint32_t t = 0; t < size; ++t) {
+                    const float cost = graph.Search(sources[s], targets[t], blocked_planes, result) == Error::OK ? result.cost : INFINITY;
+                    const float d = matrix.Distance(s, t);
+                    if (std::isinf(cost)) unreachable++;
+                    if (std::isinf(cost) != std::isinf(d) || (!std::isinf(cost) && fabsf(cost - d) > 1e-4f * std::max(1.f, cost))) mismatches++;
+                }
+            }
+            const double search_ms = ElapsedMs(start);
+            printf("   matrix%s: %ux%u in %.2f ms, %u searches %.2f ms (%.1fx), %zu unreachable\n", blocked_plane ? " (plane blocked)" : "", size, size, matrix_ms, size * size, search_ms, search_ms / std::max(matrix_ms, 1e-3), unreachable);
+        }
+        printf("   matrix: %zu mismatches\n", mismatches);
+        return mismatches == 0;
+    }
+
+    float RouteCost(const DistanceMatrix& matrix, const std::vector<uint32_t>& order)
+    {
+        float cost = 0.f;
+        uint32_t from = 0;
+        for (const auto i : order) {
+            cost += matrix.Distance(from, i + 1);
+            from = i + 1;
+        }
+        return cost;
+    }
+
+    // Searches between positions far apart, where the full search expands most of the graph
+    bool RunHierarchical(const VisGraph& graph, uint32_t queries, uint32_t seed)
+    {
+        const auto& map = graph.GetMapData();
+        auto start = Clock::now();
+        HierarchicalGraph hierarchy(graph);
+        if (!hierarchy.Build()) {
+            printf("   hierarchical: build failed\n");
+            return false;
+        }
+        printf("   hierarchical: build %.1f ms, %zu clusters, %zu entrances, %zu abstract edges, ~%.1f MB\n", ElapsedMs(start), hierarchy.GetClusterCount(), hierarchy.GetEntranceCount(), hierarchy.GetAbstractEdgeCount(),
+               hierarchy.GetMemoryUsage() / (1024.0 * 1024.0));
+
+        float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+        for (const auto& plane : map.planes) {
+            for (const auto& t : plane.trapezoids) {
+                min_x = std::min({min_x, t.XTL, t.XBL});
+                max_x = std::max({max_x, t.XTR, t.XBR});
+                min_y = std::min(min_y, t.YB);
+                max_y = std::max(max_y, t.YT);
+            }
+        }
+        const float min_distance = GetDistance({min_x, min_y}, {max_x, max_y}) * .4f;
+        std::mt19937 rng(seed + 3);
+        std::vector<std::pair<MapPos, MapPos>> pairs;
+        for (uint32_t tries = 0; pairs.size() < queries && tries < queries * 100; ++tries) {
+            const auto from = RandomPosition(map, rng);
+            const auto to = RandomPosition(map, rng);
+            if (GetDistance(ToVec2f(from), ToVec2f(to)) >= min_distance) pairs.emplace_back(from, to);
+        }
+
+        size_t mismatches = 0;
+        const auto plane_count = static_cast<uint32_t>(map.planes.size());
+        for (uint32_t blocked_plane = 0; blocked_plane < std::min(plane_count, 2u); ++blocked_plane) {
+            BlockedPlaneBitset blocked_planes;
+            if (blocked_plane) blocked_planes.set(blocked_plane);
+            double full_ms = 0.0, hierarchical_ms = 0.0, total_ratio = 0.0, worst_ratio = 1.0;
+            size_t found = 0;
+            PathResult full, fast;
+            for (const auto& [from, to] : pairs) {
+                start = Clock::now();
+                const auto err_full = graph.Search(from, to, blocked_planes, full);
+                full_ms += ElapsedMs(start);
+                start = Clock::now();
+                const auto err_fast = hierarchy.Search(from, to, blocked_planes, fast);
+                hierarchical_ms += ElapsedMs(start);
+                // Never shorter than the shortest path, and found whenever there is one
+                if (err_full != err_fast || (err_full == Error::OK && fast.cost < full.cost * (1.f - 1e-4f))) {
+                    mismatches++;
+                    continue;
+                }
+                if (err_full != Error::OK) continue;
+                const double ratio = full.cost > 0.f ? fast.cost / full.cost : 1.0;
+                total_ratio += ratio;
+                worst_ratio = std::max(worst_ratio, ratio);
+                found++;
+            }
+            if (pairs.empty()) break;
+            printf("   hierarchical%s: %zu long queries, full %.2f ms, hierarchical %.2f ms (%.1fx), %.2f%% longer on average, %.2f%% worst\n", blocked_plane ? " (plane blocked)" : "", pairs.size(), full_ms / pairs.size(),
+                   hierarchical_ms / pairs.size(), full_ms / std::max(hierarchical_ms, 1e-3), found ? (total_ratio / found - 1.0) * 100.0 : 0.0, (worst_ratio - 1.0) * 100.0);
+        }
+        printf("   hierarchical: %zu mismatches\n", mismatches);
+        return mismatches == 0;
+    }
+
+    // Every few units along the path are on some trapezoid; catches corners cut through walls
+    bool IsOnMap(const TrapezoidGrid& grid, const PathResult& path)
+    {
+        constexpr float step = 10.f;
+        for (size_t i = 1; i < path.points.size(); ++i) {
+            const auto a = ToVec2f(path.points[i - 1]);
+            const auto b = ToVec2f(path.points[i]);
+            const auto steps = static_cast<uint32_t>(GetDistance(a, b) / step) + 1;
+            for (uint32_t s = 0; s <= steps; ++s) {
+                const auto p = a + (static_cast<float>(s) / steps) * (b - a);
+                if (!grid.FindTrapezoid({p.x, p.y, path.points[i].zplane}).IsValid()) return false;
+            }
+        }
+        return true;
+    }
+
+    // Trapezoid corridors with string pulling, which need no visibility graph, against the full search
+    bool RunCorridor(const VisGraph& graph, double graph_build_ms, uint32_t queries, uint32_t seed)
+    {
+        const auto& map = graph.GetMapData();
+        auto start = Clock::now();
+        CorridorSearch corridor(map);
+        if (!corridor.Build()) {
+            printf("   corridor: build failed\n");
+            return false;
+        }
+        const double build_ms = ElapsedMs(start);
+        printf("   corridor: build %.1f ms (%.1fx faster than the graph), %zu portals, ~%.1f MB\n", build_ms, graph_build_ms / std::max(build_ms, 1e-3), corridor.GetPortalCount(), corridor.GetMemoryUsage() / (1024.0 * 1024.0));
+
+        std::mt19937 rng(seed + 4);
+        std::vector<std::pair<MapPos, MapPos>> pairs(queries);
+        for (auto& [from, to] : pairs) {
+            from = RandomPosition(map, rng);
+            to = RandomPosition(map, rng);
+        }
+
+        const TrapezoidGrid grid(map);
+        size_t off_map = 0, shorter = 0;
+        const auto plane_count = static_cast<uint32_t>(map.planes.size());
+        for (uint32_t blocked_plane = 0; blocked_plane < std::min(plane_count, 2u); ++blocked_plane) {
+            BlockedPlaneBitset blocked_planes;
+            if (blocked_plane) blocked_planes.set(blocked_plane);
+            double full_ms = 0.0, corridor_ms = 0.0, total_ratio = 0.0, worst_ratio = 1.0;
+            size_t found = 0, disagreements = 0, within_1_percent = 0;
+            PathResult full, fast;
+            for (const auto& [from, to] : pairs) {
+                start = Clock::now();
+                const auto err_full = graph.Search(from, to, blocked_planes, full);
+                full_ms += ElapsedMs(start);
+                start = Clock::now();
+                const auto err_fast = corridor.Search(from, to, blocked_planes, fast);
+                corridor_ms += ElapsedMs(start);
+                if (err_full != err_fast) {
+                    disagreements++;
+                    continue;
+                }
+                if (err_full != Error::OK) continue;
+                if (!IsOnMap(grid, fast)) off_map++;
+                // The graph doesn't see across some plane boundaries, so the funnel can beat it
+                if (fast.cost < full.cost * (1.f - 1e-4f)) shorter++;
+                const double ratio = full.cost > 0.f ? fast.cost / full.cost : 1.0;
+                total_ratio += ratio;
+                worst_ratio = std::max(worst_ratio, ratio);
+                within_1_percent += ratio <= 1.01;
+                found++;
+            }
+            if (pairs.empty()) break;
+            printf("   corridor%s: %zu queries, full %.3f ms, corridor %.3f ms (%.1fx), %.2f%% longer on average, %.2f%% worst, %.1f%% within 1%%, %zu reachability disagreements\n", blocked_plane ? " (plane blocked)" : "", pairs.size(),
+                   full_ms / pairs.size(), corridor_ms / pairs.size(), full_ms / std::max(corridor_ms, 1e-3), found ? (total_ratio / found - 1.0) * 100.0 : 0.0, (worst_ratio - 1.0) * 100.0, found ? within_1_percent * 100.0 / found : 0.0,
+                   disagreements);
+        }
+        printf("   corridor: %zu paths leave the map, %zu shorter than the graph's\n", off_map, shorter);
+        return off_map == 0;
+    }
+
+    // Walking towards a goal and asking for the rest of the path every step, as the minimap does.
+    // Cached paths must agree with full searches on reachability and stay on the map.
+    bool RunPathCache(const VisGraph& graph, uint32_t walks, uint32_t seed)
+    {
+        constexpr float step = 100.f;
+        const auto& map = graph.GetMapData();
+        const TrapezoidGrid grid(map);
+        std::mt19937 rng(seed + 5);
+        PathCache cache(graph);
+
+        double full_ms = 0.0, cached_ms = 0.0, total_ratio = 0.0, worst_ratio = 1.0;
+        size_t queries = 0, found = 0, disagreements = 0, off_map = 0;
+        for (uint32_t walk = 0; walk < walks; ++walk) {
+            BlockedPlaneBitset blocked_planes;
+            const auto from = RandomPosition(map, rng);
+            const auto to = RandomPosition(map, rng);
+            PathResult path;
+            if (graph.Search(from, to, blocked_planes, path) != Error::OK) continue;
+
+            std::vector<MapPos> positions;
+            for (size_t i = 1; i < path.points.size(); ++i) {
+                const auto a = ToVec2f(path.points[i - 1]);
+                const auto b = ToVec2f(path.points[i]);
+                const auto steps = static_cast<uint32_t>(GetDistance(a, b) / step) + 1;
+                for (uint32_t s = 0; s < steps; ++s) {
+                    const auto p = a + (static_cast<float>(s) / steps) * (b - a);
+                    positions.push_back({p.x, p.y, path.points[i - 1].zplane});
+                }
+            }
+
+            for (size_t i = 0; i < positions.size(); ++i) {
+                // A door closing halfway along
+                if (walk % 2 && i == positions.size() / 2 && map.planes.size() > 1) blocked_planes.set(1);
+                PathResult cached, full;
+                auto start = Clock::now();
+                auto err_cached = Error::OK;
+                if (!cache.Find(positions[i], to, blocked_planes, cached)) {
+                    err_cached = graph.Search(positions[i], to, blocked_planes, cached);
+                    if (err_cached == Error::OK) cache.Insert(positions[i], to, blocked_planes, cached);
+                }
+                cached_ms += ElapsedMs(start);
+                start = Clock::now();
+                const auto err_full = graph.Search(positions[i], to, blocked_planes, full);
+                full_ms += ElapsedMs(start);
+                queries++;
+
+                if ((err_cached == Error::OK) != (err_full == Error::OK)) {
+                    disagreements++;
+                    continue;
+                }
+                if (err_full != Error::OK) continue;
+                if (!IsOnMap(grid, cached)) off_map++;
+                const double ratio = full.cost > 0.f ? cached.cost / full.cost : 1.0;
+                total_ratio += ratio;
+                worst_ratio = std::max(worst_ratio, ratio);
+                found++;
+            }
+        }
+        if (!queries) return true;
+        const auto& stats = cache.GetStats();
+        printf("   path cache: %zu queries along %u walks, full %.3f ms, cached %.3f ms (%.1fx), %zu hits, %zu reattached, %zu misses, %zu invalidations\n", queries, walks, full_ms / queries, cached_ms / queries, full_ms / std::max(cached_ms, 1e-3),
+               stats.hits, stats.reattached, stats.misses, stats.invalidations);
+        printf("   path cache: %.2f%% longer on average, %.2f%% worst, %zu reachability disagreements, %zu paths leave the map\n", found ? (total_ratio / found - 1.0) * 100.0 : 0.0, (worst_ratio - 1.0) * 100.0, disagreements, off_map);
+        return disagreements == 0 && off_map == 0;
+    }
+
+    // Every enabled waypoint exactly once, either in the order or unreachable
+    bool IsValidRoute(const Route& route, const std::vector<uint8_t>& enabled)
+    {
+        std::vector<uint32_t> seen(route.order);
+        seen.insert(seen.end(), route.unreachable.begin(), route.unreachable.end());
+        std::ranges::sort(seen);
+        std::vector<uint32_t> expected;
+        for (uint32_t i = 0; i < enabled.size(); ++i) {
+            if (enabled[i]) expected.push_back(i);
+        }
+        return seen == expected;
+    }
+
+    // A route through waypoints all over the map, then rerun the way a live route would be: the player
+    // has moved on and the first group is dead. Small routes are compared against brute force.
+    bool RunRoute(const VisGraph& graph, uint32_t size, uint32_t seed)
+    {
+        const auto& map = graph.GetMapData();
+        const BlockedPlaneBitset blocked_planes;
+        std::mt19937 rng(seed + 2);
+        std::vector<MapPos> nodes(size + 1); // start, then the waypoints
+        for (auto& pos : nodes) pos = RandomPosition(map, rng);
+        const std::span<const MapPos> waypoints(nodes.begin() + 1, nodes.end());
+
+        RouteOptimizer optimizer(graph);
+        optimizer.SetWaypoints(waypoints);
+        std::vector<uint8_t> enabled(size, 1);
+        Route route;
+        auto start = Clock::now();
+        if (optimizer.Optimize(nodes[0], blocked_planes, route) != Error::OK) {
+            printf("   route: optimize failed\n");
+            return false;
+        }
+        const double first_ms = ElapsedMs(start);
+        bool valid = IsValidRoute(route, enabled);
+
+        // The same heuristic on straight line distances, walked for real
+        DistanceMatrix matrix;
+        graph.ComputeDistanceMatrix(nodes, nodes, blocked_planes, matrix);
+        DistanceMatrix straight = matrix;
+        for (uint32_t a = 0; a <= size; ++a) {
+            for (uint32_t b = 0; b <= size; ++b) {
+                if (!std::isinf(matrix.Distance(a, b))) straight.distances[a * (size + 1) + b] = GetDistance(ToVec2f(nodes[a]), ToVec2f(nodes[b]));
+            }
+        }
+        start = Clock::now();
+        Route straight_route;
+        RouteOptimizer::Optimize(straight, straight_route);
+        const double optimize_ms = ElapsedMs(start);
+        const float straight_cost = RouteCost(matrix, straight_route.order);
+        printf("   route: %u waypoints in %.1f ms (heuristic alone %.2f ms), length %.0f, straight line order walks %.0f (+%.1f%%), %zu unreachable\n", size, first_ms, optimize_ms, route.cost, straight_cost,
+               (straight_cost / route.cost - 1.f) * 100.f, route.unreachable.size());
+
+        uint32_t reruns = 0;
+        start = Clock::now();
+        for (; reruns < 10 && route.order.size() > 1; ++reruns) {
+            const auto& next = waypoints[route.order[0]];
+            const MapPos moved{(nodes[0].x + next.x) / 2, (nodes[0].y + next.y) / 2, next.zplane};
+            enabled[route.order[0]] = 0;
+            optimizer.SetEnabled(route.order[0], false);
+            if (optimizer.Optimize(moved, blocked_planes, route) != Error::OK) valid = false;
+            valid = valid && IsValidRoute(route, enabled);
+        }
+        if (reruns) printf("   route: rerun after moving and dropping a waypoint %.2f ms\n", ElapsedMs(start) / reruns);
+
+        // Repeated positions, first new and then as a subset of the known waypoints; each copy must be visited
+        bool duplicates_valid = true;
+        for (const uint32_t count : {size, size / 2}) {
+            std::vector<MapPos> repeated(waypoints.begin(), waypoints.begin() + count);
+            repeated.insert(repeated.end(), waypoints.begin(), waypoints.begin() + count / 2);
+            std::vector<uint32_t> index;
+            optimizer.UpdateWaypoints(repeated, index);
+            std::vector<uint32_t> distinct(index);
+            std::ranges::sort(distinct);
+            duplicates_valid = duplicates_valid && std::ranges::adjacent_find(distinct) == distinct.end();
+            std::vector<uint8_t> repeated_enabled(optimizer.GetWaypoints().size(), 0);
+            for (const auto i : index) repeated_enabled[i] = 1;
+            if (optimizer.Optimize(nodes[0], blocked_planes, route) != Error::OK) duplicates_valid = false;
+            duplicates_valid = duplicates_valid && IsValidRoute(route, repeated_enabled) && route.order.size() + route.unreachable.size() == repeated.size();
+        }
+        if (!duplicates_valid) printf("   route: repeated waypoints aren't each visited once\n");
+        valid = valid && duplicates_valid;
+
+        // Brute force the best order of 8 waypoints; the heuristic should land close to it
+        constexpr uint32_t small = 8;
+        double worst_gap = 0.0, total_gap = 0.0;
+        uint32_t trials = 0;
+        for (uint32_t trial = 0; trial < 20; ++trial) {
+            std::vector<MapPos> small_nodes(small + 1);
+            for (auto& pos : small_nodes) pos = RandomPosition(map, rng);
+            DistanceMatrix small_matrix;
+            graph.ComputeDistanceMatrix(small_nodes, small_nodes, blocked_planes, small_matrix);
+            Route small_route;
+            RouteOptimizer::Optimize(small_matrix, small_route);
+            if (!small_route.unreachable.empty()) continue;
+
+            std::vector<uint32_t> order(small);
+            for (uint32_t i = 0; i < small; ++i) order[i] = i;
+            float best = INFINITY;
+            do {
+                best = std::min(best, RouteCost(small_matrix, order));
+            } while (std::ranges::next_permutation(order).found);
+
+            const double gap = small_route.cost / best - 1.0;
+            worst_gap = std::max(worst_gap, gap);
+            total_gap += gap;
+            trials++;
+        }
+        if (trials) printf("   route: %u waypoints vs brute force over %u routes, %.2f%% longer on average, %.2f%% worst\n", small, trials, total_gap / trials * 100.0, worst_gap * 100.0);
+        if (!valid) printf("   route: order doesn't visit every waypoint once\n");
+        return valid;
+    }
+
+    bool RunCacheRoundTrip(const NamedMap& named, const VisGraph& built, const std::vector<std::pair<MapPos, MapPos>>& pairs, const std::filesystem::path& cache_dir)
+    {
+        const auto path = cache_dir / (std::to_string(named.map.map_file_id) + "_" + std::to_string(std::hash<std::string>{}(named.name)) + ".gwpg");
+
+        auto start = Clock::now();
+        if (!built.SaveCache(path)) {
+            printf("   cache: failed to save %s\n", path.string().c_str());
+            return false;
+        }
+        const double save_ms = ElapsedMs(start);
+
+        start = Clock::now();
+        VisGraph loaded(named.map);
+        if (!loaded.LoadCache(path)) {
+            printf("   cache: failed to load %s\n", path.string().c_str());
+            return false;
+        }
+        const double load_ms = ElapsedMs(start);
+
+        // A cache made for other teleports must be rejected
+        VisGraph other(named.map);
+        const bool rejects_stale = !other.LoadCache(path, {Teleport{{0.f, 0.f, 0}, {1.f, 1.f, 0}, true}});
+
+        // Same queries on both graphs must give the same paths
+        const BlockedPlaneBitset blocked_planes;
+        PathResult a, b;
+        size_t mismatches = 0;
+        for (const auto& [from, to] : pairs) {
+            const auto err_a = built.Search(from, to, blocked_planes, a);
+            const auto err_b = loaded.Search(from, to, blocked_planes, b);
+            if (err_a != err_b || a.cost != b.cost || a.points.size() != b.points.size()) mismatches++;
+        }
+        printf("   cache: %.1f KB, save %.1f ms, load %.1f ms, %zu mismatches%s\n", std::filesystem::file_size(path) / 1024.0, save_ms, load_ms, mismatches, rejects_stale ? "" : ", stale cache accepted!");
+        return mismatches == 0 && rejects_stale;
+    }
+
+    // The binary map must give back the same map and the same JSON; a damaged byte must be caught
+    bool RunBinaryRoundTrip(const PathingMapData& map, uint32_t repeats)
+    {
+        const auto json = nlohmann::json(map).dump();
+        const auto best_of = [repeats](const auto& fn) {
+            double best = INFINITY;
+            for (uint32_t i = 0; i < repeats; ++i) {
+                const auto start = Clock::now();
+                fn();
+                best = std::min(best, ElapsedMs(start));
+            }
+            return best;
+        };
+        nlohmann::json parsed;
+        const double json_ms = best_of([&] { parsed = nlohmann::json::parse(json); });
+
+        std::vector<uint8_t> bytes;
+        const double encode_ms = best_of([&] { bytes = EncodeBinaryMap(map); });
+        const auto path = std::filesystem::temp_directory_path() / ("PathingBench_" + std::to_string(map.map_file_id) + ".gwpm");
+        if (!WriteBinaryMap(path, map)) {
+            printf("   binary: failed to write %s\n", path.string().c_str());
+            return false;
+        }
+
+        PathingMapFile file;
+        const double open_ms = best_of([&] { file.Open(path); });
+        const double open_unchecked_ms = best_of([&] { file.Open(path, false); });
+        PathingMapData loaded;
+        const double copy_ms = best_of([&] { loaded = file.GetView().ToMapData(); });
+
+        size_t mismatches = 0;
+        if (!file.GetView().IsValid() || !IsSameMapData(map, loaded)) mismatches++;
+        if (nlohmann::json(loaded).dump() != json) mismatches++;
+        file.Close();
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+
+        // Any flipped bit past the magic must fail the checksum or the header checks
+        std::mt19937 rng(map.map_file_id);
+        size_t undetected = 0;
+        PathingMapView view;
+        for (int i = 0; i < 16 && bytes.size() > 4; ++i) {
+            const size_t at = 4 + rng() % (bytes.size() - 4);
+            const auto bit = static_cast<uint8_t>(1u << rng() % 8);
+            bytes[at] ^= bit;
+            if (view.Attach(bytes.data(), bytes.size())) undetected++;
+            bytes[at] ^= bit;
+        }
+
+        printf("   binary: %.1f KB (json %.1f KB), encode %.2f ms, open %.3f ms (%.3f ms unchecked), copy out %.2f ms, json parse %.2f ms (%.0fx open)\n", bytes.size() / 1024.0, json.size() / 1024.0, encode_ms, open_ms, open_unchecked_ms, copy_ms,
+               json_ms, json_ms / std::max(open_ms, 1e-3));
+        printf("   binary: %zu mismatches, %zu damaged maps accepted\n", mismatches, undetected);
+        return mismatches == 0 && undetected == 0;
+    }
+
+    bool RunMap(const NamedMap& named, uint32_t queries, uint32_t seed, uint32_t threads, uint32_t search_threads, uint32_t lookups, uint32_t replans, uint32_t matrix, uint32_t route, uint32_t hierarchical, uint32_t corridor, uint32_t path_cache, uint32_t binary, const std::filesystem::path& cache_dir)
+    {
+        const auto& map = named.map;
+        printf("== %s: %zu planes, %zu trapezoids\n", named.name.c_str(), map.GetPlaneCount(), map.GetTotalTrapezoidCount());
+        if (binary && !RunBinaryRoundTrip(map, binary)) {
+            return false;
+        }
+        if (lookups && !RunLookups(map, lookups, seed)) {
+            return false;
+        }
+
+        auto start = Clock::now();
+        VisGraph graph(map);
+        if (!graph.Build({}, threads)) {
+            printf("   build failed\n");
+            return false;
+        }
+        const double build_ms = ElapsedMs(start);
+        printf("   build: %.1f ms, %zu points, %zu edges, %zu blocked plane masks, ~%.1f MB\n", build_ms, graph.GetPointCount(), graph.GetEdgeCount(), graph.GetBlockedPlaneMaskCount(), graph.GetMemoryUsage() / (1024.0 * 1024.0));
+
+        std::mt19937 rng(seed);
+        std::vector<std::pair<MapPos, MapPos>> pairs(queries);
+        for (auto& [from, to] : pairs) {
+            from = RandomPosition(map, rng);
+            to = RandomPosition(map, rng);
+        }
+
+        uint32_t errors[static_cast<size_t>(Error::FailedToGetPathingMapBlock) + 1] = {};
+        size_t total_points = 0;
+        double total_cost = 0.0;
+        const BlockedPlaneBitset blocked_planes;
+        PathResult result;
+        start = Clock::now();
+        std::vector<float> costs(pairs.size(), -1.f);
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            const auto err = graph.Search(pairs[i].first, pairs[i].second, blocked_planes, result);
+            errors[std::min<size_t>(static_cast<size_t>(err), std::size(errors) - 1)]++;
+            if (err != Error::OK) continue;
+            total_points += result.points.size();
+            total_cost += result.cost;
+            costs[i] = result.cost;
+        }
+        const double search_ms = ElapsedMs(start);
+        if (queries) {
+            printf("   search: %u queries in %.1f ms, %.0f queries/s, %.1f points/path, checksum %.1f\n", queries, search_ms, queries / (search_ms / 1000.0), errors[0] ? static_cast<double>(total_points) / errors[0] : 0.0, total_cost);
+        }
+        for (size_t i = 0; i < std::size(errors); ++i) {
+            if (errors[i] && i != static_cast<size_t>(Error::OK)) printf("   %s: %u\n", ErrorName(static_cast<Error>(i)), errors[i]);
+        }
+        if (search_threads > 1 && !RunConcurrentSearches(graph, pairs, costs, search_threads)) {
+            return false;
+        }
+        if (replans && !RunReplans(graph, pairs, replans)) {
+            return false;
+        }
+        if (matrix && !RunMatrix(graph, matrix, seed)) {
+            return false;
+        }
+        if (route && !RunRoute(graph, route, seed)) {
+            return false;
+        }
+        if (hierarchical && !RunHierarchical(graph, hierarchical, seed)) {
+            return false;
+        }
+        if (corridor && !RunCorridor(graph, build_ms, corridor, seed)) {
+            return false;
+        }
+        if (path_cache && !RunPathCache(graph, path_cache, seed)) {
+            return false;
+        }
+        if (!cache_dir.empty()) {
+            return RunCacheRoundTrip(named, graph, pairs, cache_dir);
+        }
+        return true;
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t queries = 1000;
+    uint32_t seed = 1;
+    uint32_t threads = 0;
+    uint32_t search_threads = 1;
+    uint32_t lookups = 10000;
+    uint32_t replans = 50;
+    uint32_t matrix = 16;
+    uint32_t route = 100;
+    uint32_t hierarchical = 200;
+    uint32_t corridor = 1000;
+    uint32_t path_cache = 10;
+    uint32_t binary = 5;
+    std::filesystem::path cache_dir;
+    bool synthetic = false;
+    std::vector<uint32_t> synthetic_args;
+    std::vector<NamedMap> maps;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--queries" && i + 1 < argc) {
+            queries = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            threads = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--search-threads" && i + 1 < argc) {
+            search_threads = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--replans" && i + 1 < argc) {
+            replans = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--matrix" && i + 1 < argc) {
+            matrix = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--route" && i + 1 < argc) {
+            route = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--hierarchical" && i + 1 < argc) {
+            hierarchical = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--corridor" && i + 1 < argc) {
+            corridor = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--path-cache" && i + 1 < argc) {
+            path_cache = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--binary" && i + 1 < argc) {
+            binary = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--lookups" && i + 1 < argc) {
+            lookups = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--cache" && i + 1 < argc) {
+            cache_dir = argv[++i];
+            std::filesystem::create_directories(cache_dir);
+        }
+        else if (arg == "--synthetic") {
+            synthetic = true;
+        }
+        else if (synthetic && !arg.empty() && isdigit(static_cast<unsigned char>(arg[0]))) {
+            synthetic_args.push_back(static_cast<uint32_t>(strtoul(arg.c_str(), nullptr, 10)));
+        }
+        else if (std::filesystem::is_directory(arg)) {
+            std::vector<std::filesystem::path> files;
+            for (const auto& entry : std::filesystem::directory_iterator(arg)) {
+                if (entry.is_regular_file()) files.push_back(entry.path());
+            }
+            std::ranges::sort(files);
+            for (const auto& file : files)
+                LoadMapFile(file, maps);
+        }
+        else {
+            LoadMapFile(arg, maps);
+        }
+    }
+
+    if (synthetic) {
+        const uint32_t bands = synthetic_args.size() > 0 ? synthetic_args[0] : 64;
+        const uint32_t bricks = synthetic_args.size() > 1 ? synthetic_args[1] : 24;
+        char name[64];
+        snprintf(name, sizeof(name), "synthetic %ux%u", bands, bricks);
+        maps.push_back({name, MakeSyntheticMap(bands, bricks, seed)});
+    }
+
+    if (maps.empty()) {
+        printf("Usage: %s [--queries N] [--seed S] [--threads T] [--search-threads T] [--cache DIR] [--lookups N] [--replans N] [--matrix N] [--route N] [--hierarchical N] [--corridor N] [--path-cache N] [--binary N] <map.ffna | maps.gwmp | directory>... | --synthetic [bands] [bricks_per_band]\n", argv[0]);
+        return 1;
+    }
+
+    int failed = 0;
+    const auto start = Clock::now();
+    for (const auto& map : maps) {
+        if (!RunMap(map, queries, seed, threads, search_threads, lookups, replans, matrix, route, hierarchical, corridor, path_cache, binary, cache_dir)) failed++;
+    }
+    printf("total: %zu maps in %.1f ms, peak rss %zu KB\n", maps.size(), ElapsedMs(start), PeakRssKb());
+    return failed ? 2 : 0;
+}
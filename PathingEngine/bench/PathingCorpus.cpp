@@ -0,0 +1,347 @@
+// Replays recorded pathing queries (see QueryCorpus.h) to catch changes that
+// make paths wrong or slow.
+//
+// Usage:
+//   PathingCorpus [options] <corpus directory | name.queries.json>...
+//   PathingCorpus --record N [--seed S] <out directory> <map.ffna | maps.gwmp | directory>... | --synthetic [count]
+//
+// Options:
+//   --threads T         threads used to build the graph (default: one per core)
+//   --repeat R          replay every query R times; latencies are over all runs (default 3)
+//   --tolerance F       relative cost change still counted as the same path (default 0.0001)
+//   --report FILE       write build time and latencies per map to FILE (JSON)
+//   --compare FILE      show how build time and latencies moved against a report written earlier
+//   --max-slowdown P    also fail if p50 or build time got more than P percent slower than in --compare
+//
+// Each map's graph is built, then every query is searched through
+// VisGraph::Search and its error code and cost compared against the recorded
+// ones. Exits with 2 if any query gives a different error, a cost outside the
+// tolerance, or a corpus can't be read.
+//
+// --record writes a corpus of N random queries per map to the out directory,
+// with the results of the current engine as expected results; every fourth
+// query has a random plane blocked. Map files are named as for PathingBench;
+// --synthetic records count synthetic maps of growing size (default 2).
+// The toolbox records queries made in game from the pathfinding window, to
+// pathing/corpus. bench/corpus has a small synthetic corpus to start from:
+//   PathingCorpus PathingEngine/bench/corpus
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <QueryCorpus.h>
+#include <VisGraph.h>
+
+#include "BenchMaps.h"
+
+namespace {
+    using namespace Pathing;
+    using namespace Pathing::Bench;
+    using Clock = std::chrono::steady_clock;
+
+    double ElapsedMs(Clock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    }
+
+    struct Options {
+        uint32_t threads = 0;
+        uint32_t repeat = 3;
+        double tolerance = 0.0001;
+        double max_slowdown = -1.0; // percent; off when negative
+        nlohmann::json baseline;    // --compare
+    };
+
+    struct MapReport {
+        double build_ms = 0.0;
+        double p50_ms = 0.0;
+        double p99_ms = 0.0;
+        size_t queries = 0;
+        size_t cost_changes = 0;
+        size_t error_changes = 0;
+    };
+
+    double Percentile(std::vector<double>& samples, double q)
+    {
+        if (samples.empty()) return 0.0;
+        const auto n = std::min(samples.size() - 1, static_cast<size_t>(samples.size() * q));
+        std::ranges::nth_element(samples, samples.begin() + n);
+        return samples[n];
+    }
+
+    // Percent change from before to after, e.g. +10.0 for 10% slower
+    double Change(double before, double after)
+    {
+        return before > 0.0 ? (after / before - 1.0) * 100.0 : 0.0;
+    }
+
+    bool RunCorpus(const std::filesystem::path& queries_path, const Options& options, nlohmann::json& report)
+    {
+        auto name = queries_path.filename().string();
+        if (name.ends_with(CORPUS_QUERIES_EXTENSION)) name.resize(name.size() - strlen(CORPUS_QUERIES_EXTENSION));
+
+        PathingMapData map;
+        std::vector<CorpusQuery> queries;
+        if (!ReadQueryCorpus(queries_path, map, queries)) {
+            printf("%s: failed to read corpus\n", queries_path.string().c_str());
+            return false;
+        }
+
+        auto start = Clock::now();
+        VisGraph graph(std::move(map));
+        if (!graph.Build({}, options.threads)) {
+            printf("%s: build failed\n", name.c_str());
+            return false;
+        }
+        MapReport result;
+        result.build_ms = ElapsedMs(start);
+        result.queries = queries.size();
+
+        std::vector<double> latencies;
+        latencies.reserve(queries.size() * options.repeat);
+        std::vector<Error> errors(queries.size());
+        std::vector<float> costs(queries.size());
+        PathResult path;
+        for (uint32_t run = 0; run < std::max(options.repeat, 1u); ++run) {
+            for (size_t i = 0; i < queries.size(); ++i) {
+                const auto& query = queries[i];
+                start = Clock::now();
+                errors[i] = graph.Search(query.start, query.goal, query.blocked_planes, path);
+                latencies.push_back(ElapsedMs(start));
+                costs[i] = errors[i] == Error::OK ? path.cost : 0.f;
+            }
+        }
+        result.p50_ms = Percentile(latencies, 0.5);
+        result.p99_ms = Percentile(latencies, 0.99);
+
+        // Failures by error code, now and as recorded
+        std::map<Error, std::pair<size_t, size_t>> failures;
+        double total_delta = 0.0, worst_delta = 0.0;
+        size_t compared = 0;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const auto& query = queries[i];
+            if (errors[i] != Error::OK) failures[errors[i]].first++;
+            if (query.error != Error::OK) failures[query.error].second++;
+            if (errors[i] != query.error) {
+                result.error_changes++;
+                continue;
+            }
+            if (errors[i] != Error::OK || query.cost <= 0.f) continue;
+            const double delta = costs[i] / static_cast<double>(query.cost) - 1.0;
+            total_delta += delta;
+            if (std::abs(delta) > std::abs(worst_delta)) worst_delta = delta;
+            if (std::abs(delta) > options.tolerance) result.cost_changes++;
+            compared++;
+        }
+
+        printf("%s: %zu trapezoids, build %.1f ms, %zu queries, p50 %.3f ms, p99 %.3f ms\n", name.c_str(), graph.GetMapData().GetTotalTrapezoidCount(), result.build_ms, result.queries, result.p50_ms, result.p99_ms);
+        printf("   cost delta: %+.4f%% on average, %+.4f%% worst, %zu changed, %zu error changes\n", compared ? total_delta / compared * 100.0 : 0.0, worst_delta * 100.0, result.cost_changes, result.error_changes);
+        for (const auto& [error, counts] : failures) {
+            printf("   %s: %zu (recorded %zu)\n", ErrorName(error), counts.first, counts.second);
+        }
+
+        bool ok = result.cost_changes == 0 && result.error_changes == 0;
+        if (options.baseline.contains(name)) {
+            const auto& before = options.baseline[name];
+            const double build_change = Change(before.value("build_ms", 0.0), result.build_ms);
+            const double p50_change = Change(before.value("p50_ms", 0.0), result.p50_ms);
+            const double p99_change = Change(before.value("p99_ms", 0.0), result.p99_ms);
+            printf("   vs report: build %+.1f%%, p50 %+.1f%%, p99 %+.1f%%\n", build_change, p50_change, p99_change);
+            if (options.max_slowdown >= 0.0 && (build_change > options.max_slowdown || p50_change > options.max_slowdown)) {
+                printf("   slower than allowed (%.1f%%)\n", options.max_slowdown);
+                ok = false;
+            }
+        }
+
+        report[name] = {
+            {"build_ms", result.build_ms},
+            {"p50_ms", result.p50_ms},
+            {"p99_ms", result.p99_ms},
+            {"queries", result.queries},
+            {"cost_changes", result.cost_changes},
+            {"error_changes", result.error_changes}
+        };
+        return ok;
+    }
+
+    // Names of recorded corpora: the map's name as a plain file name
+    std::string CorpusName(const std::string& map_name)
+    {
+        auto name = std::filesystem::path(map_name).stem().string();
+        for (auto& c : name) {
+            if (!isalnum(static_cast<unsigned char>(c))) c = '_';
+        }
+        return name;
+    }
+
+    bool RecordCorpus(const NamedMap& named, const std::filesystem::path& out_dir, uint32_t count, uint32_t seed, uint32_t threads)
+    {
+        const auto start = Clock::now();
+        VisGraph graph(named.map);
+        if (!graph.Build({}, threads)) {
+            printf("%s: build failed\n", named.name.c_str());
+            return false;
+        }
+
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<uint32_t> plane_dist(1, static_cast<uint32_t>(std::max<size_t>(named.map.planes.size(), 2) - 1));
+        std::vector<CorpusQuery> queries(count);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            auto& query = queries[i];
+            query.start = RandomPosition(named.map, rng);
+            query.goal = RandomPosition(named.map, rng);
+            if (i % 4 == 3 && named.map.planes.size() > 1) query.blocked_planes.set(plane_dist(rng));
+        }
+        SetExpectedResults(graph, queries);
+
+        const auto name = CorpusName(named.name);
+        if (!WriteQueryCorpus(out_dir, name, named.map, queries)) {
+            printf("%s: failed to write %s\n", named.name.c_str(), (out_dir / name).string().c_str());
+            return false;
+        }
+        const auto failed = std::ranges::count_if(queries, [](const CorpusQuery& q) { return q.error != Error::OK; });
+        printf("%s: recorded %zu queries (%td without a path) in %.1f ms\n", name.c_str(), queries.size(), failed, ElapsedMs(start));
+        return true;
+    }
+
+    bool ReadReport(const std::filesystem::path& path, nlohmann::json& out)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        std::stringstream text;
+        text << file.rdbuf();
+        out = nlohmann::json::parse(text.str(), nullptr, false);
+        return !out.is_discarded() && out.is_object();
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    uint32_t record = 0;
+    uint32_t seed = 1;
+    bool synthetic = false;
+    uint32_t synthetic_count = 2;
+    std::filesystem::path report_path;
+    std::vector<std::filesystem::path> args;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            options.threads = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--repeat" && i + 1 < argc) {
+            options.repeat = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--tolerance" && i + 1 < argc) {
+            options.tolerance = strtod(argv[++i], nullptr);
+        }
+        else if (arg == "--max-slowdown" && i + 1 < argc) {
+            options.max_slowdown = strtod(argv[++i], nullptr);
+        }
+        else if (arg == "--report" && i + 1 < argc) {
+            report_path = argv[++i];
+        }
+        else if (arg == "--compare" && i + 1 < argc) {
+            if (!ReadReport(argv[++i], options.baseline)) {
+                printf("%s: not a report\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (arg == "--record" && i + 1 < argc) {
+            record = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--synthetic") {
+            synthetic = true;
+            if (i + 1 < argc && isdigit(static_cast<unsigned char>(argv[i + 1][0]))) synthetic_count = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else {
+            args.push_back(arg);
+        }
+    }
+
+    if (record) {
+        if (args.empty() || (args.size() == 1 && !synthetic)) {
+            printf("Usage: %s --record N [--seed S] [--threads T] <out directory> <map.ffna | maps.gwmp | directory>... | --synthetic [count]\n", argv[0]);
+            return 1;
+        }
+        const auto out_dir = args[0];
+        std::filesystem::create_directories(out_dir);
+        std::vector<NamedMap> maps;
+        for (size_t i = 1; i < args.size(); ++i) {
+            if (std::filesystem::is_directory(args[i])) {
+                std::vector<std::filesystem::path> files;
+                for (const auto& entry : std::filesystem::directory_iterator(args[i])) {
+                    if (entry.is_regular_file()) files.push_back(entry.path());
+                }
+                std::ranges::sort(files);
+                for (const auto& file : files)
+                    LoadMapFile(file, maps);
+            }
+            else {
+                LoadMapFile(args[i], maps);
+            }
+        }
+        if (synthetic) {
+            for (uint32_t i = 0; i < synthetic_count; ++i) {
+                const uint32_t bands = 24 + 16 * i, bricks = 10 + 4 * i;
+                char name[64];
+                snprintf(name, sizeof(name), "synthetic_%ux%u", bands, bricks);
+                maps.push_back({name, MakeSyntheticMap(bands, bricks, seed + i)});
+            }
+        }
+        int failed = 0;
+        for (const auto& map : maps) {
+            if (!RecordCorpus(map, out_dir, record, seed, options.threads)) failed++;
+        }
+        return failed || maps.empty() ? 2 : 0;
+    }
+
+    std::vector<std::filesystem::path> corpora;
+    for (const auto& arg : args) {
+        if (std::filesystem::is_directory(arg)) {
+            std::vector<std::filesystem::path> files;
+            for (const auto& entry : std::filesystem::directory_iterator(arg)) {
+                if (entry.is_regular_file() && entry.path().filename().string().ends_with(CORPUS_QUERIES_EXTENSION)) files.push_back(entry.path());
+            }
+            std::ranges::sort(files);
+            corpora.insert(corpora.end(), files.begin(), files.end());
+        }
+        else {
+            corpora.push_back(arg);
+        }
+    }
+    if (corpora.empty()) {
+        printf("Usage: %s [--threads T] [--repeat R] [--tolerance F] [--report FILE] [--compare FILE] [--max-slowdown P] <corpus directory | name.queries.json>...\n", argv[0]);
+        return 1;
+    }
+
+    int failed = 0;
+    nlohmann::json report = nlohmann::json::object();
+    const auto start = Clock::now();
+    for (const auto& corpus : corpora) {
+        if (!RunCorpus(corpus, options, report)) failed++;
+    }
+    printf("total: %zu maps in %.1f ms, %d failed\n", corpora.size(), ElapsedMs(start), failed);
+    if (!report_path.empty()) {
+        std::ofstream file(report_path, std::ios::binary);
+        file << report.dump(2) << '\n';
+        if (!file) {
+            printf("%s: failed to write report\n", report_path.string().c_str());
+            return 2;
+        }
+    }
+    return failed ? 2 : 0;
+}
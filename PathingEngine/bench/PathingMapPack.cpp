@@ -0,0 +1,142 @@
+// Builds a map pack (see MapPack.h) from raw map files.
+//
+// Usage:
+//   PathingMapPack [options] <out.gwmp> <map.ffna | directory>...
+//   PathingMapPack [options] <out.gwmp> --synthetic [count]
+//
+// Options:
+//   --threads T   threads parsing the map files (default: one per core)
+//
+// Map files are named as for PathingBench. --synthetic packs count synthetic
+// maps of different sizes (default 32) instead, encoded as map files first.
+// Every map is then read back from the pack and compared against a fresh
+// parse of its file.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <MapPack.h>
+#include <PathingMapDataParser.h>
+
+#include "BenchMaps.h"
+
+namespace {
+    using namespace Pathing;
+    using namespace Pathing::Bench;
+    using Clock = std::chrono::steady_clock;
+
+    double ElapsedMs(Clock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t threads = 0;
+    bool synthetic = false;
+    uint32_t synthetic_count = 32;
+    std::filesystem::path out_path;
+    std::map<uint32_t, std::filesystem::path> files; // map file id -> path
+
+    const auto add_file = [&files](const std::filesystem::path& path) {
+        const auto id = FileIdFromName(path);
+        if (!files.emplace(id, path).second) printf("%s: map file id %#x already added, skipped\n", path.string().c_str(), id);
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--synthetic") {
+            synthetic = true;
+            if (i + 1 < argc && isdigit(static_cast<unsigned char>(argv[i + 1][0]))) synthetic_count = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (out_path.empty()) {
+            out_path = arg;
+        }
+        else if (std::filesystem::is_directory(arg)) {
+            for (const auto& entry : std::filesystem::directory_iterator(arg)) {
+                if (entry.is_regular_file()) add_file(entry.path());
+            }
+        }
+        else {
+            add_file(arg);
+        }
+    }
+
+    if (out_path.empty() || (files.empty() && !synthetic)) {
+        printf("Usage: %s [--threads T] <out.gwmp> <map.ffna | directory>... | --synthetic [count]\n", argv[0]);
+        return 1;
+    }
+
+    // Synthetic maps are kept as encoded map files in memory
+    std::map<uint32_t, std::vector<uint8_t>> synthetic_files;
+    if (synthetic) {
+        for (uint32_t i = 0; i < synthetic_count; ++i) {
+            auto map = MakeSyntheticMap(16 + i % 48, 8 + i % 24, i + 1);
+            synthetic_files[0x10000 + i] = EncodeFFNA(map);
+        }
+    }
+    const auto read = [&](uint32_t map_file_id, std::vector<uint8_t>& out) {
+        if (synthetic) {
+            const auto found = synthetic_files.find(map_file_id);
+            if (found == synthetic_files.end()) return false;
+            out = found->second;
+            return true;
+        }
+        const auto found = files.find(map_file_id);
+        return found != files.end() && ReadFile(found->second, out);
+    };
+
+    std::vector<uint32_t> ids;
+    for (const auto& [id, _] : synthetic_files) {
+        ids.push_back(id);
+    }
+    for (const auto& [id, _] : files) {
+        ids.push_back(id);
+    }
+
+    auto start = Clock::now();
+    MapPackStats stats;
+    if (!BuildMapPack(out_path, ids, read, threads, &stats)) {
+        printf("%s: failed to write\n", out_path.string().c_str());
+        return 2;
+    }
+    printf("build: %u maps in %.1f ms, %.1f MB of map files read, %.1f MB written, %u unreadable, %u without pathing data\n", stats.maps, ElapsedMs(start), stats.bytes_read / (1024.0 * 1024.0), stats.bytes_written / (1024.0 * 1024.0),
+           stats.unreadable, stats.without_pathing);
+
+    start = Clock::now();
+    MapPack pack;
+    if (!pack.Open(out_path)) {
+        printf("%s: failed to open\n", out_path.string().c_str());
+        return 2;
+    }
+    const double open_ms = ElapsedMs(start);
+
+    // Every map in the pack must match its file, and every map file with pathing data must be in the pack
+    size_t mismatches = 0;
+    double load_ms = 0.0;
+    std::vector<uint8_t> bytes;
+    for (const auto id : ids) {
+        PathingMapData expected;
+        const bool has_pathing = read(id, bytes) && LoadPathingMapDataFromFFNA(bytes.data(), bytes.size(), id, &expected);
+        PathingMapData loaded;
+        start = Clock::now();
+        const bool in_pack = pack.Load(id, loaded);
+        load_ms += ElapsedMs(start);
+        if (has_pathing != in_pack || (in_pack && !IsSameMapData(expected, loaded))) {
+            printf("%#x: pack doesn't match the map file\n", id);
+            mismatches++;
+        }
+    }
+    printf("check: open %.2f ms, %.3f ms per map loaded, %zu mismatches\n", open_ms, pack.GetMapCount() ? load_ms / pack.GetMapCount() : 0.0, mismatches);
+    return mismatches ? 2 : 0;
+}
@@ -210,6 +210,11 @@ void CurlEasy::SetTcpNoDelay(const bool enable)
     CHECK_CURL_EASY_SETOPT(this, CURLOPT_TCP_NODELAY, static_cast<long>(enable));
 }
 
+void CurlEasy::SetTcpKeepAlive(const bool enable)
+{
+    CHECK_CURL_EASY_SETOPT(this, CURLOPT_TCP_KEEPALIVE, static_cast<long>(enable));
+}
+
 void CurlEasy::SetVerifyPeer(const bool enable)
 {
     CHECK_CURL_EASY_SETOPT(this, CURLOPT_SSL_VERIFYPEER, static_cast<long>(enable));
@@ -311,7 +316,8 @@ void CurlEasy::SetUploadFile(FILE* file, const size_t size)
 
 void CurlEasy::SetUploadFile(const char* path)
 {
-    if (fopen_s(&m_File, path, "rb") != 0) {
+    m_File = fopen(path, "rb");
+    if (m_File) {
         SetUploadFile(m_File);
     }
 }
@@ -481,7 +487,7 @@ size_t CurlEasy::ReadBufferCallback(char* buffer, const size_t size, const size_
     UploadBuffer* stream = &easy->m_UploadBuffer;
     const size_t count = size * nitems;
     const size_t bytes = std::min<size_t>(count, stream->size - stream->rpos);
-    memcpy(buffer, stream->data, bytes);
+    memcpy(buffer, stream->data + stream->rpos, bytes);
     stream->rpos += bytes;
     return bytes;
 }
@@ -538,6 +544,149 @@ void CurlMulti::Perform() const
     }
 }
 
+void CurlMulti::SetMaxHostConnections(const long amount) const
+{
+    curl_multi_setopt(m_Handle, CURLMOPT_MAX_HOST_CONNECTIONS, amount);
+}
+
+void CurlMulti::SetMaxTotalConnections(const long amount) const
+{
+    curl_multi_setopt(m_Handle, CURLMOPT_MAX_TOTAL_CONNECTIONS, amount);
+}
+
+void CurlMulti::SetMultiplexing(const bool enable) const
+{
+    curl_multi_setopt(m_Handle, CURLMOPT_PIPELINING, enable ? CURLPIPE_MULTIPLEX : CURLPIPE_NOTHING);
+}
+
+void CurlMulti::Poll(const int TimeoutMs) const
+{
+    const CURLMcode code = curl_multi_poll(m_Handle, nullptr, 0, TimeoutMs, nullptr);
+    if (code != CURLM_OK) {
+        fprintf(stderr, "Error in 'CurlMulti::Poll': %s\n", curl_multi_strerror(code));
+    }
+}
+
+void CurlMulti::Wakeup() const
+{
+    curl_multi_wakeup(m_Handle);
+}
+
+CurlMultiLoop::CurlMultiLoop() = default;
+
+bool CurlMultiLoop::IsRunning(const CurlEasy* Handle) const
+{
+    return std::find(m_Running.begin(), m_Running.end(), Handle) != m_Running.end();
+}
+
+void CurlMultiLoop::Add(CurlEasy* Handle)
+{
+    {
+        std::lock_guard Lock(m_Mutex);
+        m_Adding.push_back(Handle);
+    }
+    m_Multi.Wakeup();
+}
+
+void CurlMultiLoop::Remove(CurlEasy* Handle)
+{
+    std::unique_lock Lock(m_Mutex);
+    const auto it = std::find(m_Adding.begin(), m_Adding.end(), Handle);
+    if (it != m_Adding.end()) {
+        m_Adding.erase(it);
+        return;
+    }
+    if (!IsRunning(Handle)) {
+        return;
+    }
+    // The multi handle is only touched by the loop thread, so have it detach Handle
+    m_Removing.push_back(Handle);
+    m_Multi.Wakeup();
+    m_Removed.wait(Lock, [this, Handle] { return !IsRunning(Handle); });
+}
+
+void CurlMultiLoop::RunOnce(const int TimeoutMs)
+{
+    {
+        std::lock_guard Lock(m_Mutex);
+        for (CurlEasy* easy : m_Removing) {
+            // May have completed since Remove was called
+            if (!IsRunning(easy)) continue;
+            m_Multi.RemoveHandle(easy);
+            m_Running.erase(std::find(m_Running.begin(), m_Running.end(), easy));
+        }
+        if (!m_Removing.empty()) {
+            m_Removing.clear();
+            m_Removed.notify_all();
+        }
+        for (CurlEasy* easy : m_Adding) {
+            m_Multi.AddHandle(easy);
+            m_Running.push_back(easy);
+        }
+        m_Adding.clear();
+    }
+
+    m_Multi.Perform();
+
+    int MsgsLeft;
+    while (const CURLMsg* pMsg = curl_multi_info_read(m_Multi.GetHandle(), &MsgsLeft)) {
+        if (pMsg->msg != CURLMSG_DONE) continue;
+        CurlEasy* easy = nullptr;
+        {
+            std::lock_guard Lock(m_Mutex);
+            for (CurlEasy* running : m_Running) {
+                if (running->m_Handle == pMsg->easy_handle) {
+                    easy = running;
+                    break;
+                }
+            }
+        }
+        if (!easy) continue;
+        const int result = pMsg->data.result;
+        m_Multi.RemoveHandle(easy);
+        // Stays in m_Running until the callback returns, so Remove can't return while it's still in use;
+        // the callback may destroy easy
+        easy->OnMultiCompleted(result);
+        {
+            std::lock_guard Lock(m_Mutex);
+            m_Running.erase(std::find(m_Running.begin(), m_Running.end(), easy));
+        }
+        m_Removed.notify_all();
+    }
+
+    m_Multi.Poll(TimeoutMs);
+}
+
+void CurlMultiLoop::RemoveAll()
+{
+    std::vector<CurlEasy*> Aborted;
+    {
+        std::lock_guard Lock(m_Mutex);
+        for (CurlEasy* easy : m_Running) {
+            m_Multi.RemoveHandle(easy);
+            // Whoever is removing these completes them
+            if (std::find(m_Removing.begin(), m_Removing.end(), easy) == m_Removing.end()) {
+                Aborted.push_back(easy);
+            }
+        }
+        Aborted.insert(Aborted.end(), m_Adding.begin(), m_Adding.end());
+        m_Running.clear();
+        m_Adding.clear();
+        m_Removing.clear();
+    }
+    m_Removed.notify_all();
+    // Their owners may be waiting on them; the callbacks may destroy them
+    for (CurlEasy* easy : Aborted) {
+        easy->OnMultiCompleted(CURLE_ABORTED_BY_CALLBACK);
+    }
+}
+
+size_t CurlMultiLoop::GetTransferCount()
+{
+    std::lock_guard Lock(m_Mutex);
+    return m_Running.size() + m_Adding.size();
+}
+
 void ComposeUrl(std::string& url, const char* host, const char* path)
 {
     url.append(host);
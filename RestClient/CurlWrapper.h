@@ -3,8 +3,11 @@
 // Comment and put in precompiled header if you want :)
 #include <curl/curl.h>
 #include <stdint.h>
+#include <condition_variable>
+#include <mutex>
 #include <string>
 #include <initializer_list>
+#include <vector>
 
 #if defined(CURL_STRICTER)
 typedef struct Curl_easy CURL;
@@ -54,6 +57,7 @@ using ParamField = std::pair<const char*, const char*>;
 
 class CurlEasy {
     friend class CurlMulti;
+    friend class CurlMultiLoop;
 
 public:
     CurlEasy();
@@ -78,6 +82,8 @@ public:
     void SetMaxRedirects(int amount);
     void SetNoBody(bool enable);
     void SetTcpNoDelay(bool enable);
+    // TCP keep-alive probes, so an idle connection kept for reuse isn't silently dropped
+    void SetTcpKeepAlive(bool enable);
     void SetVerifyPeer(bool enable);
     void SetVerifyHost(bool enable);
     void SetFollowLocation(bool enable);
@@ -121,6 +127,13 @@ public:
 protected:
     void UpdateStatus(int CurlStatus);
 
+    // Called by CurlMultiLoop, on its thread, once the transfer is done and the handle is detached
+    virtual void OnMultiCompleted(int CurlStatus)
+    {
+        UpdateStatus(CurlStatus);
+        OnPerformed();
+    }
+
     // OnPerformed is executed in the context of the global curl thread which means
     // that you need to be careful when destruction the object. If OnPerformed access
     // any member variable, be sure to call Abort before the member variable start
@@ -196,12 +209,57 @@ public:
 
     void Perform() const;
 
+    // Transfers to the same host beyond this wait in curl for a connection to free up; 0 is unlimited
+    void SetMaxHostConnections(long amount) const;
+    void SetMaxTotalConnections(long amount) const;
+    // Run HTTP/2 requests to the same host as streams over one connection
+    void SetMultiplexing(bool enable) const;
+
+    // Waits up to TimeoutMs for activity on any transfer, or until Wakeup is called
+    void Poll(int TimeoutMs) const;
+    // Thread-safe; makes a Poll in progress return
+    void Wakeup() const;
+
 protected:
     CURLM* m_Handle;
 
     CurlMulti& operator=(const CurlMulti&) = delete;
 };
 
+// Runs transfers on one multi handle, so they share its connections (keep-alive, HTTP/2 multiplexing)
+// and wait on each other only where the connection caps say so.
+// RunOnce is called in a loop from one thread; Add and Remove can be called from any other.
+// Connections stay open between transfers and are reused by later requests to the same host.
+class CurlMultiLoop {
+public:
+    CurlMultiLoop();
+
+    const CurlMulti& GetMulti() const { return m_Multi; }
+
+    // The transfer starts on the next RunOnce; OnMultiCompleted is called on the loop thread when done.
+    // Response state is left as it is; the owner clears it first (AsyncRestClient::ExecuteAsync does)
+    void Add(CurlEasy* Handle);
+    // Returns once the loop is no longer using Handle. Don't call from the loop thread (e.g. in OnMultiCompleted).
+    void Remove(CurlEasy* Handle);
+
+    // Starts added transfers, progresses all of them and waits up to TimeoutMs for more to do
+    void RunOnce(int TimeoutMs);
+    // Detaches everything still running or waiting to start and completes it as aborted. Don't call while RunOnce is running.
+    void RemoveAll();
+
+    size_t GetTransferCount();
+
+private:
+    bool IsRunning(const CurlEasy* Handle) const;
+
+    CurlMulti m_Multi;
+    std::mutex m_Mutex;
+    std::condition_variable m_Removed;
+    std::vector<CurlEasy*> m_Adding;   // guarded by m_Mutex
+    std::vector<CurlEasy*> m_Removing; // guarded by m_Mutex
+    std::vector<CurlEasy*> m_Running;  // attached to m_Multi; written by the loop thread under m_Mutex
+};
+
 void ComposeUrl(std::string& url, const char* host, const char* path);
 void ComposeUrl(std::string& url, Protocol proto,
                 const char* host, const char* path);
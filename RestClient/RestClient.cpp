@@ -4,117 +4,56 @@
 
 #include "RestClient.h"
 
+// Drives every AsyncRestClient through one CurlMultiLoop, so requests share connections
 class CurlMultiThread : public Thread {
-    using Container = std::deque<AsyncRestClient*>;
-
 public:
+    // Like a browser; requests beyond this to one host queue in curl until a connection frees up
+    static constexpr long MAX_HOST_CONNECTIONS = 6;
+
     CurlMultiThread()
-        : m_pMulti(nullptr)
     {
         SetThreadName("CurlMultiThread");
     }
 
     void Start()
     {
+        m_Loop = std::make_unique<CurlMultiLoop>();
+        m_Loop->GetMulti().SetMaxHostConnections(MAX_HOST_CONNECTIONS);
+        m_Loop->GetMulti().SetMultiplexing(true);
         m_Running = true;
         StartThread();
-
-        // @Remark:
-        // Not ideal, but we have to wait for 'm_pMulti' to be setted and it is in the thread.
-        // Otherwise, there is cases where 'CurlMultiThread::Execute' block.
-        while (!m_pMulti) {
-            Sleep(1);
-        }
     }
 
     void Stop()
     {
         m_Running = false;
+        m_Loop->GetMulti().Wakeup();
         Join();
+        m_Loop->RemoveAll();
+        m_Loop.reset();
     }
 
-    void Execute(AsyncRestClient* pClient)
+    void Execute(AsyncRestClient* pClient) const
     {
-        std::lock_guard Lock(m_Mutex);
-        m_Clients.push_back(pClient);
-        m_pMulti->AddHandle(pClient);
+        m_Loop->Add(pClient);
     }
 
-    void Abort(AsyncRestClient* pClient)
+    void Abort(AsyncRestClient* pClient) const
     {
-        std::lock_guard Lock(m_Mutex);
-        const auto it = Search(pClient);
-        if (it != m_Clients.end()) {
-            m_pMulti->RemoveHandle(pClient);
-            m_Clients.erase(it);
-        }
+        m_Loop->Remove(pClient);
     }
 
 private:
     void Run() override
     {
-        CurlMulti m_Multi;
-        m_pMulti = &m_Multi;
-
         while (m_Running) {
-            {
-                std::lock_guard Lock(m_Mutex);
-                m_Multi.Perform();
-
-                int MsgsLeft;
-                const CURLMsg* pMsg = curl_multi_info_read(m_Multi.GetHandle(), &MsgsLeft);
-                while (pMsg) {
-                    AsyncRestClient* pClient = SearchPop(pMsg->easy_handle);
-                    m_Multi.RemoveHandle(pClient);
-                    pClient->OnCompletion(pMsg->data.result);
-
-                    pMsg = curl_multi_info_read(m_Multi.GetHandle(), &MsgsLeft);
-                }
-            }
-
-            Sleep(16);
-        }
-
-        m_pMulti = nullptr;
-    }
-
-    Container::iterator Search(const CURL* pHandle)
-    {
-        Container::iterator it;
-        for (it = m_Clients.begin(); it != m_Clients.end(); ++it) {
-            if ((*it)->GetHandle() == pHandle) {
-                break;
-            }
-        }
-        return it;
-    }
-
-    Container::iterator Search(const AsyncRestClient* pClient)
-    {
-        Container::iterator it;
-        for (it = m_Clients.begin(); it != m_Clients.end(); ++it) {
-            if (*it == pClient) {
-                break;
-            }
-        }
-        return it;
-    }
-
-    AsyncRestClient* SearchPop(const CURL* pHandle)
-    {
-        const auto it = Search(pHandle);
-        if (it == m_Clients.end()) {
-            return nullptr;
+            // Returns as soon as a transfer needs attention or Execute/Stop wakes it
+            m_Loop->RunOnce(1000);
         }
-        AsyncRestClient* pClient = *it;
-        m_Clients.erase(it);
-        return pClient;
     }
 
-    Container m_Clients;
-    CurlMulti* m_pMulti;
-    std::atomic<bool> m_Running;
-    std::recursive_mutex m_Mutex;
+    std::unique_ptr<CurlMultiLoop> m_Loop;
+    std::atomic<bool> m_Running = false;
 };
 
 static CurlMultiThread s_RestThread;
@@ -193,9 +132,21 @@ void AsyncRestClient::Abort()
     }
 }
 
-void AsyncRestClient::OnCompletion(const int Status)
+void AsyncRestClient::SetCompletionCallback(std::function<void(AsyncRestClient&)> callback)
+{
+    assert(!IsPending());
+    m_OnCompletion = std::move(callback);
+}
+
+void AsyncRestClient::OnMultiCompleted(const int Status)
 {
     UpdateStatus(Status);
     OnPerformed();
+    // Taken first; the callback is allowed to delete this
+    const auto callback = std::move(m_OnCompletion);
+    m_OnCompletion = nullptr;
     m_Event.SetDone();
+    if (callback) {
+        callback(*this);
+    }
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Event.h>
+#include <functional>
 
 #include "CurlWrapper.h"
 
@@ -70,8 +71,14 @@ public:
     void ExecuteAsync();
     void Abort();
 
-    void OnCompletion(int Status);
+    // Called on the curl thread once the request is done. The callback then owns the client and may delete it,
+    // so don't also Wait on a client that has one. It shouldn't block; hand anything slow to another thread.
+    void SetCompletionCallback(std::function<void(AsyncRestClient&)> callback);
+
+protected:
+    void OnMultiCompleted(int Status) override;
 
 private:
     Event m_Event;
+    std::function<void(AsyncRestClient&)> m_OnCompletion;
 };
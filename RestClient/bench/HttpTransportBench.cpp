@@ -0,0 +1,283 @@
+// Throughput of many small requests against a local loopback HTTP server:
+//   old - what Resources::Download did before CurlMultiLoop: a pool of worker threads, each request a
+//         fresh CurlEasy doing a blocking transfer on a new connection
+//   new - every request on one CurlMultiLoop, reusing kept-alive connections up to a per-host cap
+//
+//   HttpTransportBench [--requests 500] [--workers 20] [--host-connections 6]
+//                      [--handshake-ms 20] [--latency-ms 1] [--body 512]
+//
+// The server sleeps handshake-ms on every new connection, standing in for the TCP+TLS handshake a
+// real host costs, and latency-ms before every response. Exits non-zero if any request fails.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+using Socket = SOCKET;
+constexpr Socket INVALID = INVALID_SOCKET;
+static void CloseSocket(const Socket s) { closesocket(s); }
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using Socket = int;
+constexpr Socket INVALID = -1;
+static void CloseSocket(const Socket s) { close(s); }
+#endif
+
+#include "CurlWrapper.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        int requests = 500;
+        int workers = 20;          // Resources' worker count before the transport change
+        int host_connections = 6;  // CurlMultiThread::MAX_HOST_CONNECTIONS
+        int handshake_ms = 20;
+        int latency_ms = 1;
+        size_t body = 512;
+    };
+
+    // HTTP/1.1 with keep-alive, one thread per connection; just enough for curl
+    class LoopbackServer {
+    public:
+        LoopbackServer(const Options& options)
+            : options(options)
+        {
+            listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = 0;
+            if (listener == INVALID || bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listener, 128) != 0) {
+                fprintf(stderr, "Failed to start the loopback server\n");
+                exit(1);
+            }
+            socklen_t len = sizeof(addr);
+            getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len);
+            port = ntohs(addr.sin_port);
+            response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: " + std::to_string(options.body) + "\r\n\r\n" + std::string(options.body, 'x');
+            accept_thread = std::thread([this] { AcceptLoop(); });
+        }
+
+        ~LoopbackServer()
+        {
+            stopping = true;
+            // Unblocks accept()
+            const Socket poke = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = htons(port);
+            connect(poke, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+            CloseSocket(poke);
+            accept_thread.join();
+            CloseSocket(listener);
+            for (auto& t : connection_threads) {
+                t.join();
+            }
+        }
+
+        uint16_t GetPort() const { return port; }
+        uint64_t GetConnections() const { return connections; }
+
+    private:
+        void AcceptLoop()
+        {
+            while (true) {
+                const Socket client = accept(listener, nullptr, nullptr);
+                if (stopping) {
+                    if (client != INVALID) CloseSocket(client);
+                    return;
+                }
+                if (client == INVALID) continue;
+                connections++;
+                connection_threads.emplace_back([this, client] { Serve(client); });
+            }
+        }
+
+        void Serve(const Socket client)
+        {
+            int one = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+            std::this_thread::sleep_for(std::chrono::milliseconds(options.handshake_ms));
+            std::string pending;
+            char buffer[4096];
+            while (true) {
+                const auto received = recv(client, buffer, sizeof(buffer), 0);
+                if (received <= 0) break;
+                pending.append(buffer, static_cast<size_t>(received));
+                // Requests are GETs without bodies, so each ends at the blank line
+                size_t end;
+                while ((end = pending.find("\r\n\r\n")) != std::string::npos) {
+                    pending.erase(0, end + 4);
+                    std::this_thread::sleep_for(std::chrono::milliseconds(options.latency_ms));
+                    if (send(client, response.data(), static_cast<int>(response.size()), 0) != static_cast<int>(response.size())) {
+                        CloseSocket(client);
+                        return;
+                    }
+                }
+            }
+            CloseSocket(client);
+        }
+
+        const Options& options;
+        Socket listener = INVALID;
+        uint16_t port = 0;
+        std::string response;
+        std::atomic<bool> stopping = false;
+        std::atomic<uint64_t> connections = 0;
+        std::thread accept_thread;
+        std::vector<std::thread> connection_threads; // only touched by the accept thread until it's joined
+    };
+
+    // Same options as Resources' InitRestClient
+    void InitRequest(CurlEasy& r, const std::string& url)
+    {
+        r.SetUserAgent("HttpTransportBench");
+        r.SetFollowLocation(true);
+        r.SetMethod(HttpMethod::Get);
+        r.SetConnectTimeoutSec(5);
+        r.SetTimeoutSec(30);
+        r.SetTcpKeepAlive(true);
+        r.SetUrl(url.c_str());
+    }
+
+    bool Succeeded(CurlEasy& r, const size_t body)
+    {
+        return r.GetStatus() == ResponseStatus::Completed && r.GetStatusCode() == 200 && r.GetContent().size() == body;
+    }
+
+    struct Result {
+        double seconds = 0;
+        int failed = 0;
+        uint64_t connections = 0;
+    };
+
+    Result RunOld(const Options& options)
+    {
+        const LoopbackServer server(options);
+        const auto url = "http://127.0.0.1:" + std::to_string(server.GetPort()) + "/old";
+        std::atomic<int> next = 0;
+        std::atomic<int> failed = 0;
+        const auto started = Clock::now();
+        std::vector<std::thread> workers;
+        for (int i = 0; i < options.workers; i++) {
+            workers.emplace_back([&] {
+                while (next++ < options.requests) {
+                    CurlEasy r;
+                    InitRequest(r, url);
+                    r.Perform();
+                    if (!Succeeded(r, options.body)) failed++;
+                }
+            });
+        }
+        for (auto& t : workers) {
+            t.join();
+        }
+        return {std::chrono::duration<double>(Clock::now() - started).count(), failed, server.GetConnections()};
+    }
+
+    class BenchRequest : public CurlEasy {
+    public:
+        BenchRequest(std::atomic<int>& remaining, std::atomic<int>& failed, const size_t body)
+            : remaining(remaining), failed(failed), body(body) {}
+
+    protected:
+        void OnMultiCompleted(const int CurlStatus) override
+        {
+            CurlEasy::OnMultiCompleted(CurlStatus);
+            if (!Succeeded(*this, body)) failed++;
+            remaining--;
+        }
+
+    private:
+        std::atomic<int>& remaining;
+        std::atomic<int>& failed;
+        size_t body;
+    };
+
+    Result RunNew(const Options& options)
+    {
+        const LoopbackServer server(options);
+        const auto url = "http://127.0.0.1:" + std::to_string(server.GetPort()) + "/new";
+        CurlMultiLoop loop;
+        loop.GetMulti().SetMaxHostConnections(options.host_connections);
+        loop.GetMulti().SetMultiplexing(true);
+        std::atomic<int> remaining = options.requests;
+        std::atomic<int> failed = 0;
+        std::atomic<bool> running = true;
+        std::thread loop_thread([&] {
+            while (running) {
+                loop.RunOnce(1000);
+            }
+        });
+
+        std::vector<std::unique_ptr<BenchRequest>> requests;
+        const auto started = Clock::now();
+        for (int i = 0; i < options.requests; i++) {
+            auto& r = requests.emplace_back(std::make_unique<BenchRequest>(remaining, failed, options.body));
+            InitRequest(*r, url);
+            loop.Add(r.get());
+        }
+        while (remaining > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        const auto seconds = std::chrono::duration<double>(Clock::now() - started).count();
+        running = false;
+        loop.GetMulti().Wakeup();
+        loop_thread.join();
+        requests.clear();
+        return {seconds, failed, server.GetConnections()};
+    }
+
+    void Print(const char* name, const Options& options, const Result& result)
+    {
+        printf("%-4s %8.3f s %9.1f req/s %6llu connections %4d failed\n", name, result.seconds, options.requests / result.seconds,
+               static_cast<unsigned long long>(result.connections), result.failed);
+    }
+} // namespace
+
+int main(const int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (has_value && strcmp(argv[i], "--requests") == 0) options.requests = atoi(argv[++i]);
+        else if (has_value && strcmp(argv[i], "--workers") == 0) options.workers = atoi(argv[++i]);
+        else if (has_value && strcmp(argv[i], "--host-connections") == 0) options.host_connections = atoi(argv[++i]);
+        else if (has_value && strcmp(argv[i], "--handshake-ms") == 0) options.handshake_ms = atoi(argv[++i]);
+        else if (has_value && strcmp(argv[i], "--latency-ms") == 0) options.latency_ms = atoi(argv[++i]);
+        else if (has_value && strcmp(argv[i], "--body") == 0) options.body = static_cast<size_t>(atoll(argv[++i]));
+        else {
+            fprintf(stderr, "Usage: %s [--requests N] [--workers N] [--host-connections N] [--handshake-ms N] [--latency-ms N] [--body BYTES]\n", argv[0]);
+            return 1;
+        }
+    }
+#ifdef _WIN32
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+    InitCurl();
+    printf("%d requests of %zu bytes, %d ms handshake, %d ms latency\n", options.requests, options.body, options.handshake_ms, options.latency_ms);
+    const auto old_result = RunOld(options);
+    Print("old", options, old_result);
+    const auto new_result = RunNew(options);
+    Print("new", options, new_result);
+    printf("speedup %.2fx\n", old_result.seconds / new_result.seconds);
+    ShutdownCurl();
+    return old_result.failed || new_result.failed ? 2 : 0;
+}
@@ -3,12 +3,18 @@
 #include <assert.h>
 #include <stdint.h>
 
+#include <string.h>
+
 #include <algorithm>
 #include <atomic>
+#include <condition_variable>
 #include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <utility>
+#include <vector>
 
 #define CURL_STATICLIB
 #include <curl/curl.h>